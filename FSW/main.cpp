@@ -21,6 +21,13 @@
 #include "src/headers/timing.hpp"
 #include "src/headers/dataCollection.hpp"
 #include "src/headers/faultManager.hpp"
+#include "src/headers/fileCatalog.hpp"
+#include "src/headers/recordStore.hpp"
+#include "src/headers/flashQueue.hpp"
+#include "src/headers/scrubber.hpp"
+#include "src/headers/hkHistory.hpp"
+#include "src/headers/blackBox.hpp"
+#include "src/headers/spiBus.hpp"
 
 /* - - - - - - Functions - - - - - - */
 
@@ -56,6 +63,9 @@ bool init() {
     pinMode(PIN_ANALOG_THERM, INPUT);
     pinMode(PIN_OPTICS_THERM, INPUT);
 
+    // begin the SPI bus once, the science ADC has priority over flash transfers on it
+    initSpiBus(scienceSampleDue);
+
     scienceMode.setPointingAtSun(true);
 
     // lockout duration has to be initialized with a default value during compilation,
@@ -72,6 +82,36 @@ bool init() {
     resetFaultCounts(); // reset fault occurence counts
     recordNewStart();   // record the startup and check if it was expected
 
+    // mount the science record store, the catalog checks interrupted files against it
+    if (!initRecordStore()) {
+        Serial.println("Record store unavailable, science data will not be saved.");
+    }
+
+    // load the science file catalog
+    if (fileCatalog.load()) {
+        Serial.print("Catalog loaded, ");
+        Serial.print(fileCatalog.count());
+        Serial.println(" science file(s).");
+    } else {
+        Serial.println("No science file catalog found, starting empty.");
+    }
+
+    // pick up a science window interrupted by a reset
+    recoverScienceWindow();
+
+    // carry on with a flash scrub interrupted by a reset
+    initScrubber();
+
+    // index the housekeeping history kept on flash
+    if (!initHkHistory()) {
+        Serial.println("Housekeeping history will not be stored.");
+    }
+
+    // index the black box kept on flash, events logged so far are stored with the next block
+    if (!initBlackBox()) {
+        Serial.println("Black box events will not be stored.");
+    }
+
     // Sample housekeeping data
     handleHousekeeping(); 
     
@@ -106,6 +146,11 @@ int main() {
         /* ===== ALWAYS EXECUTE ===== */
         commandHandling(); // handle commands
         handleFaults();    // handle faults
+        handleStorage();   // drop a flash module that stops responding
+        handleFlashQueue(); // issue queued flash reads and writes without waiting on the modules
+        handleScrub();     // scrub flash in the background within its budget
+        handleBlackBox();  // store logged events in the background
+        handleDownlink();  // send downlink frames as the serial link has room, within its budget
                                             
         if (housekeepingTimer.checkInvoked()) { // housekeeping
             handleHousekeeping(); 
@@ -125,16 +170,6 @@ int main() {
             resetFaultCounts(); // reset fault occurence counts
          }
 
-         /* ===== ONLY EXECUTE IN STANDBY MODE ===== */
-        if (scienceMode.getMode() == STANDBY_MODE) {
-            if (scrubEvent.checkInvoked()) { // scrub flash 
-                scrubFlash(); 
-            }
-            if (downlinkEvent.checkInvoked()) { // downlink files
-                downlink(); 
-            }
-        }
-
          /* ===== EXIT MAIN LOOP ===== */
         if (exitMainLoopEvent.checkInvoked()) { // exit main loop
             prepareForRestart();
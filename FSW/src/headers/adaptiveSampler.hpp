@@ -0,0 +1,49 @@
+#ifndef ADAPTIVE_SAMPLER_H
+#define ADAPTIVE_SAMPLER_H
+
+/* - - - - - - Includes - - - - - - */
+// C++ libraries
+
+// Other libraries
+
+// NS2 headers
+#include "config.hpp"
+
+/* - - - - - - Class Declaration - - - - - - */
+
+/* - AdaptiveSampler -
+*   Chooses the sampling period of the next photodiode sample from the recent signal activity.
+*   Samples fast while the slope or noise of the signal is large (sun crossing the limb)
+*   and slowly on plateaus, without ever spending more samples than fit in the science buffer.
+*/
+class AdaptiveSampler {
+    public:
+        AdaptiveSampler();
+
+        // public methods
+        void reset();
+        uint8_t update(uint16_t sample, unsigned long elapsedMsec);
+        void setThresholds(float fastSlope, float slowSlope, float noise);
+
+        // getters
+        uint8_t getRateCode() { return m_rateCode; }
+        float getSlope() { return m_slope; }
+        float getNoise();
+        float getCredit() { return m_credit; }
+
+    private:
+        // member variables
+        float m_fastSlope;          // ADC bins/sec, slope selecting the fastest rate
+        float m_slowSlope;          // ADC bins/sec, slope below which the slowest rate is selected
+        float m_noise;              // ADC bins, standard deviation selecting the fastest rate
+        float m_mean;               // ADC bins, moving average of the signal
+        float m_variance;           // ADC bins^2, moving variance of the signal
+        float m_slope;              // ADC bins/sec, moving average of the signal slope
+        float m_credit;             // samples that can still be spent above the budget rate
+        uint16_t m_lastSample;      // previous sample, for the slope
+        unsigned long m_holdMsec;   // milliseconds left before a slower rate may be selected
+        uint8_t m_rateCode;         // rate code of the next sample
+        bool m_primed;              // whether a previous sample exists
+};
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef ADCS_FEEDBACK_H
+#define ADCS_FEEDBACK_H
+
+/* - - - - - - Includes - - - - - - */
+// C++ libraries
+
+// Other libraries
+
+// NS2 headers
+#include "config.hpp"
+
+/* - - - - - - Enums - - - - - - */
+enum AdcsQuality { // signal quality flags, combined bitwise
+    ADCS_QUALITY_VALID = 1 << 0,         // value computed from a full smoothing window
+    ADCS_QUALITY_SATURATED = 1 << 1,     // newest sample is at the top of the ADC range
+    ADCS_QUALITY_BELOW_THRESH = 1 << 2,  // smoothed signal is below the sun threshold
+    ADCS_QUALITY_NOT_POINTING = 1 << 3   // ADCS has not reported pointing at the sun
+};
+
+/* - - - - - - Structs - - - - - - */
+
+/* - AdcsFeedback -
+*   Single published value of the ADCS feedback channel.
+*   Members: irradiance, derivative, quality, sampleMicros, sequence
+*/
+struct AdcsFeedback {
+    float irradiance = 0;       // volts, smoothed photodiode voltage
+    float derivative = 0;       // volts/sec, smoothed rate of change of irradiance
+    uint8_t quality = 0;        // AdcsQuality flags
+    uint32_t sampleMicros = 0;  // micros() when the newest sample was read from the ADC
+    uint32_t sequence = 0;      // number of values published before this one
+};
+
+typedef void (*AdcsFeedbackCallback)(const AdcsFeedback &feedback); // called in the sampling context on every publish
+
+/* - - - - - - Class Declaration - - - - - - */
+
+/* - AdcsMailbox -
+*   Lock-free, single writer mailbox holding the latest AdcsFeedback.
+*   The writer fills the inactive slot and then makes it active, so a reader that interrupts
+*   the writer always finds a complete value. Each slot carries a sequence count that is odd
+*   while it is being written, so a reader that is interrupted by the writer retries.
+*/
+class AdcsMailbox {
+    public:
+        AdcsMailbox();
+
+        void publish(const AdcsFeedback &value);
+        bool read(AdcsFeedback &value);
+        uint32_t getPublishCount() { return m_publishCount; }
+
+    private:
+        struct Slot {
+            volatile uint32_t seq;  // odd while the slot is being written
+            AdcsFeedback value;
+        };
+        Slot m_slots[2];
+        volatile int m_active;      // index of slot holding the latest value
+        uint32_t m_publishCount;
+};
+
+/* - - - - - - Declarations - - - - - - */
+void publishAdcsFeedback(uint16_t buffer[], int bufIdx, uint32_t sampleMicros);
+bool readAdcsFeedback(AdcsFeedback &feedback);
+void registerAdcsCallback(AdcsFeedbackCallback callback);
+void resetAdcsLatencyStats();
+void printAdcsInfo();
+
+#endif
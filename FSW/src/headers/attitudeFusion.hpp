@@ -0,0 +1,83 @@
+#ifndef ATTITUDE_FUSION_H
+#define ATTITUDE_FUSION_H
+
+/* - - - - - - Includes - - - - - - */
+// C++ libraries
+
+// Other libraries
+
+// NS2 headers
+#include "config.hpp"
+
+/* - - - - - - Structs - - - - - - */
+
+/* - AttitudeSample -
+*   A single timestamped pointing measurement from ADCS.
+*   Members: timeMicros, elevationDeg
+*/
+struct AttitudeSample {
+    uint32_t timeMicros = 0;  // micros() time the attitude was valid at
+    float elevationDeg = 0;   // degrees, elevation of the optic line of sight above the horizon
+};
+
+/* - FusionStats -
+*   Counters kept by AttitudeFusion.
+*   Members: aligned, unaligned, attitudeDropped, photoDropped
+*/
+struct FusionStats {
+    uint32_t aligned = 0;         // photodiode samples given an interpolated attitude
+    uint32_t unaligned = 0;       // photodiode samples with no attitude close enough in time
+    uint32_t attitudeDropped = 0; // attitude samples dropped because the ring was full
+    uint32_t photoDropped = 0;    // photodiode samples dropped because the pending queue was full
+};
+
+/* - - - - - - Class Declaration - - - - - - */
+
+/* - AttitudeFusion -
+*   Aligns asynchronous attitude samples with photodiode sample times.
+*   ADCS pushes attitude samples with pushAttitude() (single producer, may be an interrupt).
+*   Each photodiode sample is queued with addPhotoSample() and align() later writes the
+*   attitude linearly interpolated to its time into the attitude column. Memory is fixed:
+*   ATTITUDE_RING_SIZE attitude samples and ATTITUDE_PENDING_SIZE photodiode samples.
+*/
+class AttitudeFusion {
+    public:
+        AttitudeFusion();
+
+        // producer
+        bool pushAttitude(const AttitudeSample &sample);
+
+        // main loop
+        bool addPhotoSample(uint32_t timeMicros, int bufIdx, int16_t column[]);
+        int align(int16_t column[], uint32_t nowMicros, int maxWork);
+        void reset();
+        FusionStats getStats() { return m_stats; }
+
+        static int16_t quantize(float elevationDeg);
+        static float dequantize(int16_t code);
+
+    private:
+        struct PendingSample {
+            uint32_t timeMicros; // time photodiode sample was read
+            int bufIdx;          // column index to write the aligned attitude to
+        };
+
+        AttitudeSample m_ring[ATTITUDE_RING_SIZE];      // attitude waiting to be used
+        volatile int m_ringHead;                        // next attitude slot to write (producer)
+        volatile int m_ringTail;                        // oldest unused attitude (consumer)
+        PendingSample m_pending[ATTITUDE_PENDING_SIZE]; // photodiode samples waiting for attitude
+        int m_pendingHead;
+        int m_pendingTail;
+        AttitudeSample m_prev;                          // newest attitude at or before the oldest pending sample
+        bool m_hasPrev;
+        FusionStats m_stats;
+};
+
+/* - - - - - - Declarations - - - - - - */
+bool pushAttitude(const AttitudeSample &sample);
+void queueAttitudeAlignment(uint32_t sampleMicros, int bufIdx, int16_t column[]);
+void alignAttitude(int16_t column[]);
+void feedSimulatedAttitude();
+void printAttitudeInfo();
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef BLACK_BOX_H
+#define BLACK_BOX_H
+
+/* - - - - - - Includes - - - - - - */
+// C++ libraries
+
+// Other libraries
+
+// NS2 headers
+#include "config.hpp"
+
+/* - - - - - - Enums - - - - - - */
+enum BlackBoxEvent : uint8_t { // events logged to the black box, 6 bits
+    BB_STARTUP = 1,         // args: start count, consecutive unexpected restarts
+    BB_FAULT,               // args: fault code, occurrences
+    BB_MODE,                // args: new mode, old mode
+    BB_COMMAND,             // args: command code, first two arguments
+    BB_SCIENCE_SAVED,       // args: catalog slot, whether the record was written
+    BB_EVICTED,             // args: catalog slot, retention score
+    BB_RESTART,             // args: mode saved for the restart
+    BB_EVENT_COUNT          // KEEP THIS LAST, it is used for indexing
+};
+
+/* - - - - - - Structs - - - - - - */
+
+/* - BlackBoxEntry -
+*   An event read back from a black box block.
+*   Members: startCount, event, argc, millis, args
+*/
+struct BlackBoxEntry {
+    uint16_t startCount = 0;  // payloadData.startCount of the run that logged it
+    uint8_t event = 0;        // BlackBoxEvent
+    uint8_t argc = 0;         // arguments logged, 0 to BLACKBOX_MAX_ARGS
+    uint32_t millis = 0;      // millis() when it was logged
+    int32_t args[BLACKBOX_MAX_ARGS] = {};
+};
+
+/* - BlackBoxStats -
+*   Events logged and the flash they took, kept by BlackBox.
+*   Members: logCalls, loggedBytes, dropped, blocksWritten, blocksLost, blocksRemoved, flashBytes
+*/
+struct BlackBoxStats {
+    uint32_t logCalls = 0;      // events logged since startup
+    uint32_t loggedBytes = 0;   // bytes the logged events took
+    uint32_t dropped = 0;       // events dropped because both RAM blocks were full
+    uint32_t blocksWritten = 0; // blocks appended to the record store
+    uint32_t blocksLost = 0;    // blocks that could not be appended, their events are lost
+    uint32_t blocksRemoved = 0; // oldest blocks removed to keep BLACKBOX_BLOCKS
+    uint32_t flashBytes = 0;    // payload bytes of the written blocks
+};
+
+/* - - - - - - Class Declaration - - - - - - */
+
+/* - BlackBox -
+*   Ring of recent events kept in the record store. log() only copies the event into a RAM
+*   block, handle() appends a full or BLACKBOX_FLUSH_MSEC old block through the flash queue
+*   while logging carries on in the other one. The newest BLACKBOX_BLOCKS blocks are kept,
+*   their keys are indexed in RAM oldest first.
+*/
+class BlackBox {
+    public:
+        BlackBox();
+
+        bool begin();
+        void log(uint8_t event, uint8_t argc = 0, int32_t arg0 = 0, int32_t arg1 = 0, int32_t arg2 = 0);
+        void handle();
+        bool flush();
+
+        int blockCount() { return m_count; }
+        uint16_t getBlockKey(int idx) { return m_keys[idx]; }
+        const uint8_t *getSealed(uint32_t &length) { length = m_sealed ? m_sealedLength : 0; return m_buffers[m_active ^ 1]; }
+        const uint8_t *getActive(uint32_t &length);
+        BlackBoxStats getStats() { return m_stats; }
+
+        static const int HEADER_MEMSIZE = 8;   // start count, entries, millis of the first entry
+        static const int ENTRY_MEMSIZE = 5;    // event and argument count, millis, then 4 bytes per argument
+
+    private:
+        static void onBlockWritten(void *context, bool status);
+        void seal();
+        void finishWrite(bool status);
+        void removeExcess();
+
+        uint8_t m_buffers[2][BLACKBOX_BLOCK_MEMSIZE]; // block being filled and block waiting to be written
+        int m_active;                // buffer being filled
+        uint32_t m_used;             // bytes of the active buffer filled, header included
+        uint16_t m_entries;          // events in the active buffer
+        uint16_t m_startCount;       // run the active buffer's events were logged in
+        uint32_t m_firstMillis;      // millis() of the active buffer's first event
+        bool m_sealed;               // the other buffer holds a block waiting to be written
+        uint32_t m_sealedLength;
+        bool m_writing;              // the sealed block has been submitted to the flash queue
+        uint16_t m_keys[BLACKBOX_BLOCKS + 1]; // stored blocks, oldest first
+        int m_count;
+        uint16_t m_nextKey;          // record key of the next block written
+        BlackBoxStats m_stats;
+};
+
+extern BlackBox blackBox;
+
+/* - - - - - - Declarations - - - - - - */
+bool initBlackBox();
+void handleBlackBox();
+int readBlackBoxBlock(const uint8_t *block, uint32_t length, BlackBoxEntry entries[], int maxEntries);
+int dumpBlackBox();
+void printBlackBoxInfo();
+
+#endif
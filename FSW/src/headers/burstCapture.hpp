@@ -0,0 +1,94 @@
+#ifndef BURST_H
+#define BURST_H
+
+/* - - - - - - Includes - - - - - - */
+// C++ libraries
+
+// Other libraries
+#include <SPI.h>
+
+// NS2 headers
+#include "config.hpp"
+
+/* - - - - - - Enums - - - - - - */
+enum BurstTrigger { // what caused a burst to be captured
+    BURST_TRIGGER_SWEEP = 1,    // optic swept off the sun (checkSweepChange)
+    BURST_TRIGGER_SUNRISE,      // photodiode rose above the sunrise threshold
+    BURST_TRIGGER_COMMAND       // triggered by command
+};
+
+/* - - - - - - Structs - - - - - - */
+
+/* - BurstHeader -
+*   Describes a captured burst, stored at the start of each burst file.
+*   Members: triggerMillis, source, rateHz, preSamples, postSamples, samplesLost, samplesMissed
+*/
+struct BurstHeader {
+    uint32_t triggerMillis = 0; // time of the trigger, milliseconds since startup
+    uint8_t source = 0;         // BurstTrigger that froze the burst
+    uint16_t rateHz = BURST_RATE_HZ; // burst sampling rate
+    uint16_t preSamples = 0;    // valid samples before the trigger
+    uint16_t postSamples = 0;   // samples after the trigger
+    uint32_t samplesLost = 0;   // total samples dropped while a burst was frozen
+    uint32_t samplesMissed = 0; // total timer ticks that never ran
+    static const int MEMSIZE = sizeof(triggerMillis) + sizeof(source) + sizeof(rateHz) + sizeof(preSamples) 
+                                + sizeof(postSamples) + sizeof(samplesLost) + sizeof(samplesMissed);
+};
+
+const int BURST_RAW_MEMSIZE = BurstHeader::MEMSIZE + BURST_SAMPLES * sizeof(uint16_t); // bytes, size of a burst file before encoding
+const int BURST_FILE_IDX_OFFSET = 9; // index of file number in burst file names ("burstFile0.bin")
+
+typedef uint16_t (*BurstSampleSource)(); // function returning a single ADC sample
+
+/* - - - - - - Class Declaration - - - - - - */
+
+/* - BurstRing -
+*   Ring of high rate samples with a pre-trigger history.
+*   addSample() is called from the sampling interrupt, everything else from the main loop.
+*   After trigger() the ring keeps filling for BURST_POST_SAMPLES samples and then freezes
+*   until release() is called. Samples arriving while frozen are counted as lost.
+*/
+class BurstRing {
+    public:
+        BurstRing();
+
+        // sampling context
+        void addSample(uint16_t sample);
+
+        // main loop
+        bool trigger(uint8_t source, uint32_t timeMillis);
+        bool isFrozen() { return m_state == FROZEN; }
+        void copyBurst(uint16_t *dst, BurstHeader &header);
+        void release();
+        void reset();
+
+        // counters
+        uint32_t getSamplesLost() { return m_samplesLost; }
+        uint32_t getTriggersIgnored() { return m_triggersIgnored; }
+
+    private:
+        enum State { FILLING, TRIGGERED, FROZEN };
+        uint16_t m_ring[BURST_SAMPLES];  // sample ring
+        volatile int m_head;             // index of next sample to overwrite
+        volatile int m_filled;           // valid samples in ring, saturates at BURST_SAMPLES
+        volatile int m_postCount;        // samples taken since the trigger
+        volatile State m_state;
+        uint8_t m_source;                // trigger source of current burst
+        uint32_t m_triggerMillis;        // trigger time of current burst
+        int m_preSamples;                // valid pre-trigger samples of current burst
+        volatile uint32_t m_samplesLost; // samples dropped while frozen
+        uint32_t m_triggersIgnored;      // triggers received while a burst was in progress
+};
+
+/* - - - - - - Declarations - - - - - - */
+void handleBurstCapture();
+void setBurstCapture(bool enable);
+void triggerBurst(uint8_t source);
+void burstSampleISR();
+void setBurstSampleSource(BurstSampleSource source);
+uint16_t readBurstAdc();
+bool saveBurst();
+void onBurstSaved(void *context, bool status);
+void printBurstInfo();
+
+#endif
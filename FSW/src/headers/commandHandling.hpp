@@ -9,78 +9,120 @@
 // NS2 headers
 #include "config.hpp"
 
+/* - - - - - - Structs - - - - - - */
+
+/* - CommandArgs -
+*   Holds the integer arguments that follow a command code.
+*   Members: values, count 
+*/
+struct CommandArgs {
+    long values[COMMAND_MAX_ARGS] = {}; // argument values, in the order they were received
+    int count = 0;                      // number of arguments read
+};
+
 /* - - - - - - Declarations - - - - - - */
 void commandHandling();
-int readCommand();
-void queueCommand(int command);
+int readCommand(CommandArgs &args);
+int commandArgCount(int command);
+void queueCommand(int command, CommandArgs &args);
 bool checkMetaCommand(int command);
 bool checkIfCommandAllowed(int command);
 void executeAllCommands();
 void clearCommandQueue();
-void executeCommand(int command);
+void executeCommand(int command, CommandArgs &args);
 void printInfo();
 
 namespace commandCode {
     // command codes are wrapped in a namespace so they are not global
     enum Code { // all possible commands
         // commands are 1 indexed so that the default initializer can be used for the command queue
+        // every code has a fixed value the ground commands by: give a new command the next value
+        // below DO_NOTHING and move DO_NOTHING up, never renumber an existing command
         // Info
         INFO = 1,                       // Prints a report of system data
 
         // Mode Change
-        ENTER_SAFE_MODE,                // enter safemode state
-        ENTER_STANDBY_MODE,             // enter standby state
-        ENTER_SUNSET_MODE,              // enter sunset data collection mode
-        ENTER_PRE_SUNRISE_MODE,         // enter watch-for-sunset mode
-        ENTER_SUNRISE_MODE,             // enter sunrise data collection mode
+        ENTER_SAFE_MODE = 2,            // enter safemode state
+        ENTER_STANDBY_MODE = 3,         // enter standby state
+        ENTER_SUNSET_MODE = 4,          // enter sunset data collection mode
+        ENTER_PRE_SUNRISE_MODE = 5,     // enter watch-for-sunset mode
+        ENTER_SUNRISE_MODE = 6,         // enter sunrise data collection mode
 
         // Data Collection
-        SAVE_BUFFER,                    // saves the buffer in the next available file slot
-        DOWNLINK_START,                 // start downlink at next available time
-        STREAM_PHOTO_T,                 // start streaming photodiode data
-        STREAM_PHOTO_F,                 // stop streaming photodiode data
-        PRINT_PHOTO_SINGLE,             // print a single photodiode sample
+        SAVE_BUFFER = 7,                // saves the buffer in the next available file slot
+        DOWNLINK_START = 8,             // start downlink at next available time
+        LIST_FILES = 49,                // prints every science file in the catalog
+        STREAM_PHOTO_T = 9,             // start streaming photodiode data
+        STREAM_PHOTO_F = 10,            // stop streaming photodiode data
+        PRINT_PHOTO_SINGLE = 11,        // print a single photodiode sample
+        ADAPTIVE_SAMPLING_T = 38,       // vary the sampling rate with signal activity
+        ADAPTIVE_SAMPLING_F = 39,       // sample at the fixed nominal rate
+        SET_ADAPTIVE_THRESH = 40,       // args: fast slope (bins/s), slow slope (bins/s), noise (bins)
+        BURST_CAPTURE_T = 41,           // start high rate burst capture in the background
+        BURST_CAPTURE_F = 42,           // stop high rate burst capture
+        TRIGGER_BURST = 43,             // freeze and save a burst now
+        CHECKPOINT_WINDOWS_T = 47,      // checkpoint science windows to flash so a reset does not lose them
+        CHECKPOINT_WINDOWS_F = 48,      // stop checkpointing science windows
+        QUICKLOOK = 57,                 // prints a summary of the newest science file, from RAM if it is cached
+        DOWNLINK_FILE = 62,             // args: file ID (science slot, MAXFILES + burst index), first chunk, last chunk
+        ACK_DOWNLINK = 63,              // args: file ID, version, first chunk, bitmap of the chunks received
+        SET_DOWNLINK_WEIGHTS = 64,      // args: score per quality point, score lost per newer product, score of a fully acknowledged product
+        SET_DOWNLINK_BUDGET = 65,       // args: bytes a downlink pass may write to the link, 0 for no limit
         
         // Housekeeping
-        TURN_HEATER_ON,                 // turn heater on, does not override housekeeping heater control
-        TURN_HEATER_OFF,                // turn heater off, does not override housekeeping heater control
-        HEATER_OVERRIDE_T,              // disables housekeeping heater control
-        HEATER_OVERRIDE_F,              // enables housekeeping heater control
-        STREAM_TEMPERATURE_T,           // start streaming temperature measurements
-        STREAM_TEMPERATURE_F,           // stop streaming temperature measurements
-        CALIBRATE_OPTICS_THERM,         // take new voltage baseline at known temp for optics thermistor
+        TURN_HEATER_ON = 12,            // turn heater on, does not override housekeeping heater control
+        TURN_HEATER_OFF = 13,           // turn heater off, does not override housekeeping heater control
+        HEATER_OVERRIDE_T = 14,         // disables housekeeping heater control
+        HEATER_OVERRIDE_F = 15,         // enables housekeeping heater control
+        STREAM_TEMPERATURE_T = 16,      // start streaming temperature measurements
+        STREAM_TEMPERATURE_F = 17,      // stop streaming temperature measurements
+        CALIBRATE_OPTICS_THERM = 18,    // take new voltage baseline at known temp for optics thermistor
+        DOWNLINK_HK_HISTORY = 60,       // args: run (start count, 0 for this one), from, to (s after the run started)
 
         // Command Handling
-        PAUSE_EXECUTE_COMMANDS,         // pause command execution
-        RESUME_EXECUTE_COMMANDS,        // resume command execution
-        CLEAR_COMMAND_QUEUE,            // clears all commands from queue
-        DANGER_COMMANDS_ALLOWED_T,      // allow potentially dangerous commands
-        DANGER_COMMANDS_ALLOWED_F,      // disallow potentially dangerous commands
+        PAUSE_EXECUTE_COMMANDS = 19,    // pause command execution
+        RESUME_EXECUTE_COMMANDS = 20,   // resume command execution
+        CLEAR_COMMAND_QUEUE = 21,       // clears all commands from queue
+        DANGER_COMMANDS_ALLOWED_T = 22, // allow potentially dangerous commands
+        DANGER_COMMANDS_ALLOWED_F = 23, // disallow potentially dangerous commands
         
         // ADCS
-        ADCS_POINTING_AT_SUN_T,         // sets pointing at sun flag to true
-        ADCS_POINTING_AT_SUN_F,         // sets pointing at sun flag to false
+        ADCS_POINTING_AT_SUN_T = 24,    // sets pointing at sun flag to true
+        ADCS_POINTING_AT_SUN_F = 25,    // sets pointing at sun flag to false
+        ADCS_RESET_LATENCY = 44,        // clears ADCS feedback latency statistics
+        SIMULATE_ATTITUDE_T = 45,       // feed a simulated attitude sweep into attitude fusion
+        SIMULATE_ATTITUDE_F = 46,       // stop feeding simulated attitude
 
         // Memory
-        SCRUB_FLASH,                    // start scrubbing the flash memory for errors
+        SCRUB_FLASH = 26,               // start scrubbing the flash memory for errors
+        STORAGE_STRIPED = 50,           // stripe science storage across both flash modules, store must be empty
+        STORAGE_MIRRORED = 51,          // mirror science storage on both flash modules, store must be empty
+        AUTO_SCRUB_T = 52,              // scrub flash in the background
+        AUTO_SCRUB_F = 53,              // only scrub flash when commanded
+        SET_SCRUB_RATE = 54,            // args: background scrub rate (bytes/s, 0 to pace by hours), hours per pass
+        DOWNLINK_ERROR_MAP = 55,        // downlinks the errors found in each flash sector as a binary product
+        CLEAR_ERROR_MAP = 56,           // clears the flash sector error counts, retired sectors are used again
+        SET_RETENTION = 58,             // args: policy (0 scored, 1 newest, 2 stored), files kept before one is evicted
+        SET_RETENTION_WEIGHTS = 59,     // args: score per quality point, score lost per newer window
 
         // Fault Mitigation
-        WIPE_EEPROM,                   // completely wipes the EEPROM and then resets persistent data
-        RESET_PERSISTENT_DATA,         // resets all persistent data to default values
-        SUPPRESS_FAULTS_T,             // disables new fault messages, faults are still logged
-        SUPPRESS_FAULTS_F,             // allows new fault messages
-        ACT_ON_FAULTS_T,               // enables corrective action when new faults are detected
-        ACT_ON_FAULTS_F,               // disables corrective action when new faults are detected
-        SAVE_FAULTS_T,                 // enables saving of new faults to EEPROM
-        SAVE_FAULTS_F,                 // disables saving of new faults to EEPROM
-        DISABLE_WD_RESET,              // disable watchdog reset signal, forcing a restart
+        WIPE_EEPROM = 27,               // completely wipes the EEPROM and then resets persistent data
+        RESET_PERSISTENT_DATA = 28,     // resets all persistent data to default values
+        SUPPRESS_FAULTS_T = 29,         // disables new fault messages, faults are still logged
+        SUPPRESS_FAULTS_F = 30,         // allows new fault messages
+        ACT_ON_FAULTS_T = 31,           // enables corrective action when new faults are detected
+        ACT_ON_FAULTS_F = 32,           // disables corrective action when new faults are detected
+        SAVE_FAULTS_T = 33,             // enables saving of new faults to EEPROM
+        SAVE_FAULTS_F = 34,             // disables saving of new faults to EEPROM
+        DUMP_BLACK_BOX = 61,            // prints the events in the black box, oldest first
+        DISABLE_WD_RESET = 35,          // disable watchdog reset signal, forcing a restart
 
         // System Commands
-        EXIT_MAIN_LOOP,                // exits the main loop
+        EXIT_MAIN_LOOP = 36,            // exits the main loop
 
         // End of list
-        SELF_DESTRUCT,                
-        DO_NOTHING                    // do nothing. KEEP THIS LAST IN THE ENUM, it is used for indexing.
+        SELF_DESTRUCT = 37,
+        DO_NOTHING = 66                 // do nothing. KEEP THIS THE HIGHEST CODE, it is used for indexing.
     };
 };
 
@@ -45,6 +45,14 @@ const float TEENSY_VOLTAGE_RES = (TEENSY_HIGH_VOLTAGE - TEENSY_LOW_VOLTAGE) / TE
 
 /* - - - - - - SPI - - - - - - */
 const int ADC_MAX_SPEED = 2000000; // Hz, maximum SPI clock speed for ADC
+const int FLASH_STATUS_SPEED = 30000000; // Hz, SPI clock speed a flash module's status register is polled at
+
+// SPI bus arbiter
+// spiBus owns the bus shared by the ADC and both flash modules: flash transfers are split into
+// chunks and a sample that comes due is taken before the next chunk (see spiBus.cpp)
+const uint32_t SPI_FLASH_CHUNK = 256;                   // bytes, largest flash transfer issued at once, a flash page so programs stay whole
+const unsigned long SPI_ADC_LATENCY_BOUND_MICROS = 100; // microseconds, one chunk at 30 MHz and an ADC read, samples later than this are counted
+const int SPI_LATENCY_BUCKETS = 12;                     // sample latency histogram buckets, bucket i holds latencies below 2^i microseconds
 
 /* - - - - - - Serial - - - - - - */
 const int SERIAL_BAUD = 19200;       // Hz, baud rate of serial connection
@@ -55,6 +63,29 @@ const int SERIAL_TIMEOUT_MSEC = 15; // milliseconds, time to wait for serial inp
 // for a future team to slot in these ADCS measurements 
 const bool ADCS_READY_FOR_SCIENCE = true;     // flag on whether or not attitude is ready for science
 
+// ADCS feedback channel, published every photodiode sample for a pointing loop to close around
+const unsigned long ADCS_FEEDBACK_MAX_LATENCY_MICROS = 200; // microseconds, latency bound from ADC read to published value
+const float ADCS_DERIVATIVE_EMA_WEIGHT = 0.5F;  // weight of newest value in the published irradiance derivative
+const uint16_t ADCS_SATURATION_BINS = 65000;    // ADC bins, samples at or above this are flagged as saturated
+const int ADCS_MAILBOX_READ_TRIES = 4;          // attempts to get a consistent copy before a read gives up
+
+// Attitude fusion, pairs each photodiode sample with the pointing elevation
+const int ATTITUDE_RING_SIZE = 32;                      // attitude samples held while waiting to be aligned
+const int ATTITUDE_PENDING_SIZE = 64;                   // photodiode samples held while waiting for attitude
+const unsigned long ATTITUDE_MAX_GAP_MICROS = 200000;   // microseconds, widest attitude gap that is interpolated across
+const unsigned long ATTITUDE_MAX_WAIT_MICROS = 500000;  // microseconds, time to wait for late attitude before giving up on a sample
+const int ATTITUDE_ALIGN_MAX_WORK = 16;                 // photodiode samples aligned per main loop iteration
+const float ATTITUDE_LSB_DEG = 0.01F;                   // degrees per bit of the stored attitude column
+const int16_t ATTITUDE_INVALID = INT16_MIN;             // stored when no attitude could be aligned to a sample
+const int8_t ATTITUDE_DELTA_INVALID = INT8_MIN;         // stored delta of a sample with no attitude
+
+// stand-in attitude feeder for testing without ADCS
+extern volatile bool SIMULATE_ATTITUDE;
+const bool SIMULATE_ATTITUDE_INIT = false;              // whether to feed a simulated sweep into attitude fusion
+const unsigned long ATTITUDE_SIM_PERIOD_MICROS = 10000; // microseconds, simulated attitude sample period (100 Hz)
+const float ATTITUDE_SIM_AMPLITUDE_DEG = 1.0F;          // degrees, amplitude of simulated sweep
+const float ATTITUDE_SIM_SWEEP_SEC = 4.0F;              // seconds, period of simulated sweep
+
 /* = = = = = = = = = = = = = = = = = = = = = =
  * = = = = = = Module Constants  = = = = = = =
  * = = = = = = = = = = = = = = = = = = = = = */
@@ -66,7 +97,7 @@ extern Event exitMainLoopEvent; // event to trigger main loop exit
 /* - - - - - - Data Collection Module - - - - - - */
 const int SAMPLING_RATE = 50;       // Hz, desired irradiance sampling rate
 const int WINDOW_LENGTH_SEC = 240;  // seconds, length of science data 
-const int MAXFILES = 10;            // maximum number of files in flash storage
+const int MAXFILES = 250;           // maximum number of science files in flash storage, one catalog slot each
 const float ADC_BINS = 65536;       // bins, number of bins in ADC (2^16)
 const float ADC_MAX_VOLTAGE = 3.3;  // Volts, upper end of ADC voltage range
 const float ADC_MIN_VOLTAGE = 0.0;  // Volts, lower end of ADC voltage range
@@ -82,7 +113,174 @@ const int TIMESTAMP_SIZE = sizeof(unsigned long);   // bytes needed to store tim
 // data size parameters, derived from other constants
 const int BUFFERSIZE = SAMPLING_RATE * WINDOW_LENGTH_SEC; // number of samples to keep in science buffer
 const int BUFFER_MEMSIZE = BUFFERSIZE * sizeof(uint16_t); // bytes, size of data buffer
-const int SCIDATA_RAW_MEMSIZE = BUFFER_MEMSIZE + TIMESTAMP_SIZE; // bytes, combined size of science data
+const int RATE_CODES_PER_BYTE = 4;  // 2 bit sample period code per buffer sample
+const int RATE_CODE_MEMSIZE = (BUFFERSIZE + RATE_CODES_PER_BYTE - 1) / RATE_CODES_PER_BYTE; // bytes, size of packed rate codes
+const int ATTITUDE_KEYFRAME_SAMPLES = 64; // samples per attitude keyframe, each sample stores an 8 bit delta from the one before
+const int ATTITUDE_KEYFRAMES = (BUFFERSIZE + ATTITUDE_KEYFRAME_SAMPLES - 1) / ATTITUDE_KEYFRAME_SAMPLES; // number of attitude keyframes
+const int ATTITUDE_COLUMN_MEMSIZE = ATTITUDE_KEYFRAMES * sizeof(int16_t) + BUFFERSIZE * sizeof(int8_t); // bytes, size of delta encoded pointing elevation column
+const int SCIDATA_USED_MEMSIZE = BUFFER_MEMSIZE + TIMESTAMP_SIZE + RATE_CODE_MEMSIZE + ATTITUDE_COLUMN_MEMSIZE; // bytes, combined size of science data
+const int SCIDATA_RAW_MEMSIZE = (SCIDATA_USED_MEMSIZE + 63) / 64 * 64; // bytes, science data padded to whole bytes of Hamming block rows
+
+// Adaptive sampling
+// the sampling period is chosen from this table, the index into the table is the 2 bit rate code
+// stored alongside each sample so that ground can reconstruct the sample times
+const int ADAPTIVE_RATE_COUNT = 4;                              // number of selectable sampling periods
+const unsigned long ADAPTIVE_PERIODS_MSEC[ADAPTIVE_RATE_COUNT] = {5, 10, 20, 80}; // milliseconds, fastest to slowest
+const uint8_t ADAPTIVE_FAST_RATE_CODE = 0;      // rate code used on the limb transition
+const uint8_t ADAPTIVE_MID_RATE_CODE = 1;       // rate code used for moderate signal activity
+const uint8_t ADAPTIVE_NOMINAL_RATE_CODE = 2;   // rate code equal to SAMPLE_PERIOD_MSEC, used when adaptive sampling is off
+const uint8_t ADAPTIVE_SLOW_RATE_CODE = 3;      // rate code used on plateaus and when the sample budget is spent
+const int ADAPTIVE_MID_DIVISOR = 4;             // moderate activity threshold is the fast threshold divided by this
+const float ADAPTIVE_EMA_WEIGHT = 0.25F;        // weight of newest sample in the slope and variance averages
+const unsigned long ADAPTIVE_HOLD_MSEC = 500;   // milliseconds, minimum time to stay at a faster rate once selected
+
+// sample budget, a window must still fit in BUFFERSIZE samples whatever the signal does
+// credit is earned in real time and spent one per sample, capping the samples in any window at BUFFERSIZE
+const float ADAPTIVE_CREDIT_MAX = BUFFERSIZE / 8; // samples, largest burst of credit that can be banked
+const float ADAPTIVE_CREDIT_PER_MSEC = (BUFFERSIZE - ADAPTIVE_CREDIT_MAX) / (float)(WINDOW_LENGTH_SEC * 1000); // samples earned per millisecond
+
+extern volatile bool ADAPTIVE_SAMPLING;
+const bool ADAPTIVE_SAMPLING_INIT = false; // whether to vary the sampling rate with signal activity
+
+// activity thresholds, commandable
+extern volatile long ADAPTIVE_FAST_SLOPE;
+const long ADAPTIVE_FAST_SLOPE_INIT = 2000;  // ADC bins/sec, signal slope that selects the fastest rate
+extern volatile long ADAPTIVE_SLOW_SLOPE;
+const long ADAPTIVE_SLOW_SLOPE_INIT = 50;    // ADC bins/sec, signal slope below which the slowest rate is selected
+extern volatile long ADAPTIVE_NOISE;
+const long ADAPTIVE_NOISE_INIT = 500;        // ADC bins, signal standard deviation that selects the fastest rate
+
+// Burst capture
+// a short high rate ring is filled in the background and frozen around the limb crossing
+extern volatile bool BURST_CAPTURE;
+const bool BURST_CAPTURE_INIT = false;  // whether to run high rate burst capture
+const int BURST_RATE_HZ = 2000;         // Hz, burst sampling rate
+const int BURST_PRE_MSEC = 300;         // milliseconds of history kept before the trigger
+const int BURST_POST_MSEC = 200;        // milliseconds captured after the trigger
+const int BURST_PRE_SAMPLES = BURST_RATE_HZ * BURST_PRE_MSEC / 1000;   // samples before the trigger
+const int BURST_POST_SAMPLES = BURST_RATE_HZ * BURST_POST_MSEC / 1000; // samples after the trigger
+const int BURST_SAMPLES = BURST_PRE_SAMPLES + BURST_POST_SAMPLES;      // samples in a burst (and the ring)
+const int MAX_BURST_FILES = 10;         // maximum number of burst files in flash storage
+
+// Record store
+// science data is appended to a log of checksummed records, each completed by a commit marker,
+// so a reset at any point leaves every record either complete or ignored
+const uint32_t FLASH_PAGE_SIZE = 256;                 // bytes, largest single program operation on a flash module
+const uint32_t RECORD_STORE_MEMSIZE = 13 * 1048576UL; // bytes, flash reserved for the record store on each module
+const int RECORD_MAX_RECORDS = 512;                  // live records the RAM index can hold
+const int RECORD_MAX_PENDING = 4;                    // appends that can be queued at once
+const int RECORD_MAX_SECTORS = 256;                  // sectors the store can use, RECORD_STORE_MEMSIZE is 208 64KB erase blocks
+const int RECORD_RECLAIM_POOL = 4;                   // erased sectors kept ready, below this reclaim() does not wait for the flash queue to be idle
+const int SECTOR_RETIRE_ERRORS = 8;                  // pages found failing their checksum in a sector before no more records are put in it
+const uint32_t STORAGE_STRIPE_CHUNK = FLASH_PAGE_SIZE; // bytes written to one flash module before moving to the other
+const unsigned long STORAGE_CHECK_INTERVAL_MSEC = 1000; // milliseconds, time between flash module health checks
+
+// Flash I/O queue
+// record reads and writes are queued and issued a page at a time across loop iterations,
+// a module still programming is polled instead of waited on
+const int FLASH_QUEUE_DEPTH = 16;                     // requests the queue can hold
+const uint32_t FLASH_QUEUE_STEP = FLASH_PAGE_SIZE;    // bytes, largest read or program issued at once
+const unsigned long FLASH_QUEUE_BUDGET_MICROS = 500;  // microseconds, time the queue may take each loop iteration
+
+// Flash scrub
+// science files are checked a few pages at a time and corrected a few byte columns of the
+// interleaved file at a time, from a cursor saved to EEPROM, so a scrub needs only a small
+// buffer, takes a bounded time each loop iteration and carries on after a reset
+const int SCRUB_CHUNK_COLUMNS = 8;  // byte columns (64 hamming blocks) corrected per step, the buffer holds every row of them
+const int SCRUB_CHECK_PAGES = 2;    // pages checked against their checksum per step
+const int SCRUB_SAVE_STEPS = 64;    // steps between saves of the scrub cursor to EEPROM
+const int SCRUB_PRIORITY_SLOTS = 8; // files that showed errors in the last pass, scrubbed first in the next
+
+// Background scrub
+// handleScrub() walks the stored science files in every mode, within a byte rate budget and
+// only when the next sample is not due, so flash is scrubbed without a command
+extern volatile bool AUTO_SCRUB;
+const bool AUTO_SCRUB_INIT = true;                   // whether to scrub flash in the background
+extern volatile long SCRUB_BYTES_PER_SEC;
+const long SCRUB_BYTES_PER_SEC_INIT = 1024;          // bytes/s, flash read by the background scrub, 0 to pace by SCRUB_PASS_HOURS
+extern volatile long SCRUB_PASS_HOURS;
+const long SCRUB_PASS_HOURS_INIT = 6;                // hours, length of a background pass when paced by it
+const unsigned long SCRUB_MIN_PASS_INTERVAL_MSEC = 600000; // milliseconds, time from a background pass ending, or from startup, to the next
+const unsigned long SCRUB_SAMPLE_GUARD_MSEC = 2;     // milliseconds, no step is taken closer than this to the next sample
+const long SCRUB_BURST_BYTES = 4096;                 // bytes, most the background scrub can save up while it waits
+
+// Window cache
+// the most recently written science windows are kept in RAM as they were written, so a
+// downlink or quicklook soon after a save does not read them back from flash
+const int WINDOW_CACHE_WINDOWS = 2;                  // windows kept, each a paged science file (about 57 KB) in the second RAM bank
+
+// Retention
+// once MAXFILES or RETENTION_QUOTA_FILES files are stored, or the record store has no room for
+// another window, saveBuffer() evicts a stored window to make room (see retention.cpp)
+extern volatile long RETENTION_POLICY;
+const long RETENTION_POLICY_INIT = 0;                // 0 evicts the lowest scored window, 1 the oldest, 2 none (new windows are dropped)
+extern volatile long RETENTION_QUOTA_FILES;
+const long RETENTION_QUOTA_FILES_INIT = MAXFILES;    // science files kept before one is evicted, at most MAXFILES
+extern volatile long RETENTION_QUALITY_WEIGHT;
+const long RETENTION_QUALITY_WEIGHT_INIT = 1;        // score per quality point (0-255)
+extern volatile long RETENTION_AGE_WEIGHT;
+const long RETENTION_AGE_WEIGHT_INIT = 4;            // score lost per window stored after this one
+const uint16_t RETENTION_FULL_RANGE_BINS = 16384;    // ADC bins, sample range of a window given the highest quality
+const int RETENTION_LOG_SIZE = 16;                   // eviction decisions kept for printRetentionInfo()
+
+// Black box
+// blackBox.log() copies an event into a RAM block, the main loop appends the block to the record
+// store once it is full or BLACKBOX_FLUSH_MSEC old, and the newest blocks are kept as a ring to be
+// dumped after an anomaly or an unexpected restart (see blackBox.cpp)
+const int BLACKBOX_BLOCK_MEMSIZE = 1024;            // bytes, RAM block, two are kept so logging carries on while one is written
+const unsigned long BLACKBOX_FLUSH_MSEC = 60000;    // milliseconds, a block is stored once its first event is this old, the most a reset loses
+const int BLACKBOX_BLOCKS = 24;                     // blocks kept on flash, the oldest is removed past this
+const int BLACKBOX_MAX_ARGS = 3;                    // integer arguments an event can carry
+
+// Downlink framing
+// files are sent in fixed-size binary frames, each carrying its file ID, version, chunk, length
+// and a CRC, COBS encoded so a zero byte only ever ends a frame (see downlinkFrame.cpp)
+const int DOWNLINK_CHUNK_SIZE = 236;                // bytes of file per frame, a frame is 255 bytes on the wire
+
+// Downlink transfers
+// the ground acknowledges the chunks it received, only the rest are sent again and a file is only
+// deleted once all of it is acknowledged (see downlinkTransfer.cpp)
+const int DOWNLINK_SUMMARY_ID = MAXFILES + MAX_BURST_FILES; // file ID of the pass summary, after the science slots and burst files
+const int DOWNLINK_ERROR_MAP_ID = DOWNLINK_SUMMARY_ID + 1; // file ID of the flash sector error map, built when it is sent
+const int DOWNLINK_HK_HISTORY_ID = DOWNLINK_ERROR_MAP_ID + 1; // file ID of the housekeeping history blocks, sent one at a time
+const int DOWNLINK_FILE_IDS = DOWNLINK_HK_HISTORY_ID + 1;
+const int DOWNLINK_ACK_CHUNKS = 32;                 // chunks acknowledged by one ACK_DOWNLINK bitmap
+
+// Downlink pacing
+// handleDownlink() sends frames in every mode a piece at a time, only as many bytes as the serial
+// transmit buffer has room for and within a budget each loop iteration, so the loop never waits on the link
+const size_t DOWNLINK_LOOP_BYTES = 256;                  // bytes, most written to the link each loop iteration
+const unsigned long DOWNLINK_LOOP_BUDGET_MICROS = 200;   // microseconds, time the downlink may take each loop iteration
+const unsigned long DOWNLINK_SAMPLE_GUARD_MSEC = 2;      // milliseconds, nothing is sent closer than this to the next sample
+
+// Downlink scheduling
+// a downlink pass sends a summary of the stored products first, then the products highest score
+// first until DOWNLINK_PASS_BYTES are on the link (see downlinkScheduler.cpp)
+extern volatile long DOWNLINK_QUALITY_WEIGHT;
+const long DOWNLINK_QUALITY_WEIGHT_INIT = 4;        // score per quality point (0-255) of a science window
+extern volatile long DOWNLINK_AGE_WEIGHT;
+const long DOWNLINK_AGE_WEIGHT_INIT = 2;            // score lost per product stored after this one
+extern volatile long DOWNLINK_PARTIAL_WEIGHT;
+const long DOWNLINK_PARTIAL_WEIGHT_INIT = 512;      // score of a product the ground has all but a chunk of, less for less of it
+const long DOWNLINK_BURST_SCORE = 768;              // score of a burst file, captured around an event the window quality misses
+extern volatile long DOWNLINK_PASS_BYTES;
+const long DOWNLINK_PASS_BYTES_INIT = 0;            // bytes, most a downlink pass writes to the link, 0 for no limit
+
+// File catalog
+// slot, state, size, timestamp, checksum and quality of every science file, kept in RAM and
+// saved as records in the science record store, mirrored on both flash modules unless striped
+const int CATALOG_CHUNK_SLOTS = 50; // catalog slots per catalog record, a save only writes the records with changed slots
+
+// Window checkpointing
+// samples of the window in progress are appended to a flash log so an unexpected reset
+// loses at most CHECKPOINT_INTERVAL_MSEC of data
+extern volatile bool CHECKPOINT_WINDOWS;
+const bool CHECKPOINT_WINDOWS_INIT = true;          // whether to checkpoint science windows to flash
+const unsigned long CHECKPOINT_INTERVAL_MSEC = 5000; // milliseconds, time between checkpoints
+const int CHECKPOINT_SEGMENT_SAMPLES = 256;         // samples per checkpoint segment, multiple of RATE_CODES_PER_BYTE
+const int CHECKPOINT_LOG_SEGMENTS = 128;            // segments the checkpoint log can hold before it is rebased
+const int CHECKPOINT_SEGMENTS_QUEUED = 2;           // segments waiting on the flash queue at once, each keeps an encoded copy in RAM
+const int CHECKPOINT_MAX_RESUMES = 1;               // consecutive unexpected restarts a window may be resumed after
 
 // timing constants
 const unsigned long SAMPLE_PERIOD_MSEC = 1000 / (unsigned long)SAMPLING_RATE; // milliseconds, time between samples  
@@ -95,11 +293,12 @@ extern Event saveBufferEvent;
 extern TimedEvent sunriseTimerEvent;
 extern TimedEvent sweepTimeoutEvent;
 extern AsyncEvent downlinkEvent;
-extern AsyncEvent scrubEvent;
+extern Event scrubEvent;
 extern Event printPhotoEvent;
 
 /* - - - - - - Command Handling Module - - - - - - */
 const int COMMAND_QUEUE_SIZE = 100;     // maximum number of commands the command queue can store.
+const int COMMAND_MAX_ARGS = 4;         // maximum number of integer arguments that can follow a command code
 
 extern volatile bool DANGER_COMMANDS_ALLOWED;
 const bool DANGER_COMMANDS_ALLOWED_INIT = false; // whether potentially dangerous commands are allowed
@@ -125,7 +324,14 @@ const int WD_PULSE_DUR_MICROSEC = 10;       // microseconds, watchdog reset sign
 extern RecurringEvent wdTimer;
 
 /* - - - - - - Housekeeping Module - - - - - - */
-const int HK_SAMPLES_TO_KEEP = 5000;   // number of previous housekeeping samples to keep
+// Housekeeping history
+// every sample is compressed into blocks appended to the record store (see hkHistory.cpp), so
+// days of history survive a reset and can be downlinked by time range
+const int HK_BLOCK_MEMSIZE = 2048;                 // bytes, largest history block, about half an hour of samples
+const unsigned long HK_BLOCK_MAX_MSEC = 1800000;   // milliseconds, a block is stored once it spans this long, the most history a reset loses
+const int HK_HISTORY_BLOCKS = 200;                 // blocks kept on flash, the oldest is removed past this
+const float HK_TEMP_RESOLUTION = 0.05F;            // celsius, temperatures are kept to this resolution
+const float HK_VOLTAGE_RESOLUTION = TEENSY_VOLTAGE_RES; // volts, currents (as sensed volts) and power good are kept to one ADC bin
 
 // Heater status
 extern volatile bool HEATER_ON;
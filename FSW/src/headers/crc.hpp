@@ -0,0 +1,16 @@
+#ifndef CRC_H
+#define CRC_H
+
+/* - - - - - - Includes - - - - - - */
+// C++ libraries
+#include <cstring>
+
+// Other libraries
+
+// NS2 headers
+#include "config.hpp"
+
+/* - - - - - - Declarations - - - - - - */
+uint32_t crc32c(const void *data, size_t size, uint32_t crc = 0);
+
+#endif
@@ -6,20 +6,33 @@
 #include <string>
 
 // Other libraries
-#include <SerialFlash.h> // for file I/O to flash modules
-#include <SPI.h> // will probably use this shortly, but it is not in use yet
+#include <SPI.h>
 #include <TimeLib.h>
 
 // NS2 headers
 #include "config.hpp"
+#include "downlinkTransfer.hpp"
 
 /* - - - - - - Declarations - - - - - - */
-uint16_t dataProcessing();
+uint16_t dataProcessing(uint32_t &sampleMicros);
+bool scienceSampleDue(uint32_t &dueMicros);
 void scienceMemoryHandling();
 void updateBuffer(uint16_t sample, int &index);
+void setRateCode(uint8_t code, int index);
+void updateSamplingRate(uint16_t sample);
 bool saveBuffer();
+void recoverScienceWindow();
 unsigned long calcTimestamp(); // currently outputs relative timestamp instead of absolute timestamp
 void downlink();
+void handleDownlink();
+void startDownlink();
+int requestDownlink(long fileNum, long first, long last);
+void requestErrorMap();
+int requestHkHistory(long startCount, long fromSec, long toSec);
+AckResult acknowledgeDownlink(long fileNum, long version, long base, long bitmap);
 void scrubFlash();
+bool quicklook();
+void onScienceSaved(void *context, bool status);
+void onDownlinkRead(void *context, bool status);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,130 @@
+#ifndef DOWNLINK_FRAME_H
+#define DOWNLINK_FRAME_H
+
+/* - - - - - - Includes - - - - - - */
+// C++ libraries
+#include <cstring>
+
+// Other libraries
+
+// NS2 headers
+#include "config.hpp"
+
+/* - - - - - - Enums - - - - - - */
+enum DownlinkFrameType : uint8_t { // first byte of every decoded frame
+    FRAME_FILE_DATA = 'D'   // a chunk of a downlinked file
+};
+
+/* - - - - - - Structs - - - - - - */
+
+/* - DownlinkStats -
+*   Frames written to the link and the bytes they took.
+*   Members: frames, payloadBytes, wireBytes
+*/
+struct DownlinkStats {
+    uint32_t frames = 0;        // frames sent
+    uint32_t payloadBytes = 0;  // file bytes carried by the frames
+    uint32_t wireBytes = 0;     // bytes written to serial, delimiters included
+};
+
+/* - - - - - - Class Declarations - - - - - - */
+
+/* - LinkPort -
+*   Where downlink frames are written, the serial link in flight. availableForWrite() is the
+*   number of bytes that can be written without waiting on the link.
+*/
+class LinkPort {
+    public:
+        virtual ~LinkPort() { }
+        virtual size_t write(const uint8_t *bytes, size_t length) = 0;
+        virtual size_t availableForWrite() = 0;
+};
+
+/* - SerialLinkPort -
+*   The serial link to the spacecraft.
+*/
+class SerialLinkPort : public LinkPort {
+    public:
+        size_t write(const uint8_t *bytes, size_t length) override { return Serial.write(bytes, length); }
+        size_t availableForWrite() override { return max(Serial.availableForWrite(), 0); }
+};
+
+/* - SimLinkPort -
+*   Host stand-in for the serial link, keeps what is written in a RAM buffer until it is full.
+*   setRoom() limits what can be written from then on, as a transmit buffer would.
+*/
+class SimLinkPort : public LinkPort {
+    public:
+        SimLinkPort(uint8_t *buffer, size_t capacity) { m_buffer = buffer; m_capacity = capacity; m_length = 0; m_roomEnd = SIZE_MAX; }
+        size_t write(const uint8_t *bytes, size_t length) override;
+        size_t availableForWrite() override { return m_roomEnd > m_length ? min(m_roomEnd, m_capacity) - m_length : 0; }
+
+        uint8_t *getData() { return m_buffer; }
+        size_t getLength() { return m_length; }
+        void clear() { m_length = 0; }
+        void setRoom(size_t room) { m_roomEnd = m_length + room; }
+
+    private:
+        uint8_t *m_buffer;
+        size_t m_capacity;
+        size_t m_length;
+        size_t m_roomEnd;   // length the buffer may be written up to
+};
+
+/* - DownlinkFrame -
+*   One chunk of a downlinked file. Every frame is the same size on the wire:
+*    header (type, file ID, version, file size, chunk, length) | DOWNLINK_CHUNK_SIZE bytes, zero padded | crc32c
+*   COBS encoded and followed by a zero byte. RAW_MEMSIZE is kept under 254 bytes so the encoding
+*   always adds exactly one byte, a receiver finds frames by the zero bytes and drops any that
+*   are the wrong size or fail their CRC.
+*/
+class DownlinkFrame {
+    public:
+        static const int HEADER_MEMSIZE = 1 + 2 + 2 + 4 + 2 + 2;
+        static const int RAW_MEMSIZE = HEADER_MEMSIZE + DOWNLINK_CHUNK_SIZE + 4;
+        static const int WIRE_MEMSIZE = RAW_MEMSIZE + 2; // COBS code byte and delimiter
+
+        uint8_t type = FRAME_FILE_DATA;
+        uint16_t fileId = 0;    // catalog slot of a science file, MAXFILES + index of a burst file
+        uint16_t version = 0;   // tells apart files stored in the same slot, acknowledgements must match it
+        uint32_t fileSize = 0;  // bytes in the whole file
+        uint16_t chunk = 0;     // index of the chunk, it starts chunk * DOWNLINK_CHUNK_SIZE bytes into the file
+        uint16_t length = 0;    // bytes of data used, the rest is padding
+        uint8_t data[DOWNLINK_CHUNK_SIZE];
+
+        void fill(uint16_t id, uint16_t fileVersion, const void *file, uint32_t size, uint16_t chunkIdx);
+        size_t encode(uint8_t *wire);
+        bool decode(const uint8_t *wire, size_t wireLength);
+};
+
+/* - FrameWriter -
+*   Writes an encoded frame to a link a piece at a time, only as many bytes as the link has room
+*   for, so a frame can go out across several loop iterations without waiting on the link.
+*/
+class FrameWriter {
+    public:
+        FrameWriter(LinkPort *port) { m_port = port; m_length = 0; m_written = 0; }
+
+        void load(DownlinkFrame &frame, bool delimit);
+        size_t write(size_t maxBytes);
+
+        bool isIdle() { return m_written == m_length; }
+        void setPort(LinkPort *port) { m_port = port; }
+
+    private:
+        LinkPort *m_port;
+        uint8_t m_wire[1 + DownlinkFrame::WIRE_MEMSIZE]; // delimiter and encoded frame
+        size_t m_length;    // bytes loaded
+        size_t m_written;   // bytes of them written
+};
+
+/* - - - - - - Declarations - - - - - - */
+size_t cobsEncode(const uint8_t *src, size_t length, uint8_t *dst);
+size_t cobsDecode(const uint8_t *src, size_t length, uint8_t *dst);
+uint16_t downlinkChunks(uint32_t size);
+size_t writeFrame(LinkPort *port, DownlinkFrame &frame);
+void writeFrameDelimiter(LinkPort *port);
+DownlinkStats getDownlinkStats();
+void printDownlinkInfo();
+
+#endif
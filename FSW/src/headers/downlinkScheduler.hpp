@@ -0,0 +1,76 @@
+#ifndef DOWNLINK_SCHEDULER_H
+#define DOWNLINK_SCHEDULER_H
+
+/* - - - - - - Includes - - - - - - */
+// C++ libraries
+#include <cstdint>
+
+// Other libraries
+
+// NS2 headers
+#include "config.hpp"
+
+/* - - - - - - Structs - - - - - - */
+
+/* - DownlinkProduct -
+*   A stored product with chunks waiting to be downlinked, as the scheduler ranks it.
+*   Members: fileId, quality, newer, chunks, acked, score
+*/
+struct DownlinkProduct {
+    uint16_t fileId = 0;    // catalog slot of a science window, MAXFILES + index of a burst file, DOWNLINK_SUMMARY_ID or a built product
+    uint8_t quality = 0;    // quality saved with a science window, 0-255
+    uint16_t newer = 0;     // products stored after it
+    uint16_t chunks = 0;    // chunks in the product
+    uint16_t acked = 0;     // chunks of it the ground has acknowledged
+    int32_t score = 0;      // higher is sent first
+};
+
+/* - ScheduleStats -
+*   Downlink passes planned since startup, kept by DownlinkScheduler.
+*   Members: passes, budgetStops
+*/
+struct ScheduleStats {
+    uint32_t passes = 0;        // downlink passes planned
+    uint32_t budgetStops = 0;   // passes ended by DOWNLINK_PASS_BYTES before every product was sent
+};
+
+/* - - - - - - Class Declaration - - - - - - */
+
+/* - DownlinkScheduler -
+*   Decides the order a downlink pass sends stored products in. plan() ranks every product with
+*   chunks wanted by its score: quality (science windows) or DOWNLINK_BURST_SCORE (burst files),
+*   less its age (the products stored after it), plus how much of it the ground already has. The
+*   summary of a full pass comes first, so the ground learns what is stored before the pass can
+*   run out of contact time or byte budget, then the products built when sent that were asked for.
+*/
+class DownlinkScheduler {
+    public:
+        static const int SUMMARY_ENTRY_MEMSIZE = 2 + 2 + 4 + 4 + 2 + 1;
+        static const int SUMMARY_MEMSIZE = SUMMARY_ENTRY_MEMSIZE * DOWNLINK_SUMMARY_ID;
+
+        DownlinkScheduler();
+
+        int plan(bool withSummary);
+        size_t buildSummary(uint8_t *buffer);
+        void noteBudgetSpent() { m_stats.budgetStops++; }
+
+        int getCount() { return m_count; }
+        DownlinkProduct &getProduct(int rank) { return m_plan[rank]; }
+        ScheduleStats getStats() { return m_stats; }
+
+        static int32_t score(const DownlinkProduct &product);
+        static void order(DownlinkProduct *products, int count);
+
+    private:
+        DownlinkProduct m_plan[DOWNLINK_FILE_IDS]; // products of the pass, in the order they are sent
+        int m_count;
+        ScheduleStats m_stats;
+};
+
+extern DownlinkScheduler downlinkScheduler;
+
+/* - - - - - - Declarations - - - - - - */
+int findDownlinkRecord(int fileId);
+void printDownlinkScheduleInfo();
+
+#endif
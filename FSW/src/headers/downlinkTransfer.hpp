@@ -0,0 +1,104 @@
+#ifndef DOWNLINK_TRANSFER_H
+#define DOWNLINK_TRANSFER_H
+
+/* - - - - - - Includes - - - - - - */
+// C++ libraries
+#include <climits>
+#include <cstdint>
+
+// Other libraries
+
+// NS2 headers
+#include "config.hpp"
+#include "downlinkFrame.hpp"
+#include "encodedSciData.hpp"
+
+/* - - - - - - Enums - - - - - - */
+enum AckResult : uint8_t { // what an acknowledgement did
+    ACK_REJECTED = 0,       // no such file, or it is not the version that was sent
+    ACK_PARTIAL,            // chunks are still missing
+    ACK_COMPLETE            // every chunk of the file is acknowledged
+};
+
+/* - - - - - - Structs - - - - - - */
+
+/* - TransferStats -
+*   Chunks sent and acknowledged, kept by DownlinkTransfer.
+*   Members: chunksSent, chunksAcked, filesAcked, acksRejected
+*/
+struct TransferStats {
+    uint32_t chunksSent = 0;    // chunks written to the link, resends included
+    uint32_t chunksAcked = 0;   // chunks newly acknowledged by the ground
+    uint32_t filesAcked = 0;    // files acknowledged in full
+    uint32_t acksRejected = 0;  // acknowledgements for a file or version that is not open
+};
+
+/* - - - - - - Class Declarations - - - - - - */
+
+/* - DownlinkTransfer -
+*   Selective repeat downlink. Every file ID has a bitmap of the chunks the ground has
+*   acknowledged and one of the chunks still wanted on the link. A downlink pass asks for the
+*   unacknowledged chunks of every file, the ground can ask for chunk ranges of one file, and
+*   only wanted chunks are sent, so a pass that drops partway resumes where it stopped. A file
+*   stored again in the same slot has another version and starts over. One file is sent at a
+*   time, startSending() and then pump() every loop iteration until isSending() is false.
+*/
+class DownlinkTransfer {
+    public:
+        static const int MAX_CHUNKS = (EncodedSciData::MEMSIZE + DOWNLINK_CHUNK_SIZE - 1) / DOWNLINK_CHUNK_SIZE;
+        static const int BITMAP_MEMSIZE = (MAX_CHUNKS + 7) / 8;
+
+        DownlinkTransfer(LinkPort *port);
+
+        bool open(uint16_t fileId, uint16_t version, uint32_t size);
+        void close(uint16_t fileId);
+        int requestUnacked(uint16_t fileId);
+        int request(uint16_t fileId, long first, long last);
+        void cancel(uint16_t fileId);
+        bool startSending(uint16_t fileId, const void *file, int maxChunks = INT_MAX);
+        size_t pump(size_t maxBytes, unsigned long budgetMicros);
+        void stopSending() { m_sendLeft = 0; } // no more chunks are taken from the file, the frame being written is finished
+        int sendWanted(uint16_t fileId, const void *file);
+        AckResult acknowledge(uint16_t fileId, uint16_t version, long base, uint32_t bitmap);
+
+        bool isOpen(uint16_t fileId) { return fileId < DOWNLINK_FILE_IDS && m_files[fileId].chunks > 0; }
+        uint16_t getVersion(uint16_t fileId) { return isOpen(fileId) ? m_files[fileId].version : 0; }
+        uint16_t getChunks(uint16_t fileId) { return isOpen(fileId) ? m_files[fileId].chunks : 0; }
+        uint32_t getSize(uint16_t fileId) { return isOpen(fileId) ? m_files[fileId].size : 0; }
+        uint16_t ackedChunks(uint16_t fileId) { return isOpen(fileId) ? m_files[fileId].ackedCount : 0; }
+        int wantedChunks(uint16_t fileId);
+        bool isSending() { return !m_writer.isIdle() || (m_sendLeft > 0 && wantedChunks(m_sendId) > 0); }
+        void setPort(LinkPort *port) { m_writer.setPort(port); }
+        TransferStats getStats() { return m_stats; }
+
+    private:
+        /* - TransferState -
+        *   Transfer of the file stored under one file ID, chunks is 0 while none is open.
+        */
+        struct TransferState {
+            uint16_t version;
+            uint16_t chunks;
+            uint16_t ackedCount;
+            uint32_t size;
+            uint8_t acked[BITMAP_MEMSIZE];
+            uint8_t wanted[BITMAP_MEMSIZE];
+        };
+
+        bool loadNextChunk();
+
+        TransferState m_files[DOWNLINK_FILE_IDS];
+        DownlinkFrame m_frame;
+        FrameWriter m_writer;
+        uint16_t m_sendId;          // file being sent
+        const uint8_t *m_sendFile;  // contents of it, kept by the caller until it is sent
+        bool m_sendDelimit;         // whether the next frame is the first of the file
+        int m_sendLeft;             // chunks of the file that may still be sent
+        TransferStats m_stats;
+};
+
+extern DownlinkTransfer downlinkTransfer;
+
+/* - - - - - - Declarations - - - - - - */
+void printDownlinkTransferInfo();
+
+#endif
@@ -9,22 +9,33 @@
 // NS2 config and utility headers
 #include "config.hpp"
 #include "hammingBlock.hpp"
+#include "crc.hpp"
 
 
 /* - - - - - - Class Declaration - - - - - - */
 
 /* - ScrubReport -
 *   Holds results of file scrub.
-*   Members: numErrors, corrected, uncorrected 
+*   Members: numErrors, corrected, uncorrected, repaired, badPages
 */
 struct ScrubReport { 
     int numErrors = 0;      // number of errors detected
     int corrected = 0;      // number of single bit errors corrected
     int uncorrected = 0;    // number of errors detected but not corrected
+    int repaired = 0;       // number of uncorrectable blocks restored from a mirror copy
+    int badPages = 0;       // number of flash pages that failed their checksum
 };
 
 /* - EncodedFile -
 *   Container for encoded data. 
+*   On flash the encoded data can be laid out in pages (toPages()), each holding PAGE_DATA_SIZE
+*   bytes of encoded data followed by their crc32c, so a page can be checked without decoding.
+*   Bit k of block b is at bit b + k * MESSAGE_COUNT, so the encoded data is ROW_COUNT rows of
+*   ROW_BYTES and byte column c of every row holds blocks 8c to 8c+7. A run of columns can be
+*   scrubbed on its own (scrubChunk()) without the rest of the file, so data gathered from pages
+*   only has to be decoded where a page failed its checksum (scrubPages()). Since a column only
+*   holds whole blocks, a file can also be encoded straight into pages a column at a time
+*   (encodePages()) and read back a few blocks at a time (decodeRange()) without the object.
 */
 template <size_t N> 
 class EncodedFile {
@@ -32,6 +43,19 @@ class EncodedFile {
         static const int DECODED_MEMSIZE = N;
         static const int MESSAGE_COUNT = (DECODED_MEMSIZE / HammingBlock::MSG_SIZE) + !!(DECODED_MEMSIZE % HammingBlock::MSG_SIZE);
         static const int MEMSIZE = MESSAGE_COUNT * HammingBlock::BLOCK_SIZE;
+
+        // paged layout
+        static const int PAGE_DATA_SIZE = FLASH_PAGE_SIZE - sizeof(uint32_t); // 28 blocks of encoded data
+        static const int PAGE_COUNT = (MEMSIZE / PAGE_DATA_SIZE) + !!(MEMSIZE % PAGE_DATA_SIZE);
+        static const int PAGED_MEMSIZE = PAGE_COUNT * FLASH_PAGE_SIZE;
+
+        // interleaved rows, a column of bytes holds 8 whole blocks
+        static const int ROW_COUNT = HammingBlock::BLOCK_SIZE * 8;
+        static const int ROW_BYTES = MESSAGE_COUNT / 8;
+        static const int BAD_PAGE_MEMSIZE = (PAGE_COUNT + 7) / 8; // bitmap of pages that failed their checksum
+
+        // copies length bytes of unencoded data starting at offset to dst
+        typedef void (*RawReader)(const void *context, int offset, uint8_t *dst, int length);
         
         // constructors
         EncodedFile() { }
@@ -40,7 +64,15 @@ class EncodedFile {
         // public methods
         void encodeData(void *src);
         void fill(void *encodedData);
-        ScrubReport scrub();
+        ScrubReport scrub(void *mirrorData = nullptr);
+        void toPages(void *pages);
+        static int unpage(void *pages, uint8_t *badPages = nullptr);
+        static void encodePages(RawReader reader, const void *context, void *pages);
+        static void decodeRange(void *encodedData, int offset, void *dst, int length);
+        static ScrubReport scrubChunk(uint8_t *chunk, int columns, uint8_t *mirrorChunk = nullptr);
+        static ScrubReport scrubPages(uint8_t *data, const uint8_t *badPages);
+        static bool crossesPage(const uint8_t *badPages, int column, int columns);
+        static int pagedOffset(int offset) { return (offset / PAGE_DATA_SIZE) * FLASH_PAGE_SIZE + offset % PAGE_DATA_SIZE; }
 
         // getters
         uint8_t *getData() { return m_data; }
@@ -52,6 +84,10 @@ class EncodedFile {
 
     protected:
         void decode();
+        void interleave();
+        void deinterleave(void *encodedData, int blockNum, HammingBlock &block);
+        static void unlace(void *encodedData, int blockNum, int blockCount, HammingBlock &block);
+        static void lace(void *encodedData, int blockNum, int blockCount, HammingBlock &block);
         HammingBlock m_blocks[MESSAGE_COUNT]; // vector of encoded hamming blocks
         uint8_t m_data[MEMSIZE];  // array to hold encoded data
         uint8_t m_decodedData[DECODED_MEMSIZE]; // array to hold decoded data
@@ -101,16 +137,7 @@ void EncodedFile<N>::encodeData(void *src) {
         m_blocks[blockNum].encodeMessage(message);
     }
 
-    /* interleave each block */
-    for (int blockNum = 0; blockNum < MESSAGE_COUNT; blockNum++) { // for each block...
-        // Interlace each block, so that burst errors span several blocks
-        for (int blockBit = 0; blockBit < HammingBlock::BLOCK_SIZE * 8; blockBit++) {
-
-            int bitIdx = blockNum + (blockBit * MESSAGE_COUNT); // index of data array to place encoded bit
-            bool val = checkBit(m_blocks[blockNum].getBlock(), blockBit); // value of bit to copy
-            assignBit(m_data, bitIdx, val); // assign bit to data array
-        }
-    }
+    interleave();
     decode();
 }
 
@@ -126,16 +153,9 @@ void EncodedFile<N>::encodeData(void *src) {
  */
 template <size_t N>
 void EncodedFile<N>::fill(void *encodedData) {
-
+    memcpy(m_data, encodedData, MEMSIZE);
     for (int blockNum = 0; blockNum < MESSAGE_COUNT; blockNum++) { // for each block...
-        uint8_t unlacedBlockData[HammingBlock::BLOCK_SIZE]; // temporary array to store block data
-        // de-interlace the encoded data
-        for (int blockBit = 0; blockBit < HammingBlock::BLOCK_SIZE * 8; blockBit++) {
-            int bitIdx = blockNum + (blockBit * MESSAGE_COUNT); // bit index of encoded data belonging to block
-            bool val = checkBit(encodedData, bitIdx); // get bit value
-            assignBit(unlacedBlockData, blockBit, val); // assign bit to temporary block
-        }
-        m_blocks[blockNum].fill(unlacedBlockData); // fill block with unlaced data
+        deinterleave(encodedData, blockNum, m_blocks[blockNum]);
     }
     decode();
 }
@@ -143,16 +163,18 @@ void EncodedFile<N>::fill(void *encodedData) {
 /* - - - - - - scrub - - - - - - *
  * Usage:
  *  Scans the file for errror and corrects single bit errors.
- *  Corrupted blocks that cannot be corrected are cleared.
+ *  Corrupted blocks that cannot be corrected are taken from the mirror copy if it 
+ *  has one that can be, otherwise they are cleared. The encoded data is rebuilt
+ *  from the corrected blocks.
  *  
  * Inputs:
- *  None
+ *  mirrorData - pointer to a second encoded copy of the file, or nullptr
  * 
  * Outputs:
  *  A ScrubReport struct containing counts of found and corrected errors
  */
 template <size_t N>
-ScrubReport EncodedFile<N>::scrub() {
+ScrubReport EncodedFile<N>::scrub(void *mirrorData) {
     ScrubReport scrubInfo;
 
     /* scan and correct each block */
@@ -160,14 +182,264 @@ ScrubReport EncodedFile<N>::scrub() {
         // correct the block and get an error report
         ErrorReport errorInfo = m_blocks[blockNum].correctBlock();
 
-        // if uncorrectable error detected, clear the block
-        if (errorInfo.size >= 2) {
+        // if uncorrectable error detected, repair the block from the mirror or clear it
+        bool repaired = false;
+        if (errorInfo.size >= 2 && mirrorData != nullptr) {
+            HammingBlock mirrorBlock;
+            deinterleave(mirrorData, blockNum, mirrorBlock);
+            if (mirrorBlock.correctBlock().size < 2) {
+                m_blocks[blockNum] = mirrorBlock;
+                repaired = true;
+            }
+        }
+        if (errorInfo.size >= 2 && !repaired) {
             m_blocks[blockNum].clear();
         } 
         // update scrub report with latest error report
         scrubInfo.numErrors += !!errorInfo.size;
         scrubInfo.corrected += errorInfo.size == 1;
-        scrubInfo.uncorrected += errorInfo.size > 1;
+        scrubInfo.uncorrected += errorInfo.size > 1 && !repaired;
+        scrubInfo.repaired += repaired;
+    }
+
+    if (scrubInfo.numErrors > 0) {
+        interleave();
+        decode();
+    }
+    return scrubInfo;
+}
+
+
+/* - - - - - - toPages - - - - - - *
+ * Usage:
+ *  Lays the encoded data out in flash pages, each page is PAGE_DATA_SIZE bytes of
+ *  encoded data followed by their crc32c. The last page is padded with 0xFF.
+ *  
+ * Inputs:
+ *  pages - pointer to PAGED_MEMSIZE bytes to fill
+ * 
+ * Outputs:
+ *  None
+ */
+template <size_t N>
+void EncodedFile<N>::toPages(void *pages) {
+    for (int pageNum = 0; pageNum < PAGE_COUNT; pageNum++) {
+        uint8_t *page = (uint8_t *)pages + pageNum * FLASH_PAGE_SIZE;
+        int dataSize = min((int)PAGE_DATA_SIZE, MEMSIZE - pageNum * PAGE_DATA_SIZE);
+        memset(page, 0xFF, PAGE_DATA_SIZE);
+        memcpy(page, m_data + pageNum * PAGE_DATA_SIZE, dataSize);
+        uint32_t crc = crc32c(page, PAGE_DATA_SIZE);
+        memcpy(page + PAGE_DATA_SIZE, &crc, sizeof(crc));
+    }
+}
+
+/* - - - - - - encodePages - - - - - - *
+ * Usage:
+ *  Encodes data straight into the layout toPages() gives, one byte column of 8 blocks at a
+ *  time, so neither the unencoded data nor the blocks are held in full. reader is asked for
+ *  the unencoded data in order, MSG_SIZE bytes at a time. Data past DECODED_MEMSIZE is zero.
+ *  
+ * Inputs:
+ *  reader - function that copies unencoded data
+ *  context - passed to reader
+ *  pages - pointer to PAGED_MEMSIZE bytes to fill
+ * 
+ * Outputs:
+ *  None
+ */
+template <size_t N>
+void EncodedFile<N>::encodePages(RawReader reader, const void *context, void *pages) {
+    static_assert(MESSAGE_COUNT % 8 == 0, "rows must be whole bytes to encode by column");
+    uint8_t *paged = (uint8_t *)pages;
+    uint8_t column[ROW_COUNT];
+    memset(paged + (PAGE_COUNT - 1) * FLASH_PAGE_SIZE, 0xFF, FLASH_PAGE_SIZE); // padding after the last block
+
+    for (int columnNum = 0; columnNum < ROW_BYTES; columnNum++) {
+        for (int blockIdx = 0; blockIdx < 8; blockIdx++) { // the 8 blocks of the column
+            uint8_t message[HammingBlock::MSG_SIZE] = {};
+            int offset = (columnNum * 8 + blockIdx) * HammingBlock::MSG_SIZE;
+            if (offset < DECODED_MEMSIZE) { reader(context, offset, message, min((int)HammingBlock::MSG_SIZE, DECODED_MEMSIZE - offset)); }
+            HammingBlock block;
+            block.encodeMessage(message);
+            lace(column, blockIdx, 8, block);
+        }
+        for (int row = 0; row < ROW_COUNT; row++) { paged[pagedOffset(row * ROW_BYTES + columnNum)] = column[row]; }
+    }
+
+    for (int pageNum = 0; pageNum < PAGE_COUNT; pageNum++) {
+        uint8_t *page = paged + pageNum * FLASH_PAGE_SIZE;
+        uint32_t crc = crc32c(page, PAGE_DATA_SIZE);
+        memcpy(page + PAGE_DATA_SIZE, &crc, sizeof(crc));
+    }
+}
+
+/* - - - - - - decodeRange - - - - - - *
+ * Usage:
+ *  Copies length bytes of decoded data starting at offset out of encoded data, only the blocks
+ *  holding them are unlaced. Errors are not corrected, scrub the data first (scrubPages()).
+ *  
+ * Inputs:
+ *  encodedData - pointer to MEMSIZE bytes of encoded data, as gathered by unpage()
+ *  offset - first byte of decoded data to copy
+ *  dst - array to hold length bytes
+ *  length - bytes to copy
+ * 
+ * Outputs:
+ *  None
+ */
+template <size_t N>
+void EncodedFile<N>::decodeRange(void *encodedData, int offset, void *dst, int length) {
+    for (int done = 0; done < length; ) {
+        int blockNum = (offset + done) / HammingBlock::MSG_SIZE;
+        int first = (offset + done) % HammingBlock::MSG_SIZE;
+        int piece = min((int)HammingBlock::MSG_SIZE - first, length - done);
+        HammingBlock block;
+        unlace(encodedData, blockNum, MESSAGE_COUNT, block);
+        memcpy((uint8_t *)dst + done, block.getMessage() + first, piece);
+        done += piece;
+    }
+}
+
+/* - - - - - - unpage - - - - - - *
+ * Usage:
+ *  Checks each page of paged data against its crc32c and gathers the encoded data
+ *  in place at the start of pages, ready for fill() or scrubPages()
+ *  
+ * Inputs:
+ *  pages - pointer to PAGED_MEMSIZE bytes laid out by toPages()
+ *  badPages - BAD_PAGE_MEMSIZE bytes to mark the pages that failed in, or nullptr
+ * 
+ * Outputs:
+ *  number of pages that failed their checksum
+ */
+template <size_t N>
+int EncodedFile<N>::unpage(void *pages, uint8_t *badPages) {
+    int badCount = 0;
+    if (badPages != nullptr) { memset(badPages, 0, BAD_PAGE_MEMSIZE); }
+    for (int pageNum = 0; pageNum < PAGE_COUNT; pageNum++) {
+        uint8_t *page = (uint8_t *)pages + pageNum * FLASH_PAGE_SIZE;
+        uint32_t crc;
+        memcpy(&crc, page + PAGE_DATA_SIZE, sizeof(crc));
+        if (crc != crc32c(page, PAGE_DATA_SIZE)) {
+            badCount++;
+            if (badPages != nullptr) { badPages[pageNum / 8] |= 1 << (pageNum % 8); }
+        }
+        memmove((uint8_t *)pages + pageNum * PAGE_DATA_SIZE, page, PAGE_DATA_SIZE); // earlier pages are already moved
+    }
+    return badCount;
+}
+
+/* - - - - - - scrubPages - - - - - - *
+ * Usage:
+ *  Scrubs encoded data gathered by unpage() where pages failed their checksum. Only the byte
+ *  columns that cross a bad page are decoded, a few at a time through a small buffer
+ *  (scrubChunk()), blocks in pages that passed are left as they are.
+ *  
+ * Inputs:
+ *  data - pointer to MEMSIZE bytes of encoded data, corrected in place
+ *  badPages - bitmap of the pages that failed, filled by unpage()
+ * 
+ * Outputs:
+ *  A ScrubReport struct containing counts of found and corrected errors
+ */
+template <size_t N>
+ScrubReport EncodedFile<N>::scrubPages(uint8_t *data, const uint8_t *badPages) {
+    const int CHUNK_COLUMNS = 8;
+    uint8_t chunk[ROW_COUNT * CHUNK_COLUMNS];
+    ScrubReport scrubInfo;
+
+    for (int column = 0; column < ROW_BYTES; column += CHUNK_COLUMNS) {
+        int columns = min(CHUNK_COLUMNS, ROW_BYTES - column);
+        if (!crossesPage(badPages, column, columns)) { continue; }
+        for (int row = 0; row < ROW_COUNT; row++) {
+            memcpy(chunk + row * columns, data + row * ROW_BYTES + column, columns);
+        }
+        ScrubReport chunkInfo = scrubChunk(chunk, columns);
+        if (chunkInfo.numErrors == 0) { continue; }
+        for (int row = 0; row < ROW_COUNT; row++) {
+            memcpy(data + row * ROW_BYTES + column, chunk + row * columns, columns);
+        }
+        scrubInfo.numErrors += chunkInfo.numErrors;
+        scrubInfo.corrected += chunkInfo.corrected;
+        scrubInfo.uncorrected += chunkInfo.uncorrected;
+    }
+    for (int pageNum = 0; pageNum < PAGE_COUNT; pageNum++) {
+        scrubInfo.badPages += !!(badPages[pageNum / 8] & (1 << (pageNum % 8)));
+    }
+    return scrubInfo;
+}
+
+/* - - - - - - crossesPage - - - - - - *
+ * Usage:
+ *  Whether any row of a run of byte columns holds bytes of a page marked in badPages
+ *  
+ * Inputs:
+ *  badPages - bitmap of pages, one bit per page
+ *  column - first byte column of the run
+ *  columns - number of byte columns in the run
+ * 
+ * Outputs:
+ *  true if a row of the run lies in a marked page
+ */
+template <size_t N>
+bool EncodedFile<N>::crossesPage(const uint8_t *badPages, int column, int columns) {
+    for (int row = 0; row < ROW_COUNT; row++) {
+        int first = (row * ROW_BYTES + column) / PAGE_DATA_SIZE;
+        int last = (row * ROW_BYTES + column + columns - 1) / PAGE_DATA_SIZE;
+        if ((badPages[first / 8] & (1 << (first % 8))) || (badPages[last / 8] & (1 << (last % 8)))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/* - - - - - - scrubChunk - - - - - - *
+ * Usage:
+ *  Scrubs the blocks held by a run of byte columns, like scrub() but without the rest of
+ *  the file. The run is read as ROW_COUNT rows of columns bytes, one after the other.
+ *  Corrected, repaired and cleared blocks are written back to the chunk, every other
+ *  byte is left as it was.
+ *  
+ * Inputs:
+ *  chunk - pointer to ROW_COUNT * columns bytes, column c0 to c0 + columns - 1 of each row
+ *  columns - number of byte columns in the chunk
+ *  mirrorChunk - the same columns from a second encoded copy of the file, or nullptr
+ * 
+ * Outputs:
+ *  A ScrubReport struct containing counts of found and corrected errors
+ */
+template <size_t N>
+ScrubReport EncodedFile<N>::scrubChunk(uint8_t *chunk, int columns, uint8_t *mirrorChunk) {
+    static_assert(MESSAGE_COUNT % 8 == 0, "rows must be whole bytes to scrub by column");
+    ScrubReport scrubInfo;
+    int blockCount = columns * 8; // blocks in the chunk, one per bit of a row
+
+    for (int blockNum = 0; blockNum < blockCount; blockNum++) { // for each block...
+        HammingBlock block;
+        unlace(chunk, blockNum, blockCount, block);
+        ErrorReport errorInfo = block.correctBlock();
+        if (errorInfo.size == 0) { continue; }
+
+        // if uncorrectable error detected, repair the block from the mirror or clear it
+        bool repaired = false;
+        if (errorInfo.size >= 2 && mirrorChunk != nullptr) {
+            HammingBlock mirrorBlock;
+            unlace(mirrorChunk, blockNum, blockCount, mirrorBlock);
+            if (mirrorBlock.correctBlock().size < 2) {
+                block = mirrorBlock;
+                repaired = true;
+            }
+        }
+        if (errorInfo.size >= 2 && !repaired) {
+            block.clear();
+        }
+        lace(chunk, blockNum, blockCount, block);
+
+        scrubInfo.numErrors++;
+        scrubInfo.corrected += errorInfo.size == 1;
+        scrubInfo.uncorrected += errorInfo.size > 1 && !repaired;
+        scrubInfo.repaired += repaired;
     }
     return scrubInfo;
 }
@@ -193,6 +465,86 @@ void EncodedFile<N>::decode() {
 }
 
 
+/* - - - - - - interleave (protected) - - - - - - *
+ * Usage:
+ *  Builds m_data from the blocks. Each block is interlaced
+ *  so that burst errors span several blocks
+ *  
+ * Inputs:
+ *  None
+ * Outputs:
+ *  None
+ */
+template <size_t N>
+void EncodedFile<N>::interleave() {
+    for (int blockNum = 0; blockNum < MESSAGE_COUNT; blockNum++) { // for each block...
+        for (int blockBit = 0; blockBit < HammingBlock::BLOCK_SIZE * 8; blockBit++) {
+
+            int bitIdx = blockNum + (blockBit * MESSAGE_COUNT); // index of data array to place encoded bit
+            bool val = checkBit(m_blocks[blockNum].getBlock(), blockBit); // value of bit to copy
+            assignBit(m_data, bitIdx, val); // assign bit to data array
+        }
+    }
+}
+
+/* - - - - - - deinterleave (protected) - - - - - - *
+ * Usage:
+ *  Fills block with the bits of block blockNum in interlaced encoded data
+ *  
+ * Inputs:
+ *  encodedData - pointer to encoded file data
+ *  blockNum - index of the block to extract
+ *  block - block to fill
+ * Outputs:
+ *  None
+ */
+template <size_t N>
+void EncodedFile<N>::deinterleave(void *encodedData, int blockNum, HammingBlock &block) {
+    unlace(encodedData, blockNum, MESSAGE_COUNT, block);
+}
+
+/* - - - - - - unlace (protected) - - - - - - *
+ * Usage:
+ *  Fills block with the bits of block blockNum of blockCount interlaced blocks
+ *  
+ * Inputs:
+ *  encodedData - pointer to interlaced data, the whole file or a chunk of columns
+ *  blockNum - index of the block to extract
+ *  blockCount - number of blocks interlaced in encodedData
+ *  block - block to fill
+ * Outputs:
+ *  None
+ */
+template <size_t N>
+void EncodedFile<N>::unlace(void *encodedData, int blockNum, int blockCount, HammingBlock &block) {
+    uint8_t unlacedBlockData[HammingBlock::BLOCK_SIZE]; // temporary array to store block data
+    for (int blockBit = 0; blockBit < HammingBlock::BLOCK_SIZE * 8; blockBit++) {
+        int bitIdx = blockNum + (blockBit * blockCount); // bit index of encoded data belonging to block
+        bool val = checkBit(encodedData, bitIdx); // get bit value
+        assignBit(unlacedBlockData, blockBit, val); // assign bit to temporary block
+    }
+    block.fill(unlacedBlockData); // fill block with unlaced data
+}
+
+/* - - - - - - lace (protected) - - - - - - *
+ * Usage:
+ *  Writes the bits of block back to block blockNum of blockCount interlaced blocks
+ *  
+ * Inputs:
+ *  encodedData - pointer to interlaced data, the whole file or a chunk of columns
+ *  blockNum - index of the block to write
+ *  blockCount - number of blocks interlaced in encodedData
+ *  block - block to write
+ * Outputs:
+ *  None
+ */
+template <size_t N>
+void EncodedFile<N>::lace(void *encodedData, int blockNum, int blockCount, HammingBlock &block) {
+    for (int blockBit = 0; blockBit < HammingBlock::BLOCK_SIZE * 8; blockBit++) {
+        assignBit(encodedData, blockNum + (blockBit * blockCount), checkBit(block.getBlock(), blockBit));
+    }
+}
+
 /* For debugging: */
 template <size_t N>
 void EncodedFile<N>::printBlock(int blockNum) {
@@ -11,6 +11,20 @@
 #include "encodedFile.hpp"
 
 
+/* - - - - - - Structs - - - - - - */
+
+/* - ScienceSource -
+*   Science window still in the ring buffers it was collected in, for EncodedSciData::encodePages().
+*   Members: buffer, rateCodes, attitude, start, timestamp
+*/
+struct ScienceSource {
+    const uint16_t *buffer = nullptr;     // photodiode samples, BUFFERSIZE
+    const uint8_t *rateCodes = nullptr;   // packed 2 bit sample period codes, nullptr if every sample was taken at the nominal rate
+    const int16_t *attitude = nullptr;    // attitude column aligned to buffer, nullptr if there is no attitude
+    int start = 0;                        // index of the oldest sample in each ring buffer
+    unsigned long timestamp = 0;          // file timestamp
+};
+
 /* - - - - - - Class Declaration - - - - - - */
 
 class EncodedSciData : public EncodedFile<SCIDATA_RAW_MEMSIZE> {
@@ -18,16 +32,29 @@ class EncodedSciData : public EncodedFile<SCIDATA_RAW_MEMSIZE> {
         // member variables
         uint16_t m_buffer[BUFFERSIZE];        // array to hold decoded buffer
         unsigned long m_timestamp = MEMSIZE;  // file timestamp
+        uint8_t m_rateCodes[RATE_CODE_MEMSIZE]; // array to hold decoded sample rate codes
+        int16_t m_attitude[BUFFERSIZE];       // array to hold decoded attitude column
 
     public:
         // constructors
         EncodedSciData() { }
-        EncodedSciData(uint16_t *buffer, unsigned long &timestamp);
+        EncodedSciData(uint16_t *buffer, unsigned long &timestamp, uint8_t *rateCodes = nullptr, int16_t *attitude = nullptr);
 
         // public methods
-        void encodeData(uint16_t *buffer, unsigned long &timestamp);
+        void encodeData(uint16_t *buffer, unsigned long &timestamp, uint8_t *rateCodes = nullptr, int16_t *attitude = nullptr);
         uint16_t *getBuffer();
         unsigned long getTimestamp();
+        uint8_t *getRateCodes();
+        uint8_t getRateCode(int sampleIdx);
+        int16_t *getAttitude();
+
+        static void encodePages(const ScienceSource &source, uint8_t *pages);
+        static void readRaw(const void *source, int offset, uint8_t *dst, int length);
+        static void packAttitude(const int16_t *attitude, uint8_t *packed);
+        static void unpackAttitude(const uint8_t *packed, int16_t *attitude);
+
+    private:
+        static int16_t packAttitudeKey(const int16_t *attitude, int start, int key, int8_t *deltas);
 };
 
 #endif
\ No newline at end of file
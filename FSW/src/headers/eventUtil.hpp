@@ -40,6 +40,7 @@ class Event {
  *  -To check if the TimedEvent is invoked call checkInvoked().
  *      If the time has elapsed, checkInvoked() will return true and invoke the event.
  *      checkInvoked() will only return true one time. Call start() again to restart the timer.
+ *  -To get the time left before the TimedEvent is invoked call remaining().
  */
 class TimedEvent : public Event {
     protected:
@@ -54,6 +55,7 @@ class TimedEvent : public Event {
         void setDuration(unsigned long newDuration);
         bool checkInvoked();
         void start();
+        unsigned long remaining();
 };
 
 /* - - - - - - RecurringEvent - - - - - - *
@@ -25,6 +25,9 @@ namespace faultCode {
         OPTICS_TOO_HOT,
         OPTICS_TOO_COLD,
 
+        // Storage
+        FLASH_MODULE_FAILED,    // a flash module stopped responding and science storage moved to the other
+
         // Bad News
         EEPROM_CORRUPTED,       // EEPROM data is corrupted beyond rescue
         ERR_CODE
@@ -46,7 +49,17 @@ struct PayloadData {
         uint16_t startCount = 1;
         uint16_t consecutiveBadRestarts = 0;
         uint8_t recoveredMode = 0;
-        static const size_t MEMSIZE = 10;
+        uint8_t storageMode = 0;    // StorageMode of the science record store
+        uint8_t scrubPhase = 0;     // ScrubPhase of the flash scrub, idle if none is in progress
+        uint8_t scrubSlot = 0;      // catalog slot the flash scrub is on
+        uint16_t scrubPos = 0;      // page or column the flash scrub is on
+        uint32_t scrubSeq = 0;      // record sequence number of the file the flash scrub is on
+        uint8_t scrubPriorityDone = 0;  // files of the priority list the flash scrub has done
+        uint8_t scrubPriorityCount = 0; // files in scrubPriority
+        uint8_t scrubPriority[SCRUB_PRIORITY_SLOTS] = {}; // slots of files that showed errors in the last scrub
+        uint16_t scrubPasses = 0;   // flash scrubs completed
+        uint32_t checkpointEpoch = 0; // checkpoint log epoch the open science window began in
+        static const size_t MEMSIZE = 27 + SCRUB_PRIORITY_SLOTS;
 };
 
 extern PayloadData payloadData;
@@ -0,0 +1,104 @@
+#ifndef FILE_CATALOG_H
+#define FILE_CATALOG_H
+
+/* - - - - - - Includes - - - - - - */
+// C++ libraries
+
+// Other libraries
+
+// NS2 headers
+#include "config.hpp"
+#include "encodedFile.hpp"
+
+/* - - - - - - Enums - - - - - - */
+enum FileState : uint8_t { // state of a catalog slot
+    FILE_FREE = 0,      // slot is unused
+    FILE_WRITING,       // file is being written, verified against its checksum after a reset
+    FILE_VALID          // file is complete
+};
+
+/* - - - - - - Structs - - - - - - */
+
+/* - CatalogEntry -
+*   Describes the science file held in one catalog slot.
+*   Members: slot, state, size, timestamp, checksum, quality
+*/
+struct CatalogEntry {
+    uint16_t slot = 0;      // slot number, also the number in the file name ("sci000.bin")
+    uint8_t state = FILE_FREE;
+    uint32_t size = 0;      // bytes, size of the file on flash
+    uint32_t timestamp = 0; // timestamp saved with the science data
+    uint32_t checksum = 0;  // crc32c of the file contents as written
+    uint8_t quality = 0;    // 0-255, from the sample range of the window, scored by the retention policy
+    static const int MEMSIZE = sizeof(slot) + sizeof(state) + sizeof(size) + sizeof(timestamp) + sizeof(checksum)
+                               + sizeof(quality);
+};
+
+// bytes, size of a saved catalog chunk before encoding: generation | entries | crc32c
+const int CATALOG_CHUNK_RAW_MEMSIZE = sizeof(uint32_t) + CATALOG_CHUNK_SLOTS * CatalogEntry::MEMSIZE + sizeof(uint32_t);
+const int CATALOG_CHUNKS = (MAXFILES + CATALOG_CHUNK_SLOTS - 1) / CATALOG_CHUNK_SLOTS;
+typedef EncodedFile<CATALOG_CHUNK_RAW_MEMSIZE> EncodedCatalogChunk;
+const int CATALOG_NAME_SIZE = 11; // chars in a science file name, including null terminator
+
+/* - - - - - - Class Declaration - - - - - - */
+
+/* - FileCatalog -
+*   RAM index of the science files on flash. Free slots are kept in a queue so allocation
+*   and release are O(1), lookup is an array index and listing is a pass over RAM.
+*   The catalog is saved in chunks of CATALOG_CHUNK_SLOTS slots, each a Hamming encoded
+*   RECORD_CATALOG record in the record store. save() queues the chunks that changed since
+*   they were last saved through the flash queue, one at a time, so saves never wait on flash
+*   and saves made while one is in flight are folded into it. A record replaces the previous
+*   copy of its chunk only once it is committed, so a reset keeps the last complete copy.
+*/
+class FileCatalog {
+    public:
+        FileCatalog();
+
+        bool load();
+        void save();
+        void service();
+        void clear();
+
+        int allocate();
+        void setState(int slot, uint8_t state);
+        void release(int slot);
+
+        CatalogEntry &getEntry(int slot) { return m_entries[slot]; }
+        bool isValid(int slot);
+        bool isSaved() { return !m_saveRequested && m_savingChunk < 0; }
+        int count() { return MAXFILES - m_freeCount; }
+        int list(uint16_t slots[], int maxCount);
+        uint32_t getGeneration() { return m_generation; }
+        uint32_t getSaveFailures() { return m_saveFailures; }
+
+        static void slotFilename(int slot, char name[CATALOG_NAME_SIZE]);
+
+    private:
+        static void onChunkSaved(void *context, bool status);
+        bool loadChunk(int chunk, int recordIdx, bool mirror);
+        uint32_t chunkCrc(int chunk);
+        void rebuildFreeList();
+        void resolveWriting();
+
+        CatalogEntry m_entries[MAXFILES];
+        uint16_t m_freeSlots[MAXFILES]; // queue of free slot numbers
+        int m_freeHead;                 // position of the next slot to allocate in m_freeSlots
+        int m_freeCount;
+        uint32_t m_generation;          // incremented on every save, saved with each chunk
+        bool m_saveRequested;           // whether chunks may differ from their saved copies
+        bool m_chunkSaved[CATALOG_CHUNKS];   // whether the store holds a copy of each chunk
+        uint32_t m_savedCrc[CATALOG_CHUNKS]; // crc32c of the entries of each chunk as last saved
+        int m_savingChunk;              // chunk waiting on the flash queue, -1 if none
+        uint32_t m_savingCrc;           // crc32c of the entries of m_savingChunk
+        uint32_t m_saveFailures;        // chunks that could not be written
+        EncodedCatalogChunk m_encoded;  // encoding workspace, kept until the chunk being saved is committed
+};
+
+extern FileCatalog fileCatalog;
+
+/* - - - - - - Declarations - - - - - - */
+void printCatalogInfo();
+void printCatalogList();
+
+#endif
@@ -0,0 +1,186 @@
+#ifndef FLASH_DEVICE_H
+#define FLASH_DEVICE_H
+
+/* - - - - - - Includes - - - - - - */
+// C++ libraries
+
+// Other libraries
+#include <SerialFlash.h> // for raw access to flash modules
+#include <SPI.h>         // for polling the status of a module that is not selected
+
+// NS2 headers
+#include "config.hpp"
+
+/* - - - - - - Enums - - - - - - */
+enum StorageMode : uint8_t { // how DualFlashDevice uses the two flash modules, saved in EEPROM
+    STORAGE_MIRRORED = 0,   // every write goes to both modules, reads come from module 1
+    STORAGE_STRIPED,        // chunks alternate between the modules, twice the capacity and write rate
+    STORAGE_SINGLE_1,       // module 2 failed, module 1 only
+    STORAGE_SINGLE_2        // module 1 failed, module 2 only
+};
+
+/* - - - - - - Class Declarations - - - - - - */
+
+/* - FlashDevice -
+*   Raw NOR flash region: programming can only clear bits and a sector must be erased
+*   to set them again. Addresses are relative to the start of the region.
+*/
+class FlashDevice {
+    public:
+        virtual ~FlashDevice() { }
+
+        virtual bool read(uint32_t addr, void *dst, uint32_t length) = 0;
+        virtual bool program(uint32_t addr, const void *src, uint32_t length) = 0;
+        virtual bool eraseSector(uint32_t addr) = 0;
+
+        virtual uint32_t capacity() = 0;   // bytes in the region
+        virtual uint32_t sectorSize() = 0; // bytes, smallest erasable unit
+
+        virtual bool isResponding() { return true; }
+        // whether the module holding addr is still programming or erasing, checked without waiting
+        virtual bool isBusy(uint32_t addr) { (void)addr; return false; }
+        // reads the redundant copy of addr, for devices that keep one
+        virtual bool readMirror(uint32_t addr, void *dst, uint32_t length) { (void)addr; (void)dst; (void)length; return false; }
+};
+
+/* - SerialFlashDevice -
+*   Region of a flash module held by an erasable SerialFlash file, accessed with the
+*   raw SerialFlash read, write and eraseBlock calls. SerialFlash only tracks the selected
+*   module, the status register of the other one is polled directly until the worst case time
+*   of its last program or erase has passed, and before the module is selected.
+*/
+class SerialFlashDevice : public FlashDevice {
+    public:
+        SerialFlashDevice(const char *filename, uint32_t size, int chipSelect);
+
+        bool begin(bool &created);
+
+        bool read(uint32_t addr, void *dst, uint32_t length) override;
+        bool program(uint32_t addr, const void *src, uint32_t length) override;
+        bool eraseSector(uint32_t addr) override;
+
+        uint32_t capacity() override { return m_size; }
+        uint32_t sectorSize() override { return m_sectorSize; }
+        bool isResponding() override;
+        bool isBusy(uint32_t addr) override;
+
+        static const unsigned long PAGE_PROGRAM_MICROS = 3000;    // microseconds, W25Q datasheet maximum page program time
+        static const unsigned long SECTOR_ERASE_MICROS = 2000000; // microseconds, W25Q datasheet maximum 64KB block erase time
+        static const uint8_t READ_STATUS = 0x05; // command that reads status register 1
+        static const uint8_t STATUS_BUSY = 0x01; // status register 1 bit set while programming or erasing
+
+    private:
+        bool select();
+        bool readBusy();
+        void waitReady();
+        bool inRange(uint32_t addr, uint32_t length) { return m_ready && addr <= m_size && length <= m_size - addr; }
+
+        const char *m_filename;
+        uint32_t m_size;
+        int m_chipSelect;
+        uint32_t m_base;        // flash address of the start of the region
+        uint32_t m_sectorSize;
+        bool m_ready;           // whether the region file was opened
+        unsigned long m_busyUntilMicros; // latest end of the last program or erase
+        static int s_selectedChip;       // chip select of the module SerialFlash is talking to
+};
+
+/* - SimFlashDevice -
+*   Host stand-in for a flash module backed by a RAM array, with NOR program and erase
+*   semantics. Power can be cut after a given number of programmed bytes: the byte being
+*   programmed is left torn and every later program or erase is dropped until power returns.
+*   A failed device stops responding. Bus time is simulated for every device on the shared
+*   SPI bus: transfers take turns on the bus, page programs and erases run on each device
+*   in the background, and a device is waited on only when it is used again while busy.
+*/
+class SimFlashDevice : public FlashDevice {
+    public:
+        SimFlashDevice(uint8_t *memory, uint32_t sectorSize, int sectorCount);
+
+        bool read(uint32_t addr, void *dst, uint32_t length) override;
+        bool program(uint32_t addr, const void *src, uint32_t length) override;
+        bool eraseSector(uint32_t addr) override;
+
+        uint32_t capacity() override { return m_sectorSize * m_sectorCount; }
+        uint32_t sectorSize() override { return m_sectorSize; }
+        bool isResponding() override { return !m_failed; }
+        bool isBusy(uint32_t addr) override { (void)addr; return m_busyUntilNanos > s_busNanos; }
+
+        void reset(uint32_t sectorSize, int sectorCount);
+        void eraseAll();
+        void setFailed(bool failed) { m_failed = failed; }
+        void cutPowerAfter(uint32_t bytes);
+        void restorePower() { m_powered = true; m_cutArmed = false; }
+        bool isPowered() { return m_powered; }
+        void injectBitFlip(uint32_t addr, int bit) { m_memory[addr] ^= 1 << bit; }
+
+        uint32_t getBytesProgrammed() { return m_bytesProgrammed; }
+        uint32_t getSectorsErased() { return m_sectorsErased; }
+        uint32_t getPagePrograms() { return m_pagePrograms; }
+        uint32_t getPartialPrograms() { return m_partialPrograms; }
+
+        static uint64_t getBusNanos() { return s_busNanos; }
+        static void resetBusClock() { s_busNanos = 0; }
+        static void advanceBusClock(uint64_t nanos) { s_busNanos += nanos; } // time spent off the bus
+
+        static const uint32_t BYTE_NANOS = 267;            // nanoseconds to clock a byte over SPI at 30 MHz
+        static const uint32_t COMMAND_BYTES = 4;           // command and address bytes before each transfer
+        static const uint32_t PAGE_SIZE = 256;             // bytes, largest single program operation
+        static const uint32_t PAGE_PROGRAM_NANOS = 700000; // nanoseconds, typical page program time
+        static const uint32_t SECTOR_ERASE_NANOS = 150000000; // nanoseconds, typical sector erase time
+
+    private:
+        void waitReady();
+
+        static uint64_t s_busNanos; // simulated time, shared by every device on the bus
+        uint64_t m_busyUntilNanos;  // simulated time the running program or erase finishes
+        bool m_failed;
+        uint8_t *m_memory;
+        uint32_t m_sectorSize;
+        int m_sectorCount;
+        bool m_powered;
+        bool m_cutArmed;            // whether power is lost once m_cutRemaining bytes are programmed
+        uint32_t m_cutRemaining;
+        uint32_t m_tornSeed;        // random source for the bits of a torn byte
+        uint32_t m_bytesProgrammed;
+        uint32_t m_sectorsErased;
+        uint32_t m_pagePrograms;    // program operations issued
+        uint32_t m_partialPrograms; // program operations of less than a page
+};
+
+/* - DualFlashDevice -
+*   Both flash modules as one device. Striped mode alternates STORAGE_STRIPE_CHUNK byte chunks
+*   between the modules so one programs while the other is written to; a sector is one sector
+*   on each module. Mirrored mode writes every chunk to both modules and reads module 1, falling
+*   back to module 2. A module that fails an operation and stops responding is dropped: mirrored
+*   storage carries on with the other copy, striped storage changes layout and must be formatted.
+*/
+class DualFlashDevice : public FlashDevice {
+    public:
+        DualFlashDevice(FlashDevice *chip1, FlashDevice *chip2);
+
+        bool read(uint32_t addr, void *dst, uint32_t length) override;
+        bool program(uint32_t addr, const void *src, uint32_t length) override;
+        bool eraseSector(uint32_t addr) override;
+
+        uint32_t capacity() override;
+        uint32_t sectorSize() override;
+        bool isResponding() override;
+        bool isBusy(uint32_t addr) override;
+        bool readMirror(uint32_t addr, void *dst, uint32_t length) override;
+
+        void setMode(uint8_t mode);
+        uint8_t getMode() { return m_mode; }
+        bool checkChips();
+        uint32_t getFailovers() { return m_failovers; }
+
+    private:
+        FlashDevice *single();
+        bool failover(int chipIdx);
+
+        FlashDevice *m_chips[2];
+        uint8_t m_mode;             // StorageMode
+        uint32_t m_failovers;       // modules dropped since startup
+};
+
+#endif
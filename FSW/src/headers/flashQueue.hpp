@@ -0,0 +1,105 @@
+#ifndef FLASH_QUEUE_H
+#define FLASH_QUEUE_H
+
+/* - - - - - - Includes - - - - - - */
+// C++ libraries
+
+// Other libraries
+
+// NS2 headers
+#include "config.hpp"
+#include "flashDevice.hpp"
+
+/* - - - - - - Enums - - - - - - */
+enum FlashOp : uint8_t { // operation of a queued flash request
+    FLASH_OP_READ = 0,
+    FLASH_OP_READ_MIRROR,   // read from the redundant copy (FlashDevice::readMirror)
+    FLASH_OP_PROGRAM,
+    FLASH_OP_ERASE          // one sector
+};
+
+// called once a request is done, status is false if any part of it failed
+typedef void (*FlashCallback)(void *context, bool status);
+
+/* - - - - - - Structs - - - - - - */
+
+/* - FlashRequest -
+*   One queued read, program or erase. The buffer must stay valid until the callback.
+*   Members: op, device, addr, buffer, length, done, callback, context, submitMicros
+*/
+struct FlashRequest {
+    uint8_t op = FLASH_OP_READ;
+    FlashDevice *device = nullptr;
+    uint32_t addr = 0;
+    uint8_t *buffer = nullptr;
+    uint32_t length = 0;      // bytes to read or program
+    uint32_t done = 0;        // bytes issued so far
+    FlashCallback callback = nullptr;
+    void *context = nullptr;  // passed to the callback
+    uint32_t submitMicros = 0;
+};
+
+/* - FlashQueueStats -
+*   Counters kept by FlashQueue since startup.
+*   Members: submitted, completed, failed, refused, maxDepth, totalLatencyMicros, maxLatencyMicros,
+*            bytes, activeMicros, maxServiceMicros
+*/
+struct FlashQueueStats {
+    uint32_t submitted = 0;
+    uint32_t completed = 0;
+    uint32_t failed = 0;             // completed with status false
+    uint32_t refused = 0;            // not submitted because the queue was full
+    int maxDepth = 0;                // most requests queued at once
+    uint32_t totalLatencyMicros = 0; // summed time from submit to callback
+    uint32_t maxLatencyMicros = 0;
+    uint32_t bytes = 0;              // bytes read or programmed
+    uint32_t activeMicros = 0;       // time the queue was not empty
+    uint32_t maxServiceMicros = 0;   // longest single call to service()
+};
+
+/* - - - - - - Class Declaration - - - - - - */
+
+/* - FlashQueue -
+*   FIFO of flash requests worked through a page at a time by service(), which is called every
+*   loop iteration with a time budget. Before each step the module it targets is polled, if it
+*   is still programming or erasing service() returns instead of waiting. Requests complete in
+*   the order submitted, so a record's commit marker is never programmed before its payload.
+*/
+class FlashQueue {
+    public:
+        FlashQueue();
+
+        bool submitRead(FlashDevice *device, uint32_t addr, void *dst, uint32_t length,
+                        FlashCallback callback, void *context, bool mirror = false);
+        bool submitProgram(FlashDevice *device, uint32_t addr, const void *src, uint32_t length,
+                           FlashCallback callback, void *context);
+        bool submitErase(FlashDevice *device, uint32_t addr, FlashCallback callback, void *context);
+
+        void service(unsigned long budgetMicros);
+        void flush();
+
+        int depth() { return m_count; }
+        int space() { return FLASH_QUEUE_DEPTH - m_count; }
+        bool isIdle() { return m_count == 0; }
+        FlashQueueStats getStats() { return m_stats; }
+        uint32_t bytesPerSecond();
+
+    private:
+        bool submit(const FlashRequest &request);
+        bool step(FlashRequest &request);
+        void complete(bool status);
+
+        FlashRequest m_requests[FLASH_QUEUE_DEPTH]; // ring buffer, oldest request at m_head
+        int m_head;
+        int m_count;
+        uint32_t m_activeSince;     // micros() when the queue last became non-empty
+        FlashQueueStats m_stats;
+};
+
+extern FlashQueue flashQueue;
+
+/* - - - - - - Declarations - - - - - - */
+void handleFlashQueue();
+void printFlashQueueInfo();
+
+#endif
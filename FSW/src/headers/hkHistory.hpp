@@ -0,0 +1,140 @@
+#ifndef HK_HISTORY_H
+#define HK_HISTORY_H
+
+/* - - - - - - Includes - - - - - - */
+// C++ libraries
+
+// Other libraries
+
+// NS2 headers
+#include "config.hpp"
+#include "housekeeping.hpp"
+#include "flashQueue.hpp"
+
+const int HK_CHANNELS = 6; // quantized values of a sample: optics, analog and digital temp, analog and digital current, power good
+const int HK_PIECE_HEADER_MEMSIZE = 2 + sizeof(uint16_t) + sizeof(uint16_t); // "HK", key and length before a downlinked block
+const int HK_PIECE_MEMSIZE = HK_PIECE_HEADER_MEMSIZE + HK_BLOCK_MEMSIZE + sizeof(uint32_t); // largest downlinked block, crc32c last
+
+/* - - - - - - Structs - - - - - - */
+
+/* - HkBlockHeader -
+*   Leads every housekeeping history block, the index kept of the block for time range queries.
+*   Members: startCount, samples, firstMillis, lastMillis, bitCount
+*/
+struct HkBlockHeader {
+    uint16_t startCount = 0;  // payloadData.startCount of the run that took the samples
+    uint16_t samples = 0;
+    uint32_t firstMillis = 0; // millis() when the first sample was taken
+    uint32_t lastMillis = 0;  // millis() when the last sample was taken
+    uint32_t bitCount = 0;    // bits of encoded samples following the header
+    static const int MEMSIZE = sizeof(startCount) + sizeof(samples) + sizeof(firstMillis) + sizeof(lastMillis)
+                                + sizeof(bitCount);
+};
+
+/* - HkHistoryPoint -
+*   A housekeeping sample decoded from a history block, values are within the quantization step.
+*   Members: millis, sample
+*/
+struct HkHistoryPoint {
+    uint32_t millis = 0;      // millis() when the sample was taken
+    HousekeepingData sample = HousekeepingData();
+};
+
+/* - HkBlockIndex -
+*   RAM index entry of a history block stored in the record store.
+*   Members: key, header
+*/
+struct HkBlockIndex {
+    uint16_t key = 0;         // record key of the block
+    HkBlockHeader header;
+};
+
+/* - HkHistoryStats -
+*   Blocks written and the space their samples took, kept by HkHistory.
+*   Members: samples, storedSamples, blocksWritten, blocksLost, blocksRemoved, encodedBits
+*/
+struct HkHistoryStats {
+    uint32_t samples = 0;       // samples added since startup
+    uint32_t storedSamples = 0; // samples in the written blocks
+    uint32_t blocksWritten = 0; // blocks appended to the record store
+    uint32_t blocksLost = 0;    // blocks that could not be appended
+    uint32_t blocksRemoved = 0; // oldest blocks removed to keep HK_HISTORY_BLOCKS
+    uint32_t encodedBits = 0;   // bits the samples of the written blocks took, without their headers
+};
+
+/* - - - - - - Class Declaration - - - - - - */
+
+/* - HkBlockEncoder -
+*   Compresses housekeeping samples into a block of at most HK_BLOCK_MEMSIZE bytes. The first
+*   sample is stored whole, then the time as a delta-of-delta and each quantized value as a
+*   delta from the last, each in a variable width bucket so an unchanged value is one bit.
+*/
+class HkBlockEncoder {
+    public:
+        HkBlockEncoder();
+
+        void begin(uint16_t startCount);
+        bool add(const HousekeepingData &sample, uint32_t millis);
+
+        const uint8_t *getData();
+        uint32_t length() { return HkBlockHeader::MEMSIZE + (m_header.bitCount + 7) / 8; }
+        HkBlockHeader &getHeader() { return m_header; }
+
+        static const int MAX_SAMPLE_BITS = 36 * (HK_CHANNELS + 1) + 1; // every delta in the widest bucket and the heater bit
+
+    private:
+        void writeBits(uint32_t value, int bits);
+        void writeDelta(int32_t delta);
+
+        uint8_t m_data[HK_BLOCK_MEMSIZE];
+        HkBlockHeader m_header;
+        int32_t m_last[HK_CHANNELS]; // quantized values of the last sample
+        uint32_t m_lastDelta;        // milliseconds between the last two samples
+};
+
+/* - HkHistory -
+*   Housekeeping history kept in the record store as compressed blocks keyed by a wrapping
+*   block number. The block being filled is kept in RAM and appended once it is full or
+*   HK_BLOCK_MAX_MSEC old, past HK_HISTORY_BLOCKS the oldest block is removed. The headers of
+*   the stored blocks are indexed in RAM, oldest first, so a time range is found without
+*   reading flash.
+*/
+class HkHistory {
+    public:
+        HkHistory();
+
+        bool begin();
+        void add(const HousekeepingData &sample, uint32_t millis);
+        bool seal();
+
+        int findBlocks(uint16_t startCount, uint32_t fromMillis, uint32_t toMillis, int blocks[], int maxBlocks);
+        int blockCount() { return m_count; }
+        HkBlockIndex &getBlock(int idx) { return m_index[idx]; }
+        HkBlockEncoder &getCurrent() { return m_current; }
+        uint16_t nextKey() { return m_nextKey; }
+        HkHistoryStats getStats() { return m_stats; }
+
+    private:
+        void removeOldest();
+
+        HkBlockIndex m_index[HK_HISTORY_BLOCKS]; // stored blocks, oldest first
+        int m_count;
+        uint16_t m_nextKey;                      // record key of the next block appended
+        uint16_t m_startCount;                   // run the samples are taken in
+        HkBlockEncoder m_current;                // block being filled
+        HkHistoryStats m_stats;
+};
+
+extern HkHistory hkHistory;
+
+/* - - - - - - Declarations - - - - - - */
+bool initHkHistory();
+int decodeHkBlock(const uint8_t *block, uint32_t length, HkHistoryPoint points[], int maxPoints);
+int selectHkHistory(long startCount, long fromSec, long toSec);
+int hkHistoryPiecesLeft();
+int readHkHistoryPiece(uint8_t *product, FlashCallback callback, void *context);
+size_t finishHkHistoryPiece(uint8_t *product);
+void nextHkHistoryPiece();
+void printHkHistoryInfo();
+
+#endif
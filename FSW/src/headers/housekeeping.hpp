@@ -54,6 +54,5 @@ void setHeater();
 void sampleHousekeepingData();
 float voltageToBoardTemp(float voltage);
 float voltageToOpticsTemp(float voltage);
-HousekeepingData *getHkData();
 
 #endif
@@ -0,0 +1,292 @@
+#ifndef RECORD_STORE_H
+#define RECORD_STORE_H
+
+/* - - - - - - Includes - - - - - - */
+// C++ libraries
+
+// Other libraries
+
+// NS2 headers
+#include "config.hpp"
+#include "flashDevice.hpp"
+#include "flashQueue.hpp"
+
+/* - - - - - - Enums - - - - - - */
+enum RecordType : uint8_t { // contents of a record
+    RECORD_SCIENCE = 1,     // encoded science window, keyed by catalog slot
+    RECORD_BURST,           // encoded burst, keyed by burst file number
+    RECORD_ERROR_MAP,       // errors found in each sector, key 0 (see RecordStore::saveErrorMap())
+    RECORD_SHADOW,          // repaired window of a science record, keyed by RecordStore::shadowKey()
+    RECORD_HK_HISTORY,      // compressed housekeeping samples, keyed by block number (see hkHistory.cpp)
+    RECORD_BLACK_BOX,       // logged events, keyed by block number (see blackBox.cpp)
+    RECORD_CATALOG          // science file catalog, keyed by chunk of CATALOG_CHUNK_SLOTS slots (see fileCatalog.cpp)
+};
+
+enum SectorState : uint8_t { // state of a sector of the store
+    SECTOR_DIRTY = 0,       // holds old or unknown data, must be erased before use
+    SECTOR_ERASING,         // erase queued by reclaim()
+    SECTOR_FREE,            // erased and stamped with its erase count, ready to be opened
+    SECTOR_USED             // opened for records
+};
+
+/* - - - - - - Structs - - - - - - */
+
+/* - RecordHeader -
+*   Leads every record in the store. A packed record continues with the payload padded to 4 bytes
+*   and a commit marker. A paged record has the header and commit marker in its first page and
+*   the payload in whole pages after it.
+*   Members: magic, type, flags, seq, key, layout, length, payloadCrc, headerCrc
+*/
+struct RecordHeader {
+    uint16_t magic = 0;       // RECORD_MAGIC
+    uint8_t type = 0;         // RecordType
+    uint8_t flags = 0xFF;     // RECORD_FLAG_LIVE is cleared in place to delete, not covered by headerCrc
+    uint32_t seq = 0;         // incremented on every append, the newest record of a type and key wins
+    uint16_t key = 0;         // identifies the record within its type
+    uint16_t layout = RECORD_LAYOUT_PACKED;
+    uint32_t length = 0;      // bytes of payload
+    uint32_t payloadCrc = 0;  // crc32c of the payload
+    uint32_t headerCrc = 0;   // crc32c of the header with flags erased and this field zeroed
+    static const int MEMSIZE = sizeof(magic) + sizeof(type) + sizeof(flags) + sizeof(seq) + sizeof(key)
+                                + sizeof(layout) + sizeof(length) + sizeof(payloadCrc) + sizeof(headerCrc);
+    static const uint16_t RECORD_MAGIC = 0x5352;    // "RS"
+    static const uint8_t RECORD_FLAG_LIVE = 0x01;
+    static const int FLAGS_OFFSET = 3;              // byte offset of flags in a stored header
+    static const uint16_t RECORD_LAYOUT_PACKED = 0xFFFF;
+    static const uint16_t RECORD_LAYOUT_PAGED = 0x0001;
+};
+
+/* - SectorHeader -
+*   Leads every sector of the store. The erase count is stamped once the sector has been erased,
+*   the sequence number is programmed when the sector is opened for records, and the obsolete
+*   flag is cleared before the sector is erased again. Each number is stored with its complement
+*   so a write cut short by a reset is seen.
+*   Members: magic, flags, eraseCount, seq
+*/
+struct SectorHeader {
+    uint16_t magic = 0;       // SECTOR_MAGIC
+    uint8_t flags = 0xFF;
+    uint32_t eraseCount = 0;  // times the sector has been erased
+    uint32_t seq = 0;         // from the same counter as record seq, the newest sector is the one being filled
+    static const int MEMSIZE = 20;          // magic, flags, a spare byte, erase count, seq, each number with its complement
+    static const int STAMP_MEMSIZE = 12;    // magic to erase count complement, programmed after an erase
+    static const int FLAGS_OFFSET = 2;
+    static const int SEQ_OFFSET = 12;
+    static const uint16_t SECTOR_MAGIC = 0x5353;  // "SS"
+    static const uint8_t SECTOR_FLAG_OBSOLETE = 0x01;
+};
+
+/* - SectorInfo -
+*   RAM state of a sector of the store.
+*   Members: seq, eraseCount, live, state
+*/
+struct SectorInfo {
+    uint32_t seq = 0;
+    uint32_t eraseCount = 0;
+    uint16_t live = 0;        // live records with their header in the sector
+    uint8_t state = SECTOR_DIRTY;
+};
+
+const uint32_t RECORD_COMMIT = 0xC0DE4E53;  // written after the payload once it is complete
+const int RECORD_COMMIT_MEMSIZE = sizeof(RECORD_COMMIT);
+
+/* - RecordInfo -
+*   RAM index entry for a live record.
+*   Members: addr, length, seq, payloadCrc, key, type, paged, shadows
+*/
+struct RecordInfo {
+    uint32_t addr = 0;        // store address of the record header
+    uint32_t length = 0;      // bytes of payload
+    uint32_t seq = 0;
+    uint32_t payloadCrc = 0;
+    uint16_t key = 0;
+    uint8_t type = 0;
+    bool paged = false;       // payload starts on the page after the header
+    uint16_t shadows = 0;     // live shadows of windows of the payload, read in place of them
+};
+
+/* - RecordStoreStats -
+*   Mount and write costs, kept by RecordStore.
+*   Members: mountMicros, headersScanned, tornHeaders, uncommitted, payloadBytes, programmedBytes, abandonedBytes,
+*            reclaimedSectors, foregroundErases, eraseFailures, shadowWindows
+*/
+struct RecordStoreStats {
+    uint32_t mountMicros = 0;     // microseconds taken by the last mount
+    uint32_t headersScanned = 0;  // headers read by the last mount
+    uint32_t tornHeaders = 0;     // unreadable headers skipped by the last mount
+    uint32_t uncommitted = 0;     // records without a commit marker found by the last mount
+    uint32_t payloadBytes = 0;    // payload bytes appended since mount
+    uint32_t programmedBytes = 0; // bytes programmed since mount, including headers, commits and deletions
+    uint32_t abandonedBytes = 0;  // bytes lost to torn or uncommitted records, and sector tails too short to use
+    uint32_t reclaimedSectors = 0; // dead sectors erased in the background since mount
+    uint32_t foregroundErases = 0; // sectors erased by an append because none were ready
+    uint32_t eraseFailures = 0;    // sectors that could not be erased or stamped
+    uint32_t shadowWindows = 0;    // windows repaired by writing a shadow since mount
+};
+
+class RecordStore;
+
+/* - PendingAppend -
+*   An append submitted to the flash queue, the packed header is kept here until it is programmed.
+*   Members: store, packed, info, failed, inUse, callback, context
+*/
+struct PendingAppend {
+    RecordStore *store = nullptr;
+    uint8_t packed[RecordHeader::MEMSIZE];
+    RecordInfo info;
+    bool failed = false;    // the header could not be programmed
+    bool inUse = false;
+    FlashCallback callback = nullptr; // caller's callback, run once the record is committed or has failed
+    void *context = nullptr;
+};
+
+/* - PendingRead -
+*   A read of a record with shadows submitted to the flash queue, the shadows are read over it
+*   once the payload has been read.
+*   Members: store, type, key, seq, dst, offset, length, mirror, inUse, callback, context
+*/
+struct PendingRead {
+    RecordStore *store = nullptr;
+    uint8_t type = 0;       // record read, looked up again as indices may change
+    uint16_t key = 0;
+    uint32_t seq = 0;
+    uint8_t *dst = nullptr;
+    uint32_t offset = 0;
+    uint32_t length = 0;
+    bool mirror = false;
+    bool inUse = false;
+    FlashCallback callback = nullptr; // caller's callback
+    void *context = nullptr;
+};
+
+/* - - - - - - Class Declaration - - - - - - */
+
+/* - RecordStore -
+*   Log of records on a flash device, filled a sector at a time. A record is written header first,
+*   then its payload, then a commit marker, so a reset at any byte leaves a record that mount()
+*   either indexes complete or skips. Records do not cross sector boundaries, an unreadable header
+*   costs only the rest of its sector. mount() reads sector headers, record headers and commit
+*   markers only.
+*   Each sector counts its live records. Once a sector holds none, reclaim() erases it in the
+*   background and it joins the pool of erased sectors, appends open the least worn of them.
+*   Paged records start on a page boundary and keep their payload in whole pages, so it is
+*   programmed one full page at a time and any page can be checked or repaired on its own.
+*   Errors found in a record (noteErrors()) are counted against its sector, the counts are kept
+*   in a record of their own and carry over a format. A sector with SECTOR_RETIRE_ERRORS or more
+*   is retired: it is read until its records are removed but never erased or opened again.
+*   A window of a science record that cannot be repaired by clearing bits is written again as a
+*   shadow record (writeShadow()), reads of the record take the window from its newest shadow.
+*   The shadow's commit marker is the switch from the old window to the new one.
+*   Appends and reads can also be submitted to the flash queue, the record is indexed when
+*   its commit marker has been programmed.
+*/
+class RecordStore {
+    public:
+        static const int ERROR_MAP_MEMSIZE = 2 + sizeof(uint16_t) + sizeof(uint8_t) + RECORD_MAX_SECTORS + sizeof(uint32_t); // downlinked error map, see buildErrorMap()
+
+        RecordStore();
+
+        bool format(FlashDevice *device);
+        bool mount(FlashDevice *device);
+        bool isMounted() { return m_device != nullptr; }
+
+        bool append(uint8_t type, uint16_t key, const void *data, uint32_t length, bool paged = false);
+        int find(uint8_t type, uint16_t key);
+        bool read(int idx, void *dst, uint32_t offset, uint32_t length);
+        bool readMirror(int idx, void *dst, uint32_t offset, uint32_t length);
+        bool verify(int idx);
+        bool remove(int idx);
+        bool patch(int idx, uint32_t offset, const void *src, uint32_t length);
+        bool writeShadow(int idx, uint32_t window, const void *data);
+        int findShadow(int idx, uint32_t window);
+        void reclaim();
+        void noteErrors(int idx, int errors);
+        bool saveErrorMap();
+        bool clearErrorMap();
+
+        bool submitAppend(uint8_t type, uint16_t key, const void *data, uint32_t length,
+                          FlashCallback callback, void *context, bool paged = false);
+        bool submitRead(int idx, void *dst, uint32_t offset, uint32_t length,
+                        FlashCallback callback, void *context, bool mirror = false);
+        int pendingAppends();
+
+        RecordInfo &getRecord(int idx) { return m_records[idx]; }
+        int count() { return m_count; }
+        uint32_t freeBytes();
+        uint32_t reclaimableBytes();
+        bool fits(uint32_t length, bool paged = false);
+        int sectorCount() { return m_sectorCount; }
+        SectorInfo &getSector(int sector) { return m_sectors[sector]; }
+        int countSectors(uint8_t state);
+        int reclaimableSectors();
+        uint8_t getSectorErrors(int sector) { return m_sectorErrors[sector]; }
+        bool isRetired(int sector) { return m_sectorErrors[sector] >= SECTOR_RETIRE_ERRORS; }
+        int retiredSectors();
+        RecordStoreStats getStats() { return m_stats; }
+
+        static uint32_t recordMemsize(uint32_t length, bool paged = false);
+        static uint32_t payloadOffset(bool paged) { return paged ? FLASH_PAGE_SIZE : RecordHeader::MEMSIZE; }
+        static uint32_t commitOffset(uint32_t length, bool paged);
+        static uint16_t shadowKey(uint16_t key, uint32_t window) { return key << 8 | window; }
+
+        static const uint32_t SHADOW_WINDOW = FLASH_PAGE_SIZE; // bytes of payload a shadow replaces
+
+    private:
+        static void onAppendHeader(void *context, bool status);
+        static void onAppendPayload(void *context, bool status);
+        static void onAppendCommit(void *context, bool status);
+        void finishAppend(PendingAppend &pending, bool status);
+        static void onReclaimErase(void *context, bool status);
+        static void onReclaimStamp(void *context, bool status);
+        static void onShadowedRead(void *context, bool status);
+
+        bool reserve(uint8_t type, uint16_t key, uint32_t length, bool paged, uint32_t &addr);
+        bool openSector();
+        bool eraseSector(int sector);
+        bool isDead(int sector);
+        bool isUsable(int sector) { return !isRetired(sector) && (m_sectors[sector].state == SECTOR_DIRTY || isDead(sector)); }
+        void loadErrorMap();
+        void readSectorHeaders();
+        bool readSectorHeader(int sector);
+        uint32_t scanSector(int sector);
+        void packStamp(uint32_t eraseCount, uint8_t stamp[SectorHeader::STAMP_MEMSIZE]);
+        int sectorOf(uint32_t addr) { return addr / m_device->sectorSize(); }
+        void packHeader(RecordHeader &header, uint8_t packed[RecordHeader::MEMSIZE]);
+        bool mirrorMatches(int idx);
+        bool readHeader(uint32_t addr, RecordHeader &header, bool &erased, bool mirror = false);
+        uint32_t headerCrc(const uint8_t packed[RecordHeader::MEMSIZE]);
+        void indexRecord(const RecordInfo &info);
+        bool readPayload(int idx, void *dst, uint32_t offset, uint32_t length, bool mirror);
+        bool readShadows(int idx, uint8_t *dst, uint32_t offset, uint32_t length, bool mirror);
+        void removeShadows(uint16_t key, uint32_t seq);
+        void linkShadows();
+        bool markDeleted(uint32_t addr);
+        bool program(uint32_t addr, const void *src, uint32_t length);
+
+        FlashDevice *m_device;
+        uint32_t m_writeAddr;     // address of the next append, in the head sector
+        int m_head;               // sector being filled, -1 before the first append
+        SectorInfo m_sectors[RECORD_MAX_SECTORS];
+        int m_sectorCount;
+        int m_reclaimSector;      // sector reclaim() is erasing, -1 if none
+        uint8_t m_stamp[SectorHeader::STAMP_MEMSIZE]; // stamp of m_reclaimSector, kept until it is programmed
+        uint32_t m_nextSeq;
+        uint8_t m_sectorErrors[RECORD_MAX_SECTORS]; // errors found in each sector, saturating
+        bool m_errorsChanged;     // counts changed since the error map was saved
+        RecordInfo m_records[RECORD_MAX_RECORDS]; // live records, in no particular order
+        int m_count;
+        RecordStoreStats m_stats;
+        PendingAppend m_pending[RECORD_MAX_PENDING];
+        PendingRead m_pendingReads[RECORD_MAX_PENDING];
+};
+
+extern RecordStore recordStore;
+
+/* - - - - - - Declarations - - - - - - */
+bool initRecordStore();
+void handleStorage();
+bool setStorageMode(uint8_t mode);
+void printRecordStoreInfo();
+size_t buildErrorMap(uint8_t *buffer);
+
+#endif
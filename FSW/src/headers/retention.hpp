@@ -0,0 +1,83 @@
+#ifndef RETENTION_H
+#define RETENTION_H
+
+/* - - - - - - Includes - - - - - - */
+// C++ libraries
+
+// Other libraries
+
+// NS2 headers
+#include "config.hpp"
+#include "windowCache.hpp"
+
+/* - - - - - - Enums - - - - - - */
+enum RetentionPolicy : uint8_t { // window evicted when storage is full, RETENTION_POLICY
+    RETAIN_SCORED = 0,  // the window with the lowest score
+    RETAIN_NEWEST,      // the oldest window
+    RETAIN_STORED       // none, the new window is dropped
+};
+
+/* - - - - - - Structs - - - - - - */
+
+/* - EvictionRecord -
+*   One eviction decision, kept in the log printed by printRetentionInfo().
+*   Members: millis, slot, quality, policy, newer, score
+*/
+struct EvictionRecord {
+    uint32_t millis = 0;    // when the window was evicted
+    uint16_t slot = 0;      // catalog slot of the window
+    uint8_t quality = 0;    // quality saved with the window, 0-255
+    uint8_t policy = 0;     // RETENTION_POLICY that chose it
+    uint16_t newer = 0;     // windows stored after it
+    int32_t score = 0;      // score it lost with, windows without a record score lowest
+};
+
+/* - RetentionStats -
+*   Windows evicted and dropped since startup, kept by Retention.
+*   Members: evictions, dropped, missing
+*/
+struct RetentionStats {
+    uint32_t evictions = 0; // stored windows evicted for a new one
+    uint32_t dropped = 0;   // new windows not saved because nothing could be evicted
+    uint32_t missing = 0;   // evicted windows whose record was already lost
+};
+
+/* - - - - - - Class Declaration - - - - - - */
+
+/* - Retention -
+*   Keeps flash available for the next science window. Before a window is saved, makeRoom()
+*   evicts stored windows while the catalog is at its quota or the record store has no room,
+*   lowest value first. A window is scored by its quality (the sample range saved in the
+*   catalog) less its age (the windows stored after it). Windows being written or read for
+*   downlink are never evicted, downlinked windows are already removed when they are sent.
+*/
+class Retention {
+    public:
+        Retention();
+
+        bool makeRoom(int busySlot);
+        int pickEviction(int busySlot, int32_t &score, int &newer);
+        int32_t score(uint8_t quality, int newer);
+
+        int logCount() { return m_logCount; }
+        EvictionRecord &getLog(int age);
+        RetentionStats getStats() { return m_stats; }
+
+        static uint8_t quality(const WindowSummary &summary);
+
+    private:
+        bool needsRoom();
+        void evict(int slot, int32_t score, int newer);
+
+        EvictionRecord m_log[RETENTION_LOG_SIZE]; // ring of the newest decisions
+        int m_logHead;                            // position of the next decision in m_log
+        int m_logCount;
+        RetentionStats m_stats;
+};
+
+extern Retention retention;
+
+/* - - - - - - Declarations - - - - - - */
+void printRetentionInfo();
+
+#endif
@@ -0,0 +1,142 @@
+#ifndef SCRUBBER_H
+#define SCRUBBER_H
+
+/* - - - - - - Includes - - - - - - */
+// C++ libraries
+
+// Other libraries
+
+// NS2 headers
+#include "config.hpp"
+#include "encodedSciData.hpp"
+#include "faultManager.hpp"
+
+/* - - - - - - Enums - - - - - - */
+enum ScrubPhase : uint8_t { // part of a file the scrub is on
+    SCRUB_IDLE = 0,     // no scrub in progress
+    SCRUB_CHECK,        // checking the pages of the file against their checksums
+    SCRUB_CORRECT,      // correcting the byte columns of the file that cross a bad page
+    SCRUB_VERIFY        // checking the bad pages again and repairing their checksums
+};
+
+enum ScrubStatus : uint8_t { // result of a scrub step
+    SCRUB_RUNNING = 0,  // more steps to go
+    SCRUB_DONE          // every file has been scrubbed
+};
+
+/* - - - - - - Structs - - - - - - */
+
+/* - ScrubCursor -
+*   Position of the scrub, saved to EEPROM so a scrub carries on after a reset.
+*   Members: phase, priority, slot, pos, seq
+*/
+struct ScrubCursor {
+    uint8_t phase = SCRUB_IDLE;
+    uint8_t priority = 0;   // files of the priority list scrubbed, the walk of every slot follows
+    uint8_t slot = 0;       // catalog slot of the walk
+    uint16_t pos = 0;       // next page to check or verify, or next column to correct
+    uint32_t seq = 0;       // record sequence number of the file, a file replaced since is started again
+};
+
+/* - ScrubStats -
+*   Coverage and costs of a scrub since it started or was resumed, kept by Scrubber.
+*   Members: storedBytes, coveredBytes, bytesRead, steps, cpuMicros, maxStepMicros, files, cleanFiles,
+*            patchedBytes, patches, shadowWindows
+*/
+struct ScrubStats {
+    uint32_t storedBytes = 0;    // bytes of science files stored when the scrub started
+    uint32_t coveredBytes = 0;   // bytes of science files scrubbed
+    uint32_t bytesRead = 0;      // bytes read from flash, the background scrub is paced by it
+    uint32_t steps = 0;
+    uint32_t cpuMicros = 0;      // time spent in steps
+    uint32_t maxStepMicros = 0;  // longest step
+    uint32_t files = 0;          // files scrubbed
+    uint32_t cleanFiles = 0;     // files whose pages all passed their checksum, not decoded
+    uint32_t patchedBytes = 0;   // bytes corrected in place
+    uint32_t patches = 0;        // program operations of corrections, none cross a page
+    uint32_t shadowWindows = 0;  // pages with a correction that sets a bit, written again as shadows
+};
+
+/* - - - - - - Class Declaration - - - - - - */
+
+/* - Scrubber -
+*   Scrubs the science files in the record store a small bounded step at a time. The pages of a
+*   file are checked against their checksums SCRUB_CHECK_PAGES at a time, a file whose pages all
+*   pass is not decoded. Otherwise every row of the byte columns that cross a bad page is read,
+*   SCRUB_CHUNK_COLUMNS columns at a time, and scrubbed on its own (EncodedFile::scrubChunk()).
+*   Corrections are programmed over the bytes they change. Flash can only clear bits, the page of
+*   a correction that has to set one is written again on its own as a shadow record
+*   (RecordStore::writeShadow()), about one page per such correction.
+*   The bad pages are checked again last and their checksums repaired the same way. Blocks too
+*   corrupted to correct are taken from the copy in the window cache, or else the mirror copy.
+*   Files that showed errors in the last scrub are scrubbed first, then every other slot in turn.
+*   The cursor is saved to EEPROM when a scrub starts and ends and every SCRUB_SAVE_STEPS steps.
+*   Bad pages are only kept in RAM, a reset part way through a file with bad pages starts that
+*   file again.
+*/
+class Scrubber {
+    public:
+        Scrubber();
+
+        void start();
+        bool resume();
+        ScrubStatus step();
+        void stop();
+
+        bool isActive() { return m_cursor.phase != SCRUB_IDLE; }
+        ScrubCursor getCursor() { return m_cursor; }
+        int currentSlot() { return m_cursor.priority < m_priorityCount ? m_priority[m_cursor.priority] : m_cursor.slot; }
+        ScrubReport getReport() { return m_report; }
+        ScrubStats getStats() { return m_stats; }
+        ScrubReport getLastReport() { return m_lastReport; }
+        ScrubStats getLastStats() { return m_lastStats; }
+        int getPasses() { return payloadData.scrubPasses; }
+        int priorityCount() { return m_priorityCount; }
+
+        static const int BUFFER_MEMSIZE = EncodedSciData::ROW_COUNT * SCRUB_CHUNK_COLUMNS;
+
+    private:
+        void beginPass();
+        void finishPass();
+        int findFile();
+        void nextFile();
+        ScrubStatus finishFile();
+        bool isPriority(int slot);
+        ScrubStatus checkPages(int recordIdx);
+        ScrubStatus correctColumns(int recordIdx);
+        ScrubStatus verifyPages(int recordIdx);
+        bool isBadPage(int page) { return m_badPages[page / 8] & (1 << (page % 8)); }
+        bool readEncoded(int recordIdx, int offset, uint8_t *dst, int length, bool mirror);
+        bool patchEncoded(int recordIdx, int offset, const uint8_t *src, int length);
+        bool repairBytes(int recordIdx, uint32_t addr, const uint8_t *src, int length);
+        void saveCursor();
+
+        ScrubCursor m_cursor;
+        bool m_fileOpen;        // whether the file at the cursor has been looked up since the cursor was set
+        bool m_paged;           // whether the file is laid out in pages with checksums
+        bool m_anyBad;          // whether a page of the file failed its checksum
+        bool m_fileErrors;      // whether the file showed any errors
+        uint8_t m_priority[SCRUB_PRIORITY_SLOTS]; // files scrubbed first, from the last scrub
+        int m_priorityCount;
+        uint8_t m_found[SCRUB_PRIORITY_SLOTS];    // files that showed errors in this scrub
+        int m_foundCount;
+        int m_stepsSinceSave;
+        uint8_t m_badPages[EncodedSciData::BAD_PAGE_MEMSIZE]; // pages of the file that failed their checksum
+        uint8_t m_buffer[BUFFER_MEMSIZE];   // pages being checked, or the rows of the columns being corrected
+        uint8_t m_mirror[BUFFER_MEMSIZE];   // the same rows from the mirror copy
+        ScrubReport m_report;
+        ScrubStats m_stats;
+        ScrubReport m_lastReport; // of the last scrub to finish
+        ScrubStats m_lastStats;
+};
+
+extern Scrubber scrubber;
+
+/* - - - - - - Declarations - - - - - - */
+bool initScrubber();
+void handleScrub();
+uint32_t scrubRate(uint32_t storedBytes);
+void printScrubReport();
+void printScrubInfo();
+
+#endif
@@ -0,0 +1,157 @@
+#ifndef SPI_BUS_H
+#define SPI_BUS_H
+
+/* - - - - - - Includes - - - - - - */
+// C++ libraries
+
+// Other libraries
+#include <SPI.h>
+
+// NS2 headers
+#include "config.hpp"
+#include "flashDevice.hpp"
+
+/* - - - - - - Enums - - - - - - */
+enum SpiDevice : uint8_t { // devices sharing the SPI bus
+    SPI_DEVICE_ADC = 0,     // science ADC
+    SPI_DEVICE_FLASH1,      // flash module 1
+    SPI_DEVICE_FLASH2,      // flash module 2
+    SPI_DEVICE_COUNT        // KEEP THIS LAST, it is used for indexing
+};
+
+// whether a polled ADC sample is due, dueMicros is set to the micros() it came due at
+typedef bool (*AdcSlotCheck)(uint32_t &dueMicros);
+
+/* - - - - - - Structs - - - - - - */
+
+/* - SpiBusStats -
+*   Bus time and ADC sample latency, kept by SpiBus. Counters are only statistics, one can miss
+*   a count when the burst interrupt samples in the middle of an update.
+*   Members: adcReads, heldSamples, lateSamples, maxLatencyMicros, latency, flashChunks, flashBytes,
+*            busyMicros, sinceMicros, sinceMillis
+*/
+struct SpiBusStats {
+    uint32_t adcReads = 0;          // ADC samples read
+    uint32_t heldSamples = 0;       // polled samples taken between flash chunks and held for the loop
+    uint32_t lateSamples = 0;       // samples read more than SPI_ADC_LATENCY_BOUND_MICROS after they came due
+    uint32_t maxLatencyMicros = 0;
+    uint32_t latency[SPI_LATENCY_BUCKETS] = {}; // samples by latency, bucket i below 2^i microseconds, the last the rest
+    uint32_t flashChunks = 0;       // flash transfers issued
+    uint32_t flashBytes = 0;        // bytes read or programmed
+    uint32_t busyMicros[SPI_DEVICE_COUNT] = {}; // time each device held the bus
+    uint32_t sinceMicros = 0;       // micros() the statistics were reset at
+    uint32_t sinceMillis = 0;       // millis() the statistics were reset at, micros() wraps every 71 minutes
+};
+
+/* - - - - - - Class Declarations - - - - - - */
+
+/* - AdcPort -
+*   The science ADC end of the bus, takes one sample per transfer.
+*/
+class AdcPort {
+    public:
+        virtual ~AdcPort() { }
+        virtual uint16_t transfer() = 0;
+};
+
+/* - SpiAdcPort -
+*   Science ADC on the SPI bus, its settings are built once instead of for every sample.
+*/
+class SpiAdcPort : public AdcPort {
+    public:
+        SpiAdcPort(int chipSelect);
+        uint16_t transfer() override;
+
+    private:
+        SPISettings m_settings;
+        int m_chipSelect;
+};
+
+/* - SimAdcPort -
+*   Host stand-in for the science ADC, returns a set value and counts its transfers.
+*/
+class SimAdcPort : public AdcPort {
+    public:
+        SimAdcPort() { m_value = 0; m_reads = 0; }
+        uint16_t transfer() override { m_reads++; return m_value; }
+
+        void setValue(uint16_t value) { m_value = value; }
+        uint32_t getReads() { return m_reads; }
+
+    private:
+        uint16_t m_value;
+        uint32_t m_reads;
+};
+
+/* - SpiBus -
+*   Owns the SPI bus shared by the science ADC and the flash modules. The ADC has strict
+*   priority: flash transfers go through BusFlashDevice in chunks of at most SPI_FLASH_CHUNK
+*   bytes, and before each chunk a polled sample that has come due is taken and held for the
+*   loop, so a sample waits for at most one chunk. The burst interrupt is kept out of flash
+*   transactions by SPI.usingInterrupt() and likewise waits for at most one chunk.
+*/
+class SpiBus {
+    public:
+        SpiBus(AdcPort *adc);
+
+        void begin();
+        uint16_t readAdc(uint32_t dueMicros);
+        uint16_t takeAdcSample(uint32_t dueMicros, uint32_t &sampleMicros);
+        void yieldToAdc();
+        void noteFlash(uint8_t device, uint32_t bytes, uint32_t busyMicros);
+
+        void setAdcSlot(AdcSlotCheck check) { m_slotCheck = check; }
+        void setAdcPort(AdcPort *adc) { m_adc = adc != nullptr ? adc : m_spiAdc; }
+        bool isHolding() { return m_holding; }
+        float utilization();
+        SpiBusStats getStats() { return m_stats; }
+        void resetStats();
+
+    private:
+        void noteLatency(uint32_t latency);
+
+        AdcPort *m_adc;
+        AdcPort *m_spiAdc;           // the ADC on the bus, restored by setAdcPort(nullptr)
+        AdcSlotCheck m_slotCheck;
+        bool m_begun;
+        bool m_holding;              // a polled sample was taken between flash chunks
+        uint16_t m_heldSample;
+        uint32_t m_heldMicros;       // micros() the held sample was taken at
+        SpiBusStats m_stats;
+};
+
+/* - BusFlashDevice -
+*   Flash module on the shared SPI bus. Reads and programs are issued in chunks of at most
+*   SPI_FLASH_CHUNK bytes aligned to SPI_FLASH_CHUNK, so programs stay whole pages, and the
+*   ADC is given the bus before each chunk.
+*/
+class BusFlashDevice : public FlashDevice {
+    public:
+        BusFlashDevice(FlashDevice *chip, SpiBus *bus, uint8_t device);
+
+        bool read(uint32_t addr, void *dst, uint32_t length) override;
+        bool program(uint32_t addr, const void *src, uint32_t length) override;
+        bool eraseSector(uint32_t addr) override;
+
+        uint32_t capacity() override { return m_chip->capacity(); }
+        uint32_t sectorSize() override { return m_chip->sectorSize(); }
+        bool isResponding() override { return m_chip->isResponding(); }
+        bool isBusy(uint32_t addr) override { return m_chip->isBusy(addr); }
+        bool readMirror(uint32_t addr, void *dst, uint32_t length) override;
+
+    private:
+        enum ChunkOp : uint8_t { CHUNK_READ, CHUNK_READ_MIRROR, CHUNK_PROGRAM };
+        bool transfer(uint8_t op, uint32_t addr, uint8_t *bytes, uint32_t length);
+
+        FlashDevice *m_chip;
+        SpiBus *m_bus;
+        uint8_t m_device;            // SpiDevice
+};
+
+extern SpiBus spiBus;
+
+/* - - - - - - Declarations - - - - - - */
+void initSpiBus(AdcSlotCheck check);
+void printSpiBusInfo();
+
+#endif
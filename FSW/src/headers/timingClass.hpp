@@ -27,6 +27,7 @@ class ScienceMode {
         // FUTURE TEAMS: this event is invoked when the ADCS should switch its sweep direction
         //   so link your ADCS module with this event to tell it when to switch direction 
         //      look at checkSweepChange() in timing.cpp for more info
+        //   for closed loop pointing, use readAdcsFeedback() or registerAdcsCallback() in adcsFeedback.hpp
         Event sweepChangeEvent;
         
         // lockout to prevent sweep change while ADCS is reversing direction
@@ -0,0 +1,85 @@
+#ifndef WINDOW_CACHE_H
+#define WINDOW_CACHE_H
+
+/* - - - - - - Includes - - - - - - */
+// C++ libraries
+
+// Other libraries
+
+// NS2 headers
+#include "config.hpp"
+#include "encodedSciData.hpp"
+
+/* - - - - - - Structs - - - - - - */
+
+/* - WindowSummary -
+*   Quicklook of a science window, taken from its samples when it is saved.
+*   Members: timestamp, samples, minSample, maxSample, meanSample
+*/
+struct WindowSummary {
+    unsigned long timestamp = 0;  // timestamp saved with the window
+    uint16_t samples = 0;
+    uint16_t minSample = 0;       // ADC bins
+    uint16_t maxSample = 0;
+    uint16_t meanSample = 0;
+};
+
+/* - WindowCacheStats -
+*   Lookups and the flash reads they saved, kept by WindowCache.
+*   Members: hits, misses, evictions, invalidations, hitBytes, missBytes, missMicros
+*/
+struct WindowCacheStats {
+    uint32_t hits = 0;
+    uint32_t misses = 0;
+    uint32_t evictions = 0;      // windows dropped for a newer one
+    uint32_t invalidations = 0;  // windows dropped because the record was removed
+    uint32_t hitBytes = 0;       // bytes served from RAM instead of flash
+    uint32_t missBytes = 0;      // bytes read from flash on a miss and timed
+    uint32_t missMicros = 0;     // time those reads took
+};
+
+/* - - - - - - Class Declaration - - - - - - */
+
+/* - WindowCache -
+*   RAM copies of the WINDOW_CACHE_WINDOWS most recently written science windows, laid out in
+*   pages as on flash, with their summaries. An entry belongs to a catalog slot and the record
+*   seq it was written as, so a newer record in the slot never hits the older copy. The least
+*   recently used entry is replaced by a put(). Entries are not changed by the scrub, a repaired
+*   record reads the same as the copy.
+*/
+class WindowCache {
+    public:
+        WindowCache();
+
+        void put(int slot, uint32_t seq, const uint8_t *pages, const WindowSummary &summary);
+        const uint8_t *get(int slot, uint32_t seq);
+        const uint8_t *peek(int slot, uint32_t seq);
+        bool getSummary(int slot, uint32_t seq, WindowSummary &summary);
+        void invalidate(int slot);
+        void clear();
+        void noteFlashRead(uint32_t bytes, uint32_t micros);
+
+        int count();
+        WindowCacheStats getStats() { return m_stats; }
+        uint32_t savedMicros();
+
+        static WindowSummary summarize(const uint16_t *buffer, int count, unsigned long timestamp);
+
+    private:
+        int find(int slot, uint32_t seq);
+
+        int16_t m_slots[WINDOW_CACHE_WINDOWS];   // catalog slot of each entry, -1 if empty
+        uint32_t m_seqs[WINDOW_CACHE_WINDOWS];   // record seq the entry was written as
+        uint32_t m_lastUse[WINDOW_CACHE_WINDOWS]; // m_useCount when the entry was last put or hit
+        uint32_t m_useCount;
+        WindowSummary m_summaries[WINDOW_CACHE_WINDOWS];
+        uint8_t *m_pages[WINDOW_CACHE_WINDOWS];  // PAGED_MEMSIZE bytes each
+        WindowCacheStats m_stats;
+};
+
+extern WindowCache windowCache;
+
+/* - - - - - - Declarations - - - - - - */
+void printWindowCacheInfo();
+
+#endif
@@ -0,0 +1,145 @@
+#ifndef WINDOW_CHECKPOINT_H
+#define WINDOW_CHECKPOINT_H
+
+/* - - - - - - Includes - - - - - - */
+// C++ libraries
+
+// Other libraries
+
+// NS2 headers
+#include "config.hpp"
+#include "encodedFile.hpp"
+#include "flashDevice.hpp"
+
+/* - - - - - - Structs - - - - - - */
+
+/* - SegmentHeader -
+*   Leads every checkpoint segment in the checkpoint log.
+*   Members: magic, seq, startCount, mode, firstIdx, count, endIdx, elapsedMsec, epoch, checksum
+*/
+struct SegmentHeader {
+    uint16_t magic = 0;       // SEGMENT_MAGIC, segments without it are skipped
+    uint16_t seq = 0;         // slot of the segment in its half of the log, must match where it is read from
+    uint16_t startCount = 0;  // payloadData.startCount of the run that wrote the segment
+    uint8_t mode = 0;         // science mode of the window being checkpointed
+    uint16_t firstIdx = 0;    // dataBuffer index of the first sample in the segment
+    uint16_t count = 0;       // number of samples in the segment
+    uint16_t endIdx = 0;      // dataBuffer index following the newest sample checkpointed so far
+    uint32_t elapsedMsec = 0; // milliseconds since the window began, at the time of the checkpoint
+    uint32_t epoch = 0;       // log epoch the half was written in, older windows have lower epochs
+    uint32_t checksum = 0;    // crc32c of the segment with this field zeroed, catches torn writes
+    static const int MEMSIZE = sizeof(magic) + sizeof(seq) + sizeof(startCount) + sizeof(mode)
+                                + sizeof(firstIdx) + sizeof(count) + sizeof(endIdx) + sizeof(elapsedMsec)
+                                + sizeof(epoch) + sizeof(checksum);
+    static const uint16_t SEGMENT_MAGIC = 0x4E32; // "N2"
+};
+
+// bytes, size of a checkpoint segment before encoding: header | samples | attitude | packed rate codes
+const int CHECKPOINT_SEGMENT_RAW_MEMSIZE = SegmentHeader::MEMSIZE + CHECKPOINT_SEGMENT_SAMPLES * (sizeof(uint16_t) + sizeof(int16_t))
+                                            + CHECKPOINT_SEGMENT_SAMPLES / RATE_CODES_PER_BYTE;
+typedef EncodedFile<CHECKPOINT_SEGMENT_RAW_MEMSIZE> EncodedSegment;
+
+/* - RecoveredWindow -
+*   Describes the partial window found in the checkpoint log at startup.
+*   Members: found, resumed, mode, startCount, elapsedMsec, samples, bufIdx, segments, skipped, corrected
+*/
+struct RecoveredWindow {
+    bool found = false;         // whether any checkpointed samples were recovered
+    bool resumed = false;       // whether the window continues, otherwise it is sealed as a partial file
+    uint8_t mode = 0;           // science mode of the recovered window
+    uint16_t startCount = 0;    // start count of the run that wrote the newest segment
+    uint32_t elapsedMsec = 0;   // window time covered by the newest segment
+    int samples = 0;            // samples restored to the buffer
+    int bufIdx = 0;             // dataBuffer index following the newest restored sample
+    int segments = 0;           // valid segments read
+    int skipped = 0;            // torn or uncorrectable segments skipped
+    int corrected = 0;          // bit errors corrected while reading
+};
+
+/* - CheckpointStats -
+*   Cost of checkpointing, kept by CheckpointLog.
+*   Members: intervals, segments, bytes, lastMicros, maxMicros, totalMicros, rebases
+*/
+struct CheckpointStats {
+    uint32_t intervals = 0;   // checkpoint intervals completed
+    uint32_t segments = 0;    // segments written
+    uint32_t bytes = 0;       // encoded bytes written
+    uint32_t lastMicros = 0;  // microseconds spent on the most recent interval
+    uint32_t maxMicros = 0;   // microseconds, longest interval
+    uint32_t totalMicros = 0; // microseconds spent checkpointing in total
+    uint32_t rebases = 0;     // times the log filled up and was rewritten from the whole buffer
+};
+
+/* - - - - - - Class Declaration - - - - - - */
+
+/* - CheckpointLog -
+*   Append-only log of the science window in progress, kept in a flash region split into two
+*   halves. Each segment holds up to CHECKPOINT_SEGMENT_SAMPLES new samples with their rate codes
+*   and attitude, so only samples taken since the previous checkpoint are written. Segments are
+*   programmed and used halves erased through the flash queue, so the main loop never waits on
+*   flash. A window starts on a half that was erased in the background after the previous one.
+*   When a half fills the whole buffer is rewritten to the other half (rebased), and the full
+*   half is erased once the rebase is written.
+*/
+class CheckpointLog {
+    public:
+        CheckpointLog();
+
+        bool attach(FlashDevice *device);
+        bool begin(uint8_t mode, uint16_t startCount, int bufIdx);
+        void requestCheckpoint() { m_requested = true; }
+        int checkpoint(const uint16_t buffer[], const uint8_t rateCodes[], const int16_t attitude[], int bufIdx);
+        RecoveredWindow recover(uint16_t buffer[], uint8_t rateCodes[], int16_t attitude[], uint32_t windowEpoch);
+        void resume();
+        void end();
+        void service();
+
+        bool isActive() { return m_active; }
+        bool isRequested() { return m_requested; }
+        bool isDirty() { return m_dirtySectors[0] > 0 || m_dirtySectors[1] > 0; }
+        uint32_t getWindowEpoch() { return m_windowEpoch; }
+        int getHalfSegments() { return m_halfSegments; }
+        CheckpointStats getStats() { return m_stats; }
+
+    private:
+        bool writeSegment(const uint16_t buffer[], const uint8_t rateCodes[], const int16_t attitude[], int count, int endIdx);
+        bool readSegment(int half, int slot, uint8_t encoded[], SegmentHeader &header, ScrubReport &scrubInfo);
+        bool eraseHalf(int half);
+        void startHalf(int half);
+        static void onSegmentWritten(void *context, bool status);
+
+        FlashDevice *m_device;
+        uint32_t m_halfSize;        // bytes in each half of the region, whole sectors
+        int m_halfSegments;         // segments each half can hold
+        int m_dirtySectors[2];      // sectors at the start of each half that may hold segments and have no erase queued
+        int m_half;                 // half being written
+        int m_holdHalf;             // other half while it still holds samples a rebase has not rewritten, -1 if none
+        bool m_active;              // whether a window is being checkpointed
+        bool m_requested;           // whether a checkpoint interval is in progress
+        bool m_rebase;              // whether the checkpoint in progress is writing the whole buffer
+        bool m_failed;              // whether a queued segment failed to program
+        uint8_t m_mode;
+        uint16_t m_startCount;
+        uint16_t m_seq;             // sequence number of the next segment in the half
+        uint32_t m_epoch;           // epoch of the half being written, raised for every window and rebase
+        uint32_t m_windowEpoch;     // epoch the window began in
+        int m_nextIdx;              // dataBuffer index of the oldest sample not yet checkpointed
+        int m_rebaseRemaining;      // samples still to write after a rebase
+        int m_rebaseEndIdx;         // dataBuffer index following the newest sample the old half holds
+        unsigned long m_startMillis;   // millis() when the window began
+        unsigned long m_intervalMicros; // microseconds spent on the current interval so far
+        CheckpointStats m_stats;
+        EncodedSegment m_segment;   // encoding workspace, kept here to stay off the stack
+        uint8_t m_queued[CHECKPOINT_SEGMENTS_QUEUED][EncodedSegment::MEMSIZE]; // segments waiting on the flash queue
+        int m_queuedHead;           // oldest segment still waiting on the flash queue
+        int m_queuedCount;
+};
+
+/* - - - - - - Declarations - - - - - - */
+void handleWindowCheckpoint(const uint16_t buffer[], const uint8_t rateCodes[], const int16_t attitude[], int bufIdx);
+RecoveredWindow recoverWindowCheckpoint(uint16_t buffer[], uint8_t rateCodes[], int16_t attitude[]);
+void endWindowCheckpoint();
+bool windowCheckpointResumed();
+void printCheckpointInfo();
+
+#endif
@@ -0,0 +1,146 @@
+/* adaptiveSampler.cpp defines the AdaptiveSampler class
+ * Usage:
+ *  An AdaptiveSampler is fed every photodiode sample and returns the rate code
+ *  (index into ADAPTIVE_PERIODS_MSEC) to use for the next sample.
+ * 
+ * Modules encompassed:
+ *  Data Processing
+ *
+ * Additional files needed for compilation:
+ *  config.hpp
+ */
+
+/* - - - - - - Includes - - - - - - */
+// All libraries are put in adaptiveSampler.hpp
+// NS2 headers
+#include "../headers/adaptiveSampler.hpp"
+
+
+/* - - - - - - Constructor - - - - - - *
+ * Inputs:
+ *  None
+ */
+AdaptiveSampler::AdaptiveSampler() {
+    m_fastSlope = ADAPTIVE_FAST_SLOPE_INIT;
+    m_slowSlope = ADAPTIVE_SLOW_SLOPE_INIT;
+    m_noise = ADAPTIVE_NOISE_INIT;
+    reset();
+}
+
+/* - - - - - - reset - - - - - - *
+ * Usage:
+ *  Forgets the signal history and spent budget, next sample is taken at the nominal rate
+ *  
+ * Inputs:
+ *  None
+ * 
+ * Outputs:
+ *  None
+ */
+void AdaptiveSampler::reset() {
+    m_mean = 0;
+    m_variance = 0;
+    m_slope = 0;
+    m_credit = 0; // start with no banked samples, so the first window is guaranteed to fit
+    m_lastSample = 0;
+    m_holdMsec = 0;
+    m_rateCode = ADAPTIVE_NOMINAL_RATE_CODE;
+    m_primed = false;
+}
+
+/* - - - - - - setThresholds - - - - - - *
+ * Usage:
+ *  Sets the signal activity thresholds used to select the sampling rate
+ *  
+ * Inputs:
+ *  fastSlope - ADC bins/sec, slope at or above which the fastest rate is selected
+ *  slowSlope - ADC bins/sec, slope below which the slowest rate is selected
+ *  noise - ADC bins, standard deviation at or above which the fastest rate is selected
+ * 
+ * Outputs:
+ *  None
+ */
+void AdaptiveSampler::setThresholds(float fastSlope, float slowSlope, float noise) {
+    m_fastSlope = fastSlope;
+    m_slowSlope = slowSlope;
+    m_noise = noise;
+}
+
+/* - - - - - - update - - - - - - *
+ * Usage:
+ *  Updates the signal statistics with a new sample and selects the rate of the next sample.
+ *  Each sample spends one credit and credit is earned in real time at ADAPTIVE_CREDIT_PER_MSEC.
+ *  When credit runs out the slowest rate is forced until it is earned back.
+ *  
+ * Inputs:
+ *  sample - newest photodiode sample, ADC bins
+ *  elapsedMsec - milliseconds since the previous sample
+ * 
+ * Outputs:
+ *  rate code of the next sample
+ */
+uint8_t AdaptiveSampler::update(uint16_t sample, unsigned long elapsedMsec) {
+    if (elapsedMsec == 0) { elapsedMsec = 1; } // guard the slope division
+
+    // update moving statistics
+    if (!m_primed) {
+        m_mean = sample;
+        m_primed = true;
+    } else {
+        float instantSlope = ((float)sample - (float)m_lastSample) * 1000.0F / (float)elapsedMsec;
+        m_slope += ADAPTIVE_EMA_WEIGHT * (instantSlope - m_slope);
+
+        float deviation = (float)sample - m_mean;
+        m_mean += ADAPTIVE_EMA_WEIGHT * deviation;
+        m_variance = (1.0F - ADAPTIVE_EMA_WEIGHT) * (m_variance + ADAPTIVE_EMA_WEIGHT * deviation * deviation);
+    }
+    m_lastSample = sample;
+
+    // spend one sample, earn credit for the time that passed
+    m_credit += ADAPTIVE_CREDIT_PER_MSEC * elapsedMsec - 1.0F;
+    if (m_credit > ADAPTIVE_CREDIT_MAX) { m_credit = ADAPTIVE_CREDIT_MAX; }
+    
+    // select rate from signal activity
+    float activity = fabsf(m_slope);
+    uint8_t newCode;
+    if (activity >= m_fastSlope || getNoise() >= m_noise) {
+        newCode = ADAPTIVE_FAST_RATE_CODE;
+    } else if (activity >= m_fastSlope / ADAPTIVE_MID_DIVISOR) {
+        newCode = ADAPTIVE_MID_RATE_CODE;
+    } else if (activity < m_slowSlope) {
+        newCode = ADAPTIVE_SLOW_RATE_CODE;
+    } else {
+        newCode = ADAPTIVE_NOMINAL_RATE_CODE;
+    }
+
+    // hold a faster rate for a while so the rate does not chatter at a threshold
+    m_holdMsec = (m_holdMsec > elapsedMsec) ? m_holdMsec - elapsedMsec : 0;
+    if (newCode < m_rateCode) {
+        m_holdMsec = ADAPTIVE_HOLD_MSEC;
+    } else if (newCode > m_rateCode && m_holdMsec > 0) {
+        newCode = m_rateCode;
+    }
+
+    // never sample faster than the budget allows
+    if (m_credit < 1.0F) {
+        newCode = ADAPTIVE_SLOW_RATE_CODE;
+        m_holdMsec = 0;
+    }
+
+    m_rateCode = newCode;
+    return m_rateCode;
+}
+
+/* - - - - - - getNoise - - - - - - *
+ * Usage:
+ *  Returns the moving standard deviation of the signal
+ *  
+ * Inputs:
+ *  None
+ * 
+ * Outputs:
+ *  standard deviation, ADC bins
+ */
+float AdaptiveSampler::getNoise() {
+    return sqrtf(m_variance);
+}
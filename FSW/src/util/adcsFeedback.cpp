@@ -0,0 +1,218 @@
+/* adcsFeedback.cpp publishes photodiode feedback for the attitude controller
+ * Usage:
+ *  publishAdcsFeedback() is called right after every photodiode sample is buffered.
+ *  An attitude controller can poll readAdcsFeedback() from any context, or register
+ *  a callback with registerAdcsCallback() to be run as soon as each value is published.
+ * 
+ * Modules encompassed:
+ *  Science window timing
+ *
+ * Additional files needed for compilation:
+ *  config.hpp
+ *  timing.hpp
+ */
+
+/* - - - - - - Includes - - - - - - */
+// All libraries are put in adcsFeedback.hpp
+// NS2 headers
+#include "../headers/adcsFeedback.hpp"
+#include "../headers/timing.hpp"
+
+// compiler barrier, the Teensy has a single core so program order only has to survive the compiler
+#define MAILBOX_BARRIER() __asm__ volatile("" ::: "memory")
+
+/* Module Variable Definitions */
+static AdcsMailbox adcsMailbox;
+static AdcsFeedbackCallback adcsCallback = nullptr;
+
+// latency statistics, microseconds from ADC read to published value
+static uint32_t latencyMax = 0;
+static uint32_t latencySum = 0;
+static uint32_t latencyCount = 0;
+static uint32_t latencyOverBound = 0;   // publishes slower than ADCS_FEEDBACK_MAX_LATENCY_MICROS
+static uint32_t callbackMaxMicros = 0;  // longest time spent in the registered callback
+
+/* - - - - - - Class Definitions - - - - - - */
+
+/* - - - - - - AdcsMailbox - - - - - - */
+// constructor
+AdcsMailbox::AdcsMailbox() {
+    m_slots[0].seq = 0;
+    m_slots[1].seq = 0;
+    m_active = 0;
+    m_publishCount = 0;
+}
+
+// writes a new value, must only be called from one context
+void AdcsMailbox::publish(const AdcsFeedback &value) {
+    int next = !m_active;
+    Slot &slot = m_slots[next];
+
+    slot.seq = slot.seq + 1; // odd, write in progress
+    MAILBOX_BARRIER();
+    slot.value = value;
+    slot.value.sequence = m_publishCount;
+    MAILBOX_BARRIER();
+    slot.seq = slot.seq + 1; // even, write complete
+    MAILBOX_BARRIER();
+
+    m_active = next;
+    m_publishCount++;
+}
+
+// copies the latest value, returns false if nothing was published or no consistent copy was found
+bool AdcsMailbox::read(AdcsFeedback &value) {
+    if (m_publishCount == 0) { return false; }
+
+    for (int attempt = 0; attempt < ADCS_MAILBOX_READ_TRIES; attempt++) {
+        Slot &slot = m_slots[m_active];
+        uint32_t seqBefore = slot.seq;
+        MAILBOX_BARRIER();
+        if (seqBefore & 1) { continue; } // being written
+
+        value = slot.value;
+        MAILBOX_BARRIER();
+        if (slot.seq == seqBefore) { return true; }
+    }
+    return false;
+}
+
+/* - - - - - - Module Driver Functions - - - - - - */
+
+/* - - - - - - publishAdcsFeedback - - - - - - *
+ * Usage:
+ *  Computes the smoothed irradiance, its derivative and quality flags from the newest
+ *  samples, publishes them to the mailbox and runs the registered callback
+ * 
+ * Inputs:
+ *  buffer - array of photodiode samples
+ *  bufIdx - index of the newest sample in buffer
+ *  sampleMicros - micros() when the newest sample was read
+ *  
+ * Outputs:
+ *  none
+ */
+void publishAdcsFeedback(uint16_t buffer[], int bufIdx, uint32_t sampleMicros) {
+    static float lastIrradiance = 0;
+    static uint32_t lastMicros = 0;
+    static float derivative = 0;
+    static int samplesSeen = 0;
+
+    AdcsFeedback feedback;
+    feedback.irradiance = voltageRunningMean(buffer, bufIdx);
+    feedback.sampleMicros = sampleMicros;
+
+    // smoothed derivative, sample period may vary with adaptive sampling
+    if (samplesSeen > 0 && sampleMicros != lastMicros) {
+        float instantDerivative = (feedback.irradiance - lastIrradiance) * 1000000.0F / (float)(sampleMicros - lastMicros);
+        derivative += ADCS_DERIVATIVE_EMA_WEIGHT * (instantDerivative - derivative);
+    }
+    feedback.derivative = derivative;
+    lastIrradiance = feedback.irradiance;
+    lastMicros = sampleMicros;
+    if (samplesSeen < SMOOTH_IDX_COUNT) { samplesSeen++; }
+
+    // quality flags
+    if (samplesSeen >= SMOOTH_IDX_COUNT) { feedback.quality |= ADCS_QUALITY_VALID; }
+    if (buffer[bufIdx] >= ADCS_SATURATION_BINS) { feedback.quality |= ADCS_QUALITY_SATURATED; }
+    if (feedback.irradiance < SUN_THRESH_VOLTAGE) { feedback.quality |= ADCS_QUALITY_BELOW_THRESH; }
+    if (!scienceMode.getPointingAtSun()) { feedback.quality |= ADCS_QUALITY_NOT_POINTING; }
+
+    adcsMailbox.publish(feedback);
+
+    // latency from ADC read to published value
+    uint32_t latency = micros() - sampleMicros;
+    if (latency > latencyMax) { latencyMax = latency; }
+    if (latency > ADCS_FEEDBACK_MAX_LATENCY_MICROS) { latencyOverBound++; }
+    latencySum += latency;
+    latencyCount++;
+
+    // hand the value straight to the attitude controller
+    if (adcsCallback != nullptr) {
+        uint32_t callbackStart = micros();
+        adcsCallback(feedback);
+        uint32_t callbackMicros = micros() - callbackStart;
+        if (callbackMicros > callbackMaxMicros) { callbackMaxMicros = callbackMicros; }
+    }
+}
+
+/* - - - - - - Helper Functions - - - - - - */
+
+/* - - - - - - readAdcsFeedback - - - - - - *
+ * Usage:
+ *  Copies the latest published feedback, safe to call from an interrupt
+ * 
+ * Inputs:
+ *  feedback - destination for the latest value (pass-by-reference)
+ *  
+ * Outputs:
+ *  true if a complete value was copied
+ */
+bool readAdcsFeedback(AdcsFeedback &feedback) {
+    return adcsMailbox.read(feedback);
+}
+
+/* - - - - - - registerAdcsCallback - - - - - - *
+ * Usage:
+ *  Registers a function to be called every time feedback is published.
+ *  The callback runs in the sampling context, keep it short.
+ * 
+ * Inputs:
+ *  callback - function to call, nullptr to remove the callback
+ *  
+ * Outputs:
+ *  none
+ */
+void registerAdcsCallback(AdcsFeedbackCallback callback) {
+    adcsCallback = callback;
+}
+
+/* - - - - - - resetAdcsLatencyStats - - - - - - *
+ * Usage:
+ *  Clears the feedback latency statistics
+ * 
+ * Inputs:
+ *  none
+ *  
+ * Outputs:
+ *  none
+ */
+void resetAdcsLatencyStats() {
+    latencyMax = 0;
+    latencySum = 0;
+    latencyCount = 0;
+    latencyOverBound = 0;
+    callbackMaxMicros = 0;
+}
+
+/* - - - - - - printAdcsInfo - - - - - - *
+ * Usage:
+ *  Prints the latest feedback and its latency statistics
+ * 
+ * Inputs:
+ *  none
+ *  
+ * Outputs:
+ *  none
+ */
+void printAdcsInfo() {
+    AdcsFeedback feedback;
+    Serial.print("ADCS Feedback (V, V/s, quality): ");
+    if (readAdcsFeedback(feedback)) {
+        Serial.print(feedback.irradiance);
+        Serial.print(", ");
+        Serial.print(feedback.derivative);
+        Serial.print(", ");
+        Serial.println(feedback.quality);
+    } else {
+        Serial.println("none published");
+    }
+    Serial.print("ADCS Feedback Latency (us, mean/max/over bound): ");
+    Serial.print(latencyCount > 0 ? latencySum / latencyCount : 0);
+    Serial.print(" / ");
+    Serial.print(latencyMax);
+    Serial.print(" / ");
+    Serial.println(latencyOverBound);
+    Serial.print("ADCS Callback Max Time (us): ");
+    Serial.println(callbackMaxMicros);
+}
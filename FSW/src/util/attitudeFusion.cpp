@@ -0,0 +1,216 @@
+/* attitudeFusion.cpp defines the AttitudeFusion class
+ * Usage:
+ *  Pairs each photodiode sample with the pointing elevation reported by ADCS.
+ *  ADCS (or the stand-in feeder) calls pushAttitude(), the data collection module 
+ *  queues samples and stores the aligned attitude as a column of the science file.
+ * 
+ * Modules encompassed:
+ *  Data Processing
+ *
+ * Additional files needed for compilation:
+ *  config.hpp
+ */
+
+/* - - - - - - Includes - - - - - - */
+// All libraries are put in attitudeFusion.hpp
+// NS2 headers
+#include "../headers/attitudeFusion.hpp"
+
+/* Module Variable Definitions */
+static AttitudeFusion attitudeFusion;
+
+/* - - - - - - Class Definitions - - - - - - */
+
+/* - - - - - - AttitudeFusion - - - - - - */
+// constructor
+AttitudeFusion::AttitudeFusion() {
+    reset();
+}
+
+// discards all queued samples and counters
+void AttitudeFusion::reset() {
+    m_ringHead = 0;
+    m_ringTail = 0;
+    m_pendingHead = 0;
+    m_pendingTail = 0;
+    m_hasPrev = false;
+    m_stats = FusionStats();
+}
+
+// adds an attitude sample, samples must arrive in time order. Returns false if the ring is full.
+bool AttitudeFusion::pushAttitude(const AttitudeSample &sample) {
+    int next = (m_ringHead + 1) % ATTITUDE_RING_SIZE;
+    if (next == m_ringTail) {
+        m_stats.attitudeDropped++;
+        return false;
+    }
+    m_ring[m_ringHead] = sample;
+    m_ringHead = next; // publish after the sample is written
+    return true;
+}
+
+// queues a photodiode sample for alignment and marks its column entry invalid until then
+bool AttitudeFusion::addPhotoSample(uint32_t timeMicros, int bufIdx, int16_t column[]) {
+    column[bufIdx] = ATTITUDE_INVALID;
+    int next = (m_pendingHead + 1) % ATTITUDE_PENDING_SIZE;
+    if (next == m_pendingTail) {
+        m_stats.photoDropped++;
+        return false;
+    }
+    m_pending[m_pendingHead].timeMicros = timeMicros;
+    m_pending[m_pendingHead].bufIdx = bufIdx;
+    m_pendingHead = next;
+    return true;
+}
+
+/* align
+ *  writes interpolated attitude for up to maxWork queued photodiode samples.
+ *  A sample waits while the attitude after it has not arrived, up to ATTITUDE_MAX_WAIT_MICROS.
+ *  returns the number of samples resolved (aligned or given up on) */
+int AttitudeFusion::align(int16_t column[], uint32_t nowMicros, int maxWork) {
+    int resolved = 0;
+
+    while (resolved < maxWork && m_pendingTail != m_pendingHead) {
+        PendingSample &photo = m_pending[m_pendingTail];
+
+        // consume attitude up to the photodiode sample time, keeping the newest as the lower bracket
+        // (time differences are signed so micros() rollover is handled)
+        while (m_ringTail != m_ringHead && (int32_t)(m_ring[m_ringTail].timeMicros - photo.timeMicros) <= 0) {
+            m_prev = m_ring[m_ringTail];
+            m_hasPrev = true;
+            m_ringTail = (m_ringTail + 1) % ATTITUDE_RING_SIZE;
+        }
+
+        int16_t value = ATTITUDE_INVALID;
+        if (m_hasPrev && m_prev.timeMicros == photo.timeMicros) {
+            value = quantize(m_prev.elevationDeg);
+        } else if (m_ringTail != m_ringHead) {
+            // upper bracket available
+            AttitudeSample &next = m_ring[m_ringTail];
+            if (m_hasPrev && next.timeMicros - m_prev.timeMicros <= ATTITUDE_MAX_GAP_MICROS) {
+                float fraction = (float)(photo.timeMicros - m_prev.timeMicros) / (float)(next.timeMicros - m_prev.timeMicros);
+                value = quantize(m_prev.elevationDeg + fraction * (next.elevationDeg - m_prev.elevationDeg));
+            }
+        } else if ((int32_t)(nowMicros - photo.timeMicros) < (int32_t)ATTITUDE_MAX_WAIT_MICROS) {
+            break; // attitude after this sample has not arrived yet, wait for it
+        }
+
+        column[photo.bufIdx] = value;
+        if (value == ATTITUDE_INVALID) { m_stats.unaligned++; }
+        else { m_stats.aligned++; }
+        m_pendingTail = (m_pendingTail + 1) % ATTITUDE_PENDING_SIZE;
+        resolved++;
+    }
+    return resolved;
+}
+
+// converts degrees to the stored column code, saturating at the int16 range
+int16_t AttitudeFusion::quantize(float elevationDeg) {
+    float code = roundf(elevationDeg / ATTITUDE_LSB_DEG);
+    if (code > INT16_MAX) { return INT16_MAX; }
+    if (code <= INT16_MIN) { return INT16_MIN + 1; } // INT16_MIN is reserved for ATTITUDE_INVALID
+    return (int16_t)code;
+}
+
+// converts a stored column code back to degrees
+float AttitudeFusion::dequantize(int16_t code) {
+    return code * ATTITUDE_LSB_DEG;
+}
+
+/* - - - - - - Module Driver Functions - - - - - - */
+
+/* - - - - - - pushAttitude - - - - - - *
+ * Usage:
+ *  Interface for ADCS, hands a new attitude sample to the fusion buffer.
+ *  Samples must be pushed in time order from a single context.
+ * 
+ * Inputs:
+ *  sample - timestamped pointing measurement
+ *  
+ * Outputs:
+ *  false if the sample was dropped because the fusion buffer is full
+ */
+bool pushAttitude(const AttitudeSample &sample) {
+    return attitudeFusion.pushAttitude(sample);
+}
+
+/* - - - - - - queueAttitudeAlignment - - - - - - *
+ * Usage:
+ *  Queues a photodiode sample to be paired with attitude
+ * 
+ * Inputs:
+ *  sampleMicros - micros() when the photodiode sample was read
+ *  bufIdx - index of the sample in the science buffer
+ *  column - attitude column parallel to the science buffer
+ *  
+ * Outputs:
+ *  none
+ */
+void queueAttitudeAlignment(uint32_t sampleMicros, int bufIdx, int16_t column[]) {
+    attitudeFusion.addPhotoSample(sampleMicros, bufIdx, column);
+}
+
+/* - - - - - - alignAttitude - - - - - - *
+ * Usage:
+ *  Writes aligned attitude for queued photodiode samples, 
+ *  work per call is bounded by ATTITUDE_ALIGN_MAX_WORK
+ * 
+ * Inputs:
+ *  column - attitude column parallel to the science buffer
+ *  
+ * Outputs:
+ *  none
+ */
+void alignAttitude(int16_t column[]) {
+    attitudeFusion.align(column, micros(), ATTITUDE_ALIGN_MAX_WORK);
+}
+
+/* - - - - - - feedSimulatedAttitude - - - - - - *
+ * Usage:
+ *  Stand-in for ADCS, pushes a sinusoidal sweep at ATTITUDE_SIM_PERIOD_MICROS while 
+ *  SIMULATE_ATTITUDE is set. Call every main loop iteration.
+ * 
+ * Inputs:
+ *  none
+ *  
+ * Outputs:
+ *  none
+ */
+void feedSimulatedAttitude() {
+    static uint32_t lastFeedMicros = 0;
+    if (!SIMULATE_ATTITUDE) { return; }
+
+    uint32_t now = micros();
+    if (now - lastFeedMicros < ATTITUDE_SIM_PERIOD_MICROS) { return; }
+    lastFeedMicros = now;
+
+    AttitudeSample sample;
+    sample.timeMicros = now;
+    sample.elevationDeg = ATTITUDE_SIM_AMPLITUDE_DEG * sinf(2.0F * (float)M_PI * (now / 1000000.0F) / ATTITUDE_SIM_SWEEP_SEC);
+    pushAttitude(sample);
+}
+
+/* - - - - - - printAttitudeInfo - - - - - - *
+ * Usage:
+ *  Prints attitude fusion counters
+ * 
+ * Inputs:
+ *  none
+ *  
+ * Outputs:
+ *  none
+ */
+void printAttitudeInfo() {
+    FusionStats stats = attitudeFusion.getStats();
+    Serial.print("Attitude Aligned / Unaligned: ");
+    Serial.print(stats.aligned);
+    Serial.print(" / ");
+    Serial.println(stats.unaligned);
+    Serial.print("Attitude Dropped (attitude / photodiode): ");
+    Serial.print(stats.attitudeDropped);
+    Serial.print(" / ");
+    Serial.println(stats.photoDropped);
+    Serial.print("Simulated Attitude: ");
+    if (SIMULATE_ATTITUDE) { Serial.println("On"); }
+    else { Serial.println("Off"); }
+}
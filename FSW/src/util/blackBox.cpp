@@ -0,0 +1,386 @@
+/* blackBox.cpp keeps a ring of recent events on flash for post-mortem analysis
+ * Usage:
+ *  blackBox.log() records an event with up to BLACKBOX_MAX_ARGS integer arguments. It only
+ *  copies the event into a RAM block, so it can be called from anywhere the serial diagnostics
+ *  are printed. handleBlackBox() runs in the main loop and seals the block once it is full or
+ *  BLACKBOX_FLUSH_MSEC old, logging carries on in the second block while the sealed one is
+ *  appended to the record store as a RECORD_BLACK_BOX record through the flash queue. If both
+ *  blocks are full the event is counted as dropped. prepareForRestart() writes the block in
+ *  RAM, an unexpected reset loses at most BLACKBOX_FLUSH_MSEC of events.
+ *  The newest BLACKBOX_BLOCKS blocks are kept, the oldest is removed past that, so the ring
+ *  holds the events before an anomaly or an unexpected restart. DUMP_BLACK_BOX prints them.
+ *
+ *  Block layout: start count (uint16) | entries (uint16) | millis of the first entry (uint32) | entries
+ *  Entry layout: event (low 6 bits) and argument count (high 2 bits) | millis (uint32) | arguments (int32 each)
+ *
+ * Modules encompassed:
+ *  Fault Mitigation
+ *
+ * Additional files needed for compilation:
+ *  config.hpp
+ *  blackBox.hpp
+ *  recordStore.cpp & recordStore.hpp
+ *  flashQueue.hpp
+ *  faultManager.hpp
+ */
+
+/* - - - - - - Includes - - - - - - */
+// All libraries are put in blackBox.hpp
+// NS2 headers
+#include "../headers/blackBox.hpp"
+#include "../headers/recordStore.hpp"
+#include "../headers/flashQueue.hpp"
+#include "../headers/faultManager.hpp"
+#include "../headers/hammingBlock.hpp"
+
+/* Module Variable Definitions */
+BlackBox blackBox;
+
+static const char *eventNames[BB_EVENT_COUNT] = {"?", "STARTUP", "FAULT", "MODE", "COMMAND", "SCIENCE_SAVED",
+                                                 "EVICTED", "RESTART"};
+
+/* - - - - - - Helper Functions - - - - - - */
+
+// packs the block header at the start of a buffer
+static void packBlockHeader(uint8_t *block, uint16_t startCount, uint16_t entries, uint32_t firstMillis) {
+    size_t bytesCopied = 0;
+    memAppend(block, &startCount, sizeof(startCount), &bytesCopied);
+    memAppend(block, &entries, sizeof(entries), &bytesCopied);
+    memAppend(block, &firstMillis, sizeof(firstMillis), &bytesCopied);
+}
+
+/* - - - - - - Class Definitions - - - - - - */
+
+/* - - - - - - BlackBox - - - - - - */
+// constructor
+BlackBox::BlackBox() {
+    m_active = 0;
+    m_used = HEADER_MEMSIZE;
+    m_entries = 0;
+    m_startCount = 0;
+    m_firstMillis = 0;
+    m_sealed = false;
+    m_sealedLength = 0;
+    m_writing = false;
+    m_count = 0;
+    m_nextKey = 0;
+}
+
+/* begin
+ *  indexes the black box blocks in the record store, oldest first, and removes any past
+ *  BLACKBOX_BLOCKS. Events already logged in RAM are kept. Call once the store is mounted.
+ *  returns false if the store is not mounted */
+bool BlackBox::begin() {
+    static uint32_t seqs[RECORD_MAX_RECORDS];
+    static uint16_t keys[RECORD_MAX_RECORDS];
+    m_count = 0;
+    m_nextKey = 0;
+    if (!recordStore.isMounted()) { return false; }
+
+    // blocks in order of record seq, the order they were written
+    int found = 0;
+    for (int idx = 0; idx < recordStore.count(); idx++) {
+        RecordInfo &info = recordStore.getRecord(idx);
+        if (info.type != RECORD_BLACK_BOX) { continue; }
+        int pos = found++;
+        while (pos > 0 && seqs[pos - 1] > info.seq) {
+            seqs[pos] = seqs[pos - 1];
+            keys[pos] = keys[pos - 1];
+            pos--;
+        }
+        seqs[pos] = info.seq;
+        keys[pos] = info.key;
+    }
+    if (found > 0) { m_nextKey = keys[found - 1] + 1; }
+
+    // older ones are removed, by key since removing a record moves others in the store index
+    int first = max(found - BLACKBOX_BLOCKS, 0);
+    for (int i = 0; i < first; i++) { recordStore.remove(recordStore.find(RECORD_BLACK_BOX, keys[i])); }
+    m_count = found - first;
+    memcpy(m_keys, keys + first, m_count * sizeof(m_keys[0]));
+    return true;
+}
+
+/* log
+ *  copies an event with argc arguments into the RAM block, switching to the other block if it
+ *  is full. The event is dropped if that one is still waiting to be written */
+void BlackBox::log(uint8_t event, uint8_t argc, int32_t arg0, int32_t arg1, int32_t arg2) {
+    if (argc > BLACKBOX_MAX_ARGS) { argc = BLACKBOX_MAX_ARGS; }
+    uint32_t length = ENTRY_MEMSIZE + argc * sizeof(int32_t);
+    if (m_used + length > BLACKBOX_BLOCK_MEMSIZE) {
+        if (m_sealed) {
+            m_stats.dropped++;
+            return;
+        }
+        seal();
+    }
+
+    uint32_t now = millis();
+    if (m_entries == 0) {
+        m_startCount = payloadData.startCount;
+        m_firstMillis = now;
+    }
+    int32_t args[BLACKBOX_MAX_ARGS] = {arg0, arg1, arg2};
+    uint8_t *entry = m_buffers[m_active] + m_used;
+    entry[0] = (event & 0x3F) | argc << 6;
+    memcpy(entry + 1, &now, sizeof(now));
+    memcpy(entry + ENTRY_MEMSIZE, args, argc * sizeof(int32_t));
+    m_used += length;
+    m_entries++;
+    m_stats.logCalls++;
+    m_stats.loggedBytes += length;
+}
+
+/* handle
+ *  seals the RAM block once its first event is BLACKBOX_FLUSH_MSEC old, submits a sealed block
+ *  to the flash queue and removes the oldest blocks past BLACKBOX_BLOCKS. Call every loop iteration */
+void BlackBox::handle() {
+    if (!m_sealed && m_entries > 0 && millis() - m_firstMillis >= BLACKBOX_FLUSH_MSEC) { seal(); }
+    if (m_sealed && !m_writing && recordStore.isMounted()) {
+        // a full queue is tried again next iteration
+        m_writing = recordStore.submitAppend(RECORD_BLACK_BOX, m_nextKey, m_buffers[m_active ^ 1], m_sealedLength,
+                                             onBlockWritten, this);
+    }
+    removeExcess();
+}
+
+/* flush
+ *  writes the block waiting to be written and the events in RAM to the record store before
+ *  returning, for a restart or a dump.
+ *  returns false if the store is not mounted, the events are kept in RAM, or a block could not
+ *  be written */
+bool BlackBox::flush() {
+    if (!recordStore.isMounted()) { return false; }
+    flashQueue.flush(); // a submitted block is written
+    removeExcess();
+    if (m_writing) { return false; }
+    bool status = true;
+    for (int pass = 0; pass < 2; pass++) {
+        if (!m_sealed) {
+            if (m_entries == 0) { break; }
+            seal();
+        }
+        bool written = recordStore.append(RECORD_BLACK_BOX, m_nextKey, m_buffers[m_active ^ 1], m_sealedLength);
+        finishWrite(written);
+        removeExcess();
+        status = status && written;
+    }
+    return status;
+}
+
+// the block being filled with its header, length is set to its bytes, 0 if it holds no events
+const uint8_t *BlackBox::getActive(uint32_t &length) {
+    packBlockHeader(m_buffers[m_active], m_startCount, m_entries, m_firstMillis);
+    length = m_entries > 0 ? m_used : 0;
+    return m_buffers[m_active];
+}
+
+// flash queue callback of a block submitted by handle()
+void BlackBox::onBlockWritten(void *context, bool status) {
+    BlackBox *box = (BlackBox *)context;
+    box->m_writing = false;
+    box->finishWrite(status);
+}
+
+// packs the header of the block being filled and starts filling the other one
+void BlackBox::seal() {
+    packBlockHeader(m_buffers[m_active], m_startCount, m_entries, m_firstMillis);
+    m_sealedLength = m_used;
+    m_sealed = true;
+    m_active ^= 1;
+    m_used = HEADER_MEMSIZE;
+    m_entries = 0;
+}
+
+// indexes the sealed block once it has been written, or counts its events as lost
+void BlackBox::finishWrite(bool status) {
+    if (status) {
+        m_keys[min(m_count, BLACKBOX_BLOCKS)] = m_nextKey;
+        m_count = min(m_count + 1, BLACKBOX_BLOCKS + 1);
+        m_nextKey++;
+        m_stats.blocksWritten++;
+        m_stats.flashBytes += m_sealedLength;
+    } else {
+        m_stats.blocksLost++;
+        Serial.print("WARNING: black box block could not be stored, events lost. ");
+        Serial.println("(Fault Mitigation Module - BlackBox::finishWrite() func)");
+    }
+    m_sealed = false;
+}
+
+// removes the oldest stored blocks past BLACKBOX_BLOCKS, outside the flash queue callbacks
+void BlackBox::removeExcess() {
+    while (m_count > BLACKBOX_BLOCKS) {
+        recordStore.remove(recordStore.find(RECORD_BLACK_BOX, m_keys[0]));
+        memmove(m_keys, m_keys + 1, (m_count - 1) * sizeof(m_keys[0]));
+        m_count--;
+        m_stats.blocksRemoved++;
+    }
+}
+
+/* - - - - - - Module Driver Functions - - - - - - */
+
+/* - - - - - - initBlackBox - - - - - - *
+ * Usage:
+ *  Indexes the black box kept on flash, call after the record store is mounted
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  whether events can be stored
+ */
+bool initBlackBox() {
+    return blackBox.begin();
+}
+
+/* - - - - - - handleBlackBox - - - - - - *
+ * Usage:
+ *  Stores black box blocks in the background, call every main loop iteration
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  none
+ */
+void handleBlackBox() {
+    blackBox.handle();
+}
+
+/* - - - - - - readBlackBoxBlock - - - - - - *
+ * Usage:
+ *  Reads the events of a black box block, the reference for ground software
+ *
+ * Inputs:
+ *  block - the block, header first
+ *  length - bytes of block
+ *  entries - events read are put here, oldest first
+ *  maxEntries - most events to read
+ *
+ * Outputs:
+ *  number of events read, -1 if the block is truncated or corrupted
+ */
+int readBlackBoxBlock(const uint8_t *block, uint32_t length, BlackBoxEntry entries[], int maxEntries) {
+    if (length < (uint32_t)BlackBox::HEADER_MEMSIZE) { return -1; }
+    uint16_t startCount;
+    uint16_t count;
+    memcpy(&startCount, block, sizeof(startCount));
+    memcpy(&count, block + sizeof(startCount), sizeof(count));
+
+    uint32_t pos = BlackBox::HEADER_MEMSIZE;
+    int read = 0;
+    for (int i = 0; i < count; i++) {
+        if (pos + BlackBox::ENTRY_MEMSIZE > length) { return -1; }
+        uint8_t argc = block[pos] >> 6;
+        if (pos + BlackBox::ENTRY_MEMSIZE + argc * sizeof(int32_t) > length || argc > BLACKBOX_MAX_ARGS) { return -1; }
+        if (read < maxEntries) {
+            BlackBoxEntry &entry = entries[read++];
+            entry = BlackBoxEntry();
+            entry.startCount = startCount;
+            entry.event = block[pos] & 0x3F;
+            entry.argc = argc;
+            memcpy(&entry.millis, block + pos + 1, sizeof(entry.millis));
+            memcpy(entry.args, block + pos + BlackBox::ENTRY_MEMSIZE, argc * sizeof(int32_t));
+        }
+        pos += BlackBox::ENTRY_MEMSIZE + argc * sizeof(int32_t);
+    }
+    return read;
+}
+
+/* - - - - - - dumpBlackBox - - - - - - *
+ * Usage:
+ *  Prints every event in the black box, oldest first, one line each:
+ *   "BB <run> <millis> <event> <args...>"
+ *  The stored blocks come first, then the ones still in RAM.
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  number of events printed
+ */
+int dumpBlackBox() {
+    static uint8_t block[BLACKBOX_BLOCK_MEMSIZE];
+    static BlackBoxEntry entries[BLACKBOX_BLOCK_MEMSIZE / BlackBox::ENTRY_MEMSIZE];
+    const int maxEntries = BLACKBOX_BLOCK_MEMSIZE / BlackBox::ENTRY_MEMSIZE;
+    int printed = 0;
+    for (int i = 0; i < blackBox.blockCount() + 2; i++) {
+        const uint8_t *data = block;
+        uint32_t length = 0;
+        if (i == blackBox.blockCount()) {
+            data = blackBox.getSealed(length);
+        } else if (i == blackBox.blockCount() + 1) {
+            data = blackBox.getActive(length);
+        } else {
+            int recordIdx = recordStore.find(RECORD_BLACK_BOX, blackBox.getBlockKey(i));
+            if (recordIdx < 0 || recordStore.getRecord(recordIdx).length > BLACKBOX_BLOCK_MEMSIZE) { continue; }
+            length = recordStore.getRecord(recordIdx).length;
+            if (!recordStore.read(recordIdx, block, 0, length)) { length = 0; }
+        }
+        if (length == 0) { continue; }
+
+        int count = readBlackBoxBlock(data, length, entries, maxEntries);
+        if (count < 0) {
+            Serial.print("WARNING: black box block ");
+            Serial.print(i);
+            Serial.println(" is corrupted, skipped. (Fault Mitigation Module - dumpBlackBox() func)");
+            continue;
+        }
+        for (int j = 0; j < count; j++) {
+            BlackBoxEntry &entry = entries[j];
+            Serial.print("BB ");
+            Serial.print(entry.startCount);
+            Serial.print(" ");
+            Serial.print(entry.millis);
+            Serial.print(" ");
+            Serial.print(entry.event < BB_EVENT_COUNT ? eventNames[entry.event] : eventNames[0]);
+            for (int arg = 0; arg < entry.argc; arg++) {
+                Serial.print(" ");
+                Serial.print(entry.args[arg]);
+            }
+            Serial.println();
+            printed++;
+        }
+    }
+    return printed;
+}
+
+/* - - - - - - printBlackBoxInfo - - - - - - *
+ * Usage:
+ *  Prints the black box blocks on flash, the events logged and dropped, and the rate the black
+ *  box writes flash at
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  none
+ */
+void printBlackBoxInfo() {
+    BlackBoxStats stats = blackBox.getStats();
+    uint32_t activeLength = 0;
+    blackBox.getActive(activeLength);
+    Serial.print("Black Box: ");
+    Serial.print(blackBox.blockCount());
+    Serial.print(" of ");
+    Serial.print(BLACKBOX_BLOCKS);
+    Serial.print(" block(s) on flash, ");
+    Serial.print(stats.logCalls);
+    Serial.print(" event(s) logged, ");
+    Serial.print(stats.dropped);
+    Serial.print(" dropped, ");
+    Serial.print(activeLength);
+    Serial.println(" bytes waiting in RAM");
+    Serial.print("Black Box Cost: ");
+    Serial.print(stats.blocksWritten);
+    Serial.print(" block(s) written, ");
+    Serial.print(stats.blocksLost);
+    Serial.print(" lost, ");
+    Serial.print(stats.blocksRemoved);
+    Serial.print(" removed as oldest, ");
+    Serial.print(stats.logCalls > 0 ? (float)stats.loggedBytes / stats.logCalls : 0.0F);
+    Serial.print(" bytes per event, ");
+    Serial.print(millis() > 0 ? (float)stats.flashBytes * 3600000.0F / millis() : 0.0F);
+    Serial.println(" flash bytes per hour");
+}
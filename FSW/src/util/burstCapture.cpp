@@ -0,0 +1,335 @@
+/* burstCapture.cpp handles high rate burst capture around the limb crossing
+ * Usage:
+ *  A timer interrupt fills a short high rate ring in the background. When the sweep change
+ *  or sunrise threshold fires, BURST_PRE_MSEC of history and BURST_POST_MSEC after the
+ *  trigger are frozen and saved to a burst record in the record store.
+ * 
+ * Modules encompassed:
+ *  Data Processing
+ *  Science Memory Handling
+ *
+ * Additional files needed for compilation:
+ *  config.hpp
+ *  burstCapture.hpp
+ *  encodedFile.hpp
+ *  recordStore.cpp & recordStore.hpp
+ *  spiBus.cpp & spiBus.hpp
+ */
+
+/* - - - - - - Includes - - - - - - */
+// All libraries are put in burstCapture.hpp
+// NS2 headers
+#include "../headers/burstCapture.hpp"
+#include "../headers/encodedFile.hpp"
+#include "../headers/recordStore.hpp"
+#include "../headers/spiBus.hpp"
+
+/* Module Variable Definitions */
+static BurstRing burstRing;
+static IntervalTimer burstTimer;
+static bool burstRunning = false;                         // whether the burst timer is running
+static BurstSampleSource sampleSource = readBurstAdc;     // where burst samples come from
+static volatile uint32_t lastTickMicros = 0;              // time of previous timer tick
+static volatile uint32_t dueTickMicros = 0;               // time the current timer tick was due
+static volatile uint32_t samplesMissed = 0;               // timer ticks that never ran
+static uint32_t burstsSaved = 0;                          // bursts written to flash since startup
+static EncodedFile<BURST_RAW_MEMSIZE> encodedBurst;       // burst being written by the flash queue
+static bool burstSaving = false;                          // whether encodedBurst is queued or being written
+
+static const unsigned long BURST_PERIOD_MICROS = 1000000UL / BURST_RATE_HZ; // microseconds between burst samples
+
+/* - - - - - - Class Definitions - - - - - - */
+
+/* - - - - - - BurstRing - - - - - - */
+// constructor
+BurstRing::BurstRing() {
+    m_samplesLost = 0;
+    m_triggersIgnored = 0;
+    reset();
+}
+
+// empties the ring and starts filling again
+void BurstRing::reset() {
+    memset(m_ring, 0, sizeof(m_ring));
+    m_head = 0;
+    m_filled = 0;
+    m_postCount = 0;
+    m_source = 0;
+    m_triggerMillis = 0;
+    m_preSamples = 0;
+    m_state = FILLING;
+}
+
+// adds a sample to the ring, call from the sampling interrupt only
+void BurstRing::addSample(uint16_t sample) {
+    if (m_state == FROZEN) {
+        m_samplesLost++;
+        return;
+    }
+    m_ring[m_head] = sample;
+    m_head = (m_head + 1) % BURST_SAMPLES;
+    if (m_filled < BURST_SAMPLES) { m_filled++; }
+
+    if (m_state == TRIGGERED) {
+        m_postCount++;
+        if (m_postCount >= BURST_POST_SAMPLES) { m_state = FROZEN; }
+    }
+}
+
+// starts the post-trigger countdown, returns false if a burst is already in progress
+bool BurstRing::trigger(uint8_t source, uint32_t timeMillis) {
+    bool accepted = false;
+    noInterrupts();
+    if (m_state == FILLING) {
+        m_preSamples = (m_filled < BURST_PRE_SAMPLES) ? m_filled : BURST_PRE_SAMPLES;
+        m_postCount = 0;
+        m_source = source;
+        m_triggerMillis = timeMillis;
+        m_state = TRIGGERED;
+        accepted = true;
+    } else {
+        m_triggersIgnored++;
+    }
+    interrupts();
+    return accepted;
+}
+
+// copies a frozen burst in time ascending order, the trigger sample is at index BURST_PRE_SAMPLES
+void BurstRing::copyBurst(uint16_t *dst, BurstHeader &header) {
+    for (int i = 0; i < BURST_SAMPLES; i++) {
+        dst[i] = m_ring[(m_head + i) % BURST_SAMPLES]; // head is the oldest sample once the ring is frozen
+    }
+    header.triggerMillis = m_triggerMillis;
+    header.source = m_source;
+    header.rateHz = BURST_RATE_HZ;
+    header.preSamples = m_preSamples;
+    header.postSamples = BURST_POST_SAMPLES;
+    header.samplesLost = m_samplesLost;
+}
+
+// un-freezes the ring, history from before the freeze is discarded since it has a gap
+void BurstRing::release() {
+    noInterrupts();
+    m_filled = 0;
+    m_postCount = 0;
+    m_state = FILLING;
+    interrupts();
+}
+
+/* - - - - - - Module Driver Functions - - - - - - */
+
+/* - - - - - - handleBurstCapture - - - - - - *
+ * Usage:
+ *  Starts or stops the burst timer to match BURST_CAPTURE and saves frozen bursts
+ * 
+ * Inputs:
+ *  none
+ *  
+ * Outputs:
+ *  none
+ */
+void handleBurstCapture() {
+    if (BURST_CAPTURE != burstRunning) {
+        setBurstCapture(BURST_CAPTURE);
+    }
+
+    // the ring stays frozen until onBurstSaved(), a new burst waits for the write
+    if (burstRing.isFrozen() && !burstSaving) {
+        if (!saveBurst()) { burstRing.release(); }
+    }
+}
+
+/* - - - - - - Helper Functions - - - - - - */
+
+/* - - - - - - setBurstCapture - - - - - - *
+ * Usage:
+ *  Starts or stops the background burst sampling timer
+ * 
+ * Inputs:
+ *  enable - true to start sampling, false to stop
+ *  
+ * Outputs:
+ *  none
+ */
+void setBurstCapture(bool enable) {
+    if (enable && !burstRunning) {
+        spiBus.begin();
+        SPI.usingInterrupt(IRQ_PIT); // keep the timer out of other SPI transactions, flash holds the bus one chunk at a time
+        burstRing.reset();
+        lastTickMicros = 0;
+        burstRunning = burstTimer.begin(burstSampleISR, BURST_PERIOD_MICROS);
+        if (!burstRunning) { Serial.println("Failed to start burst timer (Burst Capture)"); }
+    } else if (!enable && burstRunning) {
+        burstTimer.end();
+        burstRunning = false;
+    }
+}
+
+/* - - - - - - triggerBurst - - - - - - *
+ * Usage:
+ *  Freezes the pre-trigger history and starts capturing the post-trigger samples.
+ *  Does nothing if burst capture is not running.
+ * 
+ * Inputs:
+ *  source - BurstTrigger that caused the trigger
+ *  
+ * Outputs:
+ *  none
+ */
+void triggerBurst(uint8_t source) {
+    if (burstRunning) {
+        burstRing.trigger(source, millis());
+    }
+}
+
+/* - - - - - - burstSampleISR - - - - - - *
+ * Usage:
+ *  Timer interrupt, takes a single burst sample and counts ticks that were held off
+ * 
+ * Inputs:
+ *  none
+ *  
+ * Outputs:
+ *  none
+ */
+void burstSampleISR() {
+    uint32_t now = micros();
+    dueTickMicros = lastTickMicros != 0 ? lastTickMicros + BURST_PERIOD_MICROS : now;
+    if (lastTickMicros != 0) {
+        uint32_t gap = now - lastTickMicros;
+        if (gap > BURST_PERIOD_MICROS * 3 / 2) {
+            samplesMissed += gap / BURST_PERIOD_MICROS - 1;
+        }
+    }
+    lastTickMicros = now;
+    burstRing.addSample(sampleSource());
+}
+
+/* - - - - - - setBurstSampleSource - - - - - - *
+ * Usage:
+ *  Replaces the burst sample source, use a synthetic source to test without the ADC
+ * 
+ * Inputs:
+ *  source - function returning one sample, nullptr restores the ADC
+ *  
+ * Outputs:
+ *  none
+ */
+void setBurstSampleSource(BurstSampleSource source) {
+    sampleSource = (source != nullptr) ? source : readBurstAdc;
+}
+
+/* - - - - - - readBurstAdc - - - - - - *
+ * Usage:
+ *  Reads one sample from the science ADC, safe to call from the burst interrupt.
+ *  The time since the tick was due is counted in the SPI bus latency histogram
+ * 
+ * Inputs:
+ *  none
+ *  
+ * Outputs:
+ *  data from the ADC (bin number)
+ */
+uint16_t readBurstAdc() {
+    return spiBus.readAdc(dueTickMicros);
+}
+
+/* - - - - - - saveBurst - - - - - - *
+ * Usage:
+ *  Encodes the frozen burst and queues it for the next free burst file, onBurstSaved()
+ *  releases the ring once the record is committed or has failed
+ * 
+ * Inputs:
+ *  none
+ *  
+ * Outputs:
+ *  whether the burst was queued for writing
+ */
+bool saveBurst() {
+    // copy burst out of the ring
+    uint16_t samples[BURST_SAMPLES];
+    BurstHeader header;
+    burstRing.copyBurst(samples, header);
+    header.samplesMissed = samplesMissed;
+
+    // pack header and samples
+    uint8_t rawData[BURST_RAW_MEMSIZE] = {};
+    size_t bytesCopied = 0;
+    memAppend(rawData, &header.triggerMillis, sizeof(header.triggerMillis), &bytesCopied);
+    memAppend(rawData, &header.source, sizeof(header.source), &bytesCopied);
+    memAppend(rawData, &header.rateHz, sizeof(header.rateHz), &bytesCopied);
+    memAppend(rawData, &header.preSamples, sizeof(header.preSamples), &bytesCopied);
+    memAppend(rawData, &header.postSamples, sizeof(header.postSamples), &bytesCopied);
+    memAppend(rawData, &header.samplesLost, sizeof(header.samplesLost), &bytesCopied);
+    memAppend(rawData, &header.samplesMissed, sizeof(header.samplesMissed), &bytesCopied);
+    memAppend(rawData, samples, sizeof(samples), &bytesCopied);
+
+    // Run all the data through EDAC, kept until the flash queue has written it
+    encodedBurst.encodeData(rawData);
+
+    // find a free file slot
+    int fileIdx = 0;
+    for (; fileIdx < MAX_BURST_FILES; fileIdx++) {
+        if (recordStore.find(RECORD_BURST, fileIdx) < 0) { break; }
+    }
+    if (fileIdx >= MAX_BURST_FILES) {
+        Serial.println("WARNING: no free burst file, burst discarded. (Burst Capture - saveBurst() func)");
+        return false;
+    }
+
+    // write the record, its sector is reclaimed once the ground acknowledges it
+    burstSaving = recordStore.submitAppend(RECORD_BURST, fileIdx, encodedBurst.getData(), encodedBurst.MEMSIZE,
+                                           onBurstSaved, (void *)(intptr_t)fileIdx);
+    if (!burstSaving) { Serial.println("WARNING: burst write not queued, burst discarded. (Burst Capture - saveBurst() func)"); }
+    return burstSaving;
+}
+
+/* - - - - - - onBurstSaved - - - - - - *
+ * Usage:
+ *  Flash queue callback of the burst written by saveBurst(), releases the ring for the next burst
+ * 
+ * Inputs:
+ *  context - burst file number
+ *  status - whether the record was written
+ *  
+ * Outputs:
+ *  none
+ */
+void onBurstSaved(void *context, bool status) {
+    int fileIdx = (int)(intptr_t)context;
+    burstSaving = false;
+    burstRing.release();
+
+    if (status) { 
+        Serial.print("Burst saved: burstFile"); 
+        burstsSaved++;
+    } else { 
+        Serial.print("Burst save failed: burstFile"); 
+    }
+    Serial.print(fileIdx);
+    Serial.println(".bin");
+}
+
+/* - - - - - - printBurstInfo - - - - - - *
+ * Usage:
+ *  Prints burst capture status and loss counters
+ * 
+ * Inputs:
+ *  none
+ *  
+ * Outputs:
+ *  none
+ */
+void printBurstInfo() {
+    Serial.print("Burst Capture: ");
+    if (burstRunning) { Serial.println("Running"); }
+    else { Serial.println("Stopped"); }
+    Serial.print("Bursts Saved: ");
+    Serial.println(burstsSaved);
+    Serial.print("Burst Samples Lost (frozen) / Missed (held off): ");
+    Serial.print(burstRing.getSamplesLost());
+    Serial.print(" / ");
+    Serial.println(samplesMissed);
+    Serial.print("Burst Triggers Ignored: ");
+    Serial.println(burstRing.getTriggersIgnored());
+}
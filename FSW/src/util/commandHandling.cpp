@@ -21,10 +21,27 @@
 #include "../headers/timing.hpp" //for mode enum
 #include "../headers/faultManager.hpp"
 #include "../headers/housekeeping.hpp"
+#include "../headers/burstCapture.hpp"
+#include "../headers/adcsFeedback.hpp"
+#include "../headers/attitudeFusion.hpp"
+#include "../headers/windowCheckpoint.hpp"
+#include "../headers/fileCatalog.hpp"
+#include "../headers/recordStore.hpp"
+#include "../headers/flashQueue.hpp"
+#include "../headers/scrubber.hpp"
+#include "../headers/windowCache.hpp"
+#include "../headers/retention.hpp"
+#include "../headers/hkHistory.hpp"
+#include "../headers/blackBox.hpp"
+#include "../headers/spiBus.hpp"
+#include "../headers/downlinkFrame.hpp"
+#include "../headers/downlinkTransfer.hpp"
+#include "../headers/downlinkScheduler.hpp"
 
 
 /* Module Variable Definitions */
 static int commandQueue[COMMAND_QUEUE_SIZE] = {};  // initializes as all zeros
+static CommandArgs commandArgQueue[COMMAND_QUEUE_SIZE]; // arguments of each queued command
 static int queueIndex = 0;                  // next available index of command queue
 static bool isPaused = false;               // indicates if command execution is paused
 
@@ -41,11 +58,12 @@ static bool isPaused = false;               // indicates if command execution is
  *  None
  */
 void commandHandling() {
-    int newCommand = readCommand(); // read command from serial
+    CommandArgs newArgs;
+    int newCommand = readCommand(newArgs); // read command from serial
     if (checkMetaCommand(newCommand)) { // if new command is a meta command, execute it immediately
-        executeCommand(newCommand);
+        executeCommand(newCommand, newArgs);
     } else if (newCommand != -1) { // if the new command is valid, add it to the queue
-        queueCommand(newCommand);
+        queueCommand(newCommand, newArgs);
     }
     executeAllCommands(); // execute all commands in the queue
 }
@@ -55,21 +73,33 @@ void commandHandling() {
 /* - - - - - - readCommand - - - - - - *
  * Usage:
  *  Reads serial input for an incoming command, checks if it has received a valid command,
- *  and returns the new command
+ *  reads any arguments the command takes, and returns the new command.
+ *  Arguments follow the code separated by spaces, e.g. "12 2000 50 500".
+ *  Missing arguments are read as 0.
  * 
  * Inputs:
- *  none
+ *  args - filled with the arguments of the command (pass-by-reference)
  * 
  * Outputs:
  *  a single valid command code, or -1 if no valid code is received
  */
-int readCommand() {
+int readCommand(CommandArgs &args) {
     // read Serial
     if (Serial.available() > 0) { // check if there is serial input
         int serialInput = Serial.parseInt(); // read the command
         if ((serialInput <= commandCode::DO_NOTHING) && (serialInput > 0)) { // check if command is valid
             Serial.print("Command Received via Serial - code: ");
-            Serial.println(serialInput);
+            Serial.print(serialInput);
+
+            // read arguments
+            args.count = 0;
+            for (int i = 0; i < commandArgCount(serialInput); i++) {
+                args.values[i] = Serial.parseInt();
+                args.count++;
+                Serial.print(" ");
+                Serial.print(args.values[i]);
+            }
+            Serial.println();
             return serialInput;
         } else {
             // print warning, indicating the invalid command and the range of valid commands
@@ -83,6 +113,37 @@ int readCommand() {
     return -1; // no command
 }
 
+/* - - - - - - commandArgCount - - - - - - *
+ * Usage:
+ *  Returns the number of integer arguments that follow a command code.
+ *  List commands that take arguments here.
+ * 
+ * Inputs:
+ *  command - a single command code
+ * 
+ * Outputs:
+ *  number of arguments, 0 to COMMAND_MAX_ARGS
+ */
+int commandArgCount(int command) {
+    switch (command) {
+        case commandCode::ACK_DOWNLINK:
+            return 4;
+        case commandCode::SET_ADAPTIVE_THRESH:
+        case commandCode::DOWNLINK_HK_HISTORY:
+        case commandCode::DOWNLINK_FILE:
+        case commandCode::SET_DOWNLINK_WEIGHTS:
+            return 3;
+        case commandCode::SET_SCRUB_RATE:
+        case commandCode::SET_RETENTION:
+        case commandCode::SET_RETENTION_WEIGHTS:
+            return 2;
+        case commandCode::SET_DOWNLINK_BUDGET:
+            return 1;
+        default:
+            return 0; // most commands take no arguments
+    }
+}
+
 /* - - - - - - queueCommand - - - - - - *
  * Usage:
  *  Adds command to the next availiable spot in the command queue.
@@ -90,13 +151,15 @@ int readCommand() {
  * 
  * Inputs:
  *  command - a single command code
+ *  args - arguments of the command
  * 
  * Outputs:
  *  None
  */
-void queueCommand(int command) {
+void queueCommand(int command, CommandArgs &args) {
     if (queueIndex < COMMAND_QUEUE_SIZE) { // if end of queue has not been reached, add command to queue 
         commandQueue[queueIndex] = command;
+        commandArgQueue[queueIndex] = args;
         queueIndex++;
     } else {
         Serial.println("Command queue full.");
@@ -149,6 +212,8 @@ bool checkIfCommandAllowed(int command) {
         case commandCode::CALIBRATE_OPTICS_THERM:
         case commandCode::RESET_PERSISTENT_DATA:
         case commandCode::WIPE_EEPROM:
+        case commandCode::CLEAR_ERROR_MAP:
+        case commandCode::SET_RETENTION:
         case commandCode::DISABLE_WD_RESET:
         case commandCode::EXIT_MAIN_LOOP:
             break;
@@ -173,7 +238,7 @@ bool checkIfCommandAllowed(int command) {
 void executeAllCommands() {
     if (!isPaused) { // if command execution is not paused
         for (int i = 0; i < queueIndex; i++) { // execute each command in the queue
-            executeCommand(commandQueue[i]);
+            executeCommand(commandQueue[i], commandArgQueue[i]);
         }
         clearCommandQueue();
     }
@@ -192,6 +257,7 @@ void executeAllCommands() {
 void clearCommandQueue() {
     for (int i = 0; i < COMMAND_QUEUE_SIZE; i++) { // execute each command in the queue
             commandQueue[i] = 0;
+            commandArgQueue[i] = CommandArgs();
         }
         queueIndex = 0; // reset queue index
 }
@@ -202,12 +268,14 @@ void clearCommandQueue() {
  * 
  * Inputs:
  *  command - a single command code
+ *  args - arguments of the command, see commandArgCount()
  * 
  * Outputs:
  *  None
  */
-void executeCommand(int command) {
+void executeCommand(int command, CommandArgs &args) {
     if (!checkIfCommandAllowed(command)) { return; }
+    blackBox.log(BB_COMMAND, 3, command, args.values[0], args.values[1]);
 
     // When adding new commands, make sure to include any relevant headers!
     switch (command) {
@@ -238,6 +306,7 @@ void executeCommand(int command) {
             break;
         
         case commandCode::ENTER_SUNRISE_MODE: 
+            sunriseTimerEvent.setDuration(WINDOW_LENGTH_MSEC);
             sunriseTimerEvent.start(); // sunrise mode will never end w/o this call
             scienceMode.setMode(SUNRISE_MODE);
             Serial.println("Command Executed - Entering Sunrise Mode.");
@@ -245,14 +314,18 @@ void executeCommand(int command) {
 
         // Data Collection
         case commandCode::SAVE_BUFFER:
-            if (saveBuffer()) { Serial.println("Command Executed - Buffer saved to flash."); }
+            if (saveBuffer()) { Serial.println("Command Executed - Buffer queued for saving to flash."); }
             else { Serial.println("Command Executed - Attempt to save buffer failed."); }
             break;
 
         case commandCode::DOWNLINK_START:
-            downlinkEvent.invoke();
-            if (scienceMode.getMode() == STANDBY_MODE) { Serial.println("Command Executed - Downlink initiated."); }
-            else { Serial.println("Command Executed - Downlink will begin when payload enters standby."); }
+            startDownlink();
+            Serial.println("Command Executed - Downlink initiated.");
+            break;
+
+        case commandCode::LIST_FILES:
+            printCatalogList();
+            Serial.println("Command Executed - Listed science files.");
             break;
 
         case commandCode::STREAM_PHOTO_T:
@@ -272,6 +345,109 @@ void executeCommand(int command) {
             Serial.println("PHOTO | time (ms) | SPI voltage (V) | Pin voltage (V)");
             break;
 
+        case commandCode::ADAPTIVE_SAMPLING_T:
+            ADAPTIVE_SAMPLING = true;
+            Serial.println("Command Executed - Sampling rate will follow signal activity.");
+            break;
+
+        case commandCode::ADAPTIVE_SAMPLING_F:
+            ADAPTIVE_SAMPLING = false;
+            Serial.println("Command Executed - Sampling at fixed nominal rate.");
+            break;
+
+        case commandCode::SET_ADAPTIVE_THRESH:
+            if (args.values[0] <= 0 || args.values[1] <= 0 || args.values[2] <= 0 || args.values[1] >= args.values[0]) {
+                Serial.println("Command Rejected - Thresholds must be positive and slow slope must be below fast slope.");
+                break;
+            }
+            ADAPTIVE_FAST_SLOPE = args.values[0];
+            ADAPTIVE_SLOW_SLOPE = args.values[1];
+            ADAPTIVE_NOISE = args.values[2];
+            Serial.println("Command Executed - Adaptive sampling thresholds updated.");
+            break;
+
+        case commandCode::BURST_CAPTURE_T:
+            BURST_CAPTURE = true;
+            Serial.println("Command Executed - Burst capture will run in science modes.");
+            break;
+
+        case commandCode::BURST_CAPTURE_F:
+            BURST_CAPTURE = false;
+            Serial.println("Command Executed - Burst capture stopped.");
+            break;
+
+        case commandCode::TRIGGER_BURST:
+            triggerBurst(BURST_TRIGGER_COMMAND);
+            if (BURST_CAPTURE) { Serial.println("Command Executed - Burst triggered."); }
+            else { Serial.println("Command Executed - Burst capture is not enabled, nothing to trigger."); }
+            break;
+
+        case commandCode::CHECKPOINT_WINDOWS_T:
+            CHECKPOINT_WINDOWS = true;
+            Serial.println("Command Executed - Science windows will be checkpointed.");
+            break;
+
+        case commandCode::CHECKPOINT_WINDOWS_F:
+            CHECKPOINT_WINDOWS = false;
+            Serial.println("Command Executed - Science windows will NOT be checkpointed.");
+            break;
+
+        case commandCode::QUICKLOOK:
+            quicklook();
+            Serial.println("Command Executed - Summarized newest science file.");
+            break;
+
+        case commandCode::DOWNLINK_FILE: {
+            if (args.values[1] < 0 || args.values[2] < args.values[1]) {
+                Serial.println("Command Rejected - Chunk range must not be negative.");
+                break;
+            }
+            int wanted = requestDownlink(args.values[0], args.values[1], args.values[2]);
+            if (wanted < 0) {
+                Serial.println("Command Rejected - No such file stored.");
+                break;
+            }
+            Serial.print("Command Executed - ");
+            Serial.print(wanted);
+            Serial.println(" chunk(s) of the file will be downlinked.");
+            break;
+        }
+
+        case commandCode::ACK_DOWNLINK: {
+            AckResult result = acknowledgeDownlink(args.values[0], args.values[1], args.values[2], args.values[3]);
+            if (result == ACK_REJECTED) {
+                Serial.println("Command Rejected - No downlink of that file and version, or chunk out of range.");
+            } else if (result == ACK_COMPLETE) {
+                Serial.println("Command Executed - File acknowledged in full and deleted.");
+            } else {
+                Serial.print("Command Executed - ");
+                Serial.print(downlinkTransfer.ackedChunks((uint16_t)args.values[0]));
+                Serial.println(" chunk(s) of the file acknowledged.");
+            }
+            break;
+        }
+
+        case commandCode::SET_DOWNLINK_WEIGHTS:
+            if (args.values[0] < 0 || args.values[1] < 0 || args.values[2] < 0 ||
+                args.values[0] > 1000 || args.values[1] > 1000 || args.values[2] > 1000) {
+                Serial.println("Command Rejected - Downlink weights must be 0 to 1000.");
+                break;
+            }
+            DOWNLINK_QUALITY_WEIGHT = args.values[0];
+            DOWNLINK_AGE_WEIGHT = args.values[1];
+            DOWNLINK_PARTIAL_WEIGHT = args.values[2];
+            Serial.println("Command Executed - Downlink weights updated, used from the next pass.");
+            break;
+
+        case commandCode::SET_DOWNLINK_BUDGET:
+            if (args.values[0] < 0) {
+                Serial.println("Command Rejected - Downlink budget must be 0 or more bytes.");
+                break;
+            }
+            DOWNLINK_PASS_BYTES = args.values[0];
+            Serial.println("Command Executed - Downlink budget updated.");
+            break;
+
         // Housekeeping
         case commandCode::TURN_HEATER_ON: 
             HEATER_ON = true;
@@ -313,6 +489,16 @@ void executeCommand(int command) {
             Serial.println(" C");
             break;
 
+        case commandCode::DOWNLINK_HK_HISTORY:
+            if (args.values[0] < 0 || args.values[0] > UINT16_MAX || args.values[1] < 0 || args.values[2] < args.values[1]) {
+                Serial.println("Command Rejected - Run must be 0 to 65535 and the time range must not be negative.");
+                break;
+            }
+            Serial.print("Command Executed - ");
+            Serial.print(requestHkHistory(args.values[0], args.values[1], args.values[2]));
+            Serial.println(" housekeeping history block(s) will be downlinked.");
+            break;
+
         case commandCode::DISABLE_WD_RESET: 
             wdTimer.setDuration(0xFFFFFFFF); // that should do it.
             Serial.println("Command Executed - Watchdog will not be fed. Restart imminent!");
@@ -355,10 +541,85 @@ void executeCommand(int command) {
             Serial.println("Command Executed - ADCS_POINTING_AT_SUN set to false.");
             break;
 
+        case commandCode::ADCS_RESET_LATENCY:
+            resetAdcsLatencyStats();
+            Serial.println("Command Executed - ADCS feedback latency statistics cleared.");
+            break;
+
+        case commandCode::SIMULATE_ATTITUDE_T:
+            SIMULATE_ATTITUDE = true;
+            Serial.println("Command Executed - Feeding simulated attitude sweep.");
+            break;
+
+        case commandCode::SIMULATE_ATTITUDE_F:
+            SIMULATE_ATTITUDE = false;
+            Serial.println("Command Executed - Stopped feeding simulated attitude.");
+            break;
+
         // Memory
         case commandCode::SCRUB_FLASH:
             scrubEvent.invoke();
-            Serial.println("Command Executed - Flash scrub initiated.");
+            Serial.println("Command Executed - Flash scrub initiated, runs without the rate limit.");
+            break;
+
+        case commandCode::STORAGE_STRIPED:
+            if (setStorageMode(STORAGE_STRIPED)) { Serial.println("Command Executed - Science storage striped across both flash modules."); }
+            else { Serial.println("Command Executed - Attempt to change science storage mode failed."); }
+            break;
+
+        case commandCode::STORAGE_MIRRORED:
+            if (setStorageMode(STORAGE_MIRRORED)) { Serial.println("Command Executed - Science storage mirrored on both flash modules."); }
+            else { Serial.println("Command Executed - Attempt to change science storage mode failed."); }
+            break;
+
+        case commandCode::AUTO_SCRUB_T:
+            AUTO_SCRUB = true;
+            Serial.println("Command Executed - Flash will be scrubbed in the background.");
+            break;
+
+        case commandCode::AUTO_SCRUB_F:
+            AUTO_SCRUB = false;
+            Serial.println("Command Executed - Flash will only be scrubbed when commanded.");
+            break;
+
+        case commandCode::SET_SCRUB_RATE:
+            if (args.values[0] < 0 || args.values[1] <= 0) {
+                Serial.println("Command Rejected - Scrub rate must not be negative and hours per pass must be positive.");
+                break;
+            }
+            SCRUB_BYTES_PER_SEC = args.values[0];
+            SCRUB_PASS_HOURS = args.values[1];
+            Serial.println("Command Executed - Background scrub rate updated.");
+            break;
+
+        case commandCode::DOWNLINK_ERROR_MAP:
+            requestErrorMap();
+            Serial.println("Command Executed - Flash sector error map will be downlinked.");
+            break;
+
+        case commandCode::CLEAR_ERROR_MAP:
+            if (recordStore.clearErrorMap()) { Serial.println("Command Executed - Flash sector error map cleared."); }
+            else { Serial.println("Command Executed - Attempt to clear flash sector error map failed."); }
+            break;
+
+        case commandCode::SET_RETENTION:
+            if (args.values[0] < RETAIN_SCORED || args.values[0] > RETAIN_STORED || args.values[1] <= 0 || args.values[1] > MAXFILES) {
+                Serial.println("Command Rejected - Retention policy must be 0 to 2 and files kept 1 to MAXFILES.");
+                break;
+            }
+            RETENTION_POLICY = args.values[0];
+            RETENTION_QUOTA_FILES = args.values[1];
+            Serial.println("Command Executed - Retention policy updated, takes effect at the next save.");
+            break;
+
+        case commandCode::SET_RETENTION_WEIGHTS:
+            if (args.values[0] < 0 || args.values[1] < 0 || args.values[0] > 1000 || args.values[1] > 1000) {
+                Serial.println("Command Rejected - Retention weights must be 0 to 1000.");
+                break;
+            }
+            RETENTION_QUALITY_WEIGHT = args.values[0];
+            RETENTION_AGE_WEIGHT = args.values[1];
+            Serial.println("Command Executed - Retention weights updated.");
             break;
 
         // Fault Mitigation
@@ -402,6 +663,13 @@ void executeCommand(int command) {
             Serial.println("Command Executed - Faults will NOT be saved to EEPROM");
             break;
 
+        case commandCode::DUMP_BLACK_BOX:
+            blackBox.flush(); // written first so the dump matches what a reset would leave
+            Serial.print("Command Executed - Dumped ");
+            Serial.print(dumpBlackBox());
+            Serial.println(" black box event(s).");
+            break;
+
         // Main Loop
         case commandCode::EXIT_MAIN_LOOP:
             exitMainLoopEvent.invoke();
@@ -465,6 +733,31 @@ void printInfo() {
     Serial.println(latestHkSample.digitalCurrent);
     Serial.print("Digital Reg PG (V): ");
     Serial.println(latestHkSample.digitalRegPG);
+    Serial.print("Sampling Rate: ");
+    if (ADAPTIVE_SAMPLING) { Serial.println("Adaptive"); } 
+    else { Serial.println("Fixed"); }
+    Serial.print("Adaptive Thresholds (fast bins/s, slow bins/s, noise bins): ");
+    Serial.print(ADAPTIVE_FAST_SLOPE);
+    Serial.print(", ");
+    Serial.print(ADAPTIVE_SLOW_SLOPE);
+    Serial.print(", ");
+    Serial.println(ADAPTIVE_NOISE);
+    printCatalogInfo();
+    printRecordStoreInfo();
+    printWindowCacheInfo();
+    printRetentionInfo();
+    printFlashQueueInfo();
+    printSpiBusInfo();
+    printDownlinkInfo();
+    printDownlinkTransferInfo();
+    printDownlinkScheduleInfo();
+    printBurstInfo();
+    printCheckpointInfo();
+    printScrubInfo();
+    printAdcsInfo();
+    printAttitudeInfo();
+    printHkHistoryInfo();
+    printBlackBoxInfo();
     Serial.print("Heater Control: ");
     if (HEATER_OVERRIDE) { Serial.println("Manual"); } 
     else { Serial.println("NS2 has priority"); }
@@ -0,0 +1,90 @@
+/* crc.cpp computes checksums of stored data
+ * Usage:
+ *  crc32c() returns the CRC-32C (Castagnoli) of a block of memory.
+ *  Pass the previous result as crc to checksum data in pieces.
+ *  Eight lookup tables (8KB) let it take 8 bytes a step, so a clean page or file can be
+ *  checked far faster than it can be decoded.
+ * 
+ * Modules encompassed:
+ *  Program EDAC
+ *
+ * Additional files needed for compilation:
+ *  config.hpp
+ */
+
+/* - - - - - - Includes - - - - - - */
+// All libraries are put in crc.hpp
+// NS2 headers
+#include "../headers/crc.hpp"
+
+/* Module Variable Definitions */
+static const uint32_t CRC32C_POLY = 0x82F63B78; // reflected Castagnoli polynomial
+static uint32_t crcTable[8][256]; // crcTable[k][b] is the crc of byte b followed by k zero bytes
+static bool crcTableReady = false;
+
+/* - - - - - - Helper Functions - - - - - - */
+
+// fills the lookup tables, done once on first use
+static void buildCrcTable() {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (CRC32C_POLY & (0 - (crc & 1)));
+        }
+        crcTable[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int k = 1; k < 8; k++) {
+            crcTable[k][i] = (crcTable[k - 1][i] >> 8) ^ crcTable[0][crcTable[k - 1][i] & 0xFF];
+        }
+    }
+    crcTableReady = true;
+}
+
+/* - - - - - - Module Driver Functions - - - - - - */
+
+/* - - - - - - crc32c - - - - - - *
+ * Usage:
+ *  Computes the CRC-32C of a block of memory, 8 bytes per step (slice-by-8)
+ * 
+ * Inputs:
+ *  data - pointer to data
+ *  size - number of bytes
+ *  crc - result of the previous piece when checksumming in pieces, 0 otherwise
+ *  
+ * Outputs:
+ *  CRC-32C of the data
+ */
+uint32_t crc32c(const void *data, size_t size, uint32_t crc) {
+    if (!crcTableReady) { buildCrcTable(); }
+
+    const uint8_t *bytes = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+
+    // bytewise up to a word boundary
+    while (size > 0 && ((uintptr_t)bytes & 3) != 0) {
+        crc = (crc >> 8) ^ crcTable[0][(crc ^ *bytes++) & 0xFF];
+        size--;
+    }
+
+    // 8 bytes at a time, words are read little endian as on the Teensy
+    while (size >= 8) {
+        uint32_t low, high;
+        memcpy(&low, bytes, sizeof(low));
+        memcpy(&high, bytes + 4, sizeof(high));
+        low ^= crc;
+        crc = crcTable[7][low & 0xFF] ^ crcTable[6][(low >> 8) & 0xFF]
+            ^ crcTable[5][(low >> 16) & 0xFF] ^ crcTable[4][low >> 24]
+            ^ crcTable[3][high & 0xFF] ^ crcTable[2][(high >> 8) & 0xFF]
+            ^ crcTable[1][(high >> 16) & 0xFF] ^ crcTable[0][high >> 24];
+        bytes += 8;
+        size -= 8;
+    }
+
+    // the rest bytewise
+    while (size > 0) {
+        crc = (crc >> 8) ^ crcTable[0][(crc ^ *bytes++) & 0xFF];
+        size--;
+    }
+    return ~crc;
+}
@@ -12,6 +12,13 @@
  *  config.hpp
  *  timing.cpp & timing.hpp
  *  edac.cpp & edac.hpp
+ *  flashQueue.cpp & flashQueue.hpp
+ *  scrubber.cpp & scrubber.hpp
+ *  windowCache.cpp & windowCache.hpp
+ *  spiBus.cpp & spiBus.hpp
+ *  downlinkTransfer.cpp & downlinkTransfer.hpp
+ *  downlinkScheduler.cpp & downlinkScheduler.hpp
+ *  hkHistory.cpp & hkHistory.hpp
  */
 
 /* - - - - - - Includes - - - - - - */
@@ -20,6 +27,26 @@
 #include "../headers/dataCollection.hpp"
 #include "../headers/timing.hpp"
 #include "../headers/encodedSciData.hpp"
+#include "../headers/adaptiveSampler.hpp"
+#include "../headers/burstCapture.hpp"
+#include "../headers/adcsFeedback.hpp"
+#include "../headers/attitudeFusion.hpp"
+#include "../headers/windowCheckpoint.hpp"
+#include "../headers/fileCatalog.hpp"
+#include "../headers/recordStore.hpp"
+#include "../headers/flashQueue.hpp"
+#include "../headers/crc.hpp"
+#include "../headers/scrubber.hpp"
+#include "../headers/windowCache.hpp"
+#include "../headers/retention.hpp"
+#include "../headers/blackBox.hpp"
+#include "../headers/spiBus.hpp"
+#include "../headers/downlinkTransfer.hpp"
+#include "../headers/downlinkScheduler.hpp"
+#include "../headers/hkHistory.hpp"
+
+static_assert(RecordStore::ERROR_MAP_MEMSIZE <= EncodedSciData::MEMSIZE, "the error map must fit in one downlink transfer");
+static_assert(HK_PIECE_MEMSIZE <= EncodedSciData::MEMSIZE, "a housekeeping history block must fit in one downlink transfer");
 
 /* Module Variable Definitions */
 
@@ -27,41 +54,230 @@
 static int bufIdx = 0;               // index of next dataBuffer element to overwrite
 static uint16_t dataBuffer[BUFFERSIZE]; // create array to hold data buffer elements
 
-// file reading/writing
-static char filename[] = "scienceFile0.csv";   // null-terminated char array 
-static const int FILE_IDX_OFFSET = 11;           // index of file number in char array
+// adaptive sampling
+static uint8_t rateCodeBuffer[RATE_CODE_MEMSIZE];   // packed 2 bit sampling period code of each dataBuffer element
+static uint8_t rateCode = ADAPTIVE_NOMINAL_RATE_CODE; // rate code of the sample being collected
+static AdaptiveSampler adaptiveSampler;
+static uint32_t sampleDueMicros = 0;                // micros() the next sample is due at, for the SPI bus
+
+// attitude fusion
+static int16_t attitudeColumn[BUFFERSIZE]; // pointing elevation aligned to each dataBuffer element
+
+// flash queue work, kept here so it stays valid until the queue calls back
+// one paged file at a time is saved, read for downlink or quicklook, in the second RAM bank like the window cache
+DMAMEM static uint8_t pageBuffer[EncodedSciData::PAGED_MEMSIZE]; // science file laid out in flash pages
+static bool fileDataBusy = false;                   // whether a science file in pageBuffer is waiting on the flash queue
+static WindowSummary fileSummary;                   // summary of the file being saved, cached with it once it is saved
+static bool downlinkBusy = false;                   // whether a record read into pageBuffer for downlink is waiting on the flash queue
+static int downlinkSlot = 0;                        // catalog slot of the record being read for downlink
+static uint32_t downlinkReadMicros = 0;              // when the record being read for downlink was queued
+static bool downlinkSending = false;                // whether handleDownlink() is sending the file in pageBuffer
+static int downlinkFileCount = 0;                   // files sent by the current downlink event
+static uint32_t downlinkFirstChunk = 0;             // chunks the transfer had sent when the current downlink event started
+static uint32_t downlinkFirstWireBytes = 0;         // bytes written to the link when the current downlink event started
+static uint32_t downlinkLoopMicros = 0;             // longest loop iteration during the current downlink event
+static bool downlinkAll = false;                    // whether the current downlink event sends every unacknowledged chunk
+static bool downlinkHkSending = false;              // whether the file being sent is a housekeeping history block
+static bool downlinkHkNext = false;                 // whether handleDownlink() reads the next housekeeping history block
+static const int DOWNLINK_NAME_SIZE = sizeof("burstFile0.bin"); // chars in the longest downlinked file name
+
+/* - - - - - - Helper Functions - - - - - - */
+
+// name of a science or burst file, of the pass summary or of a built product
+static void downlinkFilename(int fileNum, char name[DOWNLINK_NAME_SIZE]) {
+    if (fileNum < MAXFILES) {
+        FileCatalog::slotFilename(fileNum, name);
+    } else if (fileNum == DOWNLINK_SUMMARY_ID) {
+        strcpy(name, "summary.bin");
+    } else if (fileNum == DOWNLINK_ERROR_MAP_ID) {
+        strcpy(name, "errorMap.bin");
+    } else if (fileNum == DOWNLINK_HK_HISTORY_ID) {
+        strcpy(name, "hkHistory.bin");
+    } else {
+        strcpy(name, "burstFile0.bin");
+        name[BURST_FILE_IDX_OFFSET] = '0' + (fileNum - MAXFILES);
+    }
+}
+
+/* takePageBuffer
+ *  waits for the flash queue to be done with pageBuffer and stops a downlink sending from it.
+ *  The chunks of the file that were not sent are still wanted, the next pass sends them. */
+static void takePageBuffer() {
+    if (fileDataBusy || downlinkBusy) { flashQueue.flush(); }
+    if (downlinkSending) { downlinkTransfer.stopSending(); }
+}
+
+// summary of a scrubbed science file gathered by unpage(), decoded a few blocks at a time
+static WindowSummary summarizeEncoded(uint8_t *encodedData) {
+    const int SLICE_SAMPLES = 64;
+    uint16_t samples[SLICE_SAMPLES];
+    WindowSummary summary;
+    EncodedSciData::decodeRange(encodedData, BUFFER_MEMSIZE, &summary.timestamp, TIMESTAMP_SIZE);
+    summary.samples = BUFFERSIZE;
+    uint32_t total = 0;
+    for (int first = 0; first < BUFFERSIZE; first += SLICE_SAMPLES) {
+        int count = min(SLICE_SAMPLES, BUFFERSIZE - first);
+        EncodedSciData::decodeRange(encodedData, first * sizeof(uint16_t), samples, count * sizeof(uint16_t));
+        if (first == 0) { summary.minSample = summary.maxSample = samples[0]; }
+        for (int i = 0; i < count; i++) {
+            summary.minSample = min(summary.minSample, samples[i]);
+            summary.maxSample = max(summary.maxSample, samples[i]);
+            total += samples[i];
+        }
+    }
+    summary.meanSample = (uint16_t)((total + BUFFERSIZE / 2) / BUFFERSIZE);
+    return summary;
+}
 
-// SPI 
-// may want to update this to dynamically change the flash module, keeping it simple for now
-static const int CURRENT_FLASH_CHIP = PIN_FLASH1_CS;
+/* openDownlinkTransfer
+ *  opens the transfer of a stored file. A paged science record is sent as the encoded file it
+ *  holds, and the version is taken from the record checksum so it stays the same while the
+ *  file is kept.
+ *  returns false if the file is too large to send */
+static bool openDownlinkTransfer(int fileNum, int recordIdx) {
+    RecordInfo record = recordStore.getRecord(recordIdx);
+    uint32_t fileSize = record.paged ? EncodedSciData::MEMSIZE : min(record.length, (uint32_t)EncodedSciData::MEMSIZE);
+    return downlinkTransfer.open(fileNum, (uint16_t)record.payloadCrc, fileSize);
+}
+
+// builds a product that is not stored (the pass summary, the error map) in pageBuffer, returns its size
+static size_t buildDownlinkProduct(int fileNum) {
+    if (fileNum == DOWNLINK_ERROR_MAP_ID) { return buildErrorMap(pageBuffer); }
+    return downlinkScheduler.buildSummary(pageBuffer);
+}
+
+// prints the file a downlink starts to send
+static void printDownlinkStart(int fileNum, int wanted) {
+    char downlinkFileName[DOWNLINK_NAME_SIZE];
+    downlinkFilename(fileNum, downlinkFileName);
+    Serial.print("Downlinking ");
+    Serial.print(downlinkFileName);
+    Serial.print(", ");
+    Serial.print(wanted);
+    Serial.print(" of ");
+    Serial.print(downlinkTransfer.getChunks(fileNum));
+    Serial.println(" chunk(s):");
+}
+
+/* wantBuiltProduct
+ *  asks for a product built when it is sent. The chunks of one partly sent are sent again, one
+ *  sent in full is built anew, its version and size are only known then. */
+static void wantBuiltProduct(int fileNum) {
+    if (downlinkTransfer.requestUnacked(fileNum) > 0) { return; }
+    downlinkTransfer.close(fileNum);
+    downlinkTransfer.open(fileNum, 0, 0);
+    downlinkTransfer.requestUnacked(fileNum);
+}
+
+// chunks the current downlink event may still send within DOWNLINK_PASS_BYTES, a byte is kept for the delimiter before a file
+static int downlinkBudgetChunks() {
+    if (DOWNLINK_PASS_BYTES <= 0) { return INT_MAX; }
+    long left = DOWNLINK_PASS_BYTES - (long)(getDownlinkStats().wireBytes - downlinkFirstWireBytes);
+    return left > 1 ? (left - 1) / DownlinkFrame::WIRE_MEMSIZE : 0;
+}
+
+/* nextDownlinkFile
+ *  moves the downlink on to the next file of the plan. The pass ends after the last one, or
+ *  once DOWNLINK_PASS_BYTES are spent and the rest waits for the next DOWNLINK_START. Otherwise
+ *  another pass is started for chunks requested during it. */
+static void nextDownlinkFile() {
+    bool budgetSpent = downlinkBudgetChunks() == 0;
+    if (!downlinkEvent.over() && !budgetSpent) {
+        downlinkEvent.invoke();
+        return;
+    }
+    Serial.print("Downlink complete - ");
+    Serial.print(downlinkTransfer.getStats().chunksSent - downlinkFirstChunk);
+    Serial.print(" chunk(s) of ");
+    Serial.print(downlinkFileCount);
+    Serial.print(" file(s) in ");
+    Serial.print(getDownlinkStats().wireBytes - downlinkFirstWireBytes);
+    Serial.print(" bytes, longest loop ");
+    Serial.print(downlinkLoopMicros);
+    Serial.println(" us.");
+    downlinkAll = false;
+    downlinkEvent.stop();
+
+    int waiting = 0;
+    for (int fileNum = 0; fileNum < DOWNLINK_FILE_IDS; fileNum++) { waiting += downlinkTransfer.wantedChunks(fileNum) > 0; }
+    if (waiting == 0) { return; }
+    if (!budgetSpent) {
+        downlinkEvent.invoke();
+        return;
+    }
+    for (int fileNum = 0; fileNum < DOWNLINK_FILE_IDS; fileNum++) { downlinkTransfer.cancel(fileNum); }
+    downlinkScheduler.noteBudgetSpent();
+    Serial.print("Downlink budget of ");
+    Serial.print(DOWNLINK_PASS_BYTES);
+    Serial.print(" bytes spent, ");
+    Serial.print(waiting);
+    Serial.println(" file(s) wait for the next pass.");
+}
+
+/* continueHkHistory
+ *  moves past a housekeeping history block that has no chunks left to send, handleDownlink()
+ *  reads the next one on the next loop iteration. Once every block is sent, or the budget is
+ *  spent and the rest waits for the next pass, the downlink moves on to its next file. */
+static void continueHkHistory() {
+    bool blockDone = downlinkTransfer.wantedChunks(DOWNLINK_HK_HISTORY_ID) == 0;
+    if (blockDone) { nextHkHistoryPiece(); }
+    downlinkHkNext = blockDone && hkHistoryPiecesLeft() > 0 && downlinkBudgetChunks() > 0;
+    if (!downlinkHkNext) { nextDownlinkFile(); }
+}
+
+/* onHkPieceRead
+ *  sends a housekeeping history block read into pageBuffer as a product of its own, a new block
+ *  is a new version. A block that could not be read is skipped. */
+static void onHkPieceRead(void *context, bool status) {
+    (void)context;
+    downlinkBusy = false;
+    if (!status) {
+        downlinkTransfer.cancel(DOWNLINK_HK_HISTORY_ID);
+        continueHkHistory();
+        return;
+    }
+    size_t size = finishHkHistoryPiece(pageBuffer);
+    downlinkTransfer.open(DOWNLINK_HK_HISTORY_ID, (uint16_t)crc32c(pageBuffer, size), size);
+    int wanted = downlinkTransfer.requestUnacked(DOWNLINK_HK_HISTORY_ID);
+    if (wanted > 0) { printDownlinkStart(DOWNLINK_HK_HISTORY_ID, wanted); }
+    if (downlinkTransfer.startSending(DOWNLINK_HK_HISTORY_ID, pageBuffer, downlinkBudgetChunks())) {
+        downlinkSending = true;
+        downlinkHkSending = true;
+        downlinkEvent.pause(); // handleDownlink() moves on once the block is sent
+        return;
+    }
+    continueHkHistory();
+}
+
+// reads the next housekeeping history block asked for into pageBuffer, onHkPieceRead() sends it
+static void downlinkHkPiece() {
+    downlinkBusy = true;
+    int read = readHkHistoryPiece(pageBuffer, onHkPieceRead, nullptr);
+    if (read > 0) {
+        downlinkEvent.pause(); // onHkPieceRead() moves on once the block is read
+        return;
+    }
+    onHkPieceRead(nullptr, read == 0);
+}
 
 /* - - - - - - Module Driver Functions - - - - - - */
 
 /* - - - - - - dataProcessing - - - - - - *
  * Usage:
  *  Reads incoming data from ADC, measures against baseline,
- *  sends to memory.
+ *  sends to memory. The SPI bus is begun once by initSpiBus(), a sample that came due
+ *  during a flash transfer was already read between its chunks.
  * 
  * Inputs:
- *  none
+ *  sampleMicros - set to the micros() the sample was read at (pass-by-reference)
  *  
  * Outputs:
  *  data from the ADC (bin number)
  */
-uint16_t dataProcessing() {
-
-    // begin an SPI connection
-    // TODO: we should probably begin the SPI connection in main to avoid duplicates
-    SPI.begin();  
-    pinMode(PIN_ADC_CS, OUTPUT); // set ADC chip select pin to output
+uint16_t dataProcessing(uint32_t &sampleMicros) {
 
     // access ADC Pin (SPI)
-    uint16_t photodiode16; // 16 bit variable to hold bin number from ADC
-    SPI.beginTransaction(SPISettings(ADC_MAX_SPEED, MSBFIRST, SPI_MODE3)); //SPISettings(maxSpeed,dataOrder,dataMode)
-    digitalWrite(PIN_ADC_CS, LOW);   // set Slave Select pin to low to select chip
-    photodiode16 = SPI.transfer16(0x0000);// transfer data, send 0 to slave, recieve data from ADC
-    digitalWrite(PIN_ADC_CS, HIGH);  // set Slave Select pin to high to de-select chip
-    SPI.endTransaction();
+    uint16_t photodiode16 = spiBus.takeAdcSample(sampleDueMicros, sampleMicros); // bin number from ADC
 
     /* NOTE TO FUTURE TEAMS:
      *      Append ADCS attitude (direction payload is pointing) to the voltage here
@@ -72,6 +288,9 @@ uint16_t dataProcessing() {
      *      However, NS2 did not have enough info about what form the pointing data
      *      for the cubesat would take, so we figured selecting a format would only
      *      lead to more work for future teams trying to retrofit our format
+     * 
+     *      Pointing is now paired with each sample by attitudeFusion.cpp and stored as
+     *      an elevation column in the science file. ADCS only needs to call pushAttitude()
      */
 
     // print the voltage value (for testing)
@@ -103,16 +322,82 @@ uint16_t dataProcessing() {
  */
 void scienceMemoryHandling() {    
     if (dataProcessEvent.checkInvoked()) { // checks event status from timing module
-        uint16_t photodiodeVoltage = dataProcessing();
+        uint32_t sampleMicros = 0;
+        uint16_t photodiodeVoltage = dataProcessing(sampleMicros);
+        setRateCode(rateCode, bufIdx); // record the period that preceded this sample
         updateBuffer(photodiodeVoltage, bufIdx);
 
+        // give the attitude controller the new sample before anything else
+        publishAdcsFeedback(dataBuffer, wrapBufferIdx(bufIdx - 1), sampleMicros);
+
+        // pair the sample with pointing once ADCS reports it
+        queueAttitudeAlignment(sampleMicros, wrapBufferIdx(bufIdx - 1), attitudeColumn);
+
         // determine which mode the payload is in to act on this data properly
         updatePayloadMode(dataBuffer, bufIdx); // from timing module
+
+        // choose when to take the next sample
+        updateSamplingRate(photodiodeVoltage);
+        sampleDueMicros = sampleMicros + ADAPTIVE_PERIODS_MSEC[rateCode] * 1000;
     }
 
+    feedSimulatedAttitude();        // stand-in ADCS, does nothing unless enabled
+    alignAttitude(attitudeColumn);  // pair queued samples with attitude
+
     if (saveBufferEvent.checkInvoked()) {
         saveBuffer();
     }
+
+    // checkpoint the window in progress, after saving so a finished window is not checkpointed again
+    handleWindowCheckpoint(dataBuffer, rateCodeBuffer, attitudeColumn, bufIdx);
+
+    handleBurstCapture(); // save any frozen high rate burst
+}
+
+/* - - - - - - scienceSampleDue - - - - - - *
+ * Usage:
+ *  Tells the SPI bus whether a science sample is due, so it is read between the chunks of a
+ *  flash transfer instead of waiting for the whole transfer. Registered with initSpiBus()
+ *
+ * Inputs:
+ *  dueMicros - set to the micros() the sample came due at (pass-by-reference)
+ *
+ * Outputs:
+ *  whether a sample is due
+ */
+bool scienceSampleDue(uint32_t &dueMicros) {
+    if (scienceMode.getMode() == SAFE_MODE || (int32_t)(micros() - sampleDueMicros) < 0) { return false; }
+    dueMicros = sampleDueMicros;
+    return true;
+}
+
+/* - - - - - - recoverScienceWindow - - - - - - *
+ * Usage:
+ *  Restores the science window interrupted by a reset from its checkpoints.
+ *  The window is either resumed or saved right away as a partial science file,
+ *  samples that were never checkpointed are left as zero with no attitude.
+ *  Call during init(), after recordNewStart()
+ * 
+ * Inputs:
+ *  none
+ *  
+ * Outputs:
+ *  none
+ */
+void recoverScienceWindow() {
+    // samples not restored read as nominal rate with no attitude
+    uint8_t nominalByte = 0;
+    for (int i = 0; i < RATE_CODES_PER_BYTE; i++) { nominalByte |= ADAPTIVE_NOMINAL_RATE_CODE << (2 * i); }
+    memset(rateCodeBuffer, nominalByte, RATE_CODE_MEMSIZE);
+    for (int i = 0; i < BUFFERSIZE; i++) { attitudeColumn[i] = ATTITUDE_INVALID; }
+
+    RecoveredWindow window = recoverWindowCheckpoint(dataBuffer, rateCodeBuffer, attitudeColumn);
+    if (!window.found) { return; }
+
+    bufIdx = window.bufIdx; // continue after the newest recovered sample
+    if (!window.resumed) {
+        saveBuffer(); // seal the partial window
+    }
 }
 
 /* - - - - - - Helper Functions - - - - - - */
@@ -150,92 +435,127 @@ void updateBuffer(uint16_t sample, int &index) {
     }  
 }
 
+/* - - - - - - setRateCode - - - - - - *
+ * Belongs to Science Memory Handling Module
+ *  
+ * Usage:
+ *  stores the 2 bit sampling period code of the dataBuffer element at index
+ * 
+ * Inputs:
+ *  code - rate code, index into ADAPTIVE_PERIODS_MSEC
+ *  index - index of the dataBuffer element the code belongs to
+ *  
+ * Outputs:
+ *  none
+ */
+void setRateCode(uint8_t code, int index) {
+    if (0 <= index && index < BUFFERSIZE) {
+        int byteIdx = index / RATE_CODES_PER_BYTE;
+        int shift = 2 * (index % RATE_CODES_PER_BYTE);
+        rateCodeBuffer[byteIdx] = (rateCodeBuffer[byteIdx] & ~(0b11 << shift)) | ((code & 0b11) << shift);
+    }
+}
+
+/* - - - - - - updateSamplingRate - - - - - - *
+ * Belongs to Data Processing Module
+ *  
+ * Usage:
+ *  feeds the newest sample to the adaptive sampler and changes the sampling period
+ *  of dataProcessEvent when a new rate is selected.
+ *  Returns to the nominal rate when adaptive sampling is disabled.
+ * 
+ * Inputs:
+ *  sample - newest photodiode sample
+ *  
+ * Outputs:
+ *  none
+ */
+void updateSamplingRate(uint16_t sample) {
+    uint8_t newCode = ADAPTIVE_NOMINAL_RATE_CODE;
+
+    if (ADAPTIVE_SAMPLING) {
+        adaptiveSampler.setThresholds(ADAPTIVE_FAST_SLOPE, ADAPTIVE_SLOW_SLOPE, ADAPTIVE_NOISE);
+        newCode = adaptiveSampler.update(sample, ADAPTIVE_PERIODS_MSEC[rateCode]);
+    } else if (rateCode != ADAPTIVE_NOMINAL_RATE_CODE) {
+        adaptiveSampler.reset(); // start fresh next time adaptive sampling is enabled
+    }
+
+    if (newCode != rateCode) {
+        // restart the timer so the new period applies to the very next sample
+        rateCode = newCode;
+        dataProcessEvent.setDuration(ADAPTIVE_PERIODS_MSEC[rateCode]);
+        dataProcessEvent.start();
+    }
+}
+
 /* - - - - - - saveBuffer - - - - - - *
  * Belongs to Science Memory Handling Module
  *  
  * Usage:
- *  saves the buffer array passed in to a file on the flash module in csv format
- *  appends timestamp to the end of the file
+ *  saves the buffer array passed in to the record store on the flash module, keyed by catalog slot
+ *  appends timestamp, the sample rate codes and the aligned attitude column to the end of the file
+ *  The record is written by the flash queue, onScienceSaved() completes the file once it is committed
+ *  When storage is full a stored window is evicted first, chosen by the retention policy
  * 
  * Inputs:
  *  None
  *  
  * Outputs:
- *  file creation status
+ *  whether the file was queued for writing
  */
 bool saveBuffer() {
     
-    // create array to hold data in time ascending order
-    uint16_t timeSortBuffer[BUFFERSIZE];
-    int j = 0; // iterator for sorted array index
-
-    // reorder array so that it is ascending in time
-    for (int i = bufIdx; i < BUFFERSIZE; i++) {
-        timeSortBuffer[j] = dataBuffer[i];
-        j++;
-    } 
-    // loop back to top of array and store remaining values
-    for (int i = 0; i < bufIdx; i++) {
-        timeSortBuffer[j] = dataBuffer[i];
-        j++;
-    }
+    // the window is encoded straight from the ring buffers, oldest sample first
+    ScienceSource window;
+    window.buffer = dataBuffer;
+    window.rateCodes = rateCodeBuffer;
+    window.attitude = attitudeColumn;
+    window.start = bufIdx;
     
     // compute timestamp
     unsigned long timestamp = calcTimestamp(); 
+    window.timestamp = timestamp;
     
-    // Run all the data through EDAC
-    EncodedSciData encodedFileData = EncodedSciData(timeSortBuffer, timestamp); // this one line cost 50+ hours of my life
+    // Run all the data through EDAC, once any earlier file or downlink is done with pageBuffer
+    takePageBuffer();
+    EncodedSciData::encodePages(window, pageBuffer); // this one line cost 50+ hours of my life
+    fileSummary = WindowCache::summarize(dataBuffer, BUFFERSIZE, timestamp); // order does not change the summary
 
-    /* send sorted array to file on flash memory along with timestamp 
-     * see SerialFlash docs for info on these functions
-     * https://github.com/PaulStoffregen/SerialFlash/blob/master/README.md 
+    /* send sorted array to the record store along with timestamp 
+     * a record is only found after a reset if it was written completely
      */
 
-    // check if file exists
-    int fileIdx = 0; // iterator for loop checking file existence
-    bool fileFlag = true; // true until a nonexistent file found
-
-    while (fileFlag) {
-        if (fileIdx < MAXFILES){ // prevent infinite loop
-            filename[FILE_IDX_OFFSET] += 1; // iterate up from zero
-            fileFlag = SerialFlash.exists(filename);
-            fileIdx++;
-        } else if (fileIdx >= MAXFILES) {
-            Serial.print("WARNING: fileIdx reached MAXFILES.");
-            Serial.println("(Science Memory Handling Module - saveBuffer() func)");
-        }
+    // evict a stored window if storage is full, then take a free slot, the record is keyed by its slot
+    if (!retention.makeRoom(downlinkBusy ? downlinkSlot : -1)) {
+        Serial.print("WARNING: storage full and retention policy evicts no window, buffer not saved.");
+        Serial.println("(Science Memory Handling Module - saveBuffer() func)");
+        return false;
     }
+    int slot = fileCatalog.allocate();
+    if (slot < 0) {
+        Serial.print("WARNING: all MAXFILES catalog slots are in use, buffer not saved.");
+        Serial.println("(Science Memory Handling Module - saveBuffer() func)");
+        return false;
+    }
+    char filename[CATALOG_NAME_SIZE];
+    FileCatalog::slotFilename(slot, filename);
 
-	// establish SPI connection to flash chip
-	bool status = true; // track file creation/writing status
-	
-	if (SerialFlash.begin(CURRENT_FLASH_CHIP)) { // SPI to flash module successful
-
-		// create new file (non-erasable, delete file after downlink)
-		status = SerialFlash.create(filename, encodedFileData.MEMSIZE);
-
-		if (status) { Serial.print("Successfully created file: "); }
-        else { Serial.print("Failed to create file: "); }
-        Serial.println(filename);
-
-		// write buffer to this new file
-		SerialFlashFile file;
-		file = SerialFlash.open(filename);
-		status = file.write(encodedFileData.getData(), encodedFileData.MEMSIZE); // write encoded science data to file
-
-        if (status) { Serial.print("Write successful: "); }
-        else { Serial.print("Write failed: "); }
-        Serial.println(filename);
-
-        bufIdx = 0; // reset index to start of array since we have saved the buffer
-
-	} else { // SerialFlash connection failed
+    // record the file before writing it so a reset mid-write can be detected
+    CatalogEntry &entry = fileCatalog.getEntry(slot);
+    entry.size = EncodedSciData::PAGED_MEMSIZE; // whole pages, each with its own checksum
+    entry.timestamp = timestamp;
+    entry.checksum = crc32c(pageBuffer, EncodedSciData::PAGED_MEMSIZE);
+    entry.quality = Retention::quality(fileSummary);
+    fileCatalog.save();
 
-		Serial.println("Failed to establish SerialFlash connection to current flash module (saveBuffer() func)");
-		status = false;
-	}
+    // a record left behind by a lost catalog is replaced by the append
+    bufIdx = 0; // reset index to start of array since we have saved the buffer
+    fileDataBusy = true;
+    bool status = recordStore.submitAppend(RECORD_SCIENCE, slot, pageBuffer, EncodedSciData::PAGED_MEMSIZE,
+                                           onScienceSaved, (void *)(intptr_t)slot, true);
+    if (!status) { onScienceSaved((void *)(intptr_t)slot, false); }
 
-    return status; // return whether or not file was successfully created
+    return status; // return whether or not the file is being written
 }
 
 /* - - - - - - calcTimestamp - - - - - - *
@@ -246,7 +566,8 @@ bool saveBuffer() {
  *  returns relative time be appended to the end of the file   
  *  NOTE: in the file, only the timestamp of the final data point will be 
  *        available. Use GSW and the sampling rate of FSW to backsolve for the 
- *        timestamp of all preceding data points
+ *        timestamp of all preceding data points. Each sample's rate code gives the
+ *        period (ADAPTIVE_PERIODS_MSEC) since the sample before it.
  * 
  * FOR FUTURE TEAMS:
  * this year's time is relative since we do not have a bus clock signal
@@ -279,7 +600,16 @@ unsigned long calcTimestamp() {
 /* - - - - - - downlink - - - - - - *
  *  
  * Usage:
- *  downlinks all files on the flash module
+ *  downlinks the wanted chunks of the science records and burst files on the flash module, one
+ *  file per call in the order downlinkScheduler planned when the pass started. A pass started
+ *  by startDownlink() opens a transfer for every stored file, wants every chunk the ground has
+ *  not acknowledged and sends the summary of the plan first, then the error map if it was asked
+ *  for. Both are built in pageBuffer when they are sent. The housekeeping history blocks asked
+ *  for come next, read one at a time and each sent as a product of its own. A science record still in the
+ *  window cache is sent from RAM. Otherwise it is read by the flash queue, the event is paused
+ *  until onDownlinkRead() has it. handleDownlink() then sends it a piece at a time and moves on
+ *  to the next file. No more is sent once the pass has written DOWNLINK_PASS_BYTES. Files are
+ *  kept until the ground acknowledges all of them (acknowledgeDownlink()).
  * 
  * Inputs:
  *  none
@@ -288,53 +618,263 @@ unsigned long calcTimestamp() {
  *  none
  */
 void downlink() {
-    static char downlinkFileName[] = "scienceFile0.csv";
-    static int downlinkFileCount = 0;
-
-    // reset static variables at start of new event
+    // reset static variables and plan the pass at start of new event
     if (downlinkEvent.first()) {
         downlinkFileCount = 0;
+        downlinkFirstChunk = downlinkTransfer.getStats().chunksSent;
+        downlinkFirstWireBytes = getDownlinkStats().wireBytes;
+        downlinkLoopMicros = 0;
+        for (int fileNum = 0; downlinkAll && fileNum < DOWNLINK_SUMMARY_ID; fileNum++) {
+            int recordIdx = findDownlinkRecord(fileNum);
+            if (recordIdx >= 0 && openDownlinkTransfer(fileNum, recordIdx)) { downlinkTransfer.requestUnacked(fileNum); }
+            else { downlinkTransfer.close(fileNum); }
+        }
+        if (downlinkAll) { downlinkTransfer.requestUnacked(DOWNLINK_ERROR_MAP_ID); } // the rest of one cut short
+        if (downlinkAll && hkHistoryPiecesLeft() > 0) { wantBuiltProduct(DOWNLINK_HK_HISTORY_ID); }
+        downlinkEvent.setMaxIter(max(downlinkScheduler.plan(downlinkAll), 1));
+    }
+    /* downlink a single file, highest score first */
+    int rank = downlinkEvent.iter() - 1;
+    if (rank >= downlinkScheduler.getCount() || downlinkBudgetChunks() == 0) { // nothing planned, or the budget is spent
+        nextDownlinkFile();
+        return;
+    }
+    int fileNum = downlinkScheduler.getProduct(rank).fileId;
+    bool isScienceFile = fileNum < MAXFILES;
+    bool isBuilt = fileNum >= DOWNLINK_SUMMARY_ID;
+    int recordIdx = findDownlinkRecord(fileNum);
+    if (fileNum == DOWNLINK_HK_HISTORY_ID) { // a block at a time, until every one asked for is sent
+        downlinkHkPiece();
+        return;
+    }
+    if (isBuilt) { // built now, a new one is a new version
+        size_t builtSize = buildDownlinkProduct(fileNum);
+        downlinkTransfer.open(fileNum, (uint16_t)crc32c(pageBuffer, builtSize), builtSize);
+        downlinkTransfer.requestUnacked(fileNum);
+    } else if (recordIdx < 0 || !openDownlinkTransfer(fileNum, recordIdx)) { // removed since the pass was planned
+        downlinkTransfer.close(fileNum);
+        nextDownlinkFile();
+        return;
+    }
+    int wanted = downlinkTransfer.wantedChunks(fileNum);
+    if (wanted == 0) { // acknowledged since the pass was planned
+        nextDownlinkFile();
+        return;
     }
 
-    // TODO: make flash chip we are using configurable with a command? Auto balance the load somehow?
-    SerialFlash.begin(CURRENT_FLASH_CHIP); // begin spi connection with flash module 1
+    printDownlinkStart(fileNum, wanted);
+    if (isBuilt) {
+        onDownlinkRead((void *)(intptr_t)fileNum, true);
+        return;
+    }
 
-    /* downlink a single file */
-    downlinkFileName[FILE_IDX_OFFSET] = '0' + (downlinkEvent.iter() - 1); // update file name 
-    if (SerialFlash.exists(filename)) { // check if file exists
-        Serial.print("Downlinking ");
-        Serial.print(downlinkFileName);
-        Serial.println(":");
+    memset(pageBuffer, 0, sizeof(pageBuffer));
+    RecordInfo &record = recordStore.getRecord(recordIdx);
+    uint32_t fileSize = min(record.length, (uint32_t)EncodedSciData::PAGED_MEMSIZE);
+    const uint8_t *cached = isScienceFile ? windowCache.get(fileNum, record.seq) : nullptr;
+    if (cached != nullptr) {
+        memcpy(pageBuffer, cached, fileSize);
+        onDownlinkRead((void *)(intptr_t)fileNum, true);
+        return;
+    }
+    downlinkBusy = true;
+    downlinkSlot = fileNum;
+    downlinkReadMicros = micros();
+    if (recordStore.submitRead(recordIdx, pageBuffer, 0, fileSize, onDownlinkRead, (void *)(intptr_t)fileNum)) {
+        downlinkEvent.pause(); // onDownlinkRead() moves on once the file is read
+        return;
+    }
+    onDownlinkRead((void *)(intptr_t)fileNum, false);
+}
 
+/* - - - - - - handleDownlink - - - - - - *
+ *  
+ * Usage:
+ *  Runs the downlink, call once per loop iteration in every mode. The file read by downlink()
+ *  is sent by pump(), no more than DOWNLINK_LOOP_BYTES bytes or DOWNLINK_LOOP_BUDGET_MICROS
+ *  each call and only as much as the serial transmit buffer has room for, so the loop never
+ *  waits on the link. Nothing is done within DOWNLINK_SAMPLE_GUARD_MSEC of the next sample.
+ *  The longest loop iteration of a downlink event is reported when it ends.
+ * 
+ * Inputs:
+ *  none
+ *  
+ * Outputs:
+ *  none
+ */
+void handleDownlink() {
+    static uint32_t lastMicros = micros();
+    uint32_t nowMicros = micros();
+    if ((downlinkEvent.iter() > 0 || downlinkSending) && nowMicros - lastMicros > downlinkLoopMicros) {
+        downlinkLoopMicros = nowMicros - lastMicros;
+    }
+    lastMicros = nowMicros;
 
-        // read data from file into downlink buffer
-        SerialFlashFile file;
-        file = SerialFlash.open(downlinkFileName);
-        if (file) {
-            char downlinkBuffer[EncodedSciData::MEMSIZE];
-            file.read(downlinkBuffer, EncodedSciData::MEMSIZE);
-            Serial.println(downlinkBuffer);
-            Serial.println(); // skip a line between files
-            downlinkFileCount++;
+    // leave the loop free for a sample that is about to be taken
+    if (scienceMode.getMode() != SAFE_MODE && dataProcessEvent.remaining() < DOWNLINK_SAMPLE_GUARD_MSEC) { return; }
+
+    if (downlinkSending) {
+        downlinkTransfer.pump(DOWNLINK_LOOP_BYTES, DOWNLINK_LOOP_BUDGET_MICROS);
+        if (downlinkTransfer.isSending()) { return; }
+        downlinkSending = false;
+        downlinkFileCount++;
+        if (downlinkHkSending) {
+            downlinkHkSending = false;
+            continueHkHistory();
+            return;
         }
-        // remove file
-        // this allows a file of the same name to overwrite this data in the future
-        SerialFlash.remove(downlinkFileName);
+        nextDownlinkFile();
+        return;
+    }
+    if (downlinkHkNext && !downlinkBusy && !fileDataBusy) { // one housekeeping history block each loop iteration
+        downlinkHkNext = false;
+        downlinkHkPiece();
+        return;
     }
+    if (!downlinkBusy && !fileDataBusy && downlinkEvent.checkInvoked()) { // downlink files, waits for pageBuffer to be free
+        downlink();
+    }
+}
 
-    // print report at end of event
-    if (downlinkEvent.over()) { 
-        Serial.print("Downlink complete - ");
-        Serial.print(downlinkFileCount);
-        Serial.println(" file(s).");
+/* - - - - - - startDownlink - - - - - - *
+ *  
+ * Usage:
+ *  starts a downlink pass, the summary and then every chunk the ground has not acknowledged, highest
+ *  scored file first
+ * 
+ * Inputs:
+ *  none
+ *  
+ * Outputs:
+ *  none
+ */
+void startDownlink() {
+    downlinkAll = true;
+    downlinkEvent.stop();
+    downlinkEvent.invoke();
+}
+
+/* - - - - - - requestDownlink - - - - - - *
+ *  
+ * Usage:
+ *  sends chunks first to last of one file, whether or not they were acknowledged. The request
+ *  is sent by the pass in progress, or by another one once it is over.
+ * 
+ * Inputs:
+ *  fileNum - catalog slot of a science file, MAXFILES + index of a burst file
+ *  first - first chunk
+ *  last - last chunk, clamped to the end of the file
+ *  
+ * Outputs:
+ *  number of chunks of the file waiting to be sent, -1 if there is no such file
+ */
+int requestDownlink(long fileNum, long first, long last) {
+    if (fileNum < 0 || fileNum >= DOWNLINK_FILE_IDS) { return -1; }
+    int recordIdx = findDownlinkRecord(fileNum);
+    if (recordIdx < 0 || !openDownlinkTransfer(fileNum, recordIdx)) { return -1; }
+    int wanted = downlinkTransfer.request(fileNum, first, last);
+    if (downlinkEvent.iter() == 0) { // no pass in progress
+        downlinkAll = false;
+        downlinkEvent.invoke();
+    }
+    return wanted;
+}
+
+/* - - - - - - requestErrorMap - - - - - - *
+ *  
+ * Usage:
+ *  asks for the flash sector error map (see buildErrorMap()) to be downlinked in frames. It is
+ *  built when it is sent, by the pass in progress or by another one once it is over.
+ * 
+ * Inputs:
+ *  none
+ *  
+ * Outputs:
+ *  none
+ */
+void requestErrorMap() {
+    wantBuiltProduct(DOWNLINK_ERROR_MAP_ID);
+    if (downlinkEvent.iter() == 0) { // no pass in progress
+        downlinkAll = false;
+        downlinkEvent.invoke();
+    }
+}
+
+/* - - - - - - requestHkHistory - - - - - - *
+ *  
+ * Usage:
+ *  asks for the housekeeping history of a run within a time range to be downlinked, each block
+ *  as a product of its own (see selectHkHistory()). A selection still being sent is replaced.
+ *  The blocks are sent by the pass in progress, or by another one once it is over.
+ * 
+ * Inputs:
+ *  startCount - run to send, payloadData.startCount of it, 0 for the current run
+ *  fromSec - seconds after the run started, first sample to send
+ *  toSec - seconds after the run started, last sample to send
+ *  
+ * Outputs:
+ *  number of blocks that will be downlinked
+ */
+int requestHkHistory(long startCount, long fromSec, long toSec) {
+    if (downlinkBusy) { flashQueue.flush(); } // a block of the last selection may be being read
+    if (downlinkHkSending) { // the block being sent is the last of its selection
+        downlinkTransfer.stopSending();
+        downlinkHkSending = false;
     }
+    int blocks = selectHkHistory(startCount, fromSec, toSec);
+    if (blocks == 0) { return 0; }
+    wantBuiltProduct(DOWNLINK_HK_HISTORY_ID);
+    if (downlinkEvent.iter() == 0) { // no pass in progress
+        downlinkAll = false;
+        downlinkEvent.invoke();
+    }
+    return blocks;
+}
+
+/* - - - - - - acknowledgeDownlink - - - - - - *
+ *  
+ * Usage:
+ *  marks the chunks of a file the ground received, the file is deleted once all of them are
+ * 
+ * Inputs:
+ *  fileNum - file ID from the frames of the file
+ *  version - version from the frames of the file, 0 to 65535
+ *  base - first chunk the bitmap covers
+ *  bitmap - bit i set if chunk base + i was received, DOWNLINK_ACK_CHUNKS bits
+ *  
+ * Outputs:
+ *  ACK_REJECTED if the file is not stored or is another version, ACK_PARTIAL or ACK_COMPLETE
+ */
+AckResult acknowledgeDownlink(long fileNum, long version, long base, long bitmap) {
+    if (fileNum < 0 || fileNum >= DOWNLINK_FILE_IDS || version < 0 || version > UINT16_MAX) { return ACK_REJECTED; }
+    if (fileNum >= DOWNLINK_SUMMARY_ID) { // built, nothing stored, a new one is built when asked for
+        AckResult result = downlinkTransfer.acknowledge(fileNum, version, base, (uint32_t)bitmap);
+        if (result == ACK_COMPLETE) { downlinkTransfer.close(fileNum); }
+        return result;
+    }
+    int recordIdx = findDownlinkRecord(fileNum);
+    if (recordIdx < 0 || !openDownlinkTransfer(fileNum, recordIdx)) { downlinkTransfer.close(fileNum); } // acknowledge() rejects it
+    AckResult result = downlinkTransfer.acknowledge(fileNum, version, base, (uint32_t)bitmap);
+    if (result != ACK_COMPLETE) { return result; }
+
+    // the ground has all of it, remove the record, its sector is erased in the background once nothing live is left in it
+    if (downlinkBusy && downlinkSlot == fileNum) { flashQueue.flush(); } // being read for a resend
+    recordIdx = findDownlinkRecord(fileNum);
+    if (recordIdx >= 0) { recordStore.remove(recordIdx); }
+    downlinkTransfer.close(fileNum);
+    if (fileNum < MAXFILES) {
+        windowCache.invalidate(fileNum);
+        fileCatalog.release(fileNum);
+        fileCatalog.save();
+    }
+    return result;
 }
 
 /* - - - - - - scrubFlash - - - - - - *
  *  
  * Usage:
- *  Scrubs all files in flash memory.
- *  This function should only be called when scrubEvent is invoked
+ *  Takes one step of the flash scrub (see scrubber.cpp), called by handleScrub() within its
+ *  budget. Corrections are written by the step itself, in place or as shadow pages
  * 
  * Inputs:
  *  None
@@ -342,57 +882,170 @@ void downlink() {
  *  None
  */
 void scrubFlash() {
-    // local static variables are only initialized once
-    static char scrubFilename[] = "scienceFile0.csv"; 
-    static ScrubReport totalScrubInfo;
+    ScrubStatus status = scrubber.step();
 
-    EncodedSciData correctedFileData;
-    ScrubReport scrubInfo;
-    
-    // reset static variables at start of new event
-    if (scrubEvent.first()) {
-        totalScrubInfo.numErrors = 0;
-        totalScrubInfo.corrected = 0;
-        totalScrubInfo.uncorrected = 0;
+    // save the errors found in each sector and print report at end of scrub
+    if (status == SCRUB_DONE) { 
+        recordStore.saveErrorMap();
+        printScrubReport();
     }
-    
-    /* scrub a single file */
-    scrubFilename[FILE_IDX_OFFSET] = '0' + (scrubEvent.iter() - 1); // update file name
-    if (SerialFlash.exists(scrubFilename)) { // check if file exists
-        // read data from file and scrub it
-        SerialFlashFile file;
-        file = SerialFlash.open(scrubFilename);
-        if (file) {
-            uint8_t fileContents[EncodedSciData::MEMSIZE];
-            file.read(fileContents, EncodedSciData::MEMSIZE);
-            correctedFileData.fill(fileContents);
-            scrubInfo = correctedFileData.scrub(); // scrub it
-
-            // update total scrub info
-            totalScrubInfo.corrected += scrubInfo.corrected;
-            totalScrubInfo.numErrors += scrubInfo.numErrors;
-            totalScrubInfo.uncorrected += scrubInfo.uncorrected;
+}
+
+/* - - - - - - quicklook - - - - - - *
+ *  
+ * Usage:
+ *  prints the timestamp, sample count and the lowest, highest and mean sample of the newest
+ *  science file. A file still in the window cache is summarized from RAM, otherwise it is
+ *  read from flash and decoded
+ * 
+ * Inputs:
+ *  None
+ * Outputs:
+ *  whether a file was summarized
+ */
+bool quicklook() {
+    // newest file, by record seq
+    int recordIdx = -1;
+    int slot = -1;
+    for (int i = 0; i < MAXFILES; i++) {
+        int idx = fileCatalog.isValid(i) ? recordStore.find(RECORD_SCIENCE, i) : -1;
+        if (idx >= 0 && (recordIdx < 0 || recordStore.getRecord(idx).seq > recordStore.getRecord(recordIdx).seq)) {
+            recordIdx = idx;
+            slot = i;
         }
-        
-        // replace corrupted file with corrected file
-        if (scrubInfo.numErrors > 0) {
-            SerialFlash.remove(scrubFilename); // remove corrupted file
-            
-            // create new file and write corrected data
-            bool status = SerialFlash.create(scrubFilename, EncodedSciData::MEMSIZE);
-            file = SerialFlash.open(scrubFilename);
-            status = file.write(correctedFileData.getData(), EncodedSciData::MEMSIZE); // write encoded science data to file
+    }
+    if (recordIdx < 0) {
+        Serial.println("Quicklook: no science files stored.");
+        return false;
+    }
+
+    RecordInfo &info = recordStore.getRecord(recordIdx);
+    WindowSummary summary;
+    bool cached = windowCache.getSummary(slot, info.seq, summary);
+    if (!cached) {
+        takePageBuffer();
+        uint32_t length = min(info.length, (uint32_t)EncodedSciData::PAGED_MEMSIZE);
+        uint32_t startMicros = micros();
+        if (!recordStore.read(recordIdx, pageBuffer, 0, length)) {
+            Serial.println("Quicklook: science file could not be read.");
+            return false;
         }
+        windowCache.noteFlashRead(length, micros() - startMicros);
+
+        // correct the pages that failed their checksum, every page of a packed record
+        uint8_t badPages[EncodedSciData::BAD_PAGE_MEMSIZE];
+        memset(badPages, 0xFF, sizeof(badPages));
+        if (info.paged) { EncodedSciData::unpage(pageBuffer, badPages); }
+        EncodedSciData::scrubPages(pageBuffer, badPages);
+        summary = summarizeEncoded(pageBuffer);
     }
 
-    // print report at end of event
-    if (scrubEvent.over()) { 
-        Serial.print("Scrub complete - found errors in ");
-        Serial.print(totalScrubInfo.numErrors);
-        Serial.print(" block(s), ");
-        Serial.print(totalScrubInfo.corrected);
-        Serial.print(" corrected, ");
-        Serial.print(totalScrubInfo.uncorrected);
-        Serial.println(" cleared.");
+    char filename[CATALOG_NAME_SIZE];
+    FileCatalog::slotFilename(slot, filename);
+    Serial.print("Quicklook ");
+    Serial.print(filename);
+    Serial.print(cached ? " (cached): " : " (from flash): ");
+    Serial.print(summary.samples);
+    Serial.print(" samples to ");
+    Serial.print(summary.timestamp);
+    Serial.print(" ms, min ");
+    Serial.print(summary.minSample);
+    Serial.print(", max ");
+    Serial.print(summary.maxSample);
+    Serial.print(", mean ");
+    Serial.println(summary.meanSample);
+    return true;
+}
+
+/* - - - - - - Flash Queue Callbacks - - - - - - */
+
+/* - - - - - - onScienceSaved - - - - - - *
+ * Belongs to Science Memory Handling Module
+ *  
+ * Usage:
+ *  completes the science file written by saveBuffer() once its record is committed or has failed,
+ *  and keeps a committed file in the window cache
+ * 
+ * Inputs:
+ *  context - catalog slot of the file
+ *  status - whether the record was written
+ *  
+ * Outputs:
+ *  none
+ */
+void onScienceSaved(void *context, bool status) {
+    int slot = (int)(intptr_t)context;
+    char filename[CATALOG_NAME_SIZE];
+    FileCatalog::slotFilename(slot, filename);
+    fileDataBusy = false;
+    blackBox.log(BB_SCIENCE_SAVED, 2, slot, status);
+
+    // kept in RAM as written, ground often asks for it next
+    int recordIdx = status ? recordStore.find(RECORD_SCIENCE, slot) : -1;
+    if (recordIdx >= 0) { windowCache.put(slot, recordStore.getRecord(recordIdx).seq, pageBuffer, fileSummary); }
+
+    if (status) { Serial.print("Write successful: "); }
+    else { Serial.print("Write failed: "); }
+    Serial.println(filename);
+
+    if (status) { endWindowCheckpoint(); } // window is safe, checkpoints are no longer needed
+
+    // file is complete, or give the slot back
+    if (status) { fileCatalog.setState(slot, FILE_VALID); }
+    else { fileCatalog.release(slot); }
+    fileCatalog.save();
+}
+
+/* - - - - - - onDownlinkRead - - - - - - *
+ *  
+ * Usage:
+ *  hands a record read for downlink() to handleDownlink() to send its wanted chunks, or resumes
+ *  the downlink with the next file if it could not be read. The pages of a paged science record
+ *  are checked against their checksums, only the blocks in pages that fail are decoded and
+ *  corrected before the file is sent. The record is kept until the ground acknowledges it.
+ *  The pass summary and the error map are built in place by downlink() and handed over the same way.
+ * 
+ * Inputs:
+ *  context - file ID, the catalog slot of a science file, MAXFILES + index of a burst file, or a built product
+ *  status - whether the record was read
+ *  
+ * Outputs:
+ *  none
+ */
+void onDownlinkRead(void *context, bool status) {
+    int fileNum = (int)(intptr_t)context;
+    bool isScienceFile = fileNum < MAXFILES;
+    bool isBuilt = fileNum >= DOWNLINK_SUMMARY_ID; // built in pageBuffer, there is no record
+    int recordIdx = findDownlinkRecord(fileNum);
+    if (downlinkBusy && status && isScienceFile && recordIdx >= 0) { // read from flash, timed for the cache statistics
+        windowCache.noteFlashRead(recordStore.getRecord(recordIdx).length, micros() - downlinkReadMicros);
+    }
+    downlinkBusy = false;
+    if (status && recordIdx >= 0 && recordStore.getRecord(recordIdx).paged) {
+        // back to the encoded file, the ground sees the same format either way
+        uint8_t badPages[EncodedSciData::BAD_PAGE_MEMSIZE];
+        if (EncodedSciData::unpage(pageBuffer, badPages) > 0) {
+            ScrubReport scrubInfo = EncodedSciData::scrubPages(pageBuffer, badPages);
+            recordStore.noteErrors(recordIdx, scrubInfo.badPages);
+            Serial.print("Downlink: ");
+            Serial.print(scrubInfo.badPages);
+            Serial.print(" page(s) failed checksum, ");
+            Serial.print(scrubInfo.corrected);
+            Serial.print(" block(s) corrected, ");
+            Serial.print(scrubInfo.uncorrected);
+            Serial.println(" cleared.");
+        }
     }
+    if (status && (isBuilt || recordIdx >= 0) && downlinkTransfer.startSending(fileNum, pageBuffer, downlinkBudgetChunks())) {
+        downlinkSending = true;
+        downlinkEvent.pause(); // handleDownlink() moves on once the file is sent
+        return;
+    }
+    if (!status || (!isBuilt && recordIdx < 0)) { downlinkTransfer.cancel(fileNum); } // unreadable, the next pass tries again
+    if (isScienceFile && recordIdx < 0 && fileCatalog.getEntry(fileNum).state != FILE_FREE) {
+        fileCatalog.release(fileNum); // record is gone, the slot is free
+        fileCatalog.save();
+    }
+
+    nextDownlinkFile(); // next file, or ends the pass if this was the last
 }
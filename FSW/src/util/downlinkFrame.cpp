@@ -0,0 +1,253 @@
+/* downlinkFrame.cpp frames downlinked files for the serial link
+ * Usage:
+ *  Files are downlinked as DownlinkFrames of DOWNLINK_CHUNK_SIZE bytes each, the last one zero
+ *  padded, written to a LinkPort by writeFrame(), or by a FrameWriter a piece at a time as the
+ *  link has room. Encoded data is binary, so frames are COBS
+ *  encoded (Consistent Overhead Byte Stuffing): the only zero bytes on the wire end a frame.
+ *  writeFrameDelimiter() is written before a file so diagnostic text printed before it cannot
+ *  run into the first frame. The ground receiver (GSW/FrameReceiver) decodes each frame, checks
+ *  its CRC and puts the chunk back in its place, a lost or corrupted frame costs one chunk
+ *  instead of the rest of the file. Which chunks are sent is up to downlinkTransfer.cpp.
+ *
+ *  Frame layout: type (uint8) | file ID (uint16) | version (uint16) | file size (uint32) |
+ *                chunk (uint16) | length (uint16) | data (DOWNLINK_CHUNK_SIZE) |
+ *                crc32c of everything before (uint32)
+ *  All fields are little endian.
+ *
+ * Modules encompassed:
+ *  Science Memory Handling
+ *
+ * Additional files needed for compilation:
+ *  config.hpp
+ *  downlinkFrame.hpp
+ *  crc.cpp & crc.hpp
+ *  hammingBlock.cpp & hammingBlock.hpp
+ */
+
+/* - - - - - - Includes - - - - - - */
+// All libraries are put in downlinkFrame.hpp
+// NS2 headers
+#include "../headers/downlinkFrame.hpp"
+#include "../headers/crc.hpp"
+#include "../headers/hammingBlock.hpp"
+
+// runs of 254 bytes without a zero would cost another COBS code byte
+static_assert(DownlinkFrame::RAW_MEMSIZE < 254, "DownlinkFrame must stay under 254 bytes before encoding");
+
+/* Module Variable Definitions */
+static DownlinkStats linkStats;
+
+/* - - - - - - Class Definitions - - - - - - */
+
+/* - - - - - - SimLinkPort - - - - - - */
+// keeps what fits in the buffer, the rest is lost as it would be on a dead link
+size_t SimLinkPort::write(const uint8_t *bytes, size_t length) {
+    size_t kept = min(length, m_capacity - m_length);
+    memcpy(m_buffer + m_length, bytes, kept);
+    m_length += kept;
+    return kept;
+}
+
+/* - - - - - - DownlinkFrame - - - - - - */
+
+/* fill
+ *  sets the frame to chunk chunkIdx of file, padding the rest of data */
+void DownlinkFrame::fill(uint16_t id, uint16_t fileVersion, const void *file, uint32_t size, uint16_t chunkIdx) {
+    uint32_t offset = (uint32_t)chunkIdx * DOWNLINK_CHUNK_SIZE;
+    type = FRAME_FILE_DATA;
+    fileId = id;
+    version = fileVersion;
+    fileSize = size;
+    chunk = chunkIdx;
+    length = offset < size ? min(size - offset, (uint32_t)DOWNLINK_CHUNK_SIZE) : 0;
+    memcpy(data, (const uint8_t *)file + offset, length);
+    memset(data + length, 0, DOWNLINK_CHUNK_SIZE - length);
+}
+
+/* encode
+ *  writes the frame as it goes on the wire, wire must hold WIRE_MEMSIZE bytes.
+ *  returns WIRE_MEMSIZE */
+size_t DownlinkFrame::encode(uint8_t *wire) {
+    uint8_t raw[RAW_MEMSIZE];
+    size_t bytesCopied = 0;
+    memAppend(raw, &type, sizeof(type), &bytesCopied);
+    memAppend(raw, &fileId, sizeof(fileId), &bytesCopied);
+    memAppend(raw, &version, sizeof(version), &bytesCopied);
+    memAppend(raw, &fileSize, sizeof(fileSize), &bytesCopied);
+    memAppend(raw, &chunk, sizeof(chunk), &bytesCopied);
+    memAppend(raw, &length, sizeof(length), &bytesCopied);
+    memAppend(raw, data, DOWNLINK_CHUNK_SIZE, &bytesCopied);
+    uint32_t crc = crc32c(raw, bytesCopied);
+    memAppend(raw, &crc, sizeof(crc), &bytesCopied);
+
+    size_t encoded = cobsEncode(raw, bytesCopied, wire);
+    wire[encoded++] = 0;
+    return encoded;
+}
+
+/* decode
+ *  reads a frame from wireLength bytes received before a zero byte, the delimiter left off.
+ *  returns false, leaving the frame unusable, if they are not a whole frame that passes its CRC */
+bool DownlinkFrame::decode(const uint8_t *wire, size_t wireLength) {
+    uint8_t raw[RAW_MEMSIZE + 1];
+    if (wireLength != WIRE_MEMSIZE - 1 || cobsDecode(wire, wireLength, raw) != RAW_MEMSIZE) { return false; }
+
+    size_t bytesCopied = 0;
+    uint32_t crc;
+    memExtract(raw, &type, sizeof(type), &bytesCopied);
+    memExtract(raw, &fileId, sizeof(fileId), &bytesCopied);
+    memExtract(raw, &version, sizeof(version), &bytesCopied);
+    memExtract(raw, &fileSize, sizeof(fileSize), &bytesCopied);
+    memExtract(raw, &chunk, sizeof(chunk), &bytesCopied);
+    memExtract(raw, &length, sizeof(length), &bytesCopied);
+    memExtract(raw, data, DOWNLINK_CHUNK_SIZE, &bytesCopied);
+    size_t crcOffset = bytesCopied;
+    memExtract(raw, &crc, sizeof(crc), &bytesCopied);
+    return crc == crc32c(raw, crcOffset) && type == FRAME_FILE_DATA && length <= DOWNLINK_CHUNK_SIZE;
+}
+
+/* - - - - - - Helper Functions - - - - - - */
+
+/* - - - - - - cobsEncode - - - - - - *
+ * Usage:
+ *  COBS encodes length bytes, the result has no zero bytes. Each zero is replaced by the
+ *  distance to the next, a code byte leads every run of up to 254 bytes.
+ *
+ * Inputs:
+ *  src - bytes to encode
+ *  length - number of bytes
+ *  dst - encoded bytes, must hold length + length / 254 + 1 bytes
+ *
+ * Outputs:
+ *  number of encoded bytes
+ */
+size_t cobsEncode(const uint8_t *src, size_t length, uint8_t *dst) {
+    size_t codeIdx = 0; // where the code byte of the current run goes
+    size_t out = 1;
+    uint8_t code = 1;
+    for (size_t i = 0; i < length; i++) {
+        if (src[i] != 0) {
+            dst[out++] = src[i];
+            code++;
+        }
+        if (src[i] == 0 || code == 0xFF) { // run ends at a zero or at its longest
+            dst[codeIdx] = code;
+            codeIdx = out++;
+            code = 1;
+        }
+    }
+    dst[codeIdx] = code;
+    return out;
+}
+
+/* - - - - - - cobsDecode - - - - - - *
+ * Usage:
+ *  Decodes COBS encoded bytes received between two zero bytes
+ *
+ * Inputs:
+ *  src - encoded bytes, without the delimiter
+ *  length - number of encoded bytes
+ *  dst - decoded bytes, must hold length bytes
+ *
+ * Outputs:
+ *  number of decoded bytes, 0 if src is not COBS encoded
+ */
+size_t cobsDecode(const uint8_t *src, size_t length, uint8_t *dst) {
+    size_t out = 0;
+    for (size_t i = 0; i < length; ) {
+        uint8_t code = src[i++];
+        if (code == 0 || i + code - 1 > length) { return 0; } // zero inside a frame or run past its end
+        for (int j = 1; j < code; j++) {
+            if (src[i] == 0) { return 0; }
+            dst[out++] = src[i++];
+        }
+        if (code != 0xFF && i < length) { dst[out++] = 0; }
+    }
+    return out;
+}
+
+/* - - - - - - FrameWriter - - - - - - */
+
+/* load
+ *  encodes the next frame to write, the last one must be written in full. delimit writes a
+ *  zero byte before it, as writeFrameDelimiter() does */
+void FrameWriter::load(DownlinkFrame &frame, bool delimit) {
+    m_length = 0;
+    if (delimit) { m_wire[m_length++] = 0; }
+    m_length += frame.encode(m_wire + m_length);
+    m_written = 0;
+    linkStats.frames++;
+    linkStats.payloadBytes += frame.length;
+}
+
+/* write
+ *  writes up to maxBytes more of the frame, no more than the link has room for.
+ *  returns bytes written */
+size_t FrameWriter::write(size_t maxBytes) {
+    size_t length = min(min(maxBytes, m_length - m_written), m_port->availableForWrite());
+    if (length == 0) { return 0; }
+    length = m_port->write(m_wire + m_written, length);
+    m_written += length;
+    linkStats.wireBytes += length;
+    return length;
+}
+
+/* - - - - - - Module Driver Functions - - - - - - */
+
+// chunks a file of size bytes is sent in, a file of no bytes is sent as one empty chunk so the ground still sees it
+uint16_t downlinkChunks(uint32_t size) {
+    return size == 0 ? 1 : (size + DOWNLINK_CHUNK_SIZE - 1) / DOWNLINK_CHUNK_SIZE;
+}
+
+/* - - - - - - writeFrame - - - - - - *
+ * Usage:
+ *  Encodes a frame and writes it to the link
+ *
+ * Inputs:
+ *  port - link to write to
+ *  frame - frame to send
+ *
+ * Outputs:
+ *  bytes written
+ */
+size_t writeFrame(LinkPort *port, DownlinkFrame &frame) {
+    static uint8_t wire[DownlinkFrame::WIRE_MEMSIZE];
+    size_t written = port->write(wire, frame.encode(wire));
+    linkStats.frames++;
+    linkStats.payloadBytes += frame.length;
+    linkStats.wireBytes += written;
+    return written;
+}
+
+// ends anything written before, so the next frame starts clean
+void writeFrameDelimiter(LinkPort *port) {
+    uint8_t delimiter = 0;
+    linkStats.wireBytes += port->write(&delimiter, 1);
+}
+
+// frames sent since startup
+DownlinkStats getDownlinkStats() {
+    return linkStats;
+}
+
+/* - - - - - - printDownlinkInfo - - - - - - *
+ * Usage:
+ *  Prints the frames downlinked and the share of the link that carried file data
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  none
+ */
+void printDownlinkInfo() {
+    Serial.print("Downlink Frames: ");
+    Serial.print(linkStats.frames);
+    Serial.print(" frame(s), ");
+    Serial.print(linkStats.payloadBytes);
+    Serial.print(" of ");
+    Serial.print(linkStats.wireBytes);
+    Serial.print(" bytes sent were file data (");
+    Serial.print(linkStats.wireBytes > 0 ? 100.0F * linkStats.payloadBytes / linkStats.wireBytes : 0.0F);
+    Serial.println("%)");
+}
@@ -0,0 +1,199 @@
+/* downlinkScheduler.cpp decides the order stored products are downlinked in
+ * Usage:
+ *  When a downlink pass starts, downlink() opens a transfer for every stored product and calls
+ *  downlinkScheduler.plan(), then sends one product of the plan at a time, highest score first:
+ *   summary      - always first on a pass started by DOWNLINK_START
+ *   burst file   - DOWNLINK_BURST_SCORE
+ *   science file - DOWNLINK_QUALITY_WEIGHT per quality point
+ *  less DOWNLINK_AGE_WEIGHT per product stored after it, plus DOWNLINK_PARTIAL_WEIGHT times the
+ *  share of its chunks the ground already acknowledged, so a product cut off by the end of the
+ *  last contact is finished before new ones are started. Quality is the quicklook sample range
+ *  saved in the catalog (see retention.cpp). Once DOWNLINK_PASS_BYTES are written the pass ends
+ *  and the rest waits for the next one, the products the ground values most are sent first.
+ *
+ *  Products the ground asked for by command and built when they are sent (the flash error map
+ *  under DOWNLINK_ERROR_MAP_ID, the housekeeping history under DOWNLINK_HK_HISTORY_ID) go right
+ *  after the summary, they are not scored or listed.
+ *
+ *  The summary is downlinked as a file of its own under DOWNLINK_SUMMARY_ID, one entry per
+ *  product in the order the pass sends them, so the ground sees what is stored even if the
+ *  pass ends early and can ask for any product with DOWNLINK_FILE:
+ *   file ID (uint16) | version (uint16) | size (uint32) | timestamp (uint32, 0 for a burst file) |
+ *   chunks acknowledged (uint16) | quality (uint8)
+ *  All fields are little endian.
+ *
+ * Modules encompassed:
+ *  Science Memory Handling
+ *
+ * Additional files needed for compilation:
+ *  config.hpp
+ *  downlinkScheduler.hpp
+ *  downlinkTransfer.cpp & downlinkTransfer.hpp
+ *  fileCatalog.cpp & fileCatalog.hpp
+ *  recordStore.cpp & recordStore.hpp
+ *  hammingBlock.cpp & hammingBlock.hpp
+ */
+
+/* - - - - - - Includes - - - - - - */
+// All libraries are put in downlinkScheduler.hpp
+// NS2 headers
+#include "../headers/downlinkScheduler.hpp"
+#include "../headers/downlinkTransfer.hpp"
+#include "../headers/fileCatalog.hpp"
+#include "../headers/recordStore.hpp"
+#include "../headers/hammingBlock.hpp"
+
+static_assert(DownlinkScheduler::SUMMARY_MEMSIZE <= EncodedSciData::MEMSIZE, "the summary must fit in one downlink transfer");
+
+/* Module Variable Definitions */
+DownlinkScheduler downlinkScheduler;
+
+/* - - - - - - Class Definitions - - - - - - */
+
+/* - - - - - - DownlinkScheduler - - - - - - */
+// constructor
+DownlinkScheduler::DownlinkScheduler() {
+    m_count = 0;
+}
+
+/* plan
+ *  ranks the stored products with chunks wanted, after the summary if withSummary and the
+ *  built products with chunks wanted. Transfers must already be open for them.
+ *  returns the number of products in the plan */
+int DownlinkScheduler::plan(bool withSummary) {
+    static bool stored[DOWNLINK_SUMMARY_ID];
+    static uint32_t seqs[DOWNLINK_SUMMARY_ID]; // record seq of each stored product
+    for (int fileId = 0; fileId < DOWNLINK_SUMMARY_ID; fileId++) {
+        int recordIdx = findDownlinkRecord(fileId);
+        stored[fileId] = recordIdx >= 0;
+        seqs[fileId] = stored[fileId] ? recordStore.getRecord(recordIdx).seq : 0;
+    }
+
+    m_count = 0;
+    if (withSummary) {
+        m_plan[m_count] = DownlinkProduct();
+        m_plan[m_count].fileId = DOWNLINK_SUMMARY_ID;
+        m_count++;
+    }
+    for (int fileId = DOWNLINK_SUMMARY_ID + 1; fileId < DOWNLINK_FILE_IDS; fileId++) { // asked for, sent in ID order
+        if (downlinkTransfer.wantedChunks(fileId) == 0) { continue; }
+        m_plan[m_count] = DownlinkProduct();
+        m_plan[m_count].fileId = fileId;
+        m_count++;
+    }
+    int first = m_count;
+    for (int fileId = 0; fileId < DOWNLINK_SUMMARY_ID; fileId++) {
+        if (!stored[fileId] || downlinkTransfer.wantedChunks(fileId) == 0) { continue; }
+        DownlinkProduct &product = m_plan[m_count++];
+        product = DownlinkProduct();
+        product.fileId = fileId;
+        product.quality = fileId < MAXFILES ? fileCatalog.getEntry(fileId).quality : 0;
+        for (int other = 0; other < DOWNLINK_SUMMARY_ID; other++) {
+            product.newer += stored[other] && seqs[other] > seqs[fileId];
+        }
+        product.chunks = downlinkTransfer.getChunks(fileId);
+        product.acked = downlinkTransfer.ackedChunks(fileId);
+        product.score = score(product);
+    }
+    order(m_plan + first, m_count - first);
+    m_stats.passes++;
+    return m_count;
+}
+
+/* buildSummary
+ *  writes the summary of the products planned after it, SUMMARY_ENTRY_MEMSIZE bytes each in
+ *  the order they are sent. buffer must hold SUMMARY_MEMSIZE bytes.
+ *  returns bytes written, none if nothing else is planned */
+size_t DownlinkScheduler::buildSummary(uint8_t *buffer) {
+    size_t bytesCopied = 0;
+    for (int rank = 0; rank < m_count; rank++) {
+        DownlinkProduct &product = m_plan[rank];
+        if (product.fileId >= DOWNLINK_SUMMARY_ID) { continue; } // not stored
+        uint16_t version = downlinkTransfer.getVersion(product.fileId);
+        uint32_t size = downlinkTransfer.getSize(product.fileId);
+        uint32_t timestamp = product.fileId < MAXFILES ? fileCatalog.getEntry(product.fileId).timestamp : 0;
+        memAppend(buffer, &product.fileId, sizeof(product.fileId), &bytesCopied);
+        memAppend(buffer, &version, sizeof(version), &bytesCopied);
+        memAppend(buffer, &size, sizeof(size), &bytesCopied);
+        memAppend(buffer, &timestamp, sizeof(timestamp), &bytesCopied);
+        memAppend(buffer, &product.acked, sizeof(product.acked), &bytesCopied);
+        memAppend(buffer, &product.quality, sizeof(product.quality), &bytesCopied);
+    }
+    return bytesCopied;
+}
+
+// value of sending a product now, higher is sent first
+int32_t DownlinkScheduler::score(const DownlinkProduct &product) {
+    int32_t value = product.fileId < MAXFILES ? product.quality * DOWNLINK_QUALITY_WEIGHT : DOWNLINK_BURST_SCORE;
+    value -= product.newer * DOWNLINK_AGE_WEIGHT;
+    if (product.chunks > 0) { value += DOWNLINK_PARTIAL_WEIGHT * product.acked / product.chunks; }
+    return value;
+}
+
+// sorts products highest score first, the newest first among equal scores
+void DownlinkScheduler::order(DownlinkProduct *products, int count) {
+    for (int i = 1; i < count; i++) {
+        DownlinkProduct product = products[i];
+        int j = i;
+        for (; j > 0; j--) {
+            DownlinkProduct &before = products[j - 1];
+            if (before.score > product.score || (before.score == product.score && before.newer <= product.newer)) { break; }
+            products[j] = before;
+        }
+        products[j] = product;
+    }
+}
+
+/* - - - - - - Module Driver Functions - - - - - - */
+
+// record of a science file (file ID below MAXFILES) or burst file, -1 if it is not stored
+int findDownlinkRecord(int fileId) {
+    if (fileId < 0 || fileId >= DOWNLINK_SUMMARY_ID) { return -1; }
+    if (fileId < MAXFILES) { return fileCatalog.isValid(fileId) ? recordStore.find(RECORD_SCIENCE, fileId) : -1; }
+    return recordStore.find(RECORD_BURST, fileId - MAXFILES);
+}
+
+/* - - - - - - printDownlinkScheduleInfo - - - - - - *
+ * Usage:
+ *  Prints the scheduling weights, the byte budget of a pass and the newest plan as
+ *  fileId:score pairs, in the order it sends them
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  none
+ */
+void printDownlinkScheduleInfo() {
+    ScheduleStats stats = downlinkScheduler.getStats();
+    Serial.print("Downlink Schedule: weights ");
+    Serial.print(DOWNLINK_QUALITY_WEIGHT);
+    Serial.print(" per quality, ");
+    Serial.print(DOWNLINK_AGE_WEIGHT);
+    Serial.print(" per newer product, ");
+    Serial.print(DOWNLINK_PARTIAL_WEIGHT);
+    Serial.print(" when acknowledged, ");
+    if (DOWNLINK_PASS_BYTES > 0) {
+        Serial.print(DOWNLINK_PASS_BYTES);
+        Serial.print(" bytes per pass, ");
+    } else {
+        Serial.print("no byte budget, ");
+    }
+    Serial.print(stats.passes);
+    Serial.print(" pass(es) planned, ");
+    Serial.print(stats.budgetStops);
+    Serial.println(" ended by the budget");
+    if (downlinkScheduler.getCount() == 0) { return; }
+
+    Serial.print("Downlink Plan (fileId:score):");
+    for (int rank = 0; rank < downlinkScheduler.getCount(); rank++) {
+        DownlinkProduct &product = downlinkScheduler.getProduct(rank);
+        Serial.print(" ");
+        Serial.print(product.fileId);
+        Serial.print(":");
+        if (product.fileId == DOWNLINK_SUMMARY_ID) { Serial.print("summary"); }
+        else if (product.fileId > DOWNLINK_SUMMARY_ID) { Serial.print("asked"); }
+        else { Serial.print(product.score); }
+    }
+    Serial.println();
+}
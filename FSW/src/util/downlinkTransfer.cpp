@@ -0,0 +1,231 @@
+/* downlinkTransfer.cpp keeps track of what the ground has received of each downlinked file
+ * Usage:
+ *  downlink() opens a transfer for each stored file with open(), giving the file ID, a version
+ *  that changes when another file is stored under the ID, and the file size. DOWNLINK_START
+ *  asks for every chunk the ground has not acknowledged (requestUnacked()) and DOWNLINK_FILE
+ *  for a range of chunks of one file (request()), only those chunks are sent. startSending()
+ *  picks the file to send and pump() writes its frames a piece at a time, no more than the link
+ *  can take without waiting and within a byte and time budget, so it can be called every loop
+ *  iteration in any mode. sendWanted() sends whatever the link can take at once.
+ *  The ground acknowledges what it received with ACK_DOWNLINK: file ID and version, the first
+ *  chunk and a bitmap of the next DOWNLINK_ACK_CHUNKS chunks (acknowledge()). Chunks lost on
+ *  the link stay unacknowledged and are sent again by the next pass (selective repeat), and a
+ *  file is only deleted once acknowledge() returns ACK_COMPLETE. Transfers are kept in RAM, a
+ *  reset sends unacknowledged files from the start but loses none.
+ *
+ * Modules encompassed:
+ *  Science Memory Handling
+ *
+ * Additional files needed for compilation:
+ *  config.hpp
+ *  downlinkTransfer.hpp
+ *  downlinkFrame.cpp & downlinkFrame.hpp
+ */
+
+/* - - - - - - Includes - - - - - - */
+// All libraries are put in downlinkTransfer.hpp
+// NS2 headers
+#include "../headers/downlinkTransfer.hpp"
+
+/* Module Variable Definitions */
+static SerialLinkPort serialLink;
+DownlinkTransfer downlinkTransfer(&serialLink);
+
+/* - - - - - - Helper Functions - - - - - - */
+
+static bool getBit(const uint8_t *bitmap, int idx) {
+    return (bitmap[idx / 8] >> (idx % 8)) & 1;
+}
+
+static void setBit(uint8_t *bitmap, int idx, bool value) {
+    if (value) { bitmap[idx / 8] |= (1 << (idx % 8)); }
+    else { bitmap[idx / 8] &= ~(1 << (idx % 8)); }
+}
+
+/* - - - - - - Class Definitions - - - - - - */
+
+// constructor
+DownlinkTransfer::DownlinkTransfer(LinkPort *port) : m_writer(port) {
+    memset(m_files, 0, sizeof(m_files));
+    m_sendId = 0;
+    m_sendFile = nullptr;
+    m_sendDelimit = false;
+    m_sendLeft = 0;
+}
+
+/* open
+ *  starts a transfer of the file stored under fileId, or keeps the one in progress if it is
+ *  for the same version and size. Nothing is wanted until it is requested.
+ *  returns false if the file ID or size is out of range */
+bool DownlinkTransfer::open(uint16_t fileId, uint16_t version, uint32_t size) {
+    if (fileId >= DOWNLINK_FILE_IDS || downlinkChunks(size) > MAX_CHUNKS) { return false; }
+    TransferState &state = m_files[fileId];
+    if (state.chunks > 0 && state.version == version && state.size == size) { return true; }
+    memset(&state, 0, sizeof(state));
+    state.version = version;
+    state.size = size;
+    state.chunks = downlinkChunks(size);
+    return true;
+}
+
+// forgets the transfer of a file that was deleted
+void DownlinkTransfer::close(uint16_t fileId) {
+    if (fileId >= DOWNLINK_FILE_IDS) { return; }
+    memset(&m_files[fileId], 0, sizeof(TransferState));
+}
+
+/* requestUnacked
+ *  wants every chunk of the file the ground has not acknowledged.
+ *  returns the number of chunks wanted */
+int DownlinkTransfer::requestUnacked(uint16_t fileId) {
+    if (!isOpen(fileId)) { return 0; }
+    TransferState &state = m_files[fileId];
+    for (int chunk = 0; chunk < state.chunks; chunk++) {
+        if (!getBit(state.acked, chunk)) { setBit(state.wanted, chunk, true); }
+    }
+    return wantedChunks(fileId);
+}
+
+/* request
+ *  wants chunks first to last of the file, acknowledged or not, last is clamped to the end of it.
+ *  returns the number of chunks wanted */
+int DownlinkTransfer::request(uint16_t fileId, long first, long last) {
+    if (!isOpen(fileId)) { return 0; }
+    TransferState &state = m_files[fileId];
+    first = max(first, 0L);
+    last = min(last, (long)state.chunks - 1);
+    for (long chunk = first; chunk <= last; chunk++) { setBit(state.wanted, chunk, true); }
+    return wantedChunks(fileId);
+}
+
+// stops sending the file, for when it cannot be read
+void DownlinkTransfer::cancel(uint16_t fileId) {
+    if (fileId >= DOWNLINK_FILE_IDS) { return; }
+    memset(m_files[fileId].wanted, 0, BITMAP_MEMSIZE);
+}
+
+// number of chunks of the file waiting to be sent
+int DownlinkTransfer::wantedChunks(uint16_t fileId) {
+    if (!isOpen(fileId)) { return 0; }
+    int wanted = 0;
+    for (int chunk = 0; chunk < m_files[fileId].chunks; chunk++) { wanted += getBit(m_files[fileId].wanted, chunk); }
+    return wanted;
+}
+
+/* startSending
+ *  sends the wanted chunks of the file from now on, the file must hold all of it and stay
+ *  unchanged until isSending() is false. A frame already started is finished first. No more
+ *  than maxChunks are sent, the rest stay wanted.
+ *  returns false if no chunk of the file is wanted or none may be sent */
+bool DownlinkTransfer::startSending(uint16_t fileId, const void *file, int maxChunks) {
+    if (wantedChunks(fileId) == 0 || maxChunks <= 0) { return false; }
+    m_sendId = fileId;
+    m_sendFile = (const uint8_t *)file;
+    m_sendDelimit = true;
+    m_sendLeft = maxChunks;
+    return true;
+}
+
+/* pump
+ *  writes frames of the file being sent, stopping once maxBytes are written, budgetMicros have
+ *  passed or the link has no room left. Chunks requested while the file is sent are picked up.
+ *  returns bytes written */
+size_t DownlinkTransfer::pump(size_t maxBytes, unsigned long budgetMicros) {
+    uint32_t startMicros = micros();
+    size_t written = 0;
+    while (written < maxBytes && micros() - startMicros < budgetMicros) {
+        if (m_writer.isIdle() && !loadNextChunk()) { break; }
+        size_t bytes = m_writer.write(maxBytes - written);
+        if (bytes == 0) { break; } // the link is full
+        written += bytes;
+    }
+    return written;
+}
+
+/* sendWanted
+ *  sends the wanted chunks of the file, as far as the link can take them now.
+ *  returns the number of chunks sent */
+int DownlinkTransfer::sendWanted(uint16_t fileId, const void *file) {
+    uint32_t chunksSent = m_stats.chunksSent;
+    if (startSending(fileId, file)) {
+        while (isSending() && pump(SIZE_MAX, ULONG_MAX) > 0) { }
+    }
+    return m_stats.chunksSent - chunksSent;
+}
+
+// loads the lowest wanted chunk of the file being sent into the writer, false if none is left
+bool DownlinkTransfer::loadNextChunk() {
+    if (!isOpen(m_sendId) || m_sendLeft <= 0) { return false; }
+    TransferState &state = m_files[m_sendId];
+    for (int chunk = 0; chunk < state.chunks; chunk++) {
+        if (!getBit(state.wanted, chunk)) { continue; }
+        m_frame.fill(m_sendId, state.version, m_sendFile, state.size, chunk);
+        m_writer.load(m_frame, m_sendDelimit);
+        m_sendDelimit = false;
+        setBit(state.wanted, chunk, false);
+        m_sendLeft--;
+        m_stats.chunksSent++;
+        return true;
+    }
+    return false;
+}
+
+/* acknowledge
+ *  marks the chunks the ground received, bit i of bitmap is chunk base + i. Acknowledged chunks
+ *  are no longer wanted.
+ *  returns ACK_COMPLETE once every chunk of the file is acknowledged */
+AckResult DownlinkTransfer::acknowledge(uint16_t fileId, uint16_t version, long base, uint32_t bitmap) {
+    if (!isOpen(fileId) || m_files[fileId].version != version || base < 0 || base >= m_files[fileId].chunks) {
+        m_stats.acksRejected++;
+        return ACK_REJECTED;
+    }
+    TransferState &state = m_files[fileId];
+    bool wasComplete = state.ackedCount == state.chunks;
+    for (int bit = 0; bit < DOWNLINK_ACK_CHUNKS && base + bit < state.chunks; bit++) {
+        int chunk = base + bit;
+        if (!((bitmap >> bit) & 1) || getBit(state.acked, chunk)) { continue; }
+        setBit(state.acked, chunk, true);
+        setBit(state.wanted, chunk, false);
+        state.ackedCount++;
+        m_stats.chunksAcked++;
+    }
+    if (state.ackedCount < state.chunks) { return ACK_PARTIAL; }
+    if (!wasComplete) { m_stats.filesAcked++; }
+    return ACK_COMPLETE;
+}
+
+/* - - - - - - Module Driver Functions - - - - - - */
+
+/* - - - - - - printDownlinkTransferInfo - - - - - - *
+ * Usage:
+ *  Prints the files with a transfer in progress and the chunks sent and acknowledged
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  none
+ */
+void printDownlinkTransferInfo() {
+    int open = 0;
+    int wanted = 0;
+    for (int fileId = 0; fileId < DOWNLINK_FILE_IDS; fileId++) {
+        if (!downlinkTransfer.isOpen(fileId)) { continue; }
+        open++;
+        wanted += downlinkTransfer.wantedChunks(fileId);
+    }
+    TransferStats stats = downlinkTransfer.getStats();
+    Serial.print("Downlink Transfers: ");
+    Serial.print(open);
+    Serial.print(" file(s) not yet acknowledged, ");
+    Serial.print(wanted);
+    Serial.print(" chunk(s) waiting, ");
+    Serial.print(stats.chunksSent);
+    Serial.print(" sent, ");
+    Serial.print(stats.chunksAcked);
+    Serial.print(" acknowledged, ");
+    Serial.print(stats.filesAcked);
+    Serial.print(" file(s) complete, ");
+    Serial.print(stats.acksRejected);
+    Serial.println(" acknowledgement(s) rejected");
+}
@@ -22,9 +22,11 @@
  * Inputs:
  *  buffer - pointer to buffer of photodiode data
  *  timestamp - file timestamp
+ *  rateCodes - packed 2 bit sample period codes, nullptr if every sample was taken at the nominal rate
+ *  attitude - pointing elevation column aligned to buffer, nullptr if there is no attitude
  */
-EncodedSciData::EncodedSciData(uint16_t *buffer, unsigned long &timestamp) {
-    encodeData(buffer, timestamp);
+EncodedSciData::EncodedSciData(uint16_t *buffer, unsigned long &timestamp, uint8_t *rateCodes, int16_t *attitude) {
+    encodeData(buffer, timestamp, rateCodes, attitude);
 }
 
 /* - - - - - - encodeData - - - - - - *
@@ -34,15 +36,33 @@ EncodedSciData::EncodedSciData(uint16_t *buffer, unsigned long &timestamp) {
  * Inputs:
  *  buffer - pointer to buffer of photodiode data
  *  timestamp - file timestamp
+ *  rateCodes - packed 2 bit sample period codes, nullptr if every sample was taken at the nominal rate
+ *  attitude - pointing elevation column aligned to buffer, nullptr if there is no attitude
  * 
  * Outputs:
  *  None
  */
-void EncodedSciData::encodeData(uint16_t *buffer, unsigned long &timestamp) {
+void EncodedSciData::encodeData(uint16_t *buffer, unsigned long &timestamp, uint8_t *rateCodes, int16_t *attitude) {
     
     uint8_t rawData[DECODED_MEMSIZE];
     memcpy(rawData, buffer, BUFFER_MEMSIZE); // copy buffer to data array
     memcpy(rawData + BUFFER_MEMSIZE, &timestamp, TIMESTAMP_SIZE); // copy timestamp to data array
+
+    // copy rate codes to data array, every code is nominal if none are given
+    uint8_t *rateCodeDst = rawData + BUFFER_MEMSIZE + TIMESTAMP_SIZE;
+    if (rateCodes != nullptr) {
+        memcpy(rateCodeDst, rateCodes, RATE_CODE_MEMSIZE);
+    } else {
+        uint8_t nominalByte = 0;
+        for (int i = 0; i < RATE_CODES_PER_BYTE; i++) {
+            nominalByte |= ADAPTIVE_NOMINAL_RATE_CODE << (2 * i);
+        }
+        memset(rateCodeDst, nominalByte, RATE_CODE_MEMSIZE);
+    }
+
+    // delta encode attitude column into data array, every sample is unaligned if none is given
+    packAttitude(attitude, rawData + BUFFER_MEMSIZE + TIMESTAMP_SIZE + RATE_CODE_MEMSIZE);
+    memset(rawData + SCIDATA_USED_MEMSIZE, 0, DECODED_MEMSIZE - SCIDATA_USED_MEMSIZE); // padding
     EncodedFile<SCIDATA_RAW_MEMSIZE>::encodeData(rawData);
 }
 
@@ -76,3 +96,216 @@ unsigned long EncodedSciData::getTimestamp() {
     return m_timestamp;
 }
 
+/* - - - - - - getRateCodes - - - - - - *
+ * Usage:
+ *  Returns a pointer to the decoded, packed sample rate codes.
+ *  Sample i uses bits 2*(i%4) and 2*(i%4)+1 of byte i/4.
+ *  
+ * Inputs:
+ *  None
+ * 
+ * Outputs:
+ *  Pointer to packed rate codes, type uint8_t*
+ */
+uint8_t *EncodedSciData::getRateCodes() {
+    memcpy(m_rateCodes, m_decodedData + BUFFER_MEMSIZE + TIMESTAMP_SIZE, RATE_CODE_MEMSIZE);
+    return m_rateCodes;
+}
+
+/* - - - - - - getRateCode - - - - - - *
+ * Usage:
+ *  Returns the rate code of a single sample, the index into ADAPTIVE_PERIODS_MSEC of the 
+ *  sampling period that preceded it
+ *  
+ * Inputs:
+ *  sampleIdx - index of sample in the decoded buffer
+ * 
+ * Outputs:
+ *  rate code, 0 to ADAPTIVE_RATE_COUNT - 1
+ */
+uint8_t EncodedSciData::getRateCode(int sampleIdx) {
+    uint8_t packed = m_decodedData[BUFFER_MEMSIZE + TIMESTAMP_SIZE + sampleIdx / RATE_CODES_PER_BYTE];
+    return (packed >> (2 * (sampleIdx % RATE_CODES_PER_BYTE))) & 0b11;
+}
+
+/* - - - - - - getAttitude - - - - - - *
+ * Usage:
+ *  Returns a pointer to the decoded attitude column, one pointing elevation per buffer sample
+ *  in units of ATTITUDE_LSB_DEG, ATTITUDE_INVALID where no attitude was aligned
+ *  
+ * Inputs:
+ *  None
+ * 
+ * Outputs:
+ *  Pointer to attitude column, type int16_t*
+ */
+int16_t *EncodedSciData::getAttitude() {
+    unpackAttitude(m_decodedData + BUFFER_MEMSIZE + TIMESTAMP_SIZE + RATE_CODE_MEMSIZE, m_attitude);
+    return m_attitude;
+}
+
+/* - - - - - - encodePages - - - - - - *
+ * Usage:
+ *  Encodes a science window straight from the ring buffers it was collected in into paged
+ *  layout, the same pages toPages() gives for the window in time order. No sorted copy of
+ *  the window or EncodedSciData object is needed.
+ *  
+ * Inputs:
+ *  source - ring buffers and timestamp of the window
+ *  pages - array to hold the file, PAGED_MEMSIZE bytes
+ * 
+ * Outputs:
+ *  None
+ */
+void EncodedSciData::encodePages(const ScienceSource &source, uint8_t *pages) {
+    EncodedFile<SCIDATA_RAW_MEMSIZE>::encodePages(readRaw, &source, pages);
+}
+
+/* - - - - - - readRaw - - - - - - *
+ * Usage:
+ *  Copies unencoded file bytes of a window in its ring buffers, laid out as encodeData()
+ *  lays out a window in time order: samples, timestamp, rate codes, attitude column, padding
+ *  
+ * Inputs:
+ *  source - pointer to the ScienceSource of the window
+ *  offset - first byte of the unencoded file
+ *  dst - array to hold length bytes
+ *  length - bytes to copy
+ * 
+ * Outputs:
+ *  None
+ */
+void EncodedSciData::readRaw(const void *source, int offset, uint8_t *dst, int length) {
+    const ScienceSource &window = *(const ScienceSource *)source;
+    const int rateCodeOffset = BUFFER_MEMSIZE + TIMESTAMP_SIZE;
+    const int keyframeOffset = rateCodeOffset + RATE_CODE_MEMSIZE;
+    const int deltaOffset = keyframeOffset + ATTITUDE_KEYFRAMES * sizeof(int16_t);
+    int packedKey = -1; // keyframe held in keyframe and deltas
+    int16_t keyframe = ATTITUDE_INVALID;
+    int8_t deltas[ATTITUDE_KEYFRAME_SAMPLES];
+
+    for (int i = 0; i < length; i++) {
+        int pos = offset + i;
+        if (pos < BUFFER_MEMSIZE) {
+            uint16_t sample = window.buffer[(window.start + pos / 2) % BUFFERSIZE];
+            dst[i] = ((uint8_t *)&sample)[pos % 2];
+        } else if (pos < rateCodeOffset) {
+            dst[i] = ((const uint8_t *)&window.timestamp)[pos - BUFFER_MEMSIZE];
+        } else if (pos < keyframeOffset) {
+            // every code is nominal if none are given
+            uint8_t packed = 0;
+            for (int k = 0; k < RATE_CODES_PER_BYTE; k++) {
+                int sampleIdx = (pos - rateCodeOffset) * RATE_CODES_PER_BYTE + k;
+                uint8_t code = ADAPTIVE_NOMINAL_RATE_CODE;
+                if (window.rateCodes != nullptr) {
+                    int srcIdx = (window.start + sampleIdx) % BUFFERSIZE;
+                    code = sampleIdx < BUFFERSIZE ? (window.rateCodes[srcIdx / RATE_CODES_PER_BYTE] >> (2 * (srcIdx % RATE_CODES_PER_BYTE))) & 0b11 : 0;
+                }
+                packed |= code << (2 * k);
+            }
+            dst[i] = packed;
+        } else if (pos < SCIDATA_USED_MEMSIZE) {
+            // delta encode the attitude column a keyframe at a time
+            int key = pos < deltaOffset ? (pos - keyframeOffset) / sizeof(int16_t) : (pos - deltaOffset) / ATTITUDE_KEYFRAME_SAMPLES;
+            if (key != packedKey) {
+                keyframe = packAttitudeKey(window.attitude, window.start, key, deltas);
+                packedKey = key;
+            }
+            if (pos < deltaOffset) { dst[i] = ((uint8_t *)&keyframe)[(pos - keyframeOffset) % sizeof(int16_t)]; }
+            else { dst[i] = (uint8_t)deltas[(pos - deltaOffset) % ATTITUDE_KEYFRAME_SAMPLES]; }
+        } else {
+            dst[i] = 0; // padding
+        }
+    }
+}
+
+/* - - - - - - packAttitude - - - - - - *
+ * Usage:
+ *  Delta encodes an attitude column into ATTITUDE_COLUMN_MEMSIZE bytes: ATTITUDE_KEYFRAMES int16
+ *  keyframes, then one int8 delta per sample (see packAttitudeKey()).
+ *  
+ * Inputs:
+ *  attitude - attitude column, BUFFERSIZE samples, nullptr if there is no attitude
+ *  packed - array to hold the encoded column, ATTITUDE_COLUMN_MEMSIZE bytes
+ * 
+ * Outputs:
+ *  None
+ */
+void EncodedSciData::packAttitude(const int16_t *attitude, uint8_t *packed) {
+    int8_t *deltas = reinterpret_cast<int8_t*>(packed + ATTITUDE_KEYFRAMES * sizeof(int16_t));
+    for (int key = 0; key < ATTITUDE_KEYFRAMES; key++) {
+        int16_t keyframe = packAttitudeKey(attitude, 0, key, deltas + key * ATTITUDE_KEYFRAME_SAMPLES);
+        memcpy(packed + key * sizeof(int16_t), &keyframe, sizeof(int16_t));
+    }
+}
+
+/* - - - - - - packAttitudeKey - - - - - - *
+ * Usage:
+ *  Delta encodes the ATTITUDE_KEYFRAME_SAMPLES samples of one keyframe. The keyframe holds the
+ *  first aligned attitude of its samples and each delta the change from the sample before, so
+ *  steps are stored exactly up to 127 LSB per sample. A larger step is spread over the samples
+ *  after it, and the next keyframe starts exact again. Samples with no attitude store
+ *  ATTITUDE_DELTA_INVALID and do not move the reference.
+ *  
+ * Inputs:
+ *  attitude - attitude column, BUFFERSIZE samples, nullptr if there is no attitude
+ *  start - index of the oldest sample, the column is a ring buffer
+ *  key - keyframe to encode
+ *  deltas - array to hold the deltas of the keyframe samples, ATTITUDE_KEYFRAME_SAMPLES bytes
+ * 
+ * Outputs:
+ *  keyframe
+ */
+int16_t EncodedSciData::packAttitudeKey(const int16_t *attitude, int start, int key, int8_t *deltas) {
+    int first = key * ATTITUDE_KEYFRAME_SAMPLES;
+    int last = min(first + ATTITUDE_KEYFRAME_SAMPLES, BUFFERSIZE);
+
+    // keyframe is the first aligned attitude of the block
+    int16_t keyframe = ATTITUDE_INVALID;
+    for (int i = first; i < last && attitude != nullptr; i++) {
+        int16_t value = attitude[(start + i) % BUFFERSIZE];
+        if (value != ATTITUDE_INVALID) { keyframe = value; break; }
+    }
+
+    // deltas follow the decoded value, so an error from a clamped step is not carried on
+    int32_t reference = keyframe;
+    for (int i = first; i < last; i++) {
+        int16_t value = attitude != nullptr ? attitude[(start + i) % BUFFERSIZE] : ATTITUDE_INVALID;
+        if (value == ATTITUDE_INVALID) {
+            deltas[i - first] = ATTITUDE_DELTA_INVALID;
+            continue;
+        }
+        int32_t delta = max(min((int32_t)value - reference, (int32_t)INT8_MAX), (int32_t)(INT8_MIN + 1));
+        deltas[i - first] = (int8_t)delta;
+        reference += delta;
+    }
+    return keyframe;
+}
+
+/* - - - - - - unpackAttitude - - - - - - *
+ * Usage:
+ *  Decodes an attitude column delta encoded by packAttitude
+ *  
+ * Inputs:
+ *  packed - encoded column, ATTITUDE_COLUMN_MEMSIZE bytes
+ *  attitude - array to hold the attitude column, BUFFERSIZE samples
+ * 
+ * Outputs:
+ *  None
+ */
+void EncodedSciData::unpackAttitude(const uint8_t *packed, int16_t *attitude) {
+    const int8_t *deltas = reinterpret_cast<const int8_t*>(packed + ATTITUDE_KEYFRAMES * sizeof(int16_t));
+    for (int key = 0; key < ATTITUDE_KEYFRAMES; key++) {
+        int16_t reference;
+        memcpy(&reference, packed + key * sizeof(int16_t), sizeof(int16_t));
+        int last = min((key + 1) * ATTITUDE_KEYFRAME_SAMPLES, BUFFERSIZE);
+        for (int i = key * ATTITUDE_KEYFRAME_SAMPLES; i < last; i++) {
+            if (deltas[i] == ATTITUDE_DELTA_INVALID) {
+                attitude[i] = ATTITUDE_INVALID;
+                continue;
+            }
+            reference += deltas[i];
+            attitude[i] = reference;
+        }
+    }
+}
@@ -73,6 +73,13 @@ void TimedEvent::start() {
     nextInvokeMillis = millis() + duration;
 }
 
+// returns milliseconds until the event is invoked, 0 if it is due or not started
+unsigned long TimedEvent::remaining() {
+    unsigned long now = millis();
+    if (isInvoked || now >= nextInvokeMillis) { return 0; }
+    return nextInvokeMillis - now;
+}
+
 
 /* - - - - - - RecurringEvent - - - - - - */
 // constructor
@@ -16,10 +16,30 @@ RecurringEvent dataProcessEvent = RecurringEvent(SAMPLE_PERIOD_MSEC);
 Event saveBufferEvent = Event();
 TimedEvent sunriseTimerEvent = TimedEvent(WINDOW_LENGTH_MSEC);
 TimedEvent sweepTimeoutEvent = TimedEvent(SWEEP_TIMEOUT_MSEC);
-AsyncEvent downlinkEvent = AsyncEvent(MAXFILES);
-AsyncEvent scrubEvent = AsyncEvent(MAXFILES);
+AsyncEvent downlinkEvent = AsyncEvent(DOWNLINK_FILE_IDS); // each pass sets its iterations to the files it plans
+Event scrubEvent = Event();
 Event printPhotoEvent = Event();
-
+volatile bool ADAPTIVE_SAMPLING = ADAPTIVE_SAMPLING_INIT;
+volatile long ADAPTIVE_FAST_SLOPE = ADAPTIVE_FAST_SLOPE_INIT;
+volatile long ADAPTIVE_SLOW_SLOPE = ADAPTIVE_SLOW_SLOPE_INIT;
+volatile long ADAPTIVE_NOISE = ADAPTIVE_NOISE_INIT;
+volatile bool BURST_CAPTURE = BURST_CAPTURE_INIT;
+volatile bool CHECKPOINT_WINDOWS = CHECKPOINT_WINDOWS_INIT;
+volatile bool AUTO_SCRUB = AUTO_SCRUB_INIT;
+volatile long SCRUB_BYTES_PER_SEC = SCRUB_BYTES_PER_SEC_INIT;
+volatile long SCRUB_PASS_HOURS = SCRUB_PASS_HOURS_INIT;
+volatile long RETENTION_POLICY = RETENTION_POLICY_INIT;
+volatile long RETENTION_QUOTA_FILES = RETENTION_QUOTA_FILES_INIT;
+volatile long RETENTION_QUALITY_WEIGHT = RETENTION_QUALITY_WEIGHT_INIT;
+volatile long RETENTION_AGE_WEIGHT = RETENTION_AGE_WEIGHT_INIT;
+volatile long DOWNLINK_QUALITY_WEIGHT = DOWNLINK_QUALITY_WEIGHT_INIT;
+volatile long DOWNLINK_AGE_WEIGHT = DOWNLINK_AGE_WEIGHT_INIT;
+volatile long DOWNLINK_PARTIAL_WEIGHT = DOWNLINK_PARTIAL_WEIGHT_INIT;
+volatile long DOWNLINK_PASS_BYTES = DOWNLINK_PASS_BYTES_INIT;
+
+
+// ADCS
+volatile bool SIMULATE_ATTITUDE = SIMULATE_ATTITUDE_INIT;
 
 // Command Handling
 volatile bool DANGER_COMMANDS_ALLOWED = DANGER_COMMANDS_ALLOWED_INIT;
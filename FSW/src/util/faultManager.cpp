@@ -23,6 +23,10 @@
 #include "../headers/commandHandling.hpp"
 #include "../headers/housekeeping.hpp"
 #include "../headers/timing.hpp"
+#include "../headers/windowCheckpoint.hpp"
+#include "../headers/flashQueue.hpp"
+#include "../headers/scrubber.hpp"
+#include "../headers/blackBox.hpp"
 
 /* Module Variable Definitions */
 // fault log
@@ -65,6 +69,7 @@ void logFault(int code) {
         saveRequired = true;
     }
     faultLog[code].pendingAction = true;
+    blackBox.log(BB_FAULT, 2, code, faultLog[code].occurrences);
     
     // Print message
     if (!SUPPRESS_FAULTS) {
@@ -124,6 +129,10 @@ void handleFaults() {
         switch (code) {
 
             case faultCode::UNEXPECTED_RESTART:
+                if (windowCheckpointResumed()) { // repeated restarts are not resumed, so this cannot loop
+                    Serial.println("Corrective Action Skipped - Science window resumed from checkpoint.");
+                    break;
+                }
                 scienceMode.setMode(SAFE_MODE);
                 Serial.println("Corrective Action Taken - Entering Safe Mode.");
                 Serial.println("(Unexpected restart!)");
@@ -208,6 +217,11 @@ void resetPersistentData() {
     payloadData.startCount = 1;
     payloadData.consecutiveBadRestarts = 0;
     payloadData.recoveredMode = 0;
+    payloadData.storageMode = STORAGE_MIRRORED;
+    payloadData.scrubPhase = SCRUB_IDLE;
+    payloadData.scrubPriorityCount = 0;
+    payloadData.scrubPasses = 0;
+    payloadData.checkpointEpoch = 0;
 
     for (int i = 0; i < faultCode::COUNT; i++) {
         faultLog[i].occurrences = 0;
@@ -229,6 +243,7 @@ void resetPersistentData() {
  */
 void recordNewStart() {
     payloadData.startCount++; // increment total start count
+    blackBox.log(BB_STARTUP, 2, payloadData.startCount, payloadData.consecutiveBadRestarts);
     
     // check if restart was unexpected
     if (payloadData.expectingRestartFlag != EXPECTING_RESTART_FLAG) {
@@ -246,6 +261,7 @@ void recordNewStart() {
  * Usage:
  *  Sets restart flag to indicate restart was expected 
  *   and saves the current science mode to EEPROM
+ *   Queued flash writes and the black box are finished first
  *  
  * Inputs:
  *  None
@@ -253,6 +269,9 @@ void recordNewStart() {
  *  None
  */
 void prepareForRestart() {
+    blackBox.log(BB_RESTART, 1, scienceMode.getMode());
+    blackBox.flush();
+    flashQueue.flush();
     payloadData.expectingRestartFlag = EXPECTING_RESTART_FLAG;
     payloadData.recoveredMode = scienceMode.getMode();
     saveEEPROM();
@@ -282,6 +301,16 @@ void saveEEPROM() {
     memAppend(rawData, &payloadData.startCount, sizeof(payloadData.startCount), &bytesCopied);
     memAppend(rawData, &payloadData.consecutiveBadRestarts, sizeof(payloadData.consecutiveBadRestarts), &bytesCopied);
     memAppend(rawData, &payloadData.recoveredMode, sizeof(payloadData.recoveredMode), &bytesCopied);
+    memAppend(rawData, &payloadData.storageMode, sizeof(payloadData.storageMode), &bytesCopied);
+    memAppend(rawData, &payloadData.scrubPhase, sizeof(payloadData.scrubPhase), &bytesCopied);
+    memAppend(rawData, &payloadData.scrubSlot, sizeof(payloadData.scrubSlot), &bytesCopied);
+    memAppend(rawData, &payloadData.scrubPos, sizeof(payloadData.scrubPos), &bytesCopied);
+    memAppend(rawData, &payloadData.scrubSeq, sizeof(payloadData.scrubSeq), &bytesCopied);
+    memAppend(rawData, &payloadData.scrubPriorityDone, sizeof(payloadData.scrubPriorityDone), &bytesCopied);
+    memAppend(rawData, &payloadData.scrubPriorityCount, sizeof(payloadData.scrubPriorityCount), &bytesCopied);
+    memAppend(rawData, payloadData.scrubPriority, sizeof(payloadData.scrubPriority), &bytesCopied);
+    memAppend(rawData, &payloadData.scrubPasses, sizeof(payloadData.scrubPasses), &bytesCopied);
+    memAppend(rawData, &payloadData.checkpointEpoch, sizeof(payloadData.checkpointEpoch), &bytesCopied);
 
     // copy fault data to rawData array
     for (int i = 0; i < faultCode::COUNT; i++) {
@@ -349,6 +378,16 @@ void loadEEPROM() {
     memExtract(encodedData.getDecodedData(), &payloadData.startCount, sizeof(payloadData.startCount), &bytesCopied);
     memExtract(encodedData.getDecodedData(), &payloadData.consecutiveBadRestarts, sizeof(payloadData.consecutiveBadRestarts), &bytesCopied);
     memExtract(encodedData.getDecodedData(), &payloadData.recoveredMode, sizeof(payloadData.recoveredMode), &bytesCopied);
+    memExtract(encodedData.getDecodedData(), &payloadData.storageMode, sizeof(payloadData.storageMode), &bytesCopied);
+    memExtract(encodedData.getDecodedData(), &payloadData.scrubPhase, sizeof(payloadData.scrubPhase), &bytesCopied);
+    memExtract(encodedData.getDecodedData(), &payloadData.scrubSlot, sizeof(payloadData.scrubSlot), &bytesCopied);
+    memExtract(encodedData.getDecodedData(), &payloadData.scrubPos, sizeof(payloadData.scrubPos), &bytesCopied);
+    memExtract(encodedData.getDecodedData(), &payloadData.scrubSeq, sizeof(payloadData.scrubSeq), &bytesCopied);
+    memExtract(encodedData.getDecodedData(), &payloadData.scrubPriorityDone, sizeof(payloadData.scrubPriorityDone), &bytesCopied);
+    memExtract(encodedData.getDecodedData(), &payloadData.scrubPriorityCount, sizeof(payloadData.scrubPriorityCount), &bytesCopied);
+    memExtract(encodedData.getDecodedData(), payloadData.scrubPriority, sizeof(payloadData.scrubPriority), &bytesCopied);
+    memExtract(encodedData.getDecodedData(), &payloadData.scrubPasses, sizeof(payloadData.scrubPasses), &bytesCopied);
+    memExtract(encodedData.getDecodedData(), &payloadData.checkpointEpoch, sizeof(payloadData.checkpointEpoch), &bytesCopied);
 
     // copy fault data to fault log
     for (int i = 0; i < faultCode::COUNT; i++) {
@@ -0,0 +1,360 @@
+/* fileCatalog.cpp keeps the catalog of science files on flash
+ * Usage:
+ *  The catalog is the only record of which science files exist. Files are kept in the record
+ *  store keyed by catalog slot and named after it ("sci000.bin"), so finding, listing and
+ *  allocating files never probes flash.
+ *  The catalog is saved to the record store after every change and loaded in init(), after
+ *  the store is mounted. It is kept in chunks of CATALOG_CHUNK_SLOTS slots so a change to one
+ *  slot only rewrites its chunk, and the chunk records are written through the flash queue
+ *  by handleStorage(). Mirrored storage keeps a copy of every chunk on each flash module,
+ *  load() falls back to the copy on module 2 if the one on module 1 cannot be decoded.
+ *
+ * Modules encompassed:
+ *  Science Memory Handling
+ *  Program EDAC
+ *
+ * Additional files needed for compilation:
+ *  config.hpp
+ *  fileCatalog.hpp
+ *  encodedFile.hpp
+ *  recordStore.cpp & recordStore.hpp
+ *  flashQueue.cpp & flashQueue.hpp
+ *  crc.cpp & crc.hpp
+ */
+
+/* - - - - - - Includes - - - - - - */
+// All libraries are put in fileCatalog.hpp
+// NS2 headers
+#include "../headers/fileCatalog.hpp"
+#include "../headers/recordStore.hpp"
+#include "../headers/flashQueue.hpp"
+#include "../headers/crc.hpp"
+
+/* Module Variable Definitions */
+FileCatalog fileCatalog;
+
+/* - - - - - - Class Definitions - - - - - - */
+
+/* - - - - - - FileCatalog - - - - - - */
+// constructor
+FileCatalog::FileCatalog() {
+    m_generation = 0;
+    m_saveRequested = false;
+    m_savingChunk = -1;
+    m_savingCrc = 0;
+    m_saveFailures = 0;
+    for (int chunk = 0; chunk < CATALOG_CHUNKS; chunk++) {
+        m_chunkSaved[chunk] = false;
+        m_savedCrc[chunk] = 0;
+    }
+    clear();
+}
+
+// frees every slot in RAM, does not touch flash. The generation is kept so the next save still wins
+void FileCatalog::clear() {
+    for (int slot = 0; slot < MAXFILES; slot++) {
+        m_entries[slot] = CatalogEntry();
+        m_entries[slot].slot = slot;
+    }
+    rebuildFreeList();
+}
+
+/* load
+ *  reads every chunk of the catalog from the record store, from the mirror copy if the first
+ *  copy fails its checksum. Slots of a chunk that was never saved are free.
+ *  Files left in the writing state by a reset are verified and kept or freed, and records
+ *  of free slots are removed.
+ *  returns false if no saved catalog was found */
+bool FileCatalog::load() {
+    if (m_savingChunk >= 0) { flashQueue.flush(); } // the workspace holds the chunk being saved
+    clear();
+    m_generation = 0;
+    m_saveRequested = false;
+
+    bool found = false;
+    for (int chunk = 0; chunk < CATALOG_CHUNKS; chunk++) {
+        int recordIdx = recordStore.find(RECORD_CATALOG, chunk);
+        m_chunkSaved[chunk] = recordIdx >= 0 && (loadChunk(chunk, recordIdx, false) || loadChunk(chunk, recordIdx, true));
+        if (!m_chunkSaved[chunk]) { continue; }
+        m_savedCrc[chunk] = chunkCrc(chunk);
+        found = true;
+    }
+
+    rebuildFreeList();
+    if (found) { resolveWriting(); } // without a catalog the records are left for ground to recover
+    return found;
+}
+
+/* save
+ *  queues the chunks that changed since they were last saved, the first one is submitted now
+ *  and the rest by service() as each is committed. Call after every change. */
+void FileCatalog::save() {
+    m_generation++;
+    m_saveRequested = true;
+    service();
+}
+
+/* service
+ *  submits the next chunk that differs from its saved copy, or whose record is gone after a
+ *  format, once the one before it has been committed. Called every main loop iteration by
+ *  handleStorage() */
+void FileCatalog::service() {
+    if (!m_saveRequested || m_savingChunk >= 0 || flashQueue.space() < 2) { return; }
+
+    int chunk = 0;
+    uint32_t crc = 0;
+    for (; chunk < CATALOG_CHUNKS; chunk++) {
+        crc = chunkCrc(chunk);
+        if (!m_chunkSaved[chunk] || crc != m_savedCrc[chunk] || recordStore.find(RECORD_CATALOG, chunk) < 0) { break; }
+    }
+    if (chunk == CATALOG_CHUNKS) {
+        m_saveRequested = false; // every chunk matches its saved copy
+        return;
+    }
+
+    // build and encode the chunk
+    uint8_t rawData[CATALOG_CHUNK_RAW_MEMSIZE] = {};
+    size_t bytesCopied = 0;
+    memAppend(rawData, &m_generation, sizeof(m_generation), &bytesCopied);
+    for (int slot = chunk * CATALOG_CHUNK_SLOTS; slot < (chunk + 1) * CATALOG_CHUNK_SLOTS; slot++) {
+        CatalogEntry entry;
+        entry.slot = slot;
+        if (slot < MAXFILES) { entry = m_entries[slot]; } // the last chunk is padded with free slots
+        memAppend(rawData, &entry.slot, sizeof(entry.slot), &bytesCopied);
+        memAppend(rawData, &entry.state, sizeof(entry.state), &bytesCopied);
+        memAppend(rawData, &entry.size, sizeof(entry.size), &bytesCopied);
+        memAppend(rawData, &entry.timestamp, sizeof(entry.timestamp), &bytesCopied);
+        memAppend(rawData, &entry.checksum, sizeof(entry.checksum), &bytesCopied);
+        memAppend(rawData, &entry.quality, sizeof(entry.quality), &bytesCopied);
+    }
+    uint32_t rawCrc = crc32c(rawData, bytesCopied);
+    memAppend(rawData, &rawCrc, sizeof(rawCrc), &bytesCopied);
+    m_encoded.encodeData(rawData);
+
+    if (!recordStore.submitAppend(RECORD_CATALOG, chunk, m_encoded.getData(), EncodedCatalogChunk::MEMSIZE, onChunkSaved, this)) {
+        return; // store busy or full, tried again next iteration
+    }
+    m_savingChunk = chunk;
+    m_savingCrc = crc;
+}
+
+// takes a free slot and marks it as being written, returns -1 if the catalog is full
+int FileCatalog::allocate() {
+    if (m_freeCount == 0) { return -1; }
+
+    int slot = m_freeSlots[m_freeHead];
+    m_freeHead = (m_freeHead + 1) % MAXFILES;
+    m_freeCount--;
+
+    m_entries[slot] = CatalogEntry();
+    m_entries[slot].slot = slot;
+    m_entries[slot].state = FILE_WRITING;
+    return slot;
+}
+
+// changes the state of an allocated slot, use release() to free it
+void FileCatalog::setState(int slot, uint8_t state) {
+    if (0 <= slot && slot < MAXFILES && state != FILE_FREE && m_entries[slot].state != FILE_FREE) {
+        m_entries[slot].state = state;
+    }
+}
+
+// returns a slot to the free list, freed slots are reused oldest first
+void FileCatalog::release(int slot) {
+    if (slot < 0 || slot >= MAXFILES || m_entries[slot].state == FILE_FREE) { return; }
+
+    m_entries[slot] = CatalogEntry();
+    m_entries[slot].slot = slot;
+    m_freeSlots[(m_freeHead + m_freeCount) % MAXFILES] = slot;
+    m_freeCount++;
+}
+
+// whether a slot holds a complete file
+bool FileCatalog::isValid(int slot) {
+    return 0 <= slot && slot < MAXFILES && m_entries[slot].state == FILE_VALID;
+}
+
+// fills slots with the slot numbers of complete files in slot order, returns how many were found
+int FileCatalog::list(uint16_t slots[], int maxCount) {
+    int found = 0;
+    for (int slot = 0; slot < MAXFILES && found < maxCount; slot++) {
+        if (m_entries[slot].state == FILE_VALID) {
+            slots[found] = slot;
+            found++;
+        }
+    }
+    return found;
+}
+
+// writes the file name of a slot ("sci000.bin") to name
+void FileCatalog::slotFilename(int slot, char name[CATALOG_NAME_SIZE]) {
+    snprintf(name, CATALOG_NAME_SIZE, "sci%03d.bin", slot);
+}
+
+/* loadChunk
+ *  reads, decodes and checks one copy of a chunk record and takes its entries.
+ *  returns false if the copy could not be read or fails its checksum */
+bool FileCatalog::loadChunk(int chunk, int recordIdx, bool mirror) {
+    uint8_t encoded[EncodedCatalogChunk::MEMSIZE];
+    if (recordStore.getRecord(recordIdx).length != EncodedCatalogChunk::MEMSIZE) { return false; }
+    bool status = mirror ? recordStore.readMirror(recordIdx, encoded, 0, EncodedCatalogChunk::MEMSIZE)
+                         : recordStore.read(recordIdx, encoded, 0, EncodedCatalogChunk::MEMSIZE);
+    if (!status) { return false; }
+
+    m_encoded.fill(encoded);
+    ScrubReport scrubInfo = m_encoded.scrub();
+    uint8_t *decoded = m_encoded.getDecodedData();
+
+    uint32_t crc = 0;
+    uint32_t generation = 0;
+    memcpy(&crc, decoded + CATALOG_CHUNK_RAW_MEMSIZE - sizeof(crc), sizeof(crc));
+    memcpy(&generation, decoded, sizeof(generation));
+    if (scrubInfo.uncorrected > 0 || crc != crc32c(decoded, CATALOG_CHUNK_RAW_MEMSIZE - sizeof(crc))) { return false; }
+
+    size_t bytesCopied = sizeof(uint32_t);
+    for (int slot = chunk * CATALOG_CHUNK_SLOTS; slot < (chunk + 1) * CATALOG_CHUNK_SLOTS && slot < MAXFILES; slot++) {
+        CatalogEntry entry;
+        memExtract(decoded, &entry.slot, sizeof(entry.slot), &bytesCopied);
+        memExtract(decoded, &entry.state, sizeof(entry.state), &bytesCopied);
+        memExtract(decoded, &entry.size, sizeof(entry.size), &bytesCopied);
+        memExtract(decoded, &entry.timestamp, sizeof(entry.timestamp), &bytesCopied);
+        memExtract(decoded, &entry.checksum, sizeof(entry.checksum), &bytesCopied);
+        memExtract(decoded, &entry.quality, sizeof(entry.quality), &bytesCopied);
+        if (entry.slot != slot || entry.state > FILE_VALID) { // should not happen past the checksum
+            entry = CatalogEntry();
+            entry.slot = slot;
+        }
+        m_entries[slot] = entry;
+    }
+    m_generation = max(m_generation, generation);
+    return true;
+}
+
+// crc32c of the entries of a chunk, tells whether it changed since it was saved
+uint32_t FileCatalog::chunkCrc(int chunk) {
+    int first = chunk * CATALOG_CHUNK_SLOTS;
+    int slots = min(CATALOG_CHUNK_SLOTS, MAXFILES - first);
+    uint32_t crc = 0;
+    for (int slot = first; slot < first + slots; slot++) {
+        CatalogEntry &entry = m_entries[slot];
+        crc = crc32c(&entry.state, sizeof(entry.state), crc);
+        crc = crc32c(&entry.size, sizeof(entry.size), crc);
+        crc = crc32c(&entry.timestamp, sizeof(entry.timestamp), crc);
+        crc = crc32c(&entry.checksum, sizeof(entry.checksum), crc);
+        crc = crc32c(&entry.quality, sizeof(entry.quality), crc);
+    }
+    return crc;
+}
+
+// flash queue callback of a chunk record, context is the catalog. A failed chunk is tried again by service()
+void FileCatalog::onChunkSaved(void *context, bool status) {
+    FileCatalog *catalog = (FileCatalog *)context;
+    int chunk = catalog->m_savingChunk;
+    catalog->m_savingChunk = -1;
+    if (status) {
+        catalog->m_chunkSaved[chunk] = true;
+        catalog->m_savedCrc[chunk] = catalog->m_savingCrc;
+    } else {
+        catalog->m_saveFailures++;
+    }
+    catalog->m_saveRequested = true; // other chunks may have changed while it was saved
+}
+
+// puts every free slot on the free list, lowest slot first
+void FileCatalog::rebuildFreeList() {
+    m_freeHead = 0;
+    m_freeCount = 0;
+    for (int slot = 0; slot < MAXFILES; slot++) {
+        if (m_entries[slot].state == FILE_FREE) {
+            m_freeSlots[m_freeCount] = slot;
+            m_freeCount++;
+        }
+    }
+}
+
+// keeps files interrupted while being written only if their record matches the checksum,
+// removes records whose slot is free
+void FileCatalog::resolveWriting() {
+    bool changed = false;
+    for (int slot = 0; slot < MAXFILES; slot++) {
+        CatalogEntry &entry = m_entries[slot];
+        int recordIdx = recordStore.find(RECORD_SCIENCE, slot);
+        if (entry.state == FILE_FREE) {
+            // left behind when a release was not saved, nothing refers to it
+            if (recordIdx >= 0) { recordStore.remove(recordIdx); }
+            continue;
+        }
+        if (entry.state != FILE_WRITING) { continue; }
+
+        // committed records are complete, the checksum tells this window's record from an older one
+        RecordInfo info;
+        if (recordIdx >= 0) { info = recordStore.getRecord(recordIdx); }
+        bool intact = recordIdx >= 0 && info.length == entry.size && info.payloadCrc == entry.checksum;
+
+        if (intact) {
+            entry.state = FILE_VALID;
+        } else {
+            if (recordIdx >= 0) { recordStore.remove(recordIdx); }
+            release(slot);
+        }
+        changed = true;
+    }
+    if (changed) { save(); }
+}
+
+/* - - - - - - Module Driver Functions - - - - - - */
+
+/* - - - - - - printCatalogInfo - - - - - - *
+ * Usage:
+ *  Prints catalog usage
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  none
+ */
+void printCatalogInfo() {
+    Serial.print("Science Files: ");
+    Serial.print(fileCatalog.count());
+    Serial.print(" / ");
+    Serial.println(MAXFILES);
+    Serial.print("Catalog Generation: ");
+    Serial.print(fileCatalog.getGeneration());
+    if (fileCatalog.isSaved()) { Serial.print(", saved"); }
+    else { Serial.print(", save in progress"); }
+    Serial.print(", ");
+    Serial.print(fileCatalog.getSaveFailures());
+    Serial.println(" chunk write failure(s)");
+}
+
+/* - - - - - - printCatalogList - - - - - - *
+ * Usage:
+ *  Prints the name, size, timestamp, checksum and quality of every science file
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  none
+ */
+void printCatalogList() {
+    uint16_t slots[MAXFILES];
+    int numFiles = fileCatalog.list(slots, MAXFILES);
+    for (int i = 0; i < numFiles; i++) {
+        CatalogEntry &entry = fileCatalog.getEntry(slots[i]);
+        char name[CATALOG_NAME_SIZE];
+        FileCatalog::slotFilename(entry.slot, name);
+        Serial.print(name);
+        Serial.print(", ");
+        Serial.print(entry.size);
+        Serial.print(" bytes, timestamp ");
+        Serial.print(entry.timestamp);
+        Serial.print(", crc ");
+        Serial.print(entry.checksum, HEX);
+        Serial.print(", quality ");
+        Serial.println(entry.quality);
+    }
+    Serial.print(numFiles);
+    Serial.println(" science file(s).");
+}
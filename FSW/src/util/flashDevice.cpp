@@ -0,0 +1,388 @@
+/* flashDevice.cpp gives raw sector level access to a region of flash
+ * Usage:
+ *  SerialFlashDevice maps a region onto an erasable file on a flash module so structures
+ *  like the record store can manage their own layout. DualFlashDevice stripes or mirrors
+ *  two such regions, one on each flash module. SimFlashDevice is the same interface
+ *  over a RAM array, used by unit tests to cut power at any byte or fail a module.
+ *
+ * Modules encompassed:
+ *  Science Memory Handling
+ *
+ * Additional files needed for compilation:
+ *  config.hpp
+ *  flashDevice.hpp
+ *  faultManager.cpp & faultManager.hpp
+ */
+
+/* - - - - - - Includes - - - - - - */
+// All libraries are put in flashDevice.hpp
+// NS2 headers
+#include "../headers/flashDevice.hpp"
+#include "../headers/faultManager.hpp"
+
+/* Module Variable Definitions */
+uint64_t SimFlashDevice::s_busNanos = 0;
+int SerialFlashDevice::s_selectedChip = -1;
+
+/* - - - - - - Class Definitions - - - - - - */
+
+/* - - - - - - SerialFlashDevice - - - - - - */
+// constructor
+SerialFlashDevice::SerialFlashDevice(const char *filename, uint32_t size, int chipSelect) {
+    m_filename = filename;
+    m_size = size;
+    m_chipSelect = chipSelect;
+    m_base = 0;
+    m_sectorSize = 0;
+    m_ready = false;
+    m_busyUntilMicros = 0;
+}
+
+/* begin
+ *  opens the region file, creating it if it does not exist yet.
+ *  created is set when the region is new and has to be formatted before use.
+ *  returns false if the flash module or the file could not be opened */
+bool SerialFlashDevice::begin(bool &created) {
+    created = false;
+    m_ready = false;
+    pinMode(m_chipSelect, OUTPUT); // deselected, so the status register can be polled before SerialFlash starts it
+    digitalWrite(m_chipSelect, HIGH);
+    if (!select()) { return false; }
+
+    if (!SerialFlash.exists(m_filename)) {
+        if (!SerialFlash.createErasable(m_filename, m_size)) { return false; }
+        created = true;
+    }
+    SerialFlashFile file = SerialFlash.open(m_filename);
+    if (!file) { return false; }
+
+    m_base = file.getFlashAddress();
+    m_size = min(m_size, (uint32_t)file.size());
+    m_sectorSize = SerialFlash.blockSize();
+    m_ready = true;
+    return true;
+}
+
+/* Every operation selects this module first. SerialFlash waits only for the selected module to
+ * finish its last program or erase, the other module keeps programming in the background. */
+bool SerialFlashDevice::read(uint32_t addr, void *dst, uint32_t length) {
+    if (!inRange(addr, length) || !select()) { return false; }
+    SerialFlash.read(m_base + addr, dst, length);
+    return true;
+}
+
+bool SerialFlashDevice::program(uint32_t addr, const void *src, uint32_t length) {
+    if (!inRange(addr, length) || !select()) { return false; }
+    SerialFlash.write(m_base + addr, src, length);
+    m_busyUntilMicros = micros() + PAGE_PROGRAM_MICROS;
+    return true;
+}
+
+bool SerialFlashDevice::eraseSector(uint32_t addr) {
+    if (!inRange(addr, m_sectorSize) || !select()) { return false; }
+    feedWD(); // formatting erases many sectors in a row, each can take longer than the watchdog interval
+    SerialFlash.eraseBlock(m_base + addr - addr % m_sectorSize);
+    m_busyUntilMicros = micros() + SECTOR_ERASE_MICROS;
+    return true;
+}
+
+// a module that does not answer with a manufacturer ID is not responding
+bool SerialFlashDevice::isResponding() {
+    if (!m_ready || !select()) { return false; }
+    uint8_t id[5] = {};
+    SerialFlash.readID(id);
+    return id[0] != 0x00 && id[0] != 0xFF;
+}
+
+/* isBusy
+ *  polls the status of the module. SerialFlash only knows the status of the selected one, the
+ *  status register of the other is read directly while its last operation may still run */
+bool SerialFlashDevice::isBusy(uint32_t addr) {
+    (void)addr; // the whole module is busy
+    if (s_selectedChip == m_chipSelect) { return !SerialFlash.ready(); }
+    return (long)(m_busyUntilMicros - micros()) > 0 && readBusy();
+}
+
+/* select
+ *  points SerialFlash at this module. Every flash access goes through a SerialFlashDevice, so
+ *  SerialFlash.begin() is only run again when the other module was used last. A busy module
+ *  ignores the ID read by SerialFlash.begin() and the next program, so it is waited for first.
+ *  returns false if the module could not be started */
+bool SerialFlashDevice::select() {
+    if (s_selectedChip == m_chipSelect) { return true; }
+    s_selectedChip = -1;
+    waitReady();
+    if (!SerialFlash.begin(m_chipSelect)) { return false; }
+    s_selectedChip = m_chipSelect;
+    return true;
+}
+
+// reads the busy bit of the status register, without SerialFlash, which talks to the selected module
+bool SerialFlashDevice::readBusy() {
+    SPI.beginTransaction(SPISettings(FLASH_STATUS_SPEED, MSBFIRST, SPI_MODE0));
+    digitalWrite(m_chipSelect, LOW);
+    SPI.transfer(READ_STATUS);
+    uint8_t status = SPI.transfer(0);
+    digitalWrite(m_chipSelect, HIGH);
+    SPI.endTransaction();
+    return status & STATUS_BUSY;
+}
+
+/* waitReady
+ *  polls the module until it finishes its last program or erase. Any region of the module may
+ *  have started it, so the status is read at least once. Gives up after the longest erase, a
+ *  module that does not answer then fails SerialFlash.begin() */
+void SerialFlashDevice::waitReady() {
+    unsigned long startMicros = micros();
+    while (readBusy() && micros() - startMicros < SECTOR_ERASE_MICROS) {
+        feedWD(); // an erase can take longer than the watchdog interval
+    }
+}
+
+/* - - - - - - SimFlashDevice - - - - - - */
+// constructor
+SimFlashDevice::SimFlashDevice(uint8_t *memory, uint32_t sectorSize, int sectorCount) {
+    m_memory = memory;
+    reset(sectorSize, sectorCount);
+}
+
+/* reset
+ *  gives the device a new layout over the same memory and clears its state and counters, as if it
+ *  was just constructed, so tests can share one memory. The memory must hold the new layout */
+void SimFlashDevice::reset(uint32_t sectorSize, int sectorCount) {
+    m_sectorSize = sectorSize;
+    m_sectorCount = sectorCount;
+    m_powered = true;
+    m_cutArmed = false;
+    m_cutRemaining = 0;
+    m_tornSeed = 12345;
+    m_bytesProgrammed = 0;
+    m_sectorsErased = 0;
+    m_pagePrograms = 0;
+    m_partialPrograms = 0;
+    m_busyUntilNanos = 0;
+    m_failed = false;
+}
+
+bool SimFlashDevice::read(uint32_t addr, void *dst, uint32_t length) {
+    if (m_failed || addr > capacity() || length > capacity() - addr) { return false; }
+    waitReady();
+    s_busNanos += (COMMAND_BYTES + length) * BYTE_NANOS;
+    memcpy(dst, m_memory + addr, length);
+    return true;
+}
+
+/* program
+ *  clears bits as a NOR flash does, the stored byte is the old byte ANDed with the new one.
+ *  returns false if power was lost before every byte was programmed */
+bool SimFlashDevice::program(uint32_t addr, const void *src, uint32_t length) {
+    if (m_failed || !m_powered || addr > capacity() || length > capacity() - addr) { return false; }
+
+    const uint8_t *bytes = (const uint8_t *)src;
+    for (uint32_t i = 0; i < length; i++) {
+        if (i == 0 || (addr + i) % PAGE_SIZE == 0) { // each page is a separate program operation
+            uint32_t pageBytes = min(PAGE_SIZE - (addr + i) % PAGE_SIZE, length - i);
+            waitReady();
+            s_busNanos += (COMMAND_BYTES + pageBytes) * BYTE_NANOS;
+            m_busyUntilNanos = s_busNanos + PAGE_PROGRAM_NANOS;
+            m_pagePrograms++;
+            if (pageBytes < PAGE_SIZE) { m_partialPrograms++; }
+        }
+        if (m_cutArmed && m_cutRemaining == 0) {
+            // power fails part way through this byte, some of its bits are programmed
+            m_tornSeed = m_tornSeed * 1103515245 + 12345;
+            m_memory[addr + i] &= bytes[i] | (uint8_t)(m_tornSeed >> 16);
+            m_powered = false;
+            m_cutArmed = false;
+            return false;
+        }
+        m_memory[addr + i] &= bytes[i];
+        m_bytesProgrammed++;
+        if (m_cutArmed) { m_cutRemaining--; }
+    }
+    return true;
+}
+
+bool SimFlashDevice::eraseSector(uint32_t addr) {
+    if (m_failed || !m_powered || addr >= capacity()) { return false; }
+    waitReady();
+    s_busNanos += COMMAND_BYTES * BYTE_NANOS;
+    m_busyUntilNanos = s_busNanos + SECTOR_ERASE_NANOS;
+    memset(m_memory + addr - addr % m_sectorSize, 0xFF, m_sectorSize);
+    m_sectorsErased++;
+    return true;
+}
+
+// erases the whole device without counting it, for setting up tests
+void SimFlashDevice::eraseAll() {
+    memset(m_memory, 0xFF, capacity());
+}
+
+// the next bytes bytes are programmed normally, then power is lost
+void SimFlashDevice::cutPowerAfter(uint32_t bytes) {
+    m_cutArmed = true;
+    m_cutRemaining = bytes;
+}
+
+// the bus is held until this device finishes its program or erase
+void SimFlashDevice::waitReady() {
+    if (m_busyUntilNanos > s_busNanos) { s_busNanos = m_busyUntilNanos; }
+}
+
+/* - - - - - - DualFlashDevice - - - - - - */
+// constructor
+DualFlashDevice::DualFlashDevice(FlashDevice *chip1, FlashDevice *chip2) {
+    m_chips[0] = chip1;
+    m_chips[1] = chip2;
+    m_mode = STORAGE_MIRRORED;
+    m_failovers = 0;
+}
+
+/* read
+ *  striped reads gather the chunks from both modules. Mirrored reads come from module 1,
+ *  or from module 2 if module 1 fails and is dropped.
+ *  returns false if the data could not be read */
+bool DualFlashDevice::read(uint32_t addr, void *dst, uint32_t length) {
+    if (m_mode == STORAGE_MIRRORED) {
+        if (m_chips[0]->read(addr, dst, length)) { return true; }
+        if (!failover(0)) { return false; }
+    }
+    if (m_mode != STORAGE_STRIPED) { return single()->read(addr, dst, length); }
+
+    for (uint32_t done = 0; done < length; ) {
+        uint32_t pos = addr + done;
+        uint32_t chunk = pos / STORAGE_STRIPE_CHUNK;
+        uint32_t piece = min(STORAGE_STRIPE_CHUNK - pos % STORAGE_STRIPE_CHUNK, length - done);
+        int chip = chunk % 2;
+        if (!m_chips[chip]->read((chunk / 2) * STORAGE_STRIPE_CHUNK + pos % STORAGE_STRIPE_CHUNK, (uint8_t *)dst + done, piece)) {
+            failover(chip);
+            return false;
+        }
+        done += piece;
+    }
+    return true;
+}
+
+/* program
+ *  writes chunk by chunk so one module is sent data while the other is programming.
+ *  A mirrored copy that fails is dropped along with its module if the module stopped responding.
+ *  returns false if the data was not written to every module in use */
+bool DualFlashDevice::program(uint32_t addr, const void *src, uint32_t length) {
+    for (uint32_t done = 0; done < length; ) {
+        uint32_t pos = addr + done;
+        uint32_t chunk = pos / STORAGE_STRIPE_CHUNK;
+        uint32_t piece = min(STORAGE_STRIPE_CHUNK - pos % STORAGE_STRIPE_CHUNK, length - done);
+        const uint8_t *bytes = (const uint8_t *)src + done;
+
+        if (m_mode == STORAGE_STRIPED) {
+            int chip = chunk % 2;
+            if (!m_chips[chip]->program((chunk / 2) * STORAGE_STRIPE_CHUNK + pos % STORAGE_STRIPE_CHUNK, bytes, piece)) {
+                failover(chip);
+                return false;
+            }
+        } else if (m_mode == STORAGE_MIRRORED) {
+            bool written[2];
+            for (int chip = 0; chip < 2; chip++) { written[chip] = m_chips[chip]->program(pos, bytes, piece); }
+            for (int chip = 0; chip < 2; chip++) {
+                if (!written[chip] && !failover(chip)) { return false; }
+            }
+        } else if (!single()->program(pos, bytes, piece)) {
+            return false;
+        }
+        done += piece;
+    }
+    return true;
+}
+
+// erases a sector, in striped mode that is one sector on each module
+bool DualFlashDevice::eraseSector(uint32_t addr) {
+    if (m_mode == STORAGE_STRIPED) {
+        uint32_t chipAddr = addr / sectorSize() * m_chips[0]->sectorSize();
+        for (int chip = 0; chip < 2; chip++) {
+            if (!m_chips[chip]->eraseSector(chipAddr)) {
+                failover(chip);
+                return false;
+            }
+        }
+        return true;
+    }
+    if (m_mode == STORAGE_MIRRORED) {
+        bool erased[2];
+        for (int chip = 0; chip < 2; chip++) { erased[chip] = m_chips[chip]->eraseSector(addr); }
+        for (int chip = 0; chip < 2; chip++) {
+            if (!erased[chip] && !failover(chip)) { return false; }
+        }
+        return true;
+    }
+    return single()->eraseSector(addr);
+}
+
+uint32_t DualFlashDevice::capacity() {
+    if (m_mode == STORAGE_STRIPED) { return 2 * min(m_chips[0]->capacity(), m_chips[1]->capacity()); }
+    if (m_mode == STORAGE_MIRRORED) { return min(m_chips[0]->capacity(), m_chips[1]->capacity()); }
+    return single()->capacity();
+}
+
+uint32_t DualFlashDevice::sectorSize() {
+    if (m_mode == STORAGE_STRIPED) { return 2 * m_chips[0]->sectorSize(); }
+    if (m_mode == STORAGE_MIRRORED) { return m_chips[0]->sectorSize(); }
+    return single()->sectorSize();
+}
+
+bool DualFlashDevice::isResponding() {
+    if (m_mode == STORAGE_STRIPED || m_mode == STORAGE_MIRRORED) {
+        return m_chips[0]->isResponding() && m_chips[1]->isResponding();
+    }
+    return single()->isResponding();
+}
+
+// striped, the module holding addr. Mirrored, either module since both are written together
+bool DualFlashDevice::isBusy(uint32_t addr) {
+    if (m_mode == STORAGE_STRIPED) {
+        uint32_t chunk = addr / STORAGE_STRIPE_CHUNK;
+        return m_chips[chunk % 2]->isBusy((chunk / 2) * STORAGE_STRIPE_CHUNK + addr % STORAGE_STRIPE_CHUNK);
+    }
+    if (m_mode == STORAGE_MIRRORED) { return m_chips[0]->isBusy(addr) || m_chips[1]->isBusy(addr); }
+    return single()->isBusy(addr);
+}
+
+// the copy on module 2, only kept in mirrored mode
+bool DualFlashDevice::readMirror(uint32_t addr, void *dst, uint32_t length) {
+    if (m_mode != STORAGE_MIRRORED) { return false; }
+    return m_chips[1]->read(addr, dst, length);
+}
+
+// changes how the modules are used, the layout changes so data already written is lost
+void DualFlashDevice::setMode(uint8_t mode) {
+    m_mode = mode;
+}
+
+/* checkChips
+ *  drops a module that has stopped responding.
+ *  returns whether the modules in use are responding */
+bool DualFlashDevice::checkChips() {
+    for (int chip = 0; chip < 2; chip++) {
+        if (!m_chips[chip]->isResponding()) { failover(chip); }
+    }
+    return isResponding();
+}
+
+// the module in use when only one is left
+FlashDevice *DualFlashDevice::single() {
+    return m_mode == STORAGE_SINGLE_2 ? m_chips[1] : m_chips[0];
+}
+
+/* failover
+ *  drops a module after a failed operation if it has stopped responding.
+ *  returns whether the module was dropped */
+bool DualFlashDevice::failover(int chipIdx) {
+    if (m_mode != STORAGE_STRIPED && m_mode != STORAGE_MIRRORED) { return false; }
+    if (m_chips[chipIdx]->isResponding()) { return false; } // a bad address or a power cut, not a dead module
+
+    m_mode = chipIdx == 0 ? STORAGE_SINGLE_2 : STORAGE_SINGLE_1;
+    m_failovers++;
+    Serial.print("WARNING: flash module ");
+    Serial.print(chipIdx + 1);
+    Serial.println(" stopped responding, using the other module only. (DualFlashDevice)");
+    return true;
+}
@@ -0,0 +1,222 @@
+/* flashQueue.cpp issues flash reads and writes in the background of the main loop
+ * Usage:
+ *  Modules submit requests with a callback and return to the loop. handleFlashQueue() works
+ *  through the queue a page at a time for up to FLASH_QUEUE_BUDGET_MICROS each iteration and
+ *  polls the modules between pages, so page programs and erases run while samples are taken
+ *  instead of holding up the loop.
+ *
+ * Modules encompassed:
+ *  Science Memory Handling
+ *
+ * Additional files needed for compilation:
+ *  config.hpp
+ *  flashQueue.hpp
+ *  flashDevice.cpp & flashDevice.hpp
+ */
+
+/* - - - - - - Includes - - - - - - */
+// All libraries are put in flashQueue.hpp
+// NS2 headers
+#include "../headers/flashQueue.hpp"
+
+/* Module Variable Definitions */
+FlashQueue flashQueue;
+
+/* - - - - - - Class Definitions - - - - - - */
+
+/* - - - - - - FlashQueue - - - - - - */
+// constructor
+FlashQueue::FlashQueue() {
+    m_head = 0;
+    m_count = 0;
+    m_activeSince = 0;
+}
+
+/* submitRead
+ *  queues a read of length bytes at addr into dst, from the redundant copy if mirror is set.
+ *  returns false if the queue is full */
+bool FlashQueue::submitRead(FlashDevice *device, uint32_t addr, void *dst, uint32_t length,
+                            FlashCallback callback, void *context, bool mirror) {
+    FlashRequest request;
+    request.op = mirror ? FLASH_OP_READ_MIRROR : FLASH_OP_READ;
+    request.device = device;
+    request.addr = addr;
+    request.buffer = (uint8_t *)dst;
+    request.length = length;
+    request.callback = callback;
+    request.context = context;
+    return submit(request);
+}
+
+/* submitProgram
+ *  queues a program of length bytes from src at addr, src is read as the pages are issued.
+ *  returns false if the queue is full */
+bool FlashQueue::submitProgram(FlashDevice *device, uint32_t addr, const void *src, uint32_t length,
+                               FlashCallback callback, void *context) {
+    FlashRequest request;
+    request.op = FLASH_OP_PROGRAM;
+    request.device = device;
+    request.addr = addr;
+    request.buffer = (uint8_t *)src; // never written to for a program
+    request.length = length;
+    request.callback = callback;
+    request.context = context;
+    return submit(request);
+}
+
+/* submitErase
+ *  queues an erase of the sector holding addr.
+ *  returns false if the queue is full */
+bool FlashQueue::submitErase(FlashDevice *device, uint32_t addr, FlashCallback callback, void *context) {
+    FlashRequest request;
+    request.op = FLASH_OP_ERASE;
+    request.device = device;
+    request.addr = addr;
+    request.length = 1; // a single step
+    request.callback = callback;
+    request.context = context;
+    return submit(request);
+}
+
+/* service
+ *  issues queued pages until the budget is spent, the queue is empty or the next module
+ *  is busy. Callbacks run from here, and may submit more requests. */
+void FlashQueue::service(unsigned long budgetMicros) {
+    uint32_t startMicros = micros();
+    while (m_count > 0 && micros() - startMicros < budgetMicros) {
+        FlashRequest &request = m_requests[m_head];
+        if (request.device->isBusy(request.addr + request.done)) { break; } // poll again next iteration
+
+        bool status = step(request);
+        if (!status || request.done >= request.length) { complete(status); }
+    }
+    uint32_t elapsed = micros() - startMicros;
+    if (elapsed > m_stats.maxServiceMicros) { m_stats.maxServiceMicros = elapsed; }
+}
+
+// completes every queued request, waiting on the modules, for startup, shutdown and reusing a buffer
+void FlashQueue::flush() {
+    while (m_count > 0) {
+        FlashRequest &request = m_requests[m_head];
+        bool status = step(request);
+        if (!status || request.done >= request.length) { complete(status); }
+    }
+}
+
+// bytes read or programmed per second while the queue had work
+uint32_t FlashQueue::bytesPerSecond() {
+    uint32_t activeMicros = m_stats.activeMicros + (m_count > 0 ? micros() - m_activeSince : 0);
+    if (activeMicros == 0) { return 0; }
+    return (uint32_t)((uint64_t)m_stats.bytes * 1000000 / activeMicros);
+}
+
+bool FlashQueue::submit(const FlashRequest &request) {
+    if (m_count >= FLASH_QUEUE_DEPTH) {
+        m_stats.refused++;
+        return false;
+    }
+    if (m_count == 0) { m_activeSince = micros(); }
+
+    FlashRequest &queued = m_requests[(m_head + m_count) % FLASH_QUEUE_DEPTH];
+    queued = request;
+    queued.done = 0;
+    queued.submitMicros = micros();
+    m_count++;
+
+    m_stats.submitted++;
+    if (m_count > m_stats.maxDepth) { m_stats.maxDepth = m_count; }
+    return true;
+}
+
+// issues one page of a request, at most FLASH_QUEUE_STEP bytes without crossing a page
+bool FlashQueue::step(FlashRequest &request) {
+    if (request.op == FLASH_OP_ERASE) {
+        request.done = request.length;
+        return request.device->eraseSector(request.addr);
+    }
+
+    uint32_t pos = request.addr + request.done;
+    uint32_t piece = min(FLASH_QUEUE_STEP - pos % FLASH_QUEUE_STEP, request.length - request.done);
+    uint8_t *bytes = request.buffer + request.done;
+    bool status;
+    switch (request.op) {
+        case FLASH_OP_READ:
+            status = request.device->read(pos, bytes, piece);
+            break;
+        case FLASH_OP_READ_MIRROR:
+            status = request.device->readMirror(pos, bytes, piece);
+            break;
+        default:
+            status = request.device->program(pos, bytes, piece);
+            break;
+    }
+    request.done += piece;
+    m_stats.bytes += piece;
+    return status;
+}
+
+// removes the oldest request and runs its callback, which may submit to the freed space
+void FlashQueue::complete(bool status) {
+    FlashRequest request = m_requests[m_head];
+    m_head = (m_head + 1) % FLASH_QUEUE_DEPTH;
+    m_count--;
+
+    uint32_t latency = micros() - request.submitMicros;
+    m_stats.completed++;
+    if (!status) { m_stats.failed++; }
+    m_stats.totalLatencyMicros += latency;
+    if (latency > m_stats.maxLatencyMicros) { m_stats.maxLatencyMicros = latency; }
+    if (m_count == 0) { m_stats.activeMicros += micros() - m_activeSince; }
+
+    if (request.callback != nullptr) { request.callback(request.context, status); }
+}
+
+/* - - - - - - Module Driver Functions - - - - - - */
+
+/* - - - - - - handleFlashQueue - - - - - - *
+ * Usage:
+ *  Works through queued flash requests for up to FLASH_QUEUE_BUDGET_MICROS, call every loop iteration
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  none
+ */
+void handleFlashQueue() {
+    flashQueue.service(FLASH_QUEUE_BUDGET_MICROS);
+}
+
+/* - - - - - - printFlashQueueInfo - - - - - - *
+ * Usage:
+ *  Prints the depth, latency and throughput of the flash queue
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  none
+ */
+void printFlashQueueInfo() {
+    FlashQueueStats stats = flashQueue.getStats();
+    Serial.print("Flash Queue: ");
+    Serial.print(flashQueue.depth());
+    Serial.print(" queued (max ");
+    Serial.print(stats.maxDepth);
+    Serial.print("), ");
+    Serial.print(stats.completed);
+    Serial.print(" done, ");
+    Serial.print(stats.failed);
+    Serial.print(" failed, ");
+    Serial.print(stats.refused);
+    Serial.println(" refused");
+    Serial.print("Flash Queue Timing: ");
+    Serial.print(stats.completed > 0 ? stats.totalLatencyMicros / stats.completed : 0);
+    Serial.print(" us mean latency, ");
+    Serial.print(stats.maxLatencyMicros);
+    Serial.print(" us max, ");
+    Serial.print(flashQueue.bytesPerSecond());
+    Serial.print(" bytes/s, ");
+    Serial.print(stats.maxServiceMicros);
+    Serial.println(" us longest iteration");
+}
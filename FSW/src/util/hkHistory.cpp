@@ -0,0 +1,517 @@
+/* hkHistory.cpp keeps the housekeeping history on flash, compressed
+ * Usage:
+ *  handleHousekeeping() adds every sample to hkHistory. Samples are packed into a block in RAM,
+ *  appended to the record store as a RECORD_HK_HISTORY record once it is full or spans
+ *  HK_BLOCK_MAX_MSEC, so a reset loses at most that much history. HK_HISTORY_BLOCKS blocks are
+ *  kept, the oldest is removed past that.
+ *
+ *  Block layout: HkBlockHeader | encoded samples, bit stream, most significant bit first
+ *   first sample  - each quantized value in 32 bits, heater bit
+ *   later samples - time delta-of-delta, each quantized value as a delta from the last, heater bit
+ *  Temperatures are quantized to HK_TEMP_RESOLUTION and volts to HK_VOLTAGE_RESOLUTION, in
+ *  channel order optics, analog, digital temp, analog, digital current, power good. Time
+ *  is millis(), the first sample takes the block's firstMillis. A delta is stored as
+ *   '0'                        - no change
+ *   '10'   + 3 bit signed      - within -4..3
+ *   '110'  + 7 bit signed      - within -64..63
+ *   '1110' + 12 bit signed     - within -2048..2047
+ *   '1111' + 32 bit            - anything else
+ *  Housekeeping moves slowly, most values take one to five bits, and a sample on time one bit.
+ *
+ *  selectHkHistory() picks the blocks of a run within a time range to downlink, downlink() reads
+ *  them one at a time through the flash queue and sends each as a product in frames under
+ *  DOWNLINK_HK_HISTORY_ID. decodeHkBlock() is the reference decoder.
+ *
+ * Modules encompassed:
+ *  Housekeeping
+ *
+ * Additional files needed for compilation:
+ *  config.hpp
+ *  hkHistory.hpp
+ *  housekeeping.hpp
+ *  recordStore.cpp & recordStore.hpp
+ *  faultManager.hpp
+ *  crc.hpp
+ */
+
+/* - - - - - - Includes - - - - - - */
+// All libraries are put in hkHistory.hpp
+// NS2 headers
+#include "../headers/hkHistory.hpp"
+#include "../headers/recordStore.hpp"
+#include "../headers/faultManager.hpp"
+#include "../headers/hammingBlock.hpp"
+#include "../headers/crc.hpp"
+
+/* Module Variable Definitions */
+HkHistory hkHistory;
+
+static const float channelResolution[HK_CHANNELS] = {HK_TEMP_RESOLUTION, HK_TEMP_RESOLUTION, HK_TEMP_RESOLUTION,
+                                                     HK_VOLTAGE_RESOLUTION, HK_VOLTAGE_RESOLUTION, HK_VOLTAGE_RESOLUTION};
+static const int DELTA_BITS[] = {3, 7, 12, 32}; // bits of a delta after 1 to 4 leading ones
+
+// blocks selected for downlink, sent one at a time
+static uint16_t downlinkKeys[HK_HISTORY_BLOCKS + 1]; // record keys oldest first, the last may be the block being filled
+static int downlinkCount = 0;
+static int downlinkNext = 0;                         // block being sent
+static uint16_t downlinkLength = 0;                  // bytes of the block read into the product
+
+/* - - - - - - Helper Functions - - - - - - */
+
+// quantized values of a sample, in channel order
+static void quantizeSample(const HousekeepingData &sample, int32_t values[HK_CHANNELS]) {
+    float raw[HK_CHANNELS] = {sample.opticsTemp, sample.analogTemp, sample.digitalTemp,
+                              sample.analogCurrent, sample.digitalCurrent, sample.digitalRegPG};
+    for (int channel = 0; channel < HK_CHANNELS; channel++) {
+        float steps = raw[channel] / channelResolution[channel];
+        values[channel] = steps > -1e9F && steps < 1e9F ? (int32_t)lroundf(steps) : 0; // also catches NaN
+    }
+}
+
+// sample of quantized values, in channel order
+static void restoreSample(const int32_t values[HK_CHANNELS], HousekeepingData &sample) {
+    sample.opticsTemp = values[0] * channelResolution[0];
+    sample.analogTemp = values[1] * channelResolution[1];
+    sample.digitalTemp = values[2] * channelResolution[2];
+    sample.analogCurrent = values[3] * channelResolution[3];
+    sample.digitalCurrent = values[4] * channelResolution[4];
+    sample.digitalRegPG = values[5] * channelResolution[5];
+}
+
+// header at the start of a block
+static void unpackBlockHeader(const uint8_t *block, HkBlockHeader &header) {
+    size_t bytesCopied = 0;
+    uint8_t *src = (uint8_t *)block;
+    memExtract(src, &header.startCount, sizeof(header.startCount), &bytesCopied);
+    memExtract(src, &header.samples, sizeof(header.samples), &bytesCopied);
+    memExtract(src, &header.firstMillis, sizeof(header.firstMillis), &bytesCopied);
+    memExtract(src, &header.lastMillis, sizeof(header.lastMillis), &bytesCopied);
+    memExtract(src, &header.bitCount, sizeof(header.bitCount), &bytesCopied);
+}
+
+/* - HkBitReader -
+*   Position in the encoded samples of a block while decoding.
+*/
+struct HkBitReader {
+    const uint8_t *stream;
+    uint32_t bitCount;  // bits in the stream
+    uint32_t pos;       // next bit to read
+    bool overrun;       // a read went past bitCount
+};
+
+// reads bits from the stream, most significant first, 0 once it runs out
+static uint32_t readBits(HkBitReader &reader, int bits) {
+    uint32_t value = 0;
+    for (int i = 0; i < bits; i++) {
+        if (reader.pos >= reader.bitCount) {
+            reader.overrun = true;
+            return 0;
+        }
+        value = (value << 1) | ((reader.stream[reader.pos / 8] >> (7 - reader.pos % 8)) & 1);
+        reader.pos++;
+    }
+    return value;
+}
+
+// reads a delta written by HkBlockEncoder::writeDelta()
+static int32_t readDelta(HkBitReader &reader) {
+    int ones = 0;
+    while (ones < 4 && readBits(reader, 1) == 1) { ones++; }
+    if (ones == 0) { return 0; }
+    int bits = DELTA_BITS[ones - 1];
+    uint32_t raw = readBits(reader, bits);
+    if (bits < 32 && ((raw >> (bits - 1)) & 1)) { raw |= 0xFFFFFFFFUL << bits; } // sign extend
+    return (int32_t)raw;
+}
+
+/* - - - - - - Class Definitions - - - - - - */
+
+/* - - - - - - HkBlockEncoder - - - - - - */
+// constructor
+HkBlockEncoder::HkBlockEncoder() {
+    begin(0);
+}
+
+// empties the block for samples of a run
+void HkBlockEncoder::begin(uint16_t startCount) {
+    memset(m_data, 0, sizeof(m_data));
+    m_header = HkBlockHeader();
+    m_header.startCount = startCount;
+    memset(m_last, 0, sizeof(m_last));
+    m_lastDelta = 0;
+}
+
+/* add
+ *  encodes a sample taken at millis after the last one.
+ *  returns false if the block is full */
+bool HkBlockEncoder::add(const HousekeepingData &sample, uint32_t millis) {
+    uint32_t capacity = (HK_BLOCK_MEMSIZE - HkBlockHeader::MEMSIZE) * 8;
+    if (m_header.bitCount + MAX_SAMPLE_BITS > capacity || m_header.samples == UINT16_MAX) { return false; }
+
+    int32_t values[HK_CHANNELS];
+    quantizeSample(sample, values);
+    if (m_header.samples == 0) {
+        m_header.firstMillis = millis;
+        for (int channel = 0; channel < HK_CHANNELS; channel++) { writeBits((uint32_t)values[channel], 32); }
+    } else {
+        // differences wrap, the decoder adds them back the same way
+        uint32_t delta = millis - m_header.lastMillis;
+        writeDelta((int32_t)(delta - m_lastDelta));
+        m_lastDelta = delta;
+        for (int channel = 0; channel < HK_CHANNELS; channel++) {
+            writeDelta((int32_t)((uint32_t)values[channel] - (uint32_t)m_last[channel]));
+        }
+    }
+    writeBits(sample.heaterOn, 1);
+
+    memcpy(m_last, values, sizeof(m_last));
+    m_header.lastMillis = millis;
+    m_header.samples++;
+    return true;
+}
+
+// the block with its header, length() bytes
+const uint8_t *HkBlockEncoder::getData() {
+    size_t bytesCopied = 0;
+    memAppend(m_data, &m_header.startCount, sizeof(m_header.startCount), &bytesCopied);
+    memAppend(m_data, &m_header.samples, sizeof(m_header.samples), &bytesCopied);
+    memAppend(m_data, &m_header.firstMillis, sizeof(m_header.firstMillis), &bytesCopied);
+    memAppend(m_data, &m_header.lastMillis, sizeof(m_header.lastMillis), &bytesCopied);
+    memAppend(m_data, &m_header.bitCount, sizeof(m_header.bitCount), &bytesCopied);
+    return m_data;
+}
+
+// appends the low bits of value to the stream, most significant first
+void HkBlockEncoder::writeBits(uint32_t value, int bits) {
+    uint8_t *stream = m_data + HkBlockHeader::MEMSIZE;
+    for (int i = bits - 1; i >= 0; i--) {
+        uint32_t pos = m_header.bitCount++;
+        if ((value >> i) & 1) { stream[pos / 8] |= 0x80 >> (pos % 8); }
+    }
+}
+
+// appends a delta in the narrowest bucket that holds it
+void HkBlockEncoder::writeDelta(int32_t delta) {
+    if (delta == 0) {
+        writeBits(0, 1);
+        return;
+    }
+    int bucket = 0;
+    while (bucket < 3 && (delta < -(1L << (DELTA_BITS[bucket] - 1)) || delta >= (1L << (DELTA_BITS[bucket] - 1)))) { bucket++; }
+    writeBits(0xF, bucket + 1); // one more leading one for each wider bucket
+    if (bucket < 3) { writeBits(0, 1); }
+    writeBits((uint32_t)delta, DELTA_BITS[bucket]);
+}
+
+/* - - - - - - HkHistory - - - - - - */
+// constructor
+HkHistory::HkHistory() {
+    m_count = 0;
+    m_nextKey = 0;
+    m_startCount = 0;
+}
+
+/* begin
+ *  indexes the history blocks in the record store, oldest first, and starts a block for this
+ *  run. Call once the store is mounted.
+ *  returns false if the store is not mounted */
+bool HkHistory::begin() {
+    static uint32_t seqs[RECORD_MAX_RECORDS];
+    static int16_t records[RECORD_MAX_RECORDS];
+    m_count = 0;
+    m_nextKey = 0;
+    m_startCount = payloadData.startCount;
+    m_current.begin(m_startCount);
+    if (!recordStore.isMounted()) { return false; }
+
+    // blocks in order of record seq, the order they were written
+    int found = 0;
+    for (int idx = 0; idx < recordStore.count(); idx++) {
+        RecordInfo &info = recordStore.getRecord(idx);
+        if (info.type != RECORD_HK_HISTORY) { continue; }
+        int pos = found++;
+        while (pos > 0 && seqs[pos - 1] > info.seq) {
+            seqs[pos] = seqs[pos - 1];
+            records[pos] = records[pos - 1];
+            pos--;
+        }
+        seqs[pos] = info.seq;
+        records[pos] = idx;
+    }
+
+    // the newest HK_HISTORY_BLOCKS are indexed
+    int first = max(found - HK_HISTORY_BLOCKS, 0);
+    for (int i = first; i < found; i++) {
+        uint8_t packed[HkBlockHeader::MEMSIZE];
+        HkBlockIndex &entry = m_index[m_count];
+        entry.key = recordStore.getRecord(records[i]).key;
+        if (!recordStore.read(records[i], packed, 0, HkBlockHeader::MEMSIZE)) { continue; }
+        unpackBlockHeader(packed, entry.header);
+        m_count++;
+    }
+    if (found > 0) { m_nextKey = recordStore.getRecord(records[found - 1]).key + 1; }
+
+    // older ones are removed, by key since removing a record moves others in the store index
+    uint16_t *excess = (uint16_t *)seqs;
+    for (int i = 0; i < first; i++) { excess[i] = recordStore.getRecord(records[i]).key; }
+    for (int i = 0; i < first; i++) { recordStore.remove(recordStore.find(RECORD_HK_HISTORY, excess[i])); }
+    return true;
+}
+
+/* add
+ *  adds a sample taken at millis to the block being filled, storing the block first if it is
+ *  full or spans HK_BLOCK_MAX_MSEC */
+void HkHistory::add(const HousekeepingData &sample, uint32_t millis) {
+    m_stats.samples++;
+    HkBlockHeader &header = m_current.getHeader();
+    if (header.samples > 0 && millis - header.firstMillis >= HK_BLOCK_MAX_MSEC) { seal(); }
+    if (!m_current.add(sample, millis)) {
+        seal();
+        m_current.add(sample, millis);
+    }
+}
+
+/* seal
+ *  appends the block being filled to the record store and starts the next one, removing the
+ *  oldest block past HK_HISTORY_BLOCKS. An empty block is not stored.
+ *  returns false if the block could not be stored, its samples are lost */
+bool HkHistory::seal() {
+    HkBlockHeader header = m_current.getHeader();
+    if (header.samples == 0) { return true; }
+
+    bool status = recordStore.append(RECORD_HK_HISTORY, m_nextKey, m_current.getData(), m_current.length());
+    if (status) {
+        if (m_count == HK_HISTORY_BLOCKS) { removeOldest(); }
+        m_index[m_count].key = m_nextKey;
+        m_index[m_count].header = header;
+        m_count++;
+        m_nextKey++;
+        m_stats.blocksWritten++;
+        m_stats.storedSamples += header.samples;
+        m_stats.encodedBits += header.bitCount;
+    } else {
+        m_stats.blocksLost++;
+        Serial.print("WARNING: housekeeping history block could not be stored, samples lost. ");
+        Serial.println("(Housekeeping Module - HkHistory::seal() func)");
+    }
+    m_current.begin(m_startCount);
+    return status;
+}
+
+/* findBlocks
+ *  finds the stored blocks of a run with samples from fromMillis to toMillis, using only the index.
+ *  returns the number of blocks, their positions in the index are put in blocks, oldest first */
+int HkHistory::findBlocks(uint16_t startCount, uint32_t fromMillis, uint32_t toMillis, int blocks[], int maxBlocks) {
+    int found = 0;
+    for (int i = 0; i < m_count && found < maxBlocks; i++) {
+        HkBlockHeader &header = m_index[i].header;
+        if (header.startCount == startCount && header.firstMillis <= toMillis && header.lastMillis >= fromMillis) {
+            blocks[found++] = i;
+        }
+    }
+    return found;
+}
+
+// removes the oldest stored block
+void HkHistory::removeOldest() {
+    if (m_count == 0) { return; }
+    recordStore.remove(recordStore.find(RECORD_HK_HISTORY, m_index[0].key));
+    memmove(m_index, m_index + 1, (m_count - 1) * sizeof(m_index[0]));
+    m_count--;
+    m_stats.blocksRemoved++;
+}
+
+/* - - - - - - Module Driver Functions - - - - - - */
+
+/* - - - - - - initHkHistory - - - - - - *
+ * Usage:
+ *  Indexes the housekeeping history kept on flash, call after the record store is mounted
+ *  and the startup is recorded
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  whether the history can be stored
+ */
+bool initHkHistory() {
+    return hkHistory.begin();
+}
+
+/* - - - - - - decodeHkBlock - - - - - - *
+ * Usage:
+ *  Decodes the samples of a housekeeping history block, the reference for ground software
+ *
+ * Inputs:
+ *  block - the block, header first
+ *  length - bytes of block
+ *  points - decoded samples are put here, oldest first
+ *  maxPoints - most samples to decode
+ *
+ * Outputs:
+ *  number of samples decoded, -1 if the block is truncated or corrupted
+ */
+int decodeHkBlock(const uint8_t *block, uint32_t length, HkHistoryPoint points[], int maxPoints) {
+    if (length < (uint32_t)HkBlockHeader::MEMSIZE) { return -1; }
+    HkBlockHeader header;
+    unpackBlockHeader(block, header);
+    if (header.bitCount > (length - HkBlockHeader::MEMSIZE) * 8) { return -1; }
+
+    HkBitReader reader = {block + HkBlockHeader::MEMSIZE, header.bitCount, 0, false};
+    int32_t values[HK_CHANNELS];
+    uint32_t millis = header.firstMillis;
+    uint32_t delta = 0;
+    int decoded = 0;
+    for (int sample = 0; sample < header.samples && decoded < maxPoints; sample++) {
+        if (sample == 0) {
+            for (int channel = 0; channel < HK_CHANNELS; channel++) { values[channel] = (int32_t)readBits(reader, 32); }
+        } else {
+            delta += (uint32_t)readDelta(reader);
+            millis += delta;
+            for (int channel = 0; channel < HK_CHANNELS; channel++) {
+                values[channel] = (int32_t)((uint32_t)values[channel] + (uint32_t)readDelta(reader));
+            }
+        }
+        bool heaterOn = readBits(reader, 1);
+        if (reader.overrun) { return -1; }
+
+        HkHistoryPoint &point = points[decoded++];
+        point.millis = millis;
+        restoreSample(values, point.sample);
+        point.sample.heaterOn = heaterOn;
+        point.sample.timeMillis = millis;
+    }
+    return decoded;
+}
+
+/* - - - - - - selectHkHistory - - - - - - *
+ * Usage:
+ *  Selects the housekeeping history of a run within a time range for downlink, every block that
+ *  overlaps it. The block being filled is sent last, with the key it will be stored as. Each
+ *  block is sent as a product of its own: "HK" | key (uint16) | length (uint16) | block |
+ *  crc32c of the rest, see readHkHistoryPiece().
+ *
+ * Inputs:
+ *  startCount - run to send, payloadData.startCount of it, 0 for the current run
+ *  fromSec - seconds after the run started, first sample to send
+ *  toSec - seconds after the run started, last sample to send
+ *
+ * Outputs:
+ *  number of blocks selected
+ */
+int selectHkHistory(long startCount, long fromSec, long toSec) {
+    uint16_t run = startCount == 0 ? payloadData.startCount : (uint16_t)startCount;
+    uint32_t fromMillis = (uint32_t)min(max(fromSec, 0L), 4294967L) * 1000;
+    uint32_t toMillis = (uint32_t)min(max(toSec, 0L), 4294967L) * 1000 + 999;
+
+    int blocks[HK_HISTORY_BLOCKS];
+    int found = hkHistory.findBlocks(run, fromMillis, toMillis, blocks, HK_HISTORY_BLOCKS);
+    for (int i = 0; i < found; i++) { downlinkKeys[i] = hkHistory.getBlock(blocks[i]).key; }
+    HkBlockHeader &current = hkHistory.getCurrent().getHeader();
+    if (current.samples > 0 && current.startCount == run && current.firstMillis <= toMillis && current.lastMillis >= fromMillis) {
+        downlinkKeys[found++] = hkHistory.nextKey();
+    }
+    downlinkCount = found;
+    downlinkNext = 0;
+    return found;
+}
+
+// selected blocks not yet sent
+int hkHistoryPiecesLeft() {
+    return downlinkCount - downlinkNext;
+}
+
+/* readHkHistoryPiece
+ *  starts the product of the next selected block: writes its header and reads the block after
+ *  it, through the flash queue if it is stored. Blocks removed since they were selected are
+ *  skipped. The product must hold HK_PIECE_MEMSIZE bytes, finishHkHistoryPiece() completes it.
+ *  returns 1 if the flash queue calls callback once it is read, 0 if it is read already, -1 if
+ *  no block is left or the read could not be queued */
+int readHkHistoryPiece(uint8_t *product, FlashCallback callback, void *context) {
+    while (downlinkNext < downlinkCount) {
+        uint16_t key = downlinkKeys[downlinkNext];
+        int recordIdx = recordStore.find(RECORD_HK_HISTORY, key);
+        bool stored = recordIdx >= 0 && recordStore.getRecord(recordIdx).length <= HK_BLOCK_MEMSIZE;
+        bool filling = !stored && key == hkHistory.nextKey() && hkHistory.getCurrent().getHeader().samples > 0;
+        if (!stored && !filling) { // removed since it was selected
+            downlinkNext++;
+            continue;
+        }
+
+        downlinkLength = stored ? recordStore.getRecord(recordIdx).length : hkHistory.getCurrent().length();
+        char tag[] = "HK";
+        size_t bytesCopied = 0;
+        memAppend(product, tag, 2, &bytesCopied);
+        memAppend(product, &key, sizeof(key), &bytesCopied);
+        memAppend(product, &downlinkLength, sizeof(downlinkLength), &bytesCopied);
+        if (filling) {
+            memcpy(product + HK_PIECE_HEADER_MEMSIZE, hkHistory.getCurrent().getData(), downlinkLength);
+            return 0;
+        }
+        return recordStore.submitRead(recordIdx, product + HK_PIECE_HEADER_MEMSIZE, 0, downlinkLength, callback, context) ? 1 : -1;
+    }
+    return -1;
+}
+
+// appends the crc32c to the block read by readHkHistoryPiece(), returns the size of the product
+size_t finishHkHistoryPiece(uint8_t *product) {
+    size_t bytesCopied = HK_PIECE_HEADER_MEMSIZE + downlinkLength;
+    uint32_t crc = crc32c(product, bytesCopied);
+    memAppend(product, &crc, sizeof(crc), &bytesCopied);
+    return bytesCopied;
+}
+
+// moves on to the next selected block, once the ground has the one sent or it could not be read
+void nextHkHistoryPiece() {
+    if (downlinkNext < downlinkCount) { downlinkNext++; }
+}
+
+/* - - - - - - printHkHistoryInfo - - - - - - *
+ * Usage:
+ *  Prints the housekeeping history blocks on flash, the time they cover and how well the
+ *  samples compress
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  none
+ */
+void printHkHistoryInfo() {
+    HkHistoryStats stats = hkHistory.getStats();
+    uint32_t storedBytes = 0;
+    uint32_t storedSamples = 0;
+    for (int i = 0; i < hkHistory.blockCount(); i++) {
+        HkBlockHeader &header = hkHistory.getBlock(i).header;
+        storedBytes += HkBlockHeader::MEMSIZE + (header.bitCount + 7) / 8;
+        storedSamples += header.samples;
+    }
+    Serial.print("HK History: ");
+    Serial.print(hkHistory.blockCount());
+    Serial.print(" of ");
+    Serial.print(HK_HISTORY_BLOCKS);
+    Serial.print(" block(s) on flash, ");
+    Serial.print(storedSamples);
+    Serial.print(" sample(s) in ");
+    Serial.print(storedBytes);
+    Serial.print(" bytes, ");
+    Serial.print(hkHistory.getCurrent().getHeader().samples);
+    Serial.println(" sample(s) waiting in RAM");
+    Serial.print("HK History Cost: ");
+    Serial.print(stats.blocksWritten);
+    Serial.print(" block(s) written, ");
+    Serial.print(stats.blocksLost);
+    Serial.print(" lost, ");
+    Serial.print(stats.blocksRemoved);
+    Serial.print(" removed as oldest, ");
+    Serial.print(stats.storedSamples > 0 ? (float)stats.encodedBits / stats.storedSamples : 0.0F);
+    Serial.println(" bits per sample");
+    if (hkHistory.blockCount() > 0) {
+        HkBlockHeader &oldest = hkHistory.getBlock(0).header;
+        Serial.print("HK History Oldest: run ");
+        Serial.print(oldest.startCount);
+        Serial.print(", ");
+        Serial.print(oldest.firstMillis / 1000);
+        Serial.println(" s after startup");
+    }
+}
@@ -9,7 +9,7 @@
  *  thermal control
  *
  * Additional files needed for compilation:
- *  none
+ *  hkHistory.cpp & hkHistory.hpp
  */
 
 /* - - - - - - Includes - - - - - - */
@@ -17,12 +17,11 @@
 // NS2 headers
 #include "../headers/housekeeping.hpp"
 #include "../headers/faultManager.hpp"
+#include "../headers/hkHistory.hpp"
 
 
 /* Module Variable Definitions */
 HousekeepingData latestHkSample = HousekeepingData(); // latest point of housekeeping data
-HousekeepingData housekeepingData[HK_SAMPLES_TO_KEEP] = {}; // array to store housekeeping data
-static int hkIndex = 0;
 
 /* - - - - - - Module Driver Functions - - - - - - */
 
@@ -30,7 +29,7 @@ static int hkIndex = 0;
  * Usage:
  *  Handles all housekeeping functions.
  *  Samples temperature and power data, handles thermal control
- *  
+ *  Every sample is kept in the housekeeping history on flash (see hkHistory.cpp)
  * 
  * Inputs:
  *  None
@@ -40,8 +39,6 @@ static int hkIndex = 0;
 void handleHousekeeping() {
     sampleHousekeepingData();
     setHeater();
-    hkIndex++;
-    if (hkIndex >= HK_SAMPLES_TO_KEEP) { hkIndex = 0; }
 }
 
 /* - - - - - - Module Helper Functions - - - - - - */
@@ -76,8 +73,8 @@ void setHeater() {
 
 /* - - - - - - sampleHousekeepingData - - - - - - *
  * Usage:
- *  samples temperature and power data and stores it in housekeepingData,
- *  checks for out-of-bounds values and logs faults if found
+ *  samples temperature and power data into latestHkSample and adds it to the housekeeping
+ *  history, checks for out-of-bounds values and logs faults if found
  * 
  * Inputs:
  *  None
@@ -98,8 +95,9 @@ void sampleHousekeepingData() {
     latestHkSample.analogCurrent = TEENSY_VOLTAGE_RES*(float)analogRead(PIN_AREG_CURR);
     latestHkSample.digitalCurrent = TEENSY_VOLTAGE_RES*(float)analogRead(PIN_DREG_CURR);   
     latestHkSample.digitalRegPG = TEENSY_VOLTAGE_RES*(float)analogRead(PIN_DREG_PG);
-    latestHkSample.timeMillis = millis();
-    housekeepingData[hkIndex] = latestHkSample; // update data array
+    uint32_t sampleMillis = millis();
+    latestHkSample.timeMillis = sampleMillis;
+    hkHistory.add(latestHkSample, sampleMillis); // compressed, stored on flash once a block is full
 
     // Check if values are in acceptable ranges
     // TODO: Log a fault for every case
@@ -171,32 +169,3 @@ float voltageToOpticsTemp(float voltage) {
     float opticsTemp = ( (voltage - OPTICS_THERM_CAL_VOLTAGE) / OPTICS_THERM_GAIN ) + OPTICS_THERM_CAL_TEMP;
     return opticsTemp;
 }
-
-/* - - - - - - getHkData - - - - - - *
- * Usage:
- *  Returns pointer to array of housekeeping data, sorted in ascending cronological order
- * 
- * Inputs:
- *  None
- *  
- * Outputs:
- *  Pointer to array of sorted housekeeping data, type HousekeepingData*
- */
-HousekeepingData *getHkData() {
-    // static array to hold data in time ascending order
-    static HousekeepingData timeSortHkData[HK_SAMPLES_TO_KEEP];
-    int j = 0; // iterator for sorted array index
-
-    // reorder array so that it is ascending in time
-    for (int i = hkIndex; i < HK_SAMPLES_TO_KEEP; i++) {
-        timeSortHkData[j] = housekeepingData[i];
-        j++;
-    } 
-    // loop back to top of array and store remaining values
-    for (int i = 0; i < hkIndex; i++) {
-        timeSortHkData[j] = housekeepingData[i];
-        j++;
-    }
-    // return pointer to sorted array
-    return timeSortHkData;
-}
@@ -0,0 +1,1190 @@
+/* recordStore.cpp keeps science data in a crash consistent log of records on flash
+ * Usage:
+ *  Records are appended one after another: header, payload, commit marker. The header carries
+ *  a sequence number and checksums, the commit marker is written last, so a record cut short by
+ *  a reset has no commit and is skipped. init() mounts the store by reading only headers and
+ *  commit markers and rebuilds the RAM index of live records.
+ *  Records fill one sector at a time. Removing a record (a downlinked file) only clears its live
+ *  flag, once a sector holds no live records handleStorage() erases it while the flash queue is
+ *  idle, so an append takes an already erased sector and does not wait on an erase.
+ *  The store sits on both flash modules, striped or mirrored (see DualFlashDevice). The mode is
+ *  kept in EEPROM and follows a failover to a single module.
+ *  Science records are written and read through the flash queue (submitAppend, submitRead) so
+ *  the main loop does not wait on the modules.
+ *  The scrub counts the errors it finds against the sector they are in. Sectors that collect
+ *  SECTOR_RETIRE_ERRORS are no longer used, and the counts can be downlinked as a small binary
+ *  product (buildErrorMap(), sent in frames by downlink()).
+ *  A window of a science record that needs a bit set to be repaired is written again as a small
+ *  record of its own, a shadow, and reads lay it over the window. Only the damaged pages are
+ *  written, and a reset part way through leaves the window as it was.
+ *
+ * Modules encompassed:
+ *  Science Memory Handling
+ *  Program EDAC
+ *
+ * Additional files needed for compilation:
+ *  config.hpp
+ *  recordStore.hpp
+ *  flashDevice.cpp & flashDevice.hpp
+ *  spiBus.cpp & spiBus.hpp
+ *  flashQueue.cpp & flashQueue.hpp
+ *  crc.cpp & crc.hpp
+ *  faultManager.cpp & faultManager.hpp
+ *  eventUtil.cpp & eventUtil.hpp
+ *  fileCatalog.cpp & fileCatalog.hpp
+ */
+
+/* - - - - - - Includes - - - - - - */
+// All libraries are put in recordStore.hpp
+// NS2 headers
+#include "../headers/recordStore.hpp"
+#include "../headers/hammingBlock.hpp"
+#include "../headers/crc.hpp"
+#include "../headers/faultManager.hpp"
+#include "../headers/eventUtil.hpp"
+#include "../headers/spiBus.hpp"
+#include "../headers/fileCatalog.hpp"
+
+/* Module Variable Definitions */
+RecordStore recordStore;
+
+static const char RECORD_STORE_FILENAME[] = "records.bin";
+static const int RECORD_VERIFY_CHUNK = 256; // bytes read at a time when verifying a payload checksum
+static const uint8_t SECTOR_OBSOLETE = (uint8_t)~SectorHeader::SECTOR_FLAG_OBSOLETE; // sector flags once obsolete
+static SerialFlashDevice recordChip1(RECORD_STORE_FILENAME, RECORD_STORE_MEMSIZE, PIN_FLASH1_CS);
+static SerialFlashDevice recordChip2(RECORD_STORE_FILENAME, RECORD_STORE_MEMSIZE, PIN_FLASH2_CS);
+static BusFlashDevice recordBus1(&recordChip1, &spiBus, SPI_DEVICE_FLASH1); // chunked so a due sample gets the bus
+static BusFlashDevice recordBus2(&recordChip2, &spiBus, SPI_DEVICE_FLASH2);
+static DualFlashDevice storageDevice(&recordBus1, &recordBus2);
+static RecurringEvent storageCheckEvent = RecurringEvent(STORAGE_CHECK_INTERVAL_MSEC);
+static const char *STORAGE_MODE_NAMES[] = {"mirrored", "striped", "module 1 only", "module 2 only"};
+
+/* - - - - - - Class Definitions - - - - - - */
+
+/* - - - - - - RecordStore - - - - - - */
+// constructor
+RecordStore::RecordStore() {
+    m_device = nullptr;
+    m_writeAddr = 0;
+    m_nextSeq = 1;
+    m_count = 0;
+    m_head = -1;
+    m_sectorCount = 0;
+    m_reclaimSector = -1;
+    m_errorsChanged = false;
+    memset(m_sectorErrors, 0, sizeof(m_sectorErrors));
+}
+
+// bytes a record with a payload of length bytes takes in the store
+uint32_t RecordStore::recordMemsize(uint32_t length, bool paged) {
+    if (paged) { return FLASH_PAGE_SIZE + (length + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE * FLASH_PAGE_SIZE; }
+    return RecordHeader::MEMSIZE + ((length + 3) & ~3UL) + RECORD_COMMIT_MEMSIZE;
+}
+
+// position of the commit marker from the start of a record, the end of the header page when paged
+uint32_t RecordStore::commitOffset(uint32_t length, bool paged) {
+    if (paged) { return FLASH_PAGE_SIZE - RECORD_COMMIT_MEMSIZE; }
+    return recordMemsize(length) - RECORD_COMMIT_MEMSIZE;
+}
+
+/* format
+ *  erases every sector of the device, last sector first so an interrupted format
+ *  leaves the start of the log intact, stamps each with its erase count and mounts the empty store.
+ *  The error map carries over when the device has the same sectors and is written again, retired
+ *  sectors are erased but stay retired.
+ *  returns false if a sector could not be erased */
+bool RecordStore::format(FlashDevice *device) {
+    if (pendingAppends() > 0 || m_reclaimSector >= 0) { flashQueue.flush(); } // nothing may be programmed into an erased store
+    int sectorCount = min(device->capacity() / device->sectorSize(), (uint32_t)RECORD_MAX_SECTORS);
+    if (m_device == nullptr || sectorCount != m_sectorCount || device->sectorSize() != m_device->sectorSize()) {
+        memset(m_sectorErrors, 0, sizeof(m_sectorErrors)); // a different layout, the counts are of other sectors
+    }
+    m_device = device;
+    m_sectorCount = sectorCount;
+    m_reclaimSector = -1;
+
+    readSectorHeaders(); // erase counts carry over
+    bool status = true;
+    for (int sector = m_sectorCount - 1; sector >= 0; sector--) {
+        status = eraseSector(sector) && status;
+    }
+
+    uint8_t errors[RECORD_MAX_SECTORS];
+    memcpy(errors, m_sectorErrors, sizeof(errors));
+    bool mounted = mount(device);
+    memcpy(m_sectorErrors, errors, sizeof(errors));
+    for (int sector = 0; sector < m_sectorCount; sector++) { m_errorsChanged = m_errorsChanged || errors[sector] > 0; }
+    return saveErrorMap() && mounted && status;
+}
+
+/* mount
+ *  rebuilds the index from the headers on the device. Each sector header gives the sector's state,
+ *  the opened sector with the newest seq is the one appends continue in. Within a sector the records
+ *  end at the first erased header, erased bytes up to a page boundary are padding before a paged
+ *  record. A header that cannot be read ends its sector, a record without a commit marker is
+ *  stepped over, and when a type and key appears more than once the older record is deleted.
+ *  Shadows of records that have since been replaced or removed are deleted.
+ *  The error map is read back from its record.
+ *  returns false if the device has no room left for a record, even after reclaiming */
+bool RecordStore::mount(FlashDevice *device) {
+    if (pendingAppends() > 0 || m_reclaimSector >= 0) { flashQueue.flush(); }
+    uint32_t startMicros = micros();
+    m_device = device;
+    m_count = 0;
+    m_nextSeq = 1;
+    m_head = -1;
+    m_writeAddr = 0;
+    m_reclaimSector = -1;
+    m_stats = RecordStoreStats();
+    m_sectorCount = min(device->capacity() / device->sectorSize(), (uint32_t)RECORD_MAX_SECTORS);
+
+    uint32_t sectorSize = device->sectorSize();
+    readSectorHeaders();
+    for (int sector = 0; sector < m_sectorCount; sector++) {
+        if (m_sectors[sector].state != SECTOR_USED) { continue; }
+        if (m_sectors[sector].seq >= m_nextSeq) { m_nextSeq = m_sectors[sector].seq + 1; }
+
+        uint32_t end = scanSector(sector);
+        if (m_head < 0 || m_sectors[sector].seq > m_sectors[m_head].seq) {
+            if (m_head >= 0) { m_stats.abandonedBytes += (m_head + 1) * sectorSize - m_writeAddr; }
+            m_head = sector;
+            m_writeAddr = end;
+        } else {
+            m_stats.abandonedBytes += (sector + 1) * sectorSize - end; // never appended to again
+        }
+    }
+
+    linkShadows();
+    loadErrorMap();
+    m_stats.mountMicros = micros() - startMicros;
+    return freeBytes() + reclaimableBytes() >= recordMemsize(0);
+}
+
+/* append
+ *  writes a record and indexes it, replacing any live record with the same type and key.
+ *  A paged record starts on a page and its payload on the next one.
+ *  Once every sector holds live records, records are refused until some are removed.
+ *  returns false if the record does not fit or was not written completely */
+bool RecordStore::append(uint8_t type, uint16_t key, const void *data, uint32_t length, bool paged) {
+    uint32_t addr;
+    if (!reserve(type, key, length, paged, addr)) { return false; }
+
+    RecordHeader header;
+    header.magic = RecordHeader::RECORD_MAGIC;
+    header.type = type;
+    header.seq = m_nextSeq++;
+    header.key = key;
+    header.layout = paged ? RecordHeader::RECORD_LAYOUT_PAGED : RecordHeader::RECORD_LAYOUT_PACKED;
+    header.length = length;
+    header.payloadCrc = crc32c(data, length);
+    uint8_t packed[RecordHeader::MEMSIZE];
+    packHeader(header, packed);
+
+    bool status = program(addr, packed, RecordHeader::MEMSIZE)
+                  && program(addr + payloadOffset(paged), data, length)
+                  && program(addr + commitOffset(length, paged), &RECORD_COMMIT, RECORD_COMMIT_MEMSIZE);
+    if (!status) {
+        m_stats.abandonedBytes += recordMemsize(length, paged);
+        return false;
+    }
+    m_stats.payloadBytes += length;
+
+    RecordInfo info;
+    info.addr = addr;
+    info.length = length;
+    info.seq = header.seq;
+    info.payloadCrc = header.payloadCrc;
+    info.key = key;
+    info.type = type;
+    info.paged = paged;
+    indexRecord(info);
+    return true;
+}
+
+/* submitAppend
+ *  queues a record on the flash queue: header, then payload, then once the payload is programmed
+ *  the commit marker. The record is indexed and callback is run when the commit is programmed.
+ *  data must stay unchanged until then.
+ *  returns false if the record does not fit or the queue has no room, callback is not run */
+bool RecordStore::submitAppend(uint8_t type, uint16_t key, const void *data, uint32_t length,
+                               FlashCallback callback, void *context, bool paged) {
+    PendingAppend *pending = nullptr;
+    for (int i = 0; i < RECORD_MAX_PENDING && pending == nullptr; i++) {
+        if (!m_pending[i].inUse) { pending = &m_pending[i]; }
+    }
+    uint32_t addr;
+    if (pending == nullptr || flashQueue.space() < 2 || !reserve(type, key, length, paged, addr)) { return false; }
+
+    RecordHeader header;
+    header.magic = RecordHeader::RECORD_MAGIC;
+    header.type = type;
+    header.seq = m_nextSeq++;
+    header.key = key;
+    header.layout = paged ? RecordHeader::RECORD_LAYOUT_PAGED : RecordHeader::RECORD_LAYOUT_PACKED;
+    header.length = length;
+    header.payloadCrc = crc32c(data, length);
+    packHeader(header, pending->packed);
+
+    pending->store = this;
+    pending->info.addr = addr;
+    pending->info.length = length;
+    pending->info.seq = header.seq;
+    pending->info.payloadCrc = header.payloadCrc;
+    pending->info.key = key;
+    pending->info.type = type;
+    pending->info.paged = paged;
+    pending->failed = false;
+    pending->inUse = true;
+    pending->callback = callback;
+    pending->context = context;
+
+    // space was checked, both are queued
+    flashQueue.submitProgram(m_device, addr, pending->packed, RecordHeader::MEMSIZE, onAppendHeader, pending);
+    flashQueue.submitProgram(m_device, addr + payloadOffset(paged), data, length, onAppendPayload, pending);
+    m_stats.programmedBytes += RecordHeader::MEMSIZE + length + RECORD_COMMIT_MEMSIZE;
+    return true;
+}
+
+/* submitRead
+ *  queues a read of length bytes of a record payload starting at offset, from the redundant
+ *  copy if mirror is set. The record must not be removed before callback is run. The shadows of
+ *  a repaired record are read over the payload before callback is run.
+ *  returns false if the record or copy cannot be read or the queue is full, callback is not run */
+bool RecordStore::submitRead(int idx, void *dst, uint32_t offset, uint32_t length,
+                             FlashCallback callback, void *context, bool mirror) {
+    if (idx < 0 || idx >= m_count) { return false; }
+    RecordInfo &info = m_records[idx];
+    if (offset > info.length || length > info.length - offset || (mirror && !mirrorMatches(idx))) { return false; }
+    uint32_t addr = info.addr + payloadOffset(info.paged) + offset;
+    if (info.shadows == 0) { return flashQueue.submitRead(m_device, addr, dst, length, callback, context, mirror); }
+
+    PendingRead *pending = nullptr;
+    for (int i = 0; i < RECORD_MAX_PENDING && pending == nullptr; i++) {
+        if (!m_pendingReads[i].inUse) { pending = &m_pendingReads[i]; }
+    }
+    if (pending == nullptr) { return false; }
+    pending->store = this;
+    pending->type = info.type;
+    pending->key = info.key;
+    pending->seq = info.seq;
+    pending->dst = (uint8_t *)dst;
+    pending->offset = offset;
+    pending->length = length;
+    pending->mirror = mirror;
+    pending->callback = callback;
+    pending->context = context;
+    pending->inUse = flashQueue.submitRead(m_device, addr, dst, length, onShadowedRead, pending, mirror);
+    return pending->inUse;
+}
+
+// appends submitted and not yet committed or failed
+int RecordStore::pendingAppends() {
+    int pending = 0;
+    for (int i = 0; i < RECORD_MAX_PENDING; i++) { pending += m_pending[i].inUse; }
+    return pending;
+}
+
+// index of the live record with this type and key, -1 if there is none
+int RecordStore::find(uint8_t type, uint16_t key) {
+    for (int idx = 0; idx < m_count; idx++) {
+        if (m_records[idx].type == type && m_records[idx].key == key) { return idx; }
+    }
+    return -1;
+}
+
+// reads length bytes of a record payload starting at offset
+bool RecordStore::read(int idx, void *dst, uint32_t offset, uint32_t length) {
+    if (idx < 0 || idx >= m_count) { return false; }
+    RecordInfo &info = m_records[idx];
+    if (offset > info.length || length > info.length - offset) { return false; }
+    return readPayload(idx, dst, offset, length, false);
+}
+
+/* readMirror
+ *  reads a record payload from the redundant copy, if the device keeps one.
+ *  returns false without a copy or if the copy holds a different record */
+bool RecordStore::readMirror(int idx, void *dst, uint32_t offset, uint32_t length) {
+    if (idx < 0 || idx >= m_count) { return false; }
+    RecordInfo &info = m_records[idx];
+    if (offset > info.length || length > info.length - offset || !mirrorMatches(idx)) { return false; }
+    return readPayload(idx, dst, offset, length, true);
+}
+
+// checks a record payload against the checksum in its header
+bool RecordStore::verify(int idx) {
+    if (idx < 0 || idx >= m_count) { return false; }
+    RecordInfo &info = m_records[idx];
+    uint8_t chunk[RECORD_VERIFY_CHUNK];
+    uint32_t crc = 0;
+    for (uint32_t pos = 0; pos < info.length; pos += RECORD_VERIFY_CHUNK) {
+        uint32_t length = min((uint32_t)RECORD_VERIFY_CHUNK, info.length - pos);
+        if (!read(idx, chunk, pos, length)) { return false; }
+        crc = crc32c(chunk, length, crc);
+    }
+    return crc == info.payloadCrc;
+}
+
+/* remove
+ *  deletes a record by clearing its live flag on flash and dropping it from the index, with
+ *  its shadows. The sector is reclaimed once it holds no live records. Indices of other records
+ *  may change.
+ *  returns false if the flag could not be written */
+bool RecordStore::remove(int idx) {
+    if (idx < 0 || idx >= m_count) { return false; }
+    RecordInfo info = m_records[idx];
+    bool status = markDeleted(info.addr);
+    m_sectors[sectorOf(info.addr)].live--;
+    m_records[idx] = m_records[--m_count];
+    if (info.shadows > 0) { removeShadows(info.key, 0xFFFFFFFF); }
+    return status;
+}
+
+/* patch
+ *  programs length bytes of a record payload in place, for repairs. Bytes in a window that has
+ *  a shadow are programmed into the shadow. Flash can only clear bits, the caller checks that
+ *  no bit has to be set. Afterwards the header checksum no longer matches the payload, paged
+ *  records keep a checksum in every page for it.
+ *  returns false if the bytes could not be written */
+bool RecordStore::patch(int idx, uint32_t offset, const void *src, uint32_t length) {
+    if (idx < 0 || idx >= m_count) { return false; }
+    RecordInfo &info = m_records[idx];
+    if (offset > info.length || length > info.length - offset) { return false; }
+    if (info.shadows == 0) { return program(info.addr + payloadOffset(info.paged) + offset, src, length); }
+
+    const uint8_t *bytes = (const uint8_t *)src;
+    bool status = true;
+    while (length > 0) {
+        uint32_t window = offset / SHADOW_WINDOW;
+        uint32_t piece = min(length, (window + 1) * SHADOW_WINDOW - offset);
+        int shadowIdx = findShadow(idx, window);
+        uint32_t addr = shadowIdx >= 0 ? m_records[shadowIdx].addr + payloadOffset(true) + offset % SHADOW_WINDOW
+                                       : info.addr + payloadOffset(info.paged) + offset;
+        status = program(addr, bytes, piece) && status;
+        offset += piece;
+        bytes += piece;
+        length -= piece;
+    }
+    return status;
+}
+
+/* writeShadow
+ *  writes a window of a science record payload again as a shadow, for repairs that have to set
+ *  bits. data holds the whole window, the last window of a payload may be short. The window is
+ *  read from the shadow once its commit marker is programmed, a reset before that leaves the
+ *  window as it was. A newer shadow of the window replaces the older one.
+ *  returns false if the shadow could not be written */
+bool RecordStore::writeShadow(int idx, uint32_t window, const void *data) {
+    if (idx < 0 || idx >= m_count) { return false; }
+    RecordInfo target = m_records[idx];
+    if (target.type != RECORD_SCIENCE || target.key > 0xFF || window > 0xFF || window * SHADOW_WINDOW >= target.length) { return false; }
+
+    bool replacing = findShadow(idx, window) >= 0;
+    uint32_t length = min((uint32_t)SHADOW_WINDOW, target.length - window * SHADOW_WINDOW);
+    if (!append(RECORD_SHADOW, shadowKey(target.key, window), data, length, true)) { return false; }
+    idx = find(RECORD_SCIENCE, target.key);
+    if (!replacing && idx >= 0) { m_records[idx].shadows++; }
+    m_stats.shadowWindows++;
+    return true;
+}
+
+// index of the shadow of a window of a record, -1 if the window is read from the record
+int RecordStore::findShadow(int idx, uint32_t window) {
+    if (idx < 0 || idx >= m_count || m_records[idx].shadows == 0 || window > 0xFF) { return -1; }
+    int shadowIdx = find(RECORD_SHADOW, shadowKey(m_records[idx].key, window));
+    return (shadowIdx >= 0 && m_records[shadowIdx].seq > m_records[idx].seq) ? shadowIdx : -1;
+}
+
+/* noteErrors
+ *  counts errors found in a record against the sector it is in, records do not cross sectors.
+ *  Once the sector has SECTOR_RETIRE_ERRORS it is retired. The counts are saved by saveErrorMap() */
+void RecordStore::noteErrors(int idx, int errors) {
+    if (idx < 0 || idx >= m_count || errors <= 0) { return; }
+    int sector = sectorOf(m_records[idx].addr);
+    bool retired = isRetired(sector);
+    m_sectorErrors[sector] = min(m_sectorErrors[sector] + errors, 255);
+    m_errorsChanged = true;
+    if (!retired && isRetired(sector)) {
+        Serial.print("WARNING: record store sector ");
+        Serial.print(sector);
+        Serial.println(" retired, too many errors found in it (recordStore.cpp)");
+    }
+}
+
+/* saveErrorMap
+ *  writes the error count of every sector as a RECORD_ERROR_MAP record, replacing the last one,
+ *  if any count changed since.
+ *  returns false if the record could not be written */
+bool RecordStore::saveErrorMap() {
+    if (!m_errorsChanged || m_device == nullptr) { return true; }
+    if (!append(RECORD_ERROR_MAP, 0, m_sectorErrors, m_sectorCount)) { return false; }
+    m_errorsChanged = false;
+    return true;
+}
+
+/* clearErrorMap
+ *  sets every sector error count back to zero and saves the map, retired sectors are used again.
+ *  returns false if the map could not be saved */
+bool RecordStore::clearErrorMap() {
+    memset(m_sectorErrors, 0, sizeof(m_sectorErrors));
+    m_errorsChanged = true;
+    return saveErrorMap();
+}
+
+/* reclaim
+ *  starts erasing one sector that holds no live records, through the flash queue. Only runs while
+ *  the queue is idle, unless fewer than RECORD_RECLAIM_POOL erased sectors are left. The sector is
+ *  marked obsolete first so a reset part way through the erase cannot bring its records back, and
+ *  is stamped with its erase count once erased. Retired sectors are not reclaimed. */
+void RecordStore::reclaim() {
+    if (m_device == nullptr || m_reclaimSector >= 0 || flashQueue.space() < 2) { return; }
+    if (!flashQueue.isIdle() && countSectors(SECTOR_FREE) >= RECORD_RECLAIM_POOL) { return; }
+
+    // least worn first, so the erased pool is too
+    int sector = -1;
+    for (int i = 0; i < m_sectorCount; i++) {
+        if (isUsable(i) && (sector < 0 || m_sectors[i].eraseCount < m_sectors[sector].eraseCount)) { sector = i; }
+    }
+    if (sector < 0) { return; }
+
+    uint32_t base = sector * m_device->sectorSize();
+    if (m_sectors[sector].state == SECTOR_USED) {
+        flashQueue.submitProgram(m_device, base + SectorHeader::FLAGS_OFFSET, &SECTOR_OBSOLETE, sizeof(SECTOR_OBSOLETE), nullptr, nullptr);
+    }
+    m_sectors[sector].state = SECTOR_ERASING;
+    m_reclaimSector = sector;
+    flashQueue.submitErase(m_device, base, onReclaimErase, this);
+}
+
+// bytes left for new records without erasing, in the head sector and the erased sectors
+uint32_t RecordStore::freeBytes() {
+    if (m_device == nullptr) { return 0; }
+    uint32_t sectorSize = m_device->sectorSize();
+    uint32_t headBytes = m_head >= 0 ? (m_head + 1) * sectorSize - m_writeAddr : 0;
+    int freeSectors = 0;
+    for (int sector = 0; sector < m_sectorCount; sector++) { freeSectors += m_sectors[sector].state == SECTOR_FREE && !isRetired(sector); }
+    return headBytes + freeSectors * (sectorSize - SectorHeader::MEMSIZE);
+}
+
+// bytes for new records in sectors waiting to be erased
+uint32_t RecordStore::reclaimableBytes() {
+    if (m_device == nullptr) { return 0; }
+    return reclaimableSectors() * (m_device->sectorSize() - SectorHeader::MEMSIZE);
+}
+
+/* fits
+ *  whether a record of length bytes can be appended now, at the end of the head sector or in a
+ *  sector that is erased or waiting to be erased, without removing any record */
+bool RecordStore::fits(uint32_t length, bool paged) {
+    if (m_device == nullptr || m_count >= RECORD_MAX_RECORDS) { return false; }
+
+    uint32_t memsize = recordMemsize(length, paged);
+    uint32_t sectorSize = m_device->sectorSize();
+    if (memsize > sectorSize - (paged ? FLASH_PAGE_SIZE : SectorHeader::MEMSIZE)) { return false; }
+    if (m_head >= 0 && !isRetired(m_head)) { // the same test as reserve()
+        uint32_t start = paged ? (m_writeAddr + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE * FLASH_PAGE_SIZE : m_writeAddr;
+        uint32_t sectorEnd = (m_head + 1) * sectorSize;
+        if (start <= sectorEnd && memsize <= sectorEnd - start) { return true; }
+    }
+    for (int sector = 0; sector < m_sectorCount; sector++) {
+        if (m_sectors[sector].state == SECTOR_FREE && !isRetired(sector)) { return true; }
+    }
+    return reclaimableSectors() > 0;
+}
+
+// sectors in a state
+int RecordStore::countSectors(uint8_t state) {
+    int sectors = 0;
+    for (int sector = 0; sector < m_sectorCount; sector++) { sectors += m_sectors[sector].state == state; }
+    return sectors;
+}
+
+// sectors that are dirty, being erased or hold no live records, and are not retired
+int RecordStore::reclaimableSectors() {
+    int sectors = 0;
+    for (int sector = 0; sector < m_sectorCount; sector++) {
+        sectors += isUsable(sector) || m_sectors[sector].state == SECTOR_ERASING;
+    }
+    return sectors;
+}
+
+// sectors with too many errors to be used again
+int RecordStore::retiredSectors() {
+    int sectors = 0;
+    for (int sector = 0; sector < m_sectorCount; sector++) { sectors += isRetired(sector); }
+    return sectors;
+}
+
+/* reserve
+ *  claims space for a record at the end of the head sector, opening a new sector if it does
+ *  not fit or the head has been retired. A record that fails part way is never written over.
+ *  returns false if the record does not fit */
+bool RecordStore::reserve(uint8_t type, uint16_t key, uint32_t length, bool paged, uint32_t &addr) {
+    if (m_device == nullptr) { return false; }
+
+    uint32_t memsize = recordMemsize(length, paged);
+    uint32_t sectorSize = m_device->sectorSize();
+    uint32_t firstRecord = paged ? FLASH_PAGE_SIZE : SectorHeader::MEMSIZE; // paged records start on a page
+    if (memsize > sectorSize - firstRecord) { return false; }
+    if (m_count >= RECORD_MAX_RECORDS && find(type, key) < 0) { return false; }
+
+    // records do not cross sectors
+    uint32_t start = paged ? (m_writeAddr + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE * FLASH_PAGE_SIZE : m_writeAddr;
+    uint32_t sectorEnd = (m_head + 1) * sectorSize;
+    if (m_head < 0 || isRetired(m_head) || start > sectorEnd || memsize > sectorEnd - start) {
+        uint32_t tail = m_head >= 0 ? sectorEnd - m_writeAddr : 0;
+        if (!openSector()) { return false; }
+        m_stats.abandonedBytes += tail;
+        start = m_writeAddr - SectorHeader::MEMSIZE + firstRecord;
+    }
+
+    m_stats.abandonedBytes += start - m_writeAddr;
+    addr = start;
+    m_writeAddr = start + memsize;
+    return true;
+}
+
+/* openSector
+ *  makes the least worn erased sector the head. If none are erased the sector being reclaimed
+ *  is waited for, or failing that a sector is erased now. Retired sectors are never opened.
+ *  returns false if no sector could be opened */
+bool RecordStore::openSector() {
+    int sector = -1;
+    for (int pass = 0; pass < 3 && sector < 0; pass++) {
+        if (pass == 1) {
+            if (m_reclaimSector < 0) { continue; }
+            flashQueue.flush(); // finishes the erase
+        }
+        for (int i = 0; i < m_sectorCount; i++) {
+            bool usable = pass < 2 ? m_sectors[i].state == SECTOR_FREE && !isRetired(i) : isUsable(i);
+            if (usable && (sector < 0 || m_sectors[i].eraseCount < m_sectors[sector].eraseCount)) { sector = i; }
+        }
+        if (pass == 2 && sector >= 0) {
+            m_stats.foregroundErases++;
+            if (!eraseSector(sector)) { return false; }
+        }
+    }
+    if (sector < 0) { return false; }
+
+    uint32_t seq = m_nextSeq++;
+    uint32_t packed[2] = {seq, ~seq};
+    uint32_t base = sector * m_device->sectorSize();
+    if (!program(base + SectorHeader::SEQ_OFFSET, packed, sizeof(packed))) {
+        m_sectors[sector].state = SECTOR_DIRTY;
+        return false;
+    }
+    m_sectors[sector].state = SECTOR_USED;
+    m_sectors[sector].seq = seq;
+    m_sectors[sector].live = 0;
+    m_head = sector;
+    m_writeAddr = base + SectorHeader::MEMSIZE;
+    return true;
+}
+
+/* eraseSector
+ *  marks a sector obsolete, erases it and stamps it with its new erase count.
+ *  returns false if it could not be erased or stamped, it is left dirty */
+bool RecordStore::eraseSector(int sector) {
+    uint32_t base = sector * m_device->sectorSize();
+    if (m_sectors[sector].state == SECTOR_USED) { program(base + SectorHeader::FLAGS_OFFSET, &SECTOR_OBSOLETE, sizeof(SECTOR_OBSOLETE)); }
+
+    m_sectors[sector].state = SECTOR_DIRTY;
+    m_sectors[sector].live = 0;
+    if (!m_device->eraseSector(base)) {
+        m_stats.eraseFailures++;
+        return false;
+    }
+    m_sectors[sector].eraseCount++;
+    uint8_t stamp[SectorHeader::STAMP_MEMSIZE];
+    packStamp(m_sectors[sector].eraseCount, stamp);
+    if (!program(base, stamp, sizeof(stamp))) {
+        m_stats.eraseFailures++;
+        return false;
+    }
+    m_sectors[sector].state = SECTOR_FREE;
+    return true;
+}
+
+// whether a sector is opened and holds no live records, with no append in or going to it
+bool RecordStore::isDead(int sector) {
+    if (m_sectors[sector].state != SECTOR_USED || m_sectors[sector].live > 0 || sector == m_head) { return false; }
+    for (int i = 0; i < RECORD_MAX_PENDING; i++) {
+        if (m_pending[i].inUse && sectorOf(m_pending[i].info.addr) == sector) { return false; }
+    }
+    return true;
+}
+
+// reads the error counts back from the error map record, all zero if there is none
+void RecordStore::loadErrorMap() {
+    memset(m_sectorErrors, 0, sizeof(m_sectorErrors));
+    m_errorsChanged = false;
+    int idx = find(RECORD_ERROR_MAP, 0);
+    if (idx < 0 || m_records[idx].length != (uint32_t)m_sectorCount || !read(idx, m_sectorErrors, 0, m_sectorCount)
+        || crc32c(m_sectorErrors, m_sectorCount) != m_records[idx].payloadCrc) {
+        memset(m_sectorErrors, 0, sizeof(m_sectorErrors));
+    }
+}
+
+/* readSectorHeaders
+ *  sets the state, erase count and seq of every sector from its header. A sector without a
+ *  readable stamp may not be fully erased and is dirty, it is taken to be as worn as the most
+ *  worn sector */
+void RecordStore::readSectorHeaders() {
+    bool stamped[RECORD_MAX_SECTORS];
+    uint32_t maxEraseCount = 0;
+    for (int sector = 0; sector < m_sectorCount; sector++) {
+        stamped[sector] = readSectorHeader(sector);
+        if (stamped[sector]) { maxEraseCount = max(maxEraseCount, m_sectors[sector].eraseCount); }
+    }
+    for (int sector = 0; sector < m_sectorCount; sector++) {
+        if (!stamped[sector]) { m_sectors[sector].eraseCount = maxEraseCount; }
+    }
+}
+
+// reads the header of a sector, returns false if it has no readable stamp
+bool RecordStore::readSectorHeader(int sector) {
+    SectorInfo &info = m_sectors[sector];
+    info = SectorInfo();
+    uint8_t packed[SectorHeader::MEMSIZE];
+    if (!m_device->read(sector * m_device->sectorSize(), packed, sizeof(packed))) { return false; }
+
+    SectorHeader header;
+    uint8_t spare;
+    uint32_t eraseCheck;
+    uint32_t seqCheck;
+    size_t bytesCopied = 0;
+    memExtract(packed, &header.magic, sizeof(header.magic), &bytesCopied);
+    memExtract(packed, &header.flags, sizeof(header.flags), &bytesCopied);
+    memExtract(packed, &spare, sizeof(spare), &bytesCopied);
+    memExtract(packed, &header.eraseCount, sizeof(header.eraseCount), &bytesCopied);
+    memExtract(packed, &eraseCheck, sizeof(eraseCheck), &bytesCopied);
+    memExtract(packed, &header.seq, sizeof(header.seq), &bytesCopied);
+    memExtract(packed, &seqCheck, sizeof(seqCheck), &bytesCopied);
+
+    if (header.magic != SectorHeader::SECTOR_MAGIC || eraseCheck != ~header.eraseCount) { return false; }
+    info.eraseCount = header.eraseCount;
+    if (!(header.flags & SectorHeader::SECTOR_FLAG_OBSOLETE)) { return true; } // erase was cut short
+
+    if (header.seq == 0xFFFFFFFF && seqCheck == 0xFFFFFFFF) {
+        info.state = SECTOR_FREE;
+    } else if (seqCheck == ~header.seq) {
+        info.state = SECTOR_USED;
+        info.seq = header.seq;
+    } // otherwise opening was cut short, before any record was written to it
+    return true;
+}
+
+/* scanSector
+ *  indexes the records of an opened sector.
+ *  returns the address after its last record */
+uint32_t RecordStore::scanSector(int sector) {
+    uint32_t sectorSize = m_device->sectorSize();
+    uint32_t addr = sector * sectorSize + SectorHeader::MEMSIZE;
+    uint32_t sectorEnd = (sector + 1) * sectorSize;
+    uint32_t tailAddr = addr; // start of erased bytes that may be padding before a paged record
+    bool inTail = false;
+
+    while (addr < sectorEnd && sectorEnd - addr >= recordMemsize(0)) {
+        RecordHeader header;
+        bool erased = false;
+        bool valid = readHeader(addr, header, erased);
+        m_stats.headersScanned++;
+
+        if (erased) {
+            // erased bytes before a page boundary may be padding, the records would continue on the page
+            if (addr % FLASH_PAGE_SIZE == 0) { break; }
+            if (!inTail) {
+                tailAddr = addr;
+                inTail = true;
+            }
+            addr = addr - addr % FLASH_PAGE_SIZE + FLASH_PAGE_SIZE;
+            continue;
+        }
+        if (inTail) {
+            m_stats.abandonedBytes += addr - tailAddr;
+            inTail = false;
+        }
+
+        bool paged = header.layout == RecordHeader::RECORD_LAYOUT_PAGED;
+        uint32_t memsize = valid ? recordMemsize(header.length, paged) : 0;
+        if (!valid || header.length > sectorSize || memsize > sectorEnd - addr) {
+            // torn or corrupted header, its length cannot be trusted
+            m_stats.tornHeaders++;
+            m_stats.abandonedBytes += sectorEnd - addr;
+            return sectorEnd;
+        }
+        if (header.seq >= m_nextSeq) { m_nextSeq = header.seq + 1; }
+
+        uint32_t commit = 0;
+        m_device->read(addr + commitOffset(header.length, paged), &commit, sizeof(commit));
+        if (commit != RECORD_COMMIT) {
+            m_stats.uncommitted++;
+            m_stats.abandonedBytes += memsize;
+        } else if (header.flags & RecordHeader::RECORD_FLAG_LIVE) {
+            RecordInfo info;
+            info.addr = addr;
+            info.length = header.length;
+            info.seq = header.seq;
+            info.payloadCrc = header.payloadCrc;
+            info.key = header.key;
+            info.type = header.type;
+            info.paged = paged;
+            indexRecord(info);
+        }
+        addr += memsize;
+    }
+    return inTail ? tailAddr : min(addr, sectorEnd);
+}
+
+// packs the stamp programmed after an erase
+void RecordStore::packStamp(uint32_t eraseCount, uint8_t stamp[SectorHeader::STAMP_MEMSIZE]) {
+    SectorHeader header;
+    header.magic = SectorHeader::SECTOR_MAGIC;
+    header.eraseCount = eraseCount;
+    uint8_t spare = 0xFF;
+    uint32_t eraseCheck = ~eraseCount;
+    size_t bytesCopied = 0;
+    memAppend(stamp, &header.magic, sizeof(header.magic), &bytesCopied);
+    memAppend(stamp, &header.flags, sizeof(header.flags), &bytesCopied);
+    memAppend(stamp, &spare, sizeof(spare), &bytesCopied);
+    memAppend(stamp, &header.eraseCount, sizeof(header.eraseCount), &bytesCopied);
+    memAppend(stamp, &eraseCheck, sizeof(eraseCheck), &bytesCopied);
+}
+
+// packs a header for flash, filling in its checksum
+void RecordStore::packHeader(RecordHeader &header, uint8_t packed[RecordHeader::MEMSIZE]) {
+    size_t bytesCopied = 0;
+    memAppend(packed, &header.magic, sizeof(header.magic), &bytesCopied);
+    memAppend(packed, &header.type, sizeof(header.type), &bytesCopied);
+    memAppend(packed, &header.flags, sizeof(header.flags), &bytesCopied);
+    memAppend(packed, &header.seq, sizeof(header.seq), &bytesCopied);
+    memAppend(packed, &header.key, sizeof(header.key), &bytesCopied);
+    memAppend(packed, &header.layout, sizeof(header.layout), &bytesCopied);
+    memAppend(packed, &header.length, sizeof(header.length), &bytesCopied);
+    memAppend(packed, &header.payloadCrc, sizeof(header.payloadCrc), &bytesCopied);
+    header.headerCrc = headerCrc(packed);
+    memAppend(packed, &header.headerCrc, sizeof(header.headerCrc), &bytesCopied);
+}
+
+// whether the redundant copy holds the same record
+bool RecordStore::mirrorMatches(int idx) {
+    RecordHeader header;
+    bool erased = false;
+    return readHeader(m_records[idx].addr, header, erased, true)
+           && header.seq == m_records[idx].seq && header.payloadCrc == m_records[idx].payloadCrc;
+}
+
+/* readHeader
+ *  reads the header at addr, from the redundant copy if mirror is set.
+ *  erased is set if the header has never been written.
+ *  returns whether the header is intact */
+bool RecordStore::readHeader(uint32_t addr, RecordHeader &header, bool &erased, bool mirror) {
+    uint8_t packed[RecordHeader::MEMSIZE];
+    erased = false;
+    bool status = mirror ? m_device->readMirror(addr, packed, RecordHeader::MEMSIZE)
+                         : m_device->read(addr, packed, RecordHeader::MEMSIZE);
+    if (!status) { return false; }
+
+    erased = true;
+    for (int i = 0; i < RecordHeader::MEMSIZE && erased; i++) { erased = packed[i] == 0xFF; }
+    if (erased) { return false; }
+
+    size_t bytesCopied = 0;
+    memExtract(packed, &header.magic, sizeof(header.magic), &bytesCopied);
+    memExtract(packed, &header.type, sizeof(header.type), &bytesCopied);
+    memExtract(packed, &header.flags, sizeof(header.flags), &bytesCopied);
+    memExtract(packed, &header.seq, sizeof(header.seq), &bytesCopied);
+    memExtract(packed, &header.key, sizeof(header.key), &bytesCopied);
+    memExtract(packed, &header.layout, sizeof(header.layout), &bytesCopied);
+    memExtract(packed, &header.length, sizeof(header.length), &bytesCopied);
+    memExtract(packed, &header.payloadCrc, sizeof(header.payloadCrc), &bytesCopied);
+    memExtract(packed, &header.headerCrc, sizeof(header.headerCrc), &bytesCopied);
+    return header.magic == RecordHeader::RECORD_MAGIC && header.headerCrc == headerCrc(packed);
+}
+
+// crc32c of a packed header, the flags are changed in place so they are read as erased
+uint32_t RecordStore::headerCrc(const uint8_t packed[RecordHeader::MEMSIZE]) {
+    uint8_t copy[RecordHeader::MEMSIZE];
+    memcpy(copy, packed, RecordHeader::MEMSIZE);
+    copy[RecordHeader::FLAGS_OFFSET] = 0xFF;
+    return crc32c(copy, RecordHeader::MEMSIZE - sizeof(uint32_t));
+}
+
+// adds a record to the index, the older of two records with the same type and key is deleted
+void RecordStore::indexRecord(const RecordInfo &info) {
+    int idx = find(info.type, info.key);
+    if (idx >= 0) {
+        if (m_records[idx].seq > info.seq) {
+            markDeleted(info.addr);
+            return;
+        }
+        markDeleted(m_records[idx].addr);
+        m_sectors[sectorOf(m_records[idx].addr)].live--;
+        m_sectors[sectorOf(info.addr)].live++;
+        m_records[idx] = info;
+        if (info.type == RECORD_SCIENCE) { removeShadows(info.key, info.seq); } // repairs of the old record
+        return;
+    }
+    if (m_count >= RECORD_MAX_RECORDS) {
+        Serial.println("WARNING: record store index full, record not indexed (recordStore.cpp)");
+        return;
+    }
+    m_sectors[sectorOf(info.addr)].live++;
+    m_records[m_count++] = info;
+}
+
+// reads a record payload and lays the shadows of its windows over it
+bool RecordStore::readPayload(int idx, void *dst, uint32_t offset, uint32_t length, bool mirror) {
+    RecordInfo &info = m_records[idx];
+    uint32_t addr = info.addr + payloadOffset(info.paged) + offset;
+    bool status = mirror ? m_device->readMirror(addr, dst, length) : m_device->read(addr, dst, length);
+    return status && readShadows(idx, (uint8_t *)dst, offset, length, mirror);
+}
+
+// reads the parts of the shadows of a record that fall within length bytes of its payload from offset over dst
+bool RecordStore::readShadows(int idx, uint8_t *dst, uint32_t offset, uint32_t length, bool mirror) {
+    RecordInfo &info = m_records[idx];
+    if (info.shadows == 0) { return true; }
+    for (int i = 0; i < m_count; i++) {
+        RecordInfo &shadow = m_records[i];
+        if (shadow.type != RECORD_SHADOW || shadow.key >> 8 != info.key || shadow.seq < info.seq) { continue; }
+        uint32_t start = (shadow.key & 0xFF) * SHADOW_WINDOW;
+        uint32_t end = start + shadow.length;
+        if (end <= offset || start >= offset + length) { continue; }
+
+        start = max(start, offset);
+        end = min(end, offset + length);
+        uint32_t addr = shadow.addr + payloadOffset(true) + start % SHADOW_WINDOW;
+        bool status = mirror ? mirrorMatches(i) && m_device->readMirror(addr, dst + start - offset, end - start)
+                             : m_device->read(addr, dst + start - offset, end - start);
+        if (!status) { return false; }
+    }
+    return true;
+}
+
+// removes the shadows of the science record with this key that are older than seq
+void RecordStore::removeShadows(uint16_t key, uint32_t seq) {
+    for (int idx = m_count - 1; idx >= 0; idx--) {
+        if (idx < m_count && m_records[idx].type == RECORD_SHADOW && m_records[idx].key >> 8 == key && m_records[idx].seq < seq) {
+            remove(idx);
+        }
+    }
+}
+
+// after a mount, deletes shadows whose record was replaced or removed and counts the rest against their record
+void RecordStore::linkShadows() {
+    for (int idx = m_count - 1; idx >= 0; idx--) {
+        if (idx >= m_count || m_records[idx].type != RECORD_SHADOW) { continue; }
+        RecordInfo &shadow = m_records[idx];
+        int target = find(RECORD_SCIENCE, shadow.key >> 8);
+        if (target >= 0 && m_records[target].seq < shadow.seq && (shadow.key & 0xFF) * SHADOW_WINDOW < m_records[target].length) {
+            m_records[target].shadows++;
+        } else {
+            remove(idx);
+        }
+    }
+}
+
+bool RecordStore::markDeleted(uint32_t addr) {
+    uint8_t flags = (uint8_t)~RecordHeader::RECORD_FLAG_LIVE;
+    return program(addr + RecordHeader::FLAGS_OFFSET, &flags, sizeof(flags));
+}
+
+bool RecordStore::program(uint32_t addr, const void *src, uint32_t length) {
+    m_stats.programmedBytes += length;
+    return m_device->program(addr, src, length);
+}
+
+// flash queue callbacks of a submitted append, context is its PendingAppend
+void RecordStore::onAppendHeader(void *context, bool status) {
+    if (!status) { ((PendingAppend *)context)->failed = true; }
+}
+
+void RecordStore::onAppendPayload(void *context, bool status) {
+    PendingAppend &pending = *(PendingAppend *)context;
+    RecordStore &store = *pending.store;
+    uint32_t commitAddr = pending.info.addr + commitOffset(pending.info.length, pending.info.paged);
+
+    // the commit is only queued once everything before it is on flash
+    if (!status || pending.failed
+        || !flashQueue.submitProgram(store.m_device, commitAddr, &RECORD_COMMIT, RECORD_COMMIT_MEMSIZE, onAppendCommit, context)) {
+        store.finishAppend(pending, false);
+    }
+}
+
+void RecordStore::onAppendCommit(void *context, bool status) {
+    PendingAppend &pending = *(PendingAppend *)context;
+    pending.store->finishAppend(pending, status);
+}
+
+// indexes a committed record, frees its pending slot and runs the caller's callback
+void RecordStore::finishAppend(PendingAppend &pending, bool status) {
+    if (status) {
+        m_stats.payloadBytes += pending.info.length;
+        indexRecord(pending.info);
+    } else {
+        m_stats.abandonedBytes += recordMemsize(pending.info.length, pending.info.paged);
+    }
+    pending.inUse = false;
+    if (pending.callback != nullptr) { pending.callback(pending.context, status); }
+}
+
+// flash queue callbacks of reclaim(), context is the store
+void RecordStore::onReclaimErase(void *context, bool status) {
+    RecordStore &store = *(RecordStore *)context;
+    SectorInfo &sector = store.m_sectors[store.m_reclaimSector];
+    if (status) {
+        sector.eraseCount++;
+        store.packStamp(sector.eraseCount, store.m_stamp);
+        uint32_t base = store.m_reclaimSector * store.m_device->sectorSize();
+        store.m_stats.programmedBytes += sizeof(store.m_stamp);
+        if (flashQueue.submitProgram(store.m_device, base, store.m_stamp, sizeof(store.m_stamp), onReclaimStamp, context)) { return; }
+    }
+    onReclaimStamp(context, false);
+}
+
+void RecordStore::onReclaimStamp(void *context, bool status) {
+    RecordStore &store = *(RecordStore *)context;
+    SectorInfo &sector = store.m_sectors[store.m_reclaimSector];
+    sector.live = 0;
+    if (status) {
+        sector.state = SECTOR_FREE;
+        store.m_stats.reclaimedSectors++;
+    } else {
+        sector.state = SECTOR_DIRTY; // tried again later
+        store.m_stats.eraseFailures++;
+    }
+    store.m_reclaimSector = -1;
+}
+
+// flash queue callback of a submitted read of a record with shadows, context is its PendingRead
+void RecordStore::onShadowedRead(void *context, bool status) {
+    PendingRead &pending = *(PendingRead *)context;
+    RecordStore &store = *pending.store;
+    int idx = store.find(pending.type, pending.key);
+    if (idx < 0 || store.m_records[idx].seq != pending.seq) { status = false; }
+    status = status && store.readShadows(idx, pending.dst, pending.offset, pending.length, pending.mirror);
+    pending.inUse = false;
+    if (pending.callback != nullptr) { pending.callback(pending.context, status); }
+}
+
+/* - - - - - - Module Driver Functions - - - - - - */
+
+/* - - - - - - initRecordStore - - - - - - *
+ * Usage:
+ *  Opens the record store region on both flash modules in the storage mode saved in EEPROM
+ *  and mounts it. A module that cannot be opened is dropped. The store is formatted the first
+ *  time a region is created or when losing a module changes the layout.
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  whether the store is ready for appends
+ */
+bool initRecordStore() {
+    bool created[2] = {false, false};
+    bool opened[2];
+    opened[0] = recordChip1.begin(created[0]);
+    opened[1] = recordChip2.begin(created[1]);
+    if (!opened[0] && !opened[1]) {
+        Serial.println("Failed to open record store region on either flash module (initRecordStore() func)");
+        return false;
+    }
+
+    uint8_t mode = payloadData.storageMode;
+    if (mode > STORAGE_SINGLE_2) { mode = STORAGE_MIRRORED; }
+    storageDevice.setMode(mode);
+    storageDevice.checkChips();
+
+    // a region that could not be opened is not in use either
+    if (!opened[0] && storageDevice.getMode() != STORAGE_SINGLE_2) { storageDevice.setMode(STORAGE_SINGLE_2); }
+    if (!opened[1] && storageDevice.getMode() != STORAGE_SINGLE_1) { storageDevice.setMode(STORAGE_SINGLE_1); }
+
+    uint8_t newMode = storageDevice.getMode();
+    bool relayout = newMode != mode && mode == STORAGE_STRIPED;
+    bool newRegion = (created[0] && newMode != STORAGE_SINGLE_2) || (created[1] && newMode != STORAGE_SINGLE_1);
+    if (newMode != payloadData.storageMode) {
+        if (newMode != mode) { logFault(faultCode::FLASH_MODULE_FAILED); }
+        payloadData.storageMode = newMode;
+        saveEEPROM();
+    }
+
+    bool status = (relayout || newRegion) ? recordStore.format(&storageDevice) : recordStore.mount(&storageDevice);
+    storageCheckEvent.start();
+    printRecordStoreInfo();
+    return status;
+}
+
+/* - - - - - - handleStorage - - - - - - *
+ * Usage:
+ *  Reclaims sectors that hold no live records, writes catalog changes and checks the flash modules
+ *  every STORAGE_CHECK_INTERVAL_MSEC. When a module has been dropped the new mode is saved to EEPROM,
+ *  and striped storage is formatted on the remaining module since half of every record was on the lost one.
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  none
+ */
+void handleStorage() {
+    if (!recordStore.isMounted()) { return; }
+    recordStore.reclaim();
+    fileCatalog.service();
+    if (storageCheckEvent.checkInvoked()) { storageDevice.checkChips(); }
+
+    uint8_t mode = storageDevice.getMode();
+    if (mode == payloadData.storageMode) { return; }
+
+    logFault(faultCode::FLASH_MODULE_FAILED);
+    bool relayout = payloadData.storageMode == STORAGE_STRIPED;
+    payloadData.storageMode = mode;
+    saveEEPROM();
+    if (relayout) {
+        Serial.print("Striped science storage lost with a flash module, ");
+        Serial.print(recordStore.count());
+        Serial.println(" record(s) dropped. Formatting the remaining module.");
+        recordStore.format(&storageDevice);
+        fileCatalog.save();
+    }
+}
+
+/* - - - - - - setStorageMode - - - - - - *
+ * Usage:
+ *  Switches the record store between striped and mirrored storage. The layout changes, so the
+ *  store must be empty (downlinked) and is formatted in the new mode.
+ *
+ * Inputs:
+ *  mode - STORAGE_STRIPED or STORAGE_MIRRORED
+ *
+ * Outputs:
+ *  whether the mode was changed
+ */
+bool setStorageMode(uint8_t mode) {
+    if (mode == storageDevice.getMode()) { return true; }
+    int stored = 0;
+    for (int idx = 0; idx < recordStore.count(); idx++) {
+        uint8_t type = recordStore.getRecord(idx).type;
+        stored += type != RECORD_CATALOG && type != RECORD_ERROR_MAP; // both are written again after the format
+    }
+    if (stored > 0) {
+        Serial.println("Science records still stored, downlink them before changing storage mode.");
+        return false;
+    }
+
+    uint8_t oldMode = storageDevice.getMode();
+    storageDevice.setMode(mode);
+    if (!storageDevice.isResponding()) {
+        Serial.println("Both flash modules must respond to change storage mode.");
+        storageDevice.setMode(oldMode);
+        return false;
+    }
+    payloadData.storageMode = mode;
+    saveEEPROM();
+    bool status = recordStore.format(&storageDevice);
+    fileCatalog.save();
+    return status;
+}
+
+/* - - - - - - printRecordStoreInfo - - - - - - *
+ * Usage:
+ *  Prints record store usage and the cost of the last mount and of appends since
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  none
+ */
+void printRecordStoreInfo() {
+    RecordStoreStats stats = recordStore.getStats();
+    Serial.print("Science Storage: ");
+    Serial.print(STORAGE_MODE_NAMES[storageDevice.getMode()]);
+    Serial.print(", ");
+    Serial.print(storageDevice.getFailovers());
+    Serial.println(" failover(s)");
+    Serial.print("Record Store: ");
+    Serial.print(recordStore.count());
+    Serial.print(" record(s), ");
+    Serial.print(recordStore.freeBytes());
+    Serial.print(" bytes free, ");
+    Serial.print(recordStore.reclaimableBytes());
+    Serial.println(" bytes waiting to be erased");
+    Serial.print("Record Store Sectors: ");
+    Serial.print(recordStore.countSectors(SECTOR_FREE));
+    Serial.print(" erased, ");
+    Serial.print(recordStore.countSectors(SECTOR_USED));
+    Serial.print(" in use, ");
+    Serial.print(recordStore.reclaimableSectors());
+    Serial.print(" to reclaim (");
+    Serial.print(recordStore.countSectors(SECTOR_ERASING));
+    Serial.print(" erasing), ");
+    Serial.print(stats.reclaimedSectors);
+    Serial.print(" reclaimed, ");
+    Serial.print(stats.foregroundErases);
+    Serial.print(" erased by appends, ");
+    Serial.print(stats.eraseFailures);
+    Serial.println(" erase failures");
+    Serial.print("Record Store Erase Counts:");
+    for (int sector = 0; sector < recordStore.sectorCount(); sector++) {
+        Serial.print(" ");
+        Serial.print(recordStore.getSector(sector).eraseCount);
+    }
+    Serial.println();
+    Serial.print("Record Store Errors:");
+    for (int sector = 0; sector < recordStore.sectorCount(); sector++) {
+        Serial.print(" ");
+        Serial.print(recordStore.getSectorErrors(sector));
+    }
+    Serial.print(" (");
+    Serial.print(recordStore.retiredSectors());
+    Serial.println(" retired)");
+    Serial.print("Record Store Mount: ");
+    Serial.print(stats.mountMicros);
+    Serial.print(" us, ");
+    Serial.print(stats.headersScanned);
+    Serial.print(" header(s) read, ");
+    Serial.print(stats.tornHeaders);
+    Serial.print(" torn, ");
+    Serial.print(stats.uncommitted);
+    Serial.println(" uncommitted");
+    Serial.print("Record Store Writes: ");
+    Serial.print(stats.programmedBytes);
+    Serial.print(" bytes programmed for ");
+    Serial.print(stats.payloadBytes);
+    Serial.print(" payload bytes, ");
+    Serial.print(stats.abandonedBytes);
+    Serial.print(" bytes abandoned, ");
+    Serial.print(stats.shadowWindows);
+    Serial.println(" window(s) repaired by shadow");
+}
+
+/* - - - - - - buildErrorMap - - - - - - *
+ * Usage:
+ *  Writes the error count of every record store sector as a binary product, downlinked in
+ *  frames under DOWNLINK_ERROR_MAP_ID: the bytes "EM", the sector count (uint16),
+ *  SECTOR_RETIRE_ERRORS (uint8), one count per sector (uint8) and the crc32c of everything
+ *  before it (uint32), little endian.
+ *
+ * Inputs:
+ *  buffer - holds RecordStore::ERROR_MAP_MEMSIZE bytes
+ *
+ * Outputs:
+ *  bytes written
+ */
+size_t buildErrorMap(uint8_t *buffer) {
+    uint16_t sectorCount = recordStore.sectorCount();
+    uint8_t threshold = SECTOR_RETIRE_ERRORS;
+    char tag[] = "EM";
+    size_t bytesCopied = 0;
+    memAppend(buffer, tag, 2, &bytesCopied);
+    memAppend(buffer, &sectorCount, sizeof(sectorCount), &bytesCopied);
+    memAppend(buffer, &threshold, sizeof(threshold), &bytesCopied);
+    for (int sector = 0; sector < sectorCount; sector++) {
+        uint8_t errors = recordStore.getSectorErrors(sector);
+        memAppend(buffer, &errors, sizeof(errors), &bytesCopied);
+    }
+    uint32_t crc = crc32c(buffer, bytesCopied);
+    memAppend(buffer, &crc, sizeof(crc), &bytesCopied);
+    return bytesCopied;
+}
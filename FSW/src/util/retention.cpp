@@ -0,0 +1,200 @@
+/* retention.cpp decides which stored science window gives way when storage is full
+ * Usage:
+ *  saveBuffer() calls retention.makeRoom() before it takes a catalog slot. Once the catalog
+ *  holds RETENTION_QUOTA_FILES files, or the record store has no room for another window,
+ *  stored windows are evicted one at a time by RETENTION_POLICY until the new one fits:
+ *   RETAIN_SCORED - the lowest score, RETENTION_QUALITY_WEIGHT per quality point less
+ *                   RETENTION_AGE_WEIGHT per window stored after it
+ *   RETAIN_NEWEST - the oldest
+ *   RETAIN_STORED - none, the new window is dropped as before
+ *  Quality is the sample range of the window, saved in its catalog entry: a window that
+ *  crosses the limb sweeps the photodiode from sun to dark, one that stays dark or saturated
+ *  is flat. Each eviction prints one line and is kept in a short log for printRetentionInfo().
+ *
+ * Modules encompassed:
+ *  Science Memory Handling
+ *
+ * Additional files needed for compilation:
+ *  config.hpp
+ *  retention.hpp
+ *  fileCatalog.hpp
+ *  recordStore.hpp
+ *  windowCache.hpp
+ *  blackBox.hpp
+ */
+
+/* - - - - - - Includes - - - - - - */
+// All libraries are put in retention.hpp
+// NS2 headers
+#include "../headers/retention.hpp"
+#include "../headers/fileCatalog.hpp"
+#include "../headers/recordStore.hpp"
+#include "../headers/blackBox.hpp"
+#include "../headers/downlinkTransfer.hpp"
+
+/* Module Variable Definitions */
+Retention retention;
+
+/* - - - - - - Class Definitions - - - - - - */
+
+/* - - - - - - Retention - - - - - - */
+// constructor
+Retention::Retention() {
+    m_logHead = 0;
+    m_logCount = 0;
+}
+
+/* makeRoom
+ *  evicts stored windows until a new window can be saved, never the one in busySlot (being
+ *  read for downlink, -1 if none) or one still being written.
+ *  returns false if the window cannot be saved, it is counted as dropped */
+bool Retention::makeRoom(int busySlot) {
+    int evicted = 0;
+    while (needsRoom()) {
+        int32_t lowest = 0;
+        int newer = 0;
+        int slot = RETENTION_POLICY == RETAIN_STORED ? -1 : pickEviction(busySlot, lowest, newer);
+        if (slot < 0) {
+            m_stats.dropped++;
+            if (evicted > 0) { fileCatalog.save(); } // otherwise saved with the new window
+            return false;
+        }
+        evict(slot, lowest, newer);
+        evicted++;
+    }
+    return true;
+}
+
+/* pickEviction
+ *  chooses the stored window RETENTION_POLICY evicts first, with its score and the number of
+ *  windows stored after it. A window whose record is lost is always chosen first.
+ *  returns its catalog slot, -1 if no window can be evicted */
+int Retention::pickEviction(int busySlot, int32_t &score, int &newer) {
+    static uint16_t slots[MAXFILES];
+    static uint32_t seqs[MAXFILES]; // record seq of each window, 0 if its record is lost
+    int count = 0;
+    for (int slot = 0; slot < MAXFILES; slot++) {
+        if (slot == busySlot || fileCatalog.getEntry(slot).state != FILE_VALID) { continue; }
+        int recordIdx = recordStore.find(RECORD_SCIENCE, slot);
+        slots[count] = slot;
+        seqs[count] = recordIdx >= 0 ? recordStore.getRecord(recordIdx).seq : 0;
+        count++;
+    }
+
+    int chosen = -1;
+    for (int i = 0; i < count; i++) {
+        int after = 0;
+        for (int j = 0; j < count; j++) { after += seqs[j] > seqs[i]; }
+        int32_t value = seqs[i] == 0 ? INT32_MIN : this->score(fileCatalog.getEntry(slots[i]).quality, after);
+        bool lower = RETENTION_POLICY == RETAIN_NEWEST ? after > newer : value < score || (value == score && after > newer);
+        if (chosen < 0 || lower) {
+            chosen = slots[i];
+            score = value;
+            newer = after;
+        }
+    }
+    return chosen;
+}
+
+// value of keeping a window of a quality with newer windows stored after it, higher is kept longer
+int32_t Retention::score(uint8_t quality, int newer) {
+    return (int32_t)(quality * RETENTION_QUALITY_WEIGHT - newer * RETENTION_AGE_WEIGHT);
+}
+
+// eviction decision age places before the newest
+EvictionRecord &Retention::getLog(int age) {
+    return m_log[(m_logHead - 1 - age + 2 * RETENTION_LOG_SIZE) % RETENTION_LOG_SIZE];
+}
+
+// quality of a window from its summary, 0-255 as its sample range approaches RETENTION_FULL_RANGE_BINS
+uint8_t Retention::quality(const WindowSummary &summary) {
+    uint32_t range = summary.maxSample > summary.minSample ? summary.maxSample - summary.minSample : 0;
+    return (uint8_t)min(range * 255 / RETENTION_FULL_RANGE_BINS, (uint32_t)255);
+}
+
+// whether the catalog is at its quota or the record store has no room for another window
+bool Retention::needsRoom() {
+    if (!recordStore.isMounted()) { return false; } // the save fails without evicting anything
+    if (fileCatalog.count() >= min((long)RETENTION_QUOTA_FILES, (long)MAXFILES)) { return true; }
+    return !recordStore.fits(EncodedSciData::PAGED_MEMSIZE, true);
+}
+
+// removes a window and frees its slot, the catalog is saved by the caller
+void Retention::evict(int slot, int32_t score, int newer) {
+    EvictionRecord &record = m_log[m_logHead];
+    record.millis = millis();
+    record.slot = slot;
+    record.quality = fileCatalog.getEntry(slot).quality;
+    record.policy = RETENTION_POLICY;
+    record.newer = newer;
+    record.score = score;
+    m_logHead = (m_logHead + 1) % RETENTION_LOG_SIZE;
+    m_logCount = min(m_logCount + 1, RETENTION_LOG_SIZE);
+
+    // the sector is erased in the background once nothing live is left in it
+    int recordIdx = recordStore.find(RECORD_SCIENCE, slot);
+    if (recordIdx >= 0) { recordStore.remove(recordIdx); }
+    else { m_stats.missing++; }
+    windowCache.invalidate(slot);
+    downlinkTransfer.close(slot);
+    fileCatalog.release(slot);
+    m_stats.evictions++;
+    blackBox.log(BB_EVICTED, 2, slot, score);
+
+    char filename[CATALOG_NAME_SIZE];
+    FileCatalog::slotFilename(slot, filename);
+    Serial.print("Evicted ");
+    Serial.print(filename);
+    Serial.print(": quality ");
+    Serial.print(record.quality);
+    Serial.print(", ");
+    Serial.print(newer);
+    Serial.print(" newer, score ");
+    if (recordIdx >= 0) { Serial.println(score); }
+    else { Serial.println("none (record lost)"); }
+}
+
+/* - - - - - - Module Driver Functions - - - - - - */
+
+/* - - - - - - printRetentionInfo - - - - - - *
+ * Usage:
+ *  Prints the retention policy, the windows evicted and dropped, and the newest eviction
+ *  decisions as slot:score pairs
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  none
+ */
+void printRetentionInfo() {
+    static const char *policyNames[] = {"scored", "newest", "stored"};
+    RetentionStats stats = retention.getStats();
+    Serial.print("Retention: keeps ");
+    Serial.print(RETENTION_POLICY >= 0 && RETENTION_POLICY <= RETAIN_STORED ? policyNames[RETENTION_POLICY] : "?");
+    Serial.print(", quota ");
+    Serial.print(RETENTION_QUOTA_FILES);
+    Serial.print(" file(s), weights ");
+    Serial.print(RETENTION_QUALITY_WEIGHT);
+    Serial.print(" per quality, ");
+    Serial.print(RETENTION_AGE_WEIGHT);
+    Serial.print(" per newer window, ");
+    Serial.print(stats.evictions);
+    Serial.print(" evicted (");
+    Serial.print(stats.missing);
+    Serial.print(" already lost), ");
+    Serial.print(stats.dropped);
+    Serial.println(" new window(s) dropped");
+    if (retention.logCount() == 0) { return; }
+
+    Serial.print("Retention Log (newest first, slot:score):");
+    for (int age = 0; age < retention.logCount(); age++) {
+        EvictionRecord &record = retention.getLog(age);
+        Serial.print(" ");
+        Serial.print(record.slot);
+        Serial.print(":");
+        if (record.score == INT32_MIN) { Serial.print("lost"); }
+        else { Serial.print(record.score); }
+    }
+    Serial.println();
+}
@@ -0,0 +1,589 @@
+/* scrubber.cpp scrubs science files on flash a small step at a time
+ * Usage:
+ *  handleScrub() is called every loop iteration and starts a pass over the stored science files
+ *  SCRUB_MIN_PASS_INTERVAL_MSEC after the last one ends, or when scrubEvent is invoked by
+ *  command. It steps the scrub through scrubFlash() within a budget of bytes read per second
+ *  and never within SCRUB_SAMPLE_GUARD_MSEC of the next sample, in any mode. A step only
+ *  runs while the flash queue is idle and reads at most SCRUB_CHECK_PAGES pages or every row of
+ *  SCRUB_CHUNK_COLUMNS byte columns, so the scrub uses a fixed buffer of a few hundred bytes
+ *  instead of a whole science file and never holds up the loop for long. Corrections are
+ *  programmed over the bytes they change in place, so only the pages holding errors are written.
+ *  A correction that has to set a bit writes its page again as a shadow record instead of the
+ *  whole file (RecordStore::writeShadow()).
+ *  The cursor is kept in EEPROM, initScrubber() carries on with a scrub cut short by a reset.
+ *  Files that showed errors are scrubbed first in the next pass.
+ *
+ * Modules encompassed:
+ *  Science Memory Handling
+ *  Program EDAC
+ *
+ * Additional files needed for compilation:
+ *  config.hpp
+ *  scrubber.hpp
+ *  dataCollection.cpp & dataCollection.hpp
+ *  encodedFile.hpp
+ *  recordStore.cpp & recordStore.hpp
+ *  fileCatalog.cpp & fileCatalog.hpp
+ *  faultManager.cpp & faultManager.hpp
+ *  windowCache.cpp & windowCache.hpp
+ */
+
+/* - - - - - - Includes - - - - - - */
+// All libraries are put in scrubber.hpp
+// NS2 headers
+#include "../headers/scrubber.hpp"
+#include "../headers/recordStore.hpp"
+#include "../headers/flashQueue.hpp"
+#include "../headers/fileCatalog.hpp"
+#include "../headers/faultManager.hpp"
+#include "../headers/crc.hpp"
+#include "../headers/dataCollection.hpp"
+#include "../headers/timing.hpp"
+#include "../headers/windowCache.hpp"
+
+/* Module Variable Definitions */
+Scrubber scrubber;
+
+/* - - - - - - Class Definitions - - - - - - */
+
+/* - - - - - - Scrubber - - - - - - */
+// constructor
+Scrubber::Scrubber() {
+    m_fileOpen = false;
+    m_paged = false;
+    m_anyBad = false;
+    m_fileErrors = false;
+    m_priorityCount = 0;
+    m_foundCount = 0;
+    m_stepsSinceSave = 0;
+    memset(m_badPages, 0, sizeof(m_badPages));
+}
+
+/* start
+ *  starts a scrub of every science file, those that showed errors in the last scrub first */
+void Scrubber::start() {
+    m_cursor = ScrubCursor();
+    m_cursor.phase = SCRUB_CHECK;
+    beginPass();
+    saveCursor();
+}
+
+/* resume
+ *  picks up the cursor saved in EEPROM, call after loadEEPROM() and once the record store
+ *  and catalog are loaded.
+ *  returns whether a scrub was in progress */
+bool Scrubber::resume() {
+    if (payloadData.scrubPhase == SCRUB_IDLE || payloadData.scrubSlot >= MAXFILES) { return false; }
+    m_cursor.phase = SCRUB_CHECK;
+    m_cursor.priority = payloadData.scrubPriorityDone;
+    m_cursor.slot = payloadData.scrubSlot;
+    m_cursor.pos = payloadData.scrubPos;
+    m_cursor.seq = payloadData.scrubSeq;
+    beginPass();
+    return true;
+}
+
+/* step
+ *  takes one step of the scrub. Does nothing while the flash queue has work, a module may
+ *  still be programming.
+ *  returns SCRUB_DONE once every file is scrubbed */
+ScrubStatus Scrubber::step() {
+    if (!isActive()) { return SCRUB_DONE; }
+    if (!recordStore.isMounted()) {
+        stop();
+        return SCRUB_DONE;
+    }
+    if (!flashQueue.isIdle()) { return SCRUB_RUNNING; }
+
+    uint32_t startMicros = micros();
+    ScrubStatus status = SCRUB_RUNNING;
+    int recordIdx = findFile();
+    if (recordIdx < 0) { // past the last slot
+        finishPass();
+        status = SCRUB_DONE;
+    } else if (m_cursor.phase == SCRUB_CHECK) {
+        status = checkPages(recordIdx);
+    } else if (m_cursor.phase == SCRUB_CORRECT) {
+        status = correctColumns(recordIdx);
+    } else {
+        status = verifyPages(recordIdx);
+    }
+
+    uint32_t elapsed = micros() - startMicros;
+    m_stats.steps++;
+    m_stats.cpuMicros += elapsed;
+    if (elapsed > m_stats.maxStepMicros) { m_stats.maxStepMicros = elapsed; }
+    if (status == SCRUB_DONE) { m_lastStats = m_stats; }
+    else if (++m_stepsSinceSave >= SCRUB_SAVE_STEPS) { saveCursor(); }
+    return status;
+}
+
+/* stop
+ *  ends the scrub, nothing is resumed after a reset */
+void Scrubber::stop() {
+    m_cursor.phase = SCRUB_IDLE;
+    m_fileOpen = false;
+    saveCursor();
+}
+
+// loads the priority list saved by the last scrub and counts the bytes to scrub
+void Scrubber::beginPass() {
+    m_fileOpen = false;
+    m_report = ScrubReport();
+    m_stats = ScrubStats();
+    m_foundCount = 0;
+    m_priorityCount = 0;
+    for (int i = 0; i < payloadData.scrubPriorityCount && i < SCRUB_PRIORITY_SLOTS; i++) {
+        if (payloadData.scrubPriority[i] < MAXFILES) { m_priority[m_priorityCount++] = payloadData.scrubPriority[i]; }
+    }
+    for (int slot = 0; slot < MAXFILES; slot++) {
+        int recordIdx = fileCatalog.isValid(slot) ? recordStore.find(RECORD_SCIENCE, slot) : -1;
+        if (recordIdx >= 0) { m_stats.storedBytes += recordStore.getRecord(recordIdx).length; }
+    }
+}
+
+// counts the scrub and saves the files that showed errors to be scrubbed first next time
+void Scrubber::finishPass() {
+    m_lastReport = m_report;
+    payloadData.scrubPasses++;
+    payloadData.scrubPriorityCount = m_foundCount;
+    memcpy(payloadData.scrubPriority, m_found, m_foundCount);
+    stop();
+}
+
+// index of the record of the file at the cursor, moving on past empty slots. A file replaced since
+// the cursor was set is started again. returns -1 past the last slot
+int Scrubber::findFile() {
+    for (; m_cursor.priority < m_priorityCount || m_cursor.slot < MAXFILES; nextFile()) {
+        int slot = currentSlot();
+        if (m_cursor.priority >= m_priorityCount && isPriority(slot)) { continue; } // already scrubbed first
+        int recordIdx = fileCatalog.isValid(slot) ? recordStore.find(RECORD_SCIENCE, slot) : -1;
+        if (recordIdx < 0) { continue; }
+        RecordInfo &info = recordStore.getRecord(recordIdx);
+        if (m_fileOpen && info.seq == m_cursor.seq) { return recordIdx; }
+
+        // not a science file of either layout, leave it
+        if (info.length != (uint32_t)(info.paged ? EncodedSciData::PAGED_MEMSIZE : EncodedSciData::MEMSIZE)) { continue; }
+
+        if (info.seq != m_cursor.seq) {
+            m_cursor.phase = SCRUB_CHECK;
+            m_cursor.pos = 0;
+            m_cursor.seq = info.seq;
+        }
+        m_fileOpen = true;
+        m_paged = info.paged;
+        m_anyBad = false;
+        m_fileErrors = false;
+        memset(m_badPages, 0, sizeof(m_badPages));
+        m_stats.files++;
+        if (!m_paged) { // no checksums, every column is corrected
+            memset(m_badPages, 0xFF, sizeof(m_badPages));
+            m_anyBad = true;
+            m_cursor.phase = SCRUB_CORRECT;
+            m_cursor.pos = 0;
+        }
+        return recordIdx;
+    }
+    return -1;
+}
+
+void Scrubber::nextFile() {
+    if (m_cursor.priority < m_priorityCount) { m_cursor.priority++; }
+    else { m_cursor.slot++; }
+    m_cursor.phase = SCRUB_CHECK;
+    m_cursor.pos = 0;
+    m_fileOpen = false;
+}
+
+// moves on to the next file, noting this one to be scrubbed first next time if it showed errors
+ScrubStatus Scrubber::finishFile() {
+    if (!m_paged) { m_stats.coveredBytes += EncodedSciData::MEMSIZE; }
+    if (m_fileErrors && m_foundCount < SCRUB_PRIORITY_SLOTS) { m_found[m_foundCount++] = currentSlot(); }
+    nextFile();
+    return SCRUB_RUNNING;
+}
+
+bool Scrubber::isPriority(int slot) {
+    for (int i = 0; i < m_priorityCount; i++) {
+        if (m_priority[i] == slot) { return true; }
+    }
+    return false;
+}
+
+// checks the next SCRUB_CHECK_PAGES pages against their checksums
+ScrubStatus Scrubber::checkPages(int recordIdx) {
+    int pages = min(SCRUB_CHECK_PAGES, EncodedSciData::PAGE_COUNT - m_cursor.pos);
+    if (!recordStore.read(recordIdx, m_buffer, m_cursor.pos * FLASH_PAGE_SIZE, pages * FLASH_PAGE_SIZE)) {
+        nextFile(); // unreadable, leave it
+        return SCRUB_RUNNING;
+    }
+    m_stats.bytesRead += pages * FLASH_PAGE_SIZE;
+    m_stats.coveredBytes += pages * FLASH_PAGE_SIZE;
+    for (int i = 0; i < pages; i++) {
+        uint8_t *page = m_buffer + i * FLASH_PAGE_SIZE;
+        uint32_t crc;
+        memcpy(&crc, page + EncodedSciData::PAGE_DATA_SIZE, sizeof(crc));
+        if (crc != crc32c(page, EncodedSciData::PAGE_DATA_SIZE)) {
+            int pageNum = m_cursor.pos + i;
+            m_badPages[pageNum / 8] |= 1 << (pageNum % 8);
+            m_anyBad = true;
+            m_fileErrors = true;
+            m_report.badPages++;
+            recordStore.noteErrors(recordIdx, 1);
+        }
+    }
+    m_cursor.pos += pages;
+    if (m_cursor.pos < EncodedSciData::PAGE_COUNT) { return SCRUB_RUNNING; }
+
+    if (!m_anyBad) { // clean, no need to decode
+        m_stats.cleanFiles++;
+        return finishFile();
+    }
+    m_cursor.phase = SCRUB_CORRECT;
+    m_cursor.pos = 0;
+    return SCRUB_RUNNING;
+}
+
+// scrubs the next run of columns that crosses a bad page and programs the corrections
+ScrubStatus Scrubber::correctColumns(int recordIdx) {
+    const int rows = EncodedSciData::ROW_COUNT;
+    const int rowBytes = EncodedSciData::ROW_BYTES;
+
+    // columns that only cross pages that passed hold no errors
+    while (m_cursor.pos < rowBytes && !EncodedSciData::crossesPage(m_badPages, m_cursor.pos, min(SCRUB_CHUNK_COLUMNS, rowBytes - m_cursor.pos))) {
+        m_cursor.pos += SCRUB_CHUNK_COLUMNS;
+    }
+    if (m_cursor.pos >= rowBytes) {
+        if (!m_paged) { return finishFile(); }
+        m_cursor.phase = SCRUB_VERIFY;
+        m_cursor.pos = 0;
+        return SCRUB_RUNNING;
+    }
+
+    int columns = min(SCRUB_CHUNK_COLUMNS, rowBytes - m_cursor.pos);
+    bool mirrored = true;
+    for (int row = 0; row < rows; row++) {
+        if (!readEncoded(recordIdx, row * rowBytes + m_cursor.pos, m_buffer + row * columns, columns, false)) {
+            nextFile(); // unreadable, leave it
+            return SCRUB_RUNNING;
+        }
+        mirrored = mirrored && readEncoded(recordIdx, row * rowBytes + m_cursor.pos, m_mirror + row * columns, columns, true);
+    }
+
+    ScrubReport scrubInfo = EncodedSciData::scrubChunk(m_buffer, columns, mirrored ? m_mirror : nullptr);
+    m_report.numErrors += scrubInfo.numErrors;
+    m_report.corrected += scrubInfo.corrected;
+    m_report.uncorrected += scrubInfo.uncorrected;
+    m_report.repaired += scrubInfo.repaired;
+    if (scrubInfo.numErrors > 0) { m_fileErrors = true; }
+    if (!m_paged) { recordStore.noteErrors(recordIdx, scrubInfo.numErrors); } // no pages, the blocks are counted
+
+    // program the corrected rows, the bytes that did not change are left alone
+    for (int row = 0; row < rows && scrubInfo.numErrors > 0; row++) {
+        if (!patchEncoded(recordIdx, row * rowBytes + m_cursor.pos, m_buffer + row * columns, columns)) {
+            return finishFile(); // could not be written, tried again next scrub
+        }
+    }
+    m_cursor.pos += columns;
+    return SCRUB_RUNNING;
+}
+
+// checks the next bad page again once its columns are corrected, and repairs its checksum
+ScrubStatus Scrubber::verifyPages(int recordIdx) {
+    while (m_cursor.pos < EncodedSciData::PAGE_COUNT && !isBadPage(m_cursor.pos)) { m_cursor.pos++; }
+    if (m_cursor.pos >= EncodedSciData::PAGE_COUNT) { return finishFile(); }
+
+    uint32_t pageAddr = m_cursor.pos * FLASH_PAGE_SIZE;
+    if (!recordStore.read(recordIdx, m_buffer, pageAddr, FLASH_PAGE_SIZE)) {
+        nextFile(); // unreadable, leave it
+        return SCRUB_RUNNING;
+    }
+    m_stats.bytesRead += FLASH_PAGE_SIZE;
+    uint32_t stored;
+    memcpy(&stored, m_buffer + EncodedSciData::PAGE_DATA_SIZE, sizeof(stored));
+    uint32_t crc = crc32c(m_buffer, EncodedSciData::PAGE_DATA_SIZE);
+    if (crc != stored && !repairBytes(recordIdx, pageAddr + EncodedSciData::PAGE_DATA_SIZE, (uint8_t *)&crc, sizeof(crc))) {
+        return finishFile(); // the checksum itself was hit, or cleared blocks changed the page
+    }
+    m_cursor.pos++;
+    return SCRUB_RUNNING;
+}
+
+// reads length bytes of the encoded file from offset, skipping page checksums. The other copy is
+// the one in the window cache if the file is still there, it is as the file was written
+bool Scrubber::readEncoded(int recordIdx, int offset, uint8_t *dst, int length, bool mirror) {
+    const uint8_t *cached = (mirror && m_paged) ? windowCache.peek(currentSlot(), m_cursor.seq) : nullptr;
+    while (length > 0) {
+        int piece = m_paged ? min(length, EncodedSciData::PAGE_DATA_SIZE - offset % EncodedSciData::PAGE_DATA_SIZE) : length;
+        uint32_t addr = m_paged ? EncodedSciData::pagedOffset(offset) : offset;
+        if (cached != nullptr) {
+            memcpy(dst, cached + addr, piece);
+        } else {
+            bool status = mirror ? recordStore.readMirror(recordIdx, dst, addr, piece) : recordStore.read(recordIdx, dst, addr, piece);
+            if (!status) { return false; }
+            m_stats.bytesRead += piece;
+        }
+        offset += piece;
+        dst += piece;
+        length -= piece;
+    }
+    return true;
+}
+
+// writes the bytes of the encoded file from offset that differ from src, a page at a time.
+// returns false if a page could not be read or written
+bool Scrubber::patchEncoded(int recordIdx, int offset, const uint8_t *src, int length) {
+    while (length > 0) {
+        int piece = m_paged ? min(length, EncodedSciData::PAGE_DATA_SIZE - offset % EncodedSciData::PAGE_DATA_SIZE) : length;
+        uint32_t addr = m_paged ? EncodedSciData::pagedOffset(offset) : offset;
+        piece = min(piece, (int)(RecordStore::SHADOW_WINDOW - addr % RecordStore::SHADOW_WINDOW)); // packed rows cross windows
+        if (!repairBytes(recordIdx, addr, src, piece)) { return false; }
+        offset += piece;
+        src += piece;
+        length -= piece;
+    }
+    return true;
+}
+
+// writes the bytes of a record payload from addr that differ from src, all within one shadow window.
+// They are programmed in place if only bits have to be cleared, otherwise the window is written again
+// as a shadow. returns false if the window could not be read or written
+bool Scrubber::repairBytes(int recordIdx, uint32_t addr, const uint8_t *src, int length) {
+    uint8_t stored[SCRUB_CHUNK_COLUMNS];
+    if (!recordStore.read(recordIdx, stored, addr, length)) { return false; }
+    m_stats.bytesRead += length;
+
+    int changed = 0;
+    bool setsBits = false;
+    for (int i = 0; i < length; i++) {
+        setsBits = setsBits || (src[i] & ~stored[i]) != 0;
+        changed += src[i] != stored[i];
+    }
+    if (changed == 0) { return true; }
+    if (!setsBits) {
+        if (!recordStore.patch(recordIdx, addr, src, length)) { return false; }
+        m_stats.patchedBytes += changed;
+        m_stats.patches++;
+        return true;
+    }
+
+    // the rest of the window is copied as it reads now, with the corrections already made to it
+    uint32_t window = addr / RecordStore::SHADOW_WINDOW;
+    uint32_t windowStart = window * RecordStore::SHADOW_WINDOW;
+    uint32_t windowLength = min((uint32_t)RecordStore::SHADOW_WINDOW, recordStore.getRecord(recordIdx).length - windowStart);
+    uint8_t copy[RecordStore::SHADOW_WINDOW];
+    if (!recordStore.read(recordIdx, copy, windowStart, windowLength)) { return false; }
+    m_stats.bytesRead += windowLength;
+    memcpy(copy + addr - windowStart, src, length);
+    if (!recordStore.writeShadow(recordIdx, window, copy)) { return false; }
+    m_stats.shadowWindows++;
+    return true;
+}
+
+// saves the cursor to EEPROM. Bad pages are not saved, so a file that has any is started again
+void Scrubber::saveCursor() {
+    payloadData.scrubPhase = m_cursor.phase == SCRUB_IDLE ? SCRUB_IDLE : SCRUB_CHECK;
+    payloadData.scrubPriorityDone = m_cursor.priority;
+    payloadData.scrubSlot = m_cursor.slot;
+    payloadData.scrubPos = (m_cursor.phase == SCRUB_CHECK && !m_anyBad) ? m_cursor.pos : 0;
+    payloadData.scrubSeq = m_cursor.seq;
+    saveEEPROM();
+    m_stepsSinceSave = 0;
+}
+
+/* - - - - - - Module Driver Functions - - - - - - */
+
+/* - - - - - - initScrubber - - - - - - *
+ * Usage:
+ *  Carries on with a scrub cut short by a reset, call after the record store and
+ *  file catalog are loaded
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  whether a scrub was resumed
+ */
+bool initScrubber() {
+    if (!scrubber.resume()) { return false; }
+    Serial.print("Resuming flash scrub at file ");
+    Serial.println(scrubber.currentSlot());
+    return true;
+}
+
+/* - - - - - - scrubRate - - - - - - *
+ * Usage:
+ *  Rate the background scrub reads flash at, SCRUB_BYTES_PER_SEC or enough to read the stored
+ *  science files once in SCRUB_PASS_HOURS
+ *
+ * Inputs:
+ *  storedBytes - bytes of science files stored
+ *
+ * Outputs:
+ *  bytes/s
+ */
+uint32_t scrubRate(uint32_t storedBytes) {
+    if (SCRUB_BYTES_PER_SEC > 0) { return SCRUB_BYTES_PER_SEC; }
+    long hours = SCRUB_PASS_HOURS > 0 ? SCRUB_PASS_HOURS : 1;
+    return storedBytes / (hours * 3600UL) + 1;
+}
+
+/* - - - - - - handleScrub - - - - - - *
+ * Usage:
+ *  Runs the background flash scrub, call once per loop iteration in every mode. A pass starts
+ *  SCRUB_MIN_PASS_INTERVAL_MSEC after the last one ends while AUTO_SCRUB is set, or right away
+ *  when scrubEvent is invoked, a commanded pass is not held to the rate. Steps are paced by the
+ *  bytes they read from flash: a step is taken once the budget of scrubRate() bytes/s is in
+ *  credit, up to SCRUB_BURST_BYTES saved while waiting, and not within SCRUB_SAMPLE_GUARD_MSEC
+ *  of the next sample.
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  none
+ */
+void handleScrub() {
+    static bool commanded = false;       // pass started by command, not held to the rate
+    static unsigned long lastPassMillis = 0; // end of the last pass, or startup
+    static unsigned long lastMicros = micros();
+    static int64_t credit = 0;           // byte-microseconds the scrub may still read
+
+    unsigned long nowMicros = micros();
+    unsigned long elapsedMicros = nowMicros - lastMicros;
+    lastMicros = nowMicros;
+
+    if (scrubEvent.checkInvoked()) {
+        if (!scrubber.isActive()) { scrubber.start(); }
+        commanded = true;
+    }
+    if (!scrubber.isActive()) {
+        credit = 0;
+        if (!AUTO_SCRUB || !recordStore.isMounted() || millis() - lastPassMillis < SCRUB_MIN_PASS_INTERVAL_MSEC) { return; }
+        scrubber.start();
+    }
+
+    // leave the loop free for a sample that is about to be taken
+    if (scienceMode.getMode() != SAFE_MODE && dataProcessEvent.remaining() < SCRUB_SAMPLE_GUARD_MSEC) { return; }
+
+    if (!commanded) {
+        const int64_t maxCredit = (int64_t)SCRUB_BURST_BYTES * 1000000;
+        credit += (int64_t)scrubRate(scrubber.getStats().storedBytes) * elapsedMicros;
+        if (credit > maxCredit) { credit = maxCredit; }
+        if (credit <= 0) { return; }
+    }
+
+    uint32_t bytesRead = scrubber.getStats().bytesRead;
+    scrubFlash();
+    credit -= (int64_t)(scrubber.getStats().bytesRead - bytesRead) * 1000000;
+
+    if (!scrubber.isActive()) {
+        commanded = false;
+        lastPassMillis = millis();
+    }
+}
+
+/* - - - - - - printScrubReport - - - - - - *
+ * Usage:
+ *  Prints the totals and costs of the last scrub
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  none
+ */
+void printScrubReport() {
+    ScrubReport report = scrubber.getLastReport();
+    ScrubStats stats = scrubber.getLastStats();
+    Serial.print("Scrub complete - found errors in ");
+    Serial.print(report.numErrors);
+    Serial.print(" block(s), ");
+    Serial.print(report.corrected);
+    Serial.print(" corrected, ");
+    Serial.print(report.repaired);
+    Serial.print(" repaired from mirror, ");
+    Serial.print(report.uncorrected);
+    Serial.print(" cleared, ");
+    Serial.print(report.badPages);
+    Serial.println(" page(s) failed checksum.");
+    Serial.print("Scrub Cost: ");
+    Serial.print(stats.files);
+    Serial.print(" file(s), ");
+    Serial.print(stats.cleanFiles);
+    Serial.print(" clean, ");
+    Serial.print(stats.coveredBytes);
+    Serial.print(" of ");
+    Serial.print(stats.storedBytes);
+    Serial.print(" bytes covered, ");
+    Serial.print(stats.steps);
+    Serial.print(" steps, ");
+    Serial.print(stats.cpuMicros);
+    Serial.print(" us total, ");
+    Serial.print(stats.maxStepMicros);
+    Serial.print(" us longest step, ");
+    Serial.print(stats.patchedBytes);
+    Serial.print(" byte(s) corrected in place in ");
+    Serial.print(stats.patches);
+    Serial.print(" program(s), ");
+    Serial.print(stats.shadowWindows);
+    Serial.println(" page(s) written again as shadows.");
+}
+
+/* - - - - - - printScrubInfo - - - - - - *
+ * Usage:
+ *  Prints the settings of the background scrub, the progress of the current pass and the errors
+ *  found in the last
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  none
+ */
+void printScrubInfo() {
+    Serial.println("Flash Scrub:");
+    Serial.print("  Background Scrub: ");
+    Serial.println(AUTO_SCRUB ? "on" : "off");
+    Serial.print("  Rate: ");
+    if (SCRUB_BYTES_PER_SEC > 0) {
+        Serial.print(SCRUB_BYTES_PER_SEC);
+        Serial.println(" bytes/s");
+    } else {
+        Serial.print("one pass per ");
+        Serial.print(SCRUB_PASS_HOURS);
+        Serial.println(" hour(s)");
+    }
+    Serial.print("  Passes Completed: ");
+    Serial.println(scrubber.getPasses());
+    if (scrubber.isActive()) {
+        ScrubStats stats = scrubber.getStats();
+        Serial.print("  Current Pass: file ");
+        Serial.print(scrubber.currentSlot());
+        Serial.print(", ");
+        Serial.print(stats.coveredBytes);
+        Serial.print(" of ");
+        Serial.print(stats.storedBytes);
+        Serial.print(" bytes covered (");
+        Serial.print(stats.storedBytes > 0 ? (int)(100ULL * stats.coveredBytes / stats.storedBytes) : 100);
+        Serial.print("%), ");
+        Serial.print(scrubber.getReport().numErrors);
+        Serial.print(" block error(s), ");
+        Serial.print(stats.cpuMicros);
+        Serial.println(" us");
+    }
+    ScrubStats last = scrubber.getLastStats();
+    if (last.steps > 0) {
+        Serial.print("  Last Pass: ");
+        Serial.print(last.coveredBytes);
+        Serial.print(" bytes covered, ");
+        Serial.print(scrubber.getLastReport().numErrors);
+        Serial.print(" block error(s), ");
+        Serial.print(scrubber.getLastReport().badPages);
+        Serial.print(" bad page(s), ");
+        Serial.print(last.cpuMicros);
+        Serial.println(" us");
+    }
+    Serial.print("  Files To Scrub First: ");
+    Serial.println(payloadData.scrubPriorityCount);
+}
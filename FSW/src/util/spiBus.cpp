@@ -0,0 +1,265 @@
+/* spiBus.cpp arbitrates the SPI bus shared by the science ADC and the flash modules
+ * Usage:
+ *  initSpiBus() begins the bus once in init(). Science samples are read through spiBus, the
+ *  record store reaches each flash module through a BusFlashDevice. The ADC always comes first:
+ *   polled samples - before every flash chunk the slot check registered by the sampling code
+ *                    is asked whether a sample is due, if so it is read right away and held,
+ *                    scienceMemoryHandling() takes the held sample with the time it was read
+ *   burst samples  - the timer interrupt is masked only during a flash chunk
+ *  so no sample waits longer than one chunk of SPI_FLASH_CHUNK bytes for the bus. Every ADC
+ *  read counts the time since its slot came due in a histogram, and the time each device
+ *  holds the bus is kept for the bus utilization. printSpiBusInfo() reports both.
+ *
+ * Modules encompassed:
+ *  Data Processing
+ *  Science Memory Handling
+ *
+ * Additional files needed for compilation:
+ *  config.hpp
+ *  spiBus.hpp
+ *  flashDevice.cpp & flashDevice.hpp
+ */
+
+/* - - - - - - Includes - - - - - - */
+// All libraries are put in spiBus.hpp
+// NS2 headers
+#include "../headers/spiBus.hpp"
+
+/* Module Variable Definitions */
+static SpiAdcPort scienceAdc(PIN_ADC_CS);
+SpiBus spiBus(&scienceAdc);
+
+/* - - - - - - Class Definitions - - - - - - */
+
+/* - - - - - - SpiAdcPort - - - - - - */
+// constructor
+SpiAdcPort::SpiAdcPort(int chipSelect) : m_settings(ADC_MAX_SPEED, MSBFIRST, SPI_MODE3) {
+    m_chipSelect = chipSelect;
+}
+
+// reads one sample, send 0 to the ADC and receive the bin number
+uint16_t SpiAdcPort::transfer() {
+    SPI.beginTransaction(m_settings);
+    digitalWrite(m_chipSelect, LOW);   // select the ADC
+    uint16_t sample = SPI.transfer16(0x0000);
+    digitalWrite(m_chipSelect, HIGH);  // de-select the ADC
+    SPI.endTransaction();
+    return sample;
+}
+
+/* - - - - - - SpiBus - - - - - - */
+// constructor
+SpiBus::SpiBus(AdcPort *adc) {
+    m_adc = adc;
+    m_spiAdc = adc;
+    m_slotCheck = nullptr;
+    m_begun = false;
+    m_holding = false;
+    m_heldSample = 0;
+    m_heldMicros = 0;
+}
+
+// begins the SPI peripheral, only the first call does anything
+void SpiBus::begin() {
+    if (m_begun) { return; }
+    SPI.begin();
+    pinMode(PIN_ADC_CS, OUTPUT);
+    digitalWrite(PIN_ADC_CS, HIGH);
+    m_begun = true;
+    resetStats();
+}
+
+/* readAdc
+ *  reads the ADC now, counting the time since the sample came due at dueMicros.
+ *  Safe to call from the burst interrupt.
+ *  returns the bin number */
+uint16_t SpiBus::readAdc(uint32_t dueMicros) {
+    uint32_t start = micros();
+    uint16_t sample = m_adc->transfer();
+    m_stats.busyMicros[SPI_DEVICE_ADC] += micros() - start;
+    m_stats.adcReads++;
+    noteLatency((int32_t)(start - dueMicros) > 0 ? start - dueMicros : 0);
+    return sample;
+}
+
+/* takeAdcSample
+ *  takes the polled sample due at dueMicros, the one held if it was read between flash chunks.
+ *  sampleMicros is set to the micros() it was read at.
+ *  returns the bin number */
+uint16_t SpiBus::takeAdcSample(uint32_t dueMicros, uint32_t &sampleMicros) {
+    if (m_holding) {
+        m_holding = false;
+        sampleMicros = m_heldMicros;
+        return m_heldSample;
+    }
+    sampleMicros = micros();
+    return readAdc(dueMicros);
+}
+
+/* yieldToAdc
+ *  gives the bus to the ADC if a polled sample is due, call between flash chunks.
+ *  The sample is held until takeAdcSample(), only one is held */
+void SpiBus::yieldToAdc() {
+    uint32_t dueMicros = 0;
+    if (m_holding || m_slotCheck == nullptr || !m_slotCheck(dueMicros)) { return; }
+    m_heldMicros = micros();
+    m_heldSample = readAdc(dueMicros);
+    m_holding = true;
+    m_stats.heldSamples++;
+}
+
+// counts a flash chunk of bytes that held the bus for busyMicros
+void SpiBus::noteFlash(uint8_t device, uint32_t bytes, uint32_t busyMicros) {
+    if (device >= SPI_DEVICE_COUNT) { return; }
+    m_stats.busyMicros[device] += busyMicros;
+    m_stats.flashChunks++;
+    m_stats.flashBytes += bytes;
+}
+
+/* utilization
+ *  fraction of the time since the statistics were reset that any device held the bus. Past a
+ *  minute the time is taken from millis(), micros() wraps every 71 minutes. A burst sample
+ *  read inside a polled one counts twice, so the result is clamped to 1. */
+float SpiBus::utilization() {
+    uint32_t elapsedMillis = millis() - m_stats.sinceMillis;
+    float elapsed = elapsedMillis > 60000 ? elapsedMillis * 1000.0F : (float)(micros() - m_stats.sinceMicros);
+    if (elapsed <= 0) { return 0.0F; }
+    float busy = 0;
+    for (int device = 0; device < SPI_DEVICE_COUNT; device++) { busy += m_stats.busyMicros[device]; }
+    return min(busy / elapsed, 1.0F);
+}
+
+// clears the statistics
+void SpiBus::resetStats() {
+    m_stats = SpiBusStats();
+    m_stats.sinceMicros = micros();
+    m_stats.sinceMillis = millis();
+}
+
+// counts a sample read latency microseconds after it came due
+void SpiBus::noteLatency(uint32_t latency) {
+    int bucket = 0;
+    while (bucket < SPI_LATENCY_BUCKETS - 1 && latency >= (1UL << bucket)) { bucket++; }
+    m_stats.latency[bucket]++;
+    if (latency > m_stats.maxLatencyMicros) { m_stats.maxLatencyMicros = latency; }
+    if (latency > SPI_ADC_LATENCY_BOUND_MICROS) { m_stats.lateSamples++; }
+}
+
+/* - - - - - - BusFlashDevice - - - - - - */
+// constructor
+BusFlashDevice::BusFlashDevice(FlashDevice *chip, SpiBus *bus, uint8_t device) {
+    m_chip = chip;
+    m_bus = bus;
+    m_device = device;
+}
+
+bool BusFlashDevice::read(uint32_t addr, void *dst, uint32_t length) {
+    return transfer(CHUNK_READ, addr, (uint8_t *)dst, length);
+}
+
+bool BusFlashDevice::readMirror(uint32_t addr, void *dst, uint32_t length) {
+    return transfer(CHUNK_READ_MIRROR, addr, (uint8_t *)dst, length);
+}
+
+bool BusFlashDevice::program(uint32_t addr, const void *src, uint32_t length) {
+    return transfer(CHUNK_PROGRAM, addr, (uint8_t *)src, length); // src is never written to
+}
+
+// an erase command is a few bytes, the module erases on its own afterwards
+bool BusFlashDevice::eraseSector(uint32_t addr) {
+    m_bus->yieldToAdc();
+    uint32_t start = micros();
+    bool status = m_chip->eraseSector(addr);
+    m_bus->noteFlash(m_device, 0, micros() - start);
+    return status;
+}
+
+/* transfer
+ *  issues a read or program a chunk at a time, giving the ADC the bus before each chunk.
+ *  returns false once a chunk fails */
+bool BusFlashDevice::transfer(uint8_t op, uint32_t addr, uint8_t *bytes, uint32_t length) {
+    for (uint32_t done = 0; done < length; ) {
+        uint32_t pos = addr + done;
+        uint32_t piece = min(SPI_FLASH_CHUNK - pos % SPI_FLASH_CHUNK, length - done);
+        m_bus->yieldToAdc();
+
+        uint32_t start = micros();
+        bool status;
+        switch (op) {
+            case CHUNK_READ:
+                status = m_chip->read(pos, bytes + done, piece);
+                break;
+            case CHUNK_READ_MIRROR:
+                status = m_chip->readMirror(pos, bytes + done, piece);
+                break;
+            default:
+                status = m_chip->program(pos, bytes + done, piece);
+                break;
+        }
+        m_bus->noteFlash(m_device, piece, micros() - start);
+        if (!status) { return false; }
+        done += piece;
+    }
+    return true;
+}
+
+/* - - - - - - Module Driver Functions - - - - - - */
+
+/* - - - - - - initSpiBus - - - - - - *
+ * Usage:
+ *  Begins the SPI bus, call in init() before flash is used
+ *
+ * Inputs:
+ *  check - tells the bus whether a polled science sample is due
+ *
+ * Outputs:
+ *  none
+ */
+void initSpiBus(AdcSlotCheck check) {
+    spiBus.begin();
+    spiBus.setAdcSlot(check);
+}
+
+/* - - - - - - printSpiBusInfo - - - - - - *
+ * Usage:
+ *  Prints the bus utilization by device and the ADC sample latency histogram
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  none
+ */
+void printSpiBusInfo() {
+    SpiBusStats stats = spiBus.getStats();
+    Serial.print("SPI Bus: ");
+    Serial.print(spiBus.utilization() * 100);
+    Serial.print("% busy (ADC ");
+    Serial.print(stats.busyMicros[SPI_DEVICE_ADC]);
+    Serial.print(" us, flash 1 ");
+    Serial.print(stats.busyMicros[SPI_DEVICE_FLASH1]);
+    Serial.print(" us, flash 2 ");
+    Serial.print(stats.busyMicros[SPI_DEVICE_FLASH2]);
+    Serial.print(" us), ");
+    Serial.print(stats.flashChunks);
+    Serial.print(" flash chunk(s), ");
+    Serial.print(stats.flashBytes);
+    Serial.println(" bytes");
+    Serial.print("SPI ADC Latency: ");
+    Serial.print(stats.adcReads);
+    Serial.print(" sample(s), ");
+    Serial.print(stats.heldSamples);
+    Serial.print(" taken between flash chunks, ");
+    Serial.print(stats.lateSamples);
+    Serial.print(" over ");
+    Serial.print(SPI_ADC_LATENCY_BOUND_MICROS);
+    Serial.print(" us, ");
+    Serial.print(stats.maxLatencyMicros);
+    Serial.println(" us max");
+    Serial.print("SPI ADC Latency Histogram (below 1, 2, 4 ... us):");
+    for (int bucket = 0; bucket < SPI_LATENCY_BUCKETS; bucket++) {
+        Serial.print(" ");
+        Serial.print(stats.latency[bucket]);
+    }
+    Serial.println();
+}
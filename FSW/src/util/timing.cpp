@@ -22,6 +22,8 @@
 #include "../headers/eventUtil.hpp"
 #include "../headers/commandHandling.hpp"
 #include "../headers/dataCollection.hpp"
+#include "../headers/burstCapture.hpp"
+#include "../headers/blackBox.hpp"
 
 /* Module Variable Definitions */
 
@@ -52,6 +54,7 @@ void ScienceMode::setMode(int newMode) {
     if (mode == SUNRISE_MODE || mode == SUNSET_MODE) {
         saveBufferEvent.invoke();
     }
+    blackBox.log(BB_MODE, 2, newMode, mode);
     mode = newMode;
 
     Serial.print("Mode Changed: ");
@@ -121,7 +124,11 @@ void updatePayloadMode(uint16_t buffer[], int bufIdx) {
                 
                 case PRE_SUNRISE_MODE: // waiting for sun to rise above horizon
                     if (pdVoltageSmooth >= SUN_THRESH_VOLTAGE) {
+                        // capture the limb crossing at high rate
+                        triggerBurst(BURST_TRIGGER_SUNRISE);
+
                         // start sunrise event 
+                        sunriseTimerEvent.setDuration(WINDOW_LENGTH_MSEC); // may have been shortened by a resumed window
                         sunriseTimerEvent.start();
                         scienceMode.setMode(SUNRISE_MODE);
                     }
@@ -232,6 +239,7 @@ void checkSweepChange(uint16_t buffer[], int bufIdx) {
     // change the sweep direction if the voltage crossed the threshold
     //  requires optic to have recently dropped below the voltage threshold 
     if ((pdNew < SUN_THRESH_VOLTAGE) && (pdOld > SUN_THRESH_VOLTAGE)){
+        triggerBurst(BURST_TRIGGER_SWEEP); // capture the limb crossing at high rate
         scienceMode.sweepChange();
     }
 }
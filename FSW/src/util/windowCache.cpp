@@ -0,0 +1,193 @@
+/* windowCache.cpp keeps the most recently written science windows in RAM
+ * Usage:
+ *  Ground often asks for a window right after it is saved. onScienceSaved() puts the window,
+ *  as written to flash, into the cache with a summary of its samples, and downlink() and
+ *  quicklook() take it from there instead of reading it back from flash (and, for quicklook,
+ *  decoding it). The scrub uses a cached copy in place of the mirror copy to repair blocks
+ *  too corrupted to correct. The windows live in the second RAM bank (DMAMEM).
+ *  Hits, misses and the flash read time they saved are printed by printWindowCacheInfo().
+ *
+ * Modules encompassed:
+ *  Science Memory Handling
+ *
+ * Additional files needed for compilation:
+ *  config.hpp
+ *  windowCache.hpp
+ *  encodedFile.hpp
+ */
+
+/* - - - - - - Includes - - - - - - */
+// All libraries are put in windowCache.hpp
+// NS2 headers
+#include "../headers/windowCache.hpp"
+
+/* Module Variable Definitions */
+WindowCache windowCache;
+
+DMAMEM static uint8_t windowCacheMemory[WINDOW_CACHE_WINDOWS][EncodedSciData::PAGED_MEMSIZE];
+
+/* - - - - - - Class Definitions - - - - - - */
+
+/* - - - - - - WindowCache - - - - - - */
+// constructor
+WindowCache::WindowCache() {
+    m_useCount = 0;
+    for (int i = 0; i < WINDOW_CACHE_WINDOWS; i++) {
+        m_slots[i] = -1;
+        m_seqs[i] = 0;
+        m_lastUse[i] = 0;
+        m_pages[i] = windowCacheMemory[i];
+    }
+}
+
+/* put
+ *  copies a window written to a catalog slot as record seq into the cache, replacing an older
+ *  window of the slot, an empty entry or else the least recently used one */
+void WindowCache::put(int slot, uint32_t seq, const uint8_t *pages, const WindowSummary &summary) {
+    int entry = -1;
+    for (int i = 0; i < WINDOW_CACHE_WINDOWS && entry < 0; i++) {
+        if (m_slots[i] == slot) { entry = i; }
+    }
+    for (int i = 0; i < WINDOW_CACHE_WINDOWS && entry < 0; i++) {
+        if (m_slots[i] < 0) { entry = i; }
+    }
+    if (entry < 0) {
+        entry = 0;
+        for (int i = 1; i < WINDOW_CACHE_WINDOWS; i++) {
+            if (m_lastUse[i] < m_lastUse[entry]) { entry = i; }
+        }
+        m_stats.evictions++;
+    }
+    memcpy(m_pages[entry], pages, EncodedSciData::PAGED_MEMSIZE);
+    m_summaries[entry] = summary;
+    m_slots[entry] = slot;
+    m_seqs[entry] = seq;
+    m_lastUse[entry] = ++m_useCount;
+}
+
+/* get
+ *  looks up the window of a slot written as record seq and counts the hit or miss.
+ *  returns its pages, nullptr if it is not cached */
+const uint8_t *WindowCache::get(int slot, uint32_t seq) {
+    int entry = find(slot, seq);
+    if (entry < 0) {
+        m_stats.misses++;
+        return nullptr;
+    }
+    m_stats.hits++;
+    m_stats.hitBytes += EncodedSciData::PAGED_MEMSIZE;
+    m_lastUse[entry] = ++m_useCount;
+    return m_pages[entry];
+}
+
+// the pages of a cached window without counting a lookup, nullptr if it is not cached
+const uint8_t *WindowCache::peek(int slot, uint32_t seq) {
+    int entry = find(slot, seq);
+    return entry < 0 ? nullptr : m_pages[entry];
+}
+
+/* getSummary
+ *  looks up the summary of a window and counts the hit or miss.
+ *  returns false if the window is not cached */
+bool WindowCache::getSummary(int slot, uint32_t seq, WindowSummary &summary) {
+    int entry = find(slot, seq);
+    if (entry < 0) {
+        m_stats.misses++;
+        return false;
+    }
+    m_stats.hits++;
+    m_lastUse[entry] = ++m_useCount;
+    summary = m_summaries[entry];
+    return true;
+}
+
+// drops the window of a slot, once its record is removed
+void WindowCache::invalidate(int slot) {
+    for (int i = 0; i < WINDOW_CACHE_WINDOWS; i++) {
+        if (m_slots[i] == slot) {
+            m_slots[i] = -1;
+            m_stats.invalidations++;
+        }
+    }
+}
+
+// drops every window
+void WindowCache::clear() {
+    for (int i = 0; i < WINDOW_CACHE_WINDOWS; i++) { m_slots[i] = -1; }
+}
+
+// counts the time a window took to read from flash after a miss, savedMicros() is estimated from it
+void WindowCache::noteFlashRead(uint32_t bytes, uint32_t micros) {
+    m_stats.missBytes += bytes;
+    m_stats.missMicros += micros;
+}
+
+// windows cached
+int WindowCache::count() {
+    int windows = 0;
+    for (int i = 0; i < WINDOW_CACHE_WINDOWS; i++) { windows += m_slots[i] >= 0; }
+    return windows;
+}
+
+// flash read time saved by hits, at the rate reads after misses took
+uint32_t WindowCache::savedMicros() {
+    if (m_stats.missBytes == 0) { return 0; }
+    return (uint32_t)((uint64_t)m_stats.hitBytes * m_stats.missMicros / m_stats.missBytes);
+}
+
+// summary of count samples of a window
+WindowSummary WindowCache::summarize(const uint16_t *buffer, int count, unsigned long timestamp) {
+    WindowSummary summary;
+    summary.timestamp = timestamp;
+    summary.samples = count;
+    if (count <= 0) { return summary; }
+    uint32_t total = 0;
+    summary.minSample = buffer[0];
+    summary.maxSample = buffer[0];
+    for (int i = 0; i < count; i++) {
+        summary.minSample = min(summary.minSample, buffer[i]);
+        summary.maxSample = max(summary.maxSample, buffer[i]);
+        total += buffer[i];
+    }
+    summary.meanSample = (uint16_t)((total + count / 2) / count);
+    return summary;
+}
+
+// entry holding the window of a slot written as record seq, -1 if none
+int WindowCache::find(int slot, uint32_t seq) {
+    for (int i = 0; i < WINDOW_CACHE_WINDOWS; i++) {
+        if (m_slots[i] == slot && m_seqs[i] == seq) { return i; }
+    }
+    return -1;
+}
+
+/* - - - - - - Module Driver Functions - - - - - - */
+
+/* - - - - - - printWindowCacheInfo - - - - - - *
+ * Usage:
+ *  Prints the windows cached, the hits and misses and the flash read time saved
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  none
+ */
+void printWindowCacheInfo() {
+    WindowCacheStats stats = windowCache.getStats();
+    Serial.print("Window Cache: ");
+    Serial.print(windowCache.count());
+    Serial.print(" of ");
+    Serial.print(WINDOW_CACHE_WINDOWS);
+    Serial.print(" window(s), ");
+    Serial.print(stats.hits);
+    Serial.print(" hit(s), ");
+    Serial.print(stats.misses);
+    Serial.print(" miss(es), ");
+    Serial.print(stats.evictions);
+    Serial.print(" evicted, ");
+    Serial.print(stats.invalidations);
+    Serial.print(" invalidated, about ");
+    Serial.print(windowCache.savedMicros());
+    Serial.println(" us of flash reads saved");
+}
@@ -0,0 +1,615 @@
+/* windowCheckpoint.cpp checkpoints the science window in progress to flash
+ * Usage:
+ *  While in sunrise or sunset mode, samples collected since the last checkpoint are appended
+ *  to a flash log every CHECKPOINT_INTERVAL_MSEC as Hamming encoded segments.
+ *  After a reset, init() reads the log back into the science buffer and either resumes
+ *  the window or seals it as a partial science file. The log is erased once the window is saved.
+ *
+ *  The log region is split into two halves. Segments are programmed and halves erased through
+ *  the flash queue, in the background. A window is written to the half erased after the window
+ *  before it, its epoch is saved in EEPROM when it begins so segments left over from older
+ *  windows are never recovered. A full half is rebased to the other half, which gets a new
+ *  epoch, and is only erased once the rebase has been queued in full.
+ *
+ * Modules encompassed:
+ *  Science Memory Handling
+ *  Fault Mitigation
+ *
+ * Additional files needed for compilation:
+ *  config.hpp
+ *  windowCheckpoint.hpp
+ *  encodedFile.hpp
+ *  flashDevice.cpp & flashDevice.hpp
+ *  flashQueue.cpp & flashQueue.hpp
+ *  spiBus.cpp & spiBus.hpp
+ *  crc.cpp & crc.hpp
+ *  timing.hpp
+ *  faultManager.hpp
+ */
+
+/* - - - - - - Includes - - - - - - */
+// All libraries are put in windowCheckpoint.hpp
+// NS2 headers
+#include "../headers/windowCheckpoint.hpp"
+#include "../headers/flashQueue.hpp"
+#include "../headers/spiBus.hpp"
+#include "../headers/crc.hpp"
+#include "../headers/timing.hpp"
+#include "../headers/faultManager.hpp"
+
+/* Module Variable Definitions */
+static const char CHECKPOINT_FILENAME[] = "checkpoint.bin";
+// bytes, each half holds CHECKPOINT_LOG_SEGMENTS segments rounded up to whole 64KB erase blocks
+static const uint32_t CHECKPOINT_HALF_MEMSIZE = (CHECKPOINT_LOG_SEGMENTS * EncodedSegment::MEMSIZE + 65535) / 65536 * 65536;
+
+static SerialFlashDevice checkpointChip(CHECKPOINT_FILENAME, 2 * CHECKPOINT_HALF_MEMSIZE, PIN_FLASH1_CS);
+static BusFlashDevice checkpointBus(&checkpointChip, &spiBus, SPI_DEVICE_FLASH1); // chunked so a due sample gets the bus
+static CheckpointLog checkpointLog;
+static RecurringEvent checkpointEvent = RecurringEvent(CHECKPOINT_INTERVAL_MSEC);
+static bool windowResumed = false; // whether init() resumed a window from the log
+
+// offsets into a decoded segment
+static const int SEGMENT_SAMPLE_OFFSET = SegmentHeader::MEMSIZE;
+static const int SEGMENT_ATTITUDE_OFFSET = SEGMENT_SAMPLE_OFFSET + CHECKPOINT_SEGMENT_SAMPLES * sizeof(uint16_t);
+static const int SEGMENT_RATE_CODE_OFFSET = SEGMENT_ATTITUDE_OFFSET + CHECKPOINT_SEGMENT_SAMPLES * sizeof(int16_t);
+static const int SEGMENT_CHECKSUM_OFFSET = SegmentHeader::MEMSIZE - sizeof(uint32_t); // checksum is the last header field
+
+/* - - - - - - Class Definitions - - - - - - */
+
+/* - - - - - - CheckpointLog - - - - - - */
+// constructor
+CheckpointLog::CheckpointLog() {
+    m_device = nullptr;
+    m_halfSize = 0;
+    m_halfSegments = 0;
+    m_dirtySectors[0] = 0;
+    m_dirtySectors[1] = 0;
+    m_half = 0;
+    m_holdHalf = -1;
+    m_active = false;
+    m_requested = false;
+    m_rebase = false;
+    m_failed = false;
+    m_mode = 0;
+    m_startCount = 0;
+    m_seq = 0;
+    m_epoch = 0;
+    m_windowEpoch = 0;
+    m_nextIdx = 0;
+    m_rebaseRemaining = 0;
+    m_rebaseEndIdx = 0;
+    m_startMillis = 0;
+    m_intervalMicros = 0;
+    m_queuedHead = 0;
+    m_queuedCount = 0;
+}
+
+/* attach
+ *  keeps the log on device, split into two halves of whole sectors. Everything on it is taken
+ *  to need erasing until recover() has read it.
+ *  returns false if a half cannot hold a whole buffer with room to spare */
+bool CheckpointLog::attach(FlashDevice *device) {
+    m_device = device;
+    m_halfSize = device->capacity() / 2 / device->sectorSize() * device->sectorSize();
+    m_halfSegments = min(CHECKPOINT_LOG_SEGMENTS, (int)(m_halfSize / EncodedSegment::MEMSIZE));
+    m_dirtySectors[0] = m_halfSize / device->sectorSize();
+    m_dirtySectors[1] = m_dirtySectors[0];
+    m_active = false;
+    m_holdHalf = -1;
+    return m_halfSegments > (BUFFERSIZE + CHECKPOINT_SEGMENT_SAMPLES - 1) / CHECKPOINT_SEGMENT_SAMPLES;
+}
+
+/* begin
+ *  starts checkpointing a new window from bufIdx in a new epoch, on an erased half if there is
+ *  one. Erases of the half still outstanding are queued ahead of its first segment.
+ *  returns false if no log is attached */
+bool CheckpointLog::begin(uint8_t mode, uint16_t startCount, int bufIdx) {
+    if (m_device == nullptr) { return false; }
+
+    int half = 1 - m_half;
+    if (m_dirtySectors[half] > 0 && m_dirtySectors[m_half] == 0) { half = m_half; }
+    startHalf(half);
+    m_windowEpoch = m_epoch;
+    m_holdHalf = -1;
+
+    m_mode = mode;
+    m_startCount = startCount;
+    m_nextIdx = bufIdx;
+    m_rebase = false;
+    m_rebaseRemaining = 0;
+    m_failed = false;
+    m_requested = false;
+    m_intervalMicros = 0;
+    m_startMillis = millis();
+    m_active = true;
+
+    eraseHalf(m_half);
+    return true;
+}
+
+/* checkpoint
+ *  queues samples collected since the last checkpoint while an interval is requested, as many
+ *  segments as there are free CHECKPOINT_SEGMENTS_QUEUED buffers.
+ *  returns the number of segments queued */
+int CheckpointLog::checkpoint(const uint16_t buffer[], const uint8_t rateCodes[], const int16_t attitude[], int bufIdx) {
+    if (!m_active || !m_requested) { return 0; }
+
+    uint32_t startMicros = micros();
+    int written = 0;
+    int pending = m_rebase ? m_rebaseRemaining : (bufIdx - m_nextIdx + BUFFERSIZE) % BUFFERSIZE;
+
+    while (pending > 0 && !m_failed && m_queuedCount < CHECKPOINT_SEGMENTS_QUEUED) {
+        if (m_seq >= m_halfSegments) {
+            // half is full, start over in the other half with everything still in the buffer
+            m_holdHalf = m_half;
+            startHalf(1 - m_half);
+            m_rebase = true;
+            m_rebaseRemaining = BUFFERSIZE;
+            m_rebaseEndIdx = m_nextIdx;
+            m_nextIdx = bufIdx;
+            m_stats.rebases++;
+            pending = m_rebaseRemaining;
+        }
+        if ((m_seq == 0 && !eraseHalf(m_half)) || flashQueue.space() == 0) { break; } // erases go ahead of the first segment
+
+        int count = min(pending, CHECKPOINT_SEGMENT_SAMPLES);
+        int segmentEnd = (m_nextIdx + count) % BUFFERSIZE;
+        int endIdx = segmentEnd;
+        if (m_rebase) {
+            // the newest samples are in the old half until the rebase passes them
+            int ahead = (m_rebaseEndIdx - segmentEnd + BUFFERSIZE) % BUFFERSIZE;
+            if (ahead > 0 && ahead <= m_rebaseRemaining - count) { endIdx = m_rebaseEndIdx; }
+        }
+        if (!writeSegment(buffer, rateCodes, attitude, count, endIdx)) { break; }
+        written++;
+        m_nextIdx = segmentEnd;
+        if (m_rebase) {
+            m_rebaseRemaining -= count;
+            m_rebase = m_rebaseRemaining > 0;
+            if (!m_rebase) { m_holdHalf = -1; } // old half is erased behind the rebase
+        }
+        pending = m_rebase ? m_rebaseRemaining : (bufIdx - m_nextIdx + BUFFERSIZE) % BUFFERSIZE;
+    }
+    m_intervalMicros += micros() - startMicros;
+
+    if (m_failed) {
+        Serial.println("Checkpoint write failed, checkpointing stopped for this window (windowCheckpoint)");
+        m_active = false;
+    }
+
+    // interval is complete once everything has been queued
+    if (pending == 0 || !m_active) {
+        m_requested = false;
+        m_stats.intervals++;
+        m_stats.lastMicros = m_intervalMicros;
+        m_stats.maxMicros = max(m_stats.maxMicros, (uint32_t)m_intervalMicros);
+        m_stats.totalMicros += m_intervalMicros;
+        m_intervalMicros = 0;
+    }
+    return written;
+}
+
+/* recover
+ *  reads both halves of the log and restores the samples of segments written in windowEpoch or
+ *  later to the given arrays, the older half first. Torn or uncorrectable segments are skipped.
+ *  Pass nullptr arrays to only scan the log. Reads the device directly, call before the flash
+ *  queue is in use. The log is left inactive, call resume() to keep appending to it */
+RecoveredWindow CheckpointLog::recover(uint16_t buffer[], uint8_t rateCodes[], int16_t attitude[], uint32_t windowEpoch) {
+    RecoveredWindow window;
+    m_active = false;
+    m_holdHalf = -1;
+    m_windowEpoch = windowEpoch;
+    m_epoch = max(m_epoch, windowEpoch);
+    if (m_device == nullptr) { return window; }
+
+    uint8_t encoded[EncodedSegment::MEMSIZE];
+    int used[2] = {};           // slots before the first erased one
+    uint32_t halfEpoch[2] = {}; // epoch of the first valid segment
+    bool accepted[2] = {};      // whether the half belongs to the window
+    for (int half = 0; half < 2; half++) {
+        // everything up to the last programmed slot has to be erased before the half is used again
+        int lastUsed = -1;
+        used[half] = -1;
+        for (int slot = 0; slot < m_halfSegments; slot++) {
+            bool erased = m_device->read(half * m_halfSize + slot * EncodedSegment::MEMSIZE, encoded, EncodedSegment::MEMSIZE);
+            for (int i = 0; i < EncodedSegment::MEMSIZE && erased; i++) { erased = encoded[i] == 0xFF; }
+            if (erased && used[half] < 0) { used[half] = slot; }
+            if (!erased) { lastUsed = slot; }
+        }
+        if (used[half] < 0) { used[half] = m_halfSegments; }
+        m_dirtySectors[half] = ((lastUsed + 1) * EncodedSegment::MEMSIZE + m_device->sectorSize() - 1) / m_device->sectorSize();
+
+        for (int slot = 0; slot < used[half]; slot++) {
+            SegmentHeader header;
+            ScrubReport scrubInfo;
+            if (!readSegment(half, slot, encoded, header, scrubInfo)) { continue; }
+            halfEpoch[half] = header.epoch;
+            accepted[half] = header.epoch >= windowEpoch;
+            m_epoch = max(m_epoch, header.epoch);
+            break;
+        }
+    }
+
+    int first = accepted[1] && (!accepted[0] || halfEpoch[1] < halfEpoch[0]) ? 1 : 0;
+    for (int half = first, n = 0; n < 2; half = 1 - half, n++) {
+        if (!accepted[half]) { continue; }
+        for (int slot = 0; slot < used[half]; slot++) {
+            SegmentHeader header;
+            ScrubReport scrubInfo;
+            if (!readSegment(half, slot, encoded, header, scrubInfo) || header.epoch != halfEpoch[half]) {
+                window.skipped++;
+                continue;
+            }
+            uint8_t *decoded = m_segment.getDecodedData();
+
+            // restore samples to the buffer, newer segments overwrite older ones
+            if (buffer != nullptr) {
+                for (int i = 0; i < header.count; i++) {
+                    int idx = (header.firstIdx + i) % BUFFERSIZE;
+                    memcpy(&buffer[idx], decoded + SEGMENT_SAMPLE_OFFSET + i * sizeof(uint16_t), sizeof(uint16_t));
+                    memcpy(&attitude[idx], decoded + SEGMENT_ATTITUDE_OFFSET + i * sizeof(int16_t), sizeof(int16_t));
+
+                    uint8_t code = (decoded[SEGMENT_RATE_CODE_OFFSET + i / RATE_CODES_PER_BYTE] >> (2 * (i % RATE_CODES_PER_BYTE))) & 0b11;
+                    int shift = 2 * (idx % RATE_CODES_PER_BYTE);
+                    rateCodes[idx / RATE_CODES_PER_BYTE] = (rateCodes[idx / RATE_CODES_PER_BYTE] & ~(0b11 << shift)) | (code << shift);
+                }
+            }
+
+            window.found = true;
+            window.mode = header.mode;
+            window.startCount = header.startCount;
+            window.elapsedMsec = header.elapsedMsec;
+            window.samples = min(window.samples + (int)header.count, BUFFERSIZE);
+            window.bufIdx = header.endIdx;
+            window.segments++;
+            window.corrected += scrubInfo.corrected;
+
+            // remember where the window left off in case it is resumed
+            m_half = half;
+            m_epoch = halfEpoch[half];
+            m_nextIdx = (header.firstIdx + header.count) % BUFFERSIZE;
+            m_rebaseEndIdx = header.endIdx;
+        }
+        if (window.found && m_half == half) { m_seq = used[half]; }
+    }
+
+    m_mode = window.mode;
+    m_startCount = window.startCount;
+    m_startMillis = millis() - window.elapsedMsec;
+    if (window.found && accepted[1 - m_half]) { m_holdHalf = 1 - m_half; }
+    m_epoch = max(m_epoch, max(halfEpoch[0], halfEpoch[1]));
+    return window;
+}
+
+/* resume
+ *  continues appending to the log read by recover(). If the reset interrupted a rebase, the
+ *  rest of it is written before new samples and the old half is kept until then */
+void CheckpointLog::resume() {
+    m_rebaseRemaining = (m_rebaseEndIdx - m_nextIdx + BUFFERSIZE) % BUFFERSIZE;
+    m_rebase = m_rebaseRemaining > 0;
+    if (!m_rebase) { m_holdHalf = -1; }
+    m_active = true;
+    m_failed = false;
+    m_requested = false;
+    m_intervalMicros = 0;
+}
+
+// stops checkpointing, the log is erased in the background by service(). Call once the window has been saved
+void CheckpointLog::end() {
+    m_active = false;
+    m_requested = false;
+    m_rebase = false;
+    m_holdHalf = -1;
+    service();
+}
+
+/* service
+ *  queues erases of halves that hold no samples of the open window, so the next window starts
+ *  on an erased half. Call every main loop iteration */
+void CheckpointLog::service() {
+    if (m_device == nullptr) { return; }
+    for (int half = 0; half < 2; half++) {
+        if (half == m_holdHalf || (m_active && half == m_half)) { continue; }
+        eraseHalf(half);
+    }
+}
+
+// encodes the next count samples starting at m_nextIdx and queues them for the next slot
+bool CheckpointLog::writeSegment(const uint16_t buffer[], const uint8_t rateCodes[], const int16_t attitude[], int count, int endIdx) {
+    uint8_t rawData[CHECKPOINT_SEGMENT_RAW_MEMSIZE] = {};
+
+    SegmentHeader header;
+    header.magic = SegmentHeader::SEGMENT_MAGIC;
+    header.seq = m_seq;
+    header.startCount = m_startCount;
+    header.mode = m_mode;
+    header.firstIdx = m_nextIdx;
+    header.count = count;
+    header.endIdx = endIdx;
+    header.elapsedMsec = millis() - m_startMillis;
+    header.epoch = m_epoch;
+
+    size_t bytesCopied = 0;
+    memAppend(rawData, &header.magic, sizeof(header.magic), &bytesCopied);
+    memAppend(rawData, &header.seq, sizeof(header.seq), &bytesCopied);
+    memAppend(rawData, &header.startCount, sizeof(header.startCount), &bytesCopied);
+    memAppend(rawData, &header.mode, sizeof(header.mode), &bytesCopied);
+    memAppend(rawData, &header.firstIdx, sizeof(header.firstIdx), &bytesCopied);
+    memAppend(rawData, &header.count, sizeof(header.count), &bytesCopied);
+    memAppend(rawData, &header.endIdx, sizeof(header.endIdx), &bytesCopied);
+    memAppend(rawData, &header.elapsedMsec, sizeof(header.elapsedMsec), &bytesCopied);
+    memAppend(rawData, &header.epoch, sizeof(header.epoch), &bytesCopied);
+
+    for (int i = 0; i < count; i++) {
+        int idx = (m_nextIdx + i) % BUFFERSIZE;
+        memcpy(rawData + SEGMENT_SAMPLE_OFFSET + i * sizeof(uint16_t), &buffer[idx], sizeof(uint16_t));
+        memcpy(rawData + SEGMENT_ATTITUDE_OFFSET + i * sizeof(int16_t), &attitude[idx], sizeof(int16_t));
+
+        uint8_t code = (rateCodes[idx / RATE_CODES_PER_BYTE] >> (2 * (idx % RATE_CODES_PER_BYTE))) & 0b11;
+        rawData[SEGMENT_RATE_CODE_OFFSET + i / RATE_CODES_PER_BYTE] |= code << (2 * (i % RATE_CODES_PER_BYTE));
+    }
+
+    // checksum covers the whole segment with the checksum field still zero
+    header.checksum = crc32c(rawData, CHECKPOINT_SEGMENT_RAW_MEMSIZE);
+    memcpy(rawData + SEGMENT_CHECKSUM_OFFSET, &header.checksum, sizeof(header.checksum));
+
+    // the flash queue programs from a copy that stays put until the segment is written
+    m_segment.encodeData(rawData);
+    uint8_t *queued = m_queued[(m_queuedHead + m_queuedCount) % CHECKPOINT_SEGMENTS_QUEUED];
+    memcpy(queued, m_segment.getData(), EncodedSegment::MEMSIZE);
+    uint32_t offset = m_seq * EncodedSegment::MEMSIZE;
+    if (!flashQueue.submitProgram(m_device, m_half * m_halfSize + offset, queued, EncodedSegment::MEMSIZE, onSegmentWritten, this)) {
+        return false;
+    }
+    m_queuedCount++;
+
+    int sectors = (offset + EncodedSegment::MEMSIZE + m_device->sectorSize() - 1) / m_device->sectorSize();
+    m_dirtySectors[m_half] = max(m_dirtySectors[m_half], sectors);
+    m_seq++;
+    m_stats.segments++;
+    m_stats.bytes += EncodedSegment::MEMSIZE;
+    return true;
+}
+
+/* readSegment
+ *  reads and decodes the segment in a slot, the decoded segment is left in m_segment.
+ *  returns false if it is torn, uncorrectable or not from that slot */
+bool CheckpointLog::readSegment(int half, int slot, uint8_t encoded[], SegmentHeader &header, ScrubReport &scrubInfo) {
+    if (!m_device->read(half * m_halfSize + slot * EncodedSegment::MEMSIZE, encoded, EncodedSegment::MEMSIZE)) { return false; }
+    m_segment.fill(encoded);
+    scrubInfo = m_segment.scrub();
+    uint8_t *decoded = m_segment.getDecodedData();
+
+    size_t bytesCopied = 0;
+    memExtract(decoded, &header.magic, sizeof(header.magic), &bytesCopied);
+    memExtract(decoded, &header.seq, sizeof(header.seq), &bytesCopied);
+    memExtract(decoded, &header.startCount, sizeof(header.startCount), &bytesCopied);
+    memExtract(decoded, &header.mode, sizeof(header.mode), &bytesCopied);
+    memExtract(decoded, &header.firstIdx, sizeof(header.firstIdx), &bytesCopied);
+    memExtract(decoded, &header.count, sizeof(header.count), &bytesCopied);
+    memExtract(decoded, &header.endIdx, sizeof(header.endIdx), &bytesCopied);
+    memExtract(decoded, &header.elapsedMsec, sizeof(header.elapsedMsec), &bytesCopied);
+    memExtract(decoded, &header.epoch, sizeof(header.epoch), &bytesCopied);
+    memExtract(decoded, &header.checksum, sizeof(header.checksum), &bytesCopied);
+    memset(decoded + SEGMENT_CHECKSUM_OFFSET, 0, sizeof(header.checksum));
+
+    return scrubInfo.uncorrected == 0
+            && header.magic == SegmentHeader::SEGMENT_MAGIC
+            && header.seq == slot
+            && header.firstIdx < BUFFERSIZE
+            && header.endIdx < BUFFERSIZE
+            && header.count <= CHECKPOINT_SEGMENT_SAMPLES
+            && header.checksum == crc32c(decoded, CHECKPOINT_SEGMENT_RAW_MEMSIZE);
+}
+
+/* eraseHalf
+ *  queues erases of the sectors of a half that may hold segments, from the top down so an
+ *  interrupted erase leaves the first erased slot after any stale ones. Leaves at least half of
+ *  the flash queue to other requests, call again until it is done.
+ *  returns true once every erase of the half has been queued */
+bool CheckpointLog::eraseHalf(int half) {
+    while (m_dirtySectors[half] > 0 && flashQueue.space() > FLASH_QUEUE_DEPTH / 2) {
+        uint32_t addr = half * m_halfSize + (m_dirtySectors[half] - 1) * m_device->sectorSize();
+        if (!flashQueue.submitErase(m_device, addr, nullptr, nullptr)) { break; }
+        m_dirtySectors[half]--;
+    }
+    return m_dirtySectors[half] == 0;
+}
+
+// moves writing to the start of a half, in a new epoch
+void CheckpointLog::startHalf(int half) {
+    m_half = half;
+    m_seq = 0;
+    m_epoch++;
+}
+
+// frees the oldest queued segment buffer once the flash queue has programmed it
+void CheckpointLog::onSegmentWritten(void *context, bool status) {
+    CheckpointLog *log = (CheckpointLog *)context;
+    log->m_queuedHead = (log->m_queuedHead + 1) % CHECKPOINT_SEGMENTS_QUEUED;
+    log->m_queuedCount--;
+    if (!status) { log->m_failed = true; }
+}
+
+/* - - - - - - Module Driver Functions - - - - - - */
+
+/* - - - - - - handleWindowCheckpoint - - - - - - *
+ * Usage:
+ *  Starts checkpointing when a sunrise or sunset window begins and writes a checkpoint
+ *  every CHECKPOINT_INTERVAL_MSEC while it runs. Call every main loop iteration.
+ *  The log is closed by endWindowCheckpoint() once the window is saved.
+ *
+ * Inputs:
+ *  buffer - science data buffer
+ *  rateCodes - packed rate codes of the science data buffer
+ *  attitude - attitude column of the science data buffer
+ *  bufIdx - index of the next dataBuffer element to overwrite
+ *
+ * Outputs:
+ *  none
+ */
+void handleWindowCheckpoint(const uint16_t buffer[], const uint8_t rateCodes[], const int16_t attitude[], int bufIdx) {
+    checkpointLog.service(); // erases the log behind a saved window
+
+    int mode = scienceMode.getMode();
+    if (!CHECKPOINT_WINDOWS || (mode != SUNRISE_MODE && mode != SUNSET_MODE)) { return; }
+
+    if (!checkpointLog.isActive()) {
+        // new window, remember it and its epoch in EEPROM so only its segments are trusted after a reset
+        if (!checkpointLog.begin(mode, payloadData.startCount, bufIdx)) {
+            Serial.println("Failed to open checkpoint log (windowCheckpoint)");
+            return;
+        }
+        payloadData.recoveredMode = mode;
+        payloadData.checkpointEpoch = checkpointLog.getWindowEpoch();
+        saveEEPROM();
+        checkpointEvent.start();
+    }
+
+    if (checkpointEvent.checkInvoked()) {
+        checkpointLog.requestCheckpoint();
+    }
+    checkpointLog.checkpoint(buffer, rateCodes, attitude, bufIdx);
+}
+
+/* - - - - - - recoverWindowCheckpoint - - - - - - *
+ * Usage:
+ *  Call during init(), after recordNewStart(). Restores a window that was interrupted by a reset.
+ *  The window is resumed if the reset was unexpected, no more than CHECKPOINT_MAX_RESUMES resets
+ *  happened in a row and the window still has time left. Otherwise the caller should save the
+ *  recovered samples as a partial file. A log left over from a window that was already saved is
+ *  erased in the background.
+ *
+ * Inputs:
+ *  buffer - science data buffer to restore samples to
+ *  rateCodes - packed rate codes of the science data buffer
+ *  attitude - attitude column of the science data buffer
+ *
+ * Outputs:
+ *  description of the recovered window
+ */
+RecoveredWindow recoverWindowCheckpoint(uint16_t buffer[], uint8_t rateCodes[], int16_t attitude[]) {
+    RecoveredWindow window;
+    windowResumed = false;
+
+    bool created;
+    if (!checkpointChip.begin(created) || !checkpointLog.attach(&checkpointBus)) {
+        Serial.println("Checkpoint log unavailable, science windows will not be checkpointed (windowCheckpoint)");
+        return window;
+    }
+
+    if (payloadData.recoveredMode != SUNRISE_MODE && payloadData.recoveredMode != SUNSET_MODE) {
+        // no window was open, anything in the log was already saved
+        checkpointLog.recover(nullptr, nullptr, nullptr, payloadData.checkpointEpoch);
+        checkpointLog.end();
+        return window;
+    }
+
+    window = checkpointLog.recover(buffer, rateCodes, attitude, payloadData.checkpointEpoch);
+    if (!window.found) {
+        checkpointLog.end();
+        return window;
+    }
+
+    bool unexpected = payloadData.consecutiveBadRestarts > 0;
+    bool timeLeft = window.mode == SUNSET_MODE || window.elapsedMsec < (uint32_t)WINDOW_LENGTH_MSEC;
+    window.resumed = CHECKPOINT_WINDOWS && unexpected && timeLeft
+                        && payloadData.consecutiveBadRestarts <= CHECKPOINT_MAX_RESUMES;
+
+    if (window.resumed) {
+        checkpointLog.resume();
+        checkpointEvent.start();
+        if (window.mode == SUNRISE_MODE) {
+            sunriseTimerEvent.setDuration(WINDOW_LENGTH_MSEC - window.elapsedMsec); // finish the original window
+            sunriseTimerEvent.start();
+        } else {
+            sweepTimeoutEvent.start();
+        }
+        scienceMode.setMode(window.mode);
+        windowResumed = true;
+    }
+
+    Serial.print("Recovered ");
+    Serial.print(window.samples);
+    Serial.print(" samples (");
+    Serial.print(window.elapsedMsec);
+    Serial.print(" ms) from ");
+    Serial.print(window.segments);
+    Serial.print(" checkpoint segment(s), ");
+    Serial.print(window.skipped);
+    Serial.println(" skipped.");
+    if (window.resumed) { Serial.println("Resuming science window."); }
+    else { Serial.println("Sealing science window as a partial file."); }
+
+    return window;
+}
+
+/* - - - - - - endWindowCheckpoint - - - - - - *
+ * Usage:
+ *  Closes the checkpoint log, which is erased in the background. Call once the window has been
+ *  saved to a science file
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  none
+ */
+void endWindowCheckpoint() {
+    // the window is safe in its science file, the log must not be trusted after a reset
+    if (payloadData.recoveredMode == SUNRISE_MODE || payloadData.recoveredMode == SUNSET_MODE) {
+        payloadData.recoveredMode = scienceMode.getMode();
+        if (payloadData.recoveredMode == SUNRISE_MODE || payloadData.recoveredMode == SUNSET_MODE) {
+            payloadData.recoveredMode = STANDBY_MODE;
+        }
+        saveEEPROM();
+    }
+    checkpointLog.end();
+    windowResumed = false;
+}
+
+/* - - - - - - windowCheckpointResumed - - - - - - *
+ * Usage:
+ *  Returns whether init() resumed a science window from the checkpoint log
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  true if a window was resumed and has not been saved yet
+ */
+bool windowCheckpointResumed() {
+    return windowResumed;
+}
+
+/* - - - - - - printCheckpointInfo - - - - - - *
+ * Usage:
+ *  Prints checkpoint counters and overhead
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  none
+ */
+void printCheckpointInfo() {
+    CheckpointStats stats = checkpointLog.getStats();
+    Serial.print("Window Checkpointing: ");
+    if (CHECKPOINT_WINDOWS) { Serial.println("On"); }
+    else { Serial.println("Off"); }
+    Serial.print("Checkpoint Intervals / Segments / Rebases: ");
+    Serial.print(stats.intervals);
+    Serial.print(" / ");
+    Serial.print(stats.segments);
+    Serial.print(" / ");
+    Serial.println(stats.rebases);
+    Serial.print("Checkpoint Bytes Written: ");
+    Serial.println(stats.bytes);
+    Serial.print("Checkpoint Overhead (last / max / mean us per interval): ");
+    Serial.print(stats.lastMicros);
+    Serial.print(" / ");
+    Serial.print(stats.maxMicros);
+    Serial.print(" / ");
+    if (stats.intervals > 0) { Serial.println(stats.totalMicros / stats.intervals); }
+    else { Serial.println(0); }
+}
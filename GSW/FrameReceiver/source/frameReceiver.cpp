@@ -0,0 +1,208 @@
+/* frameReceiver.cpp reassembles files downlinked by NS2 in binary frames
+ * Usage:
+ *  see frameReceiver.hpp
+ */
+
+/* - - - - - - Includes - - - - - - */
+#include "frameReceiver.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+/* - - - - - - Helper Functions - - - - - - */
+
+// little endian field at pos
+static uint32_t readLE(const uint8_t *raw, size_t pos, size_t size) {
+    uint32_t value = 0;
+    for (size_t i = 0; i < size; i++) { value |= (uint32_t)raw[pos + i] << (8 * i); }
+    return value;
+}
+
+/* cobsDecode
+ *  decodes COBS bytes received between two zero bytes, dst must hold length bytes.
+ *  returns the number of decoded bytes, 0 if src is not COBS encoded */
+size_t cobsDecode(const uint8_t *src, size_t length, uint8_t *dst) {
+    size_t out = 0;
+    for (size_t i = 0; i < length; ) {
+        uint8_t code = src[i++];
+        if (code == 0 || i + code - 1 > length) { return 0; }
+        for (int j = 1; j < code; j++) {
+            if (src[i] == 0) { return 0; }
+            dst[out++] = src[i++];
+        }
+        if (code != 0xFF && i < length) { dst[out++] = 0; }
+    }
+    return out;
+}
+
+// CRC-32C (Castagnoli), same as crc32c() in the flight software
+uint32_t crc32c(const uint8_t *data, size_t size) {
+    static uint32_t table[256];
+    static bool ready = false;
+    if (!ready) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; bit++) { crc = (crc >> 1) ^ (0x82F63B78 & (0 - (crc & 1))); }
+            table[i] = crc;
+        }
+        ready = true;
+    }
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < size; i++) { crc = (crc >> 8) ^ table[(crc ^ data[i]) & 0xFF]; }
+    return ~crc;
+}
+
+/* - - - - - - FrameReceiver - - - - - - */
+
+/* decodeFrame
+ *  reads a frame from the bytes received before a zero byte.
+ *  returns false if they are not a whole frame that passes its CRC */
+bool FrameReceiver::decodeFrame(const uint8_t *wire, size_t length, Frame &frame) {
+    uint8_t raw[FRAME_RAW_MEMSIZE + 1];
+    if (length != FRAME_WIRE_MEMSIZE - 1 || cobsDecode(wire, length, raw) != FRAME_RAW_MEMSIZE) { return false; }
+    size_t crcOffset = FRAME_RAW_MEMSIZE - 4;
+    if (readLE(raw, crcOffset, 4) != crc32c(raw, crcOffset)) { return false; }
+
+    frame.type = raw[0];
+    frame.fileId = (uint16_t)readLE(raw, 1, 2);
+    frame.version = (uint16_t)readLE(raw, 3, 2);
+    frame.fileSize = readLE(raw, 5, 4);
+    frame.chunk = (uint16_t)readLE(raw, 9, 2);
+    frame.length = (uint16_t)readLE(raw, 11, 2);
+    memcpy(frame.data, raw + FRAME_HEADER_MEMSIZE, DOWNLINK_CHUNK_SIZE);
+    return frame.type == FRAME_FILE_DATA && frame.length <= DOWNLINK_CHUNK_SIZE;
+}
+
+// name the flight software gives the file
+std::string FrameReceiver::fileName(uint16_t fileId) {
+    char name[32];
+    if (fileId < MAXFILES) { snprintf(name, sizeof(name), "sci%03d.bin", fileId); }
+    else if (fileId == SUMMARY_FILE_ID) { snprintf(name, sizeof(name), "summary.bin"); }
+    else if (fileId == ERROR_MAP_FILE_ID) { snprintf(name, sizeof(name), "errorMap.bin"); }
+    else if (fileId == HK_HISTORY_FILE_ID) { snprintf(name, sizeof(name), "hkHistory.bin"); }
+    else { snprintf(name, sizeof(name), "burstFile%d.bin", fileId - MAXFILES); }
+    return name;
+}
+
+// name to save a received file under, a housekeeping history block is named by its key
+std::string FrameReceiver::fileName(const FileAssembly &file) {
+    if (file.fileId != HK_HISTORY_FILE_ID || file.data.size() < 4) { return fileName(file.fileId); }
+    char name[32];
+    snprintf(name, sizeof(name), "hkHistory%05u.bin", (unsigned)readLE(file.data.data(), 2, 2));
+    return name;
+}
+
+void FrameReceiver::push(uint8_t byte) {
+    m_stats.bytes++;
+    if (byte == 0) {
+        endPiece();
+        return;
+    }
+    m_piece.push_back(byte);
+    if (m_piece.size() > 4096) { endPiece(); } // no frame is this long, keep text flowing
+}
+
+void FrameReceiver::push(const uint8_t *bytes, size_t length) {
+    for (size_t i = 0; i < length; i++) { push(bytes[i]); }
+}
+
+// handles the bytes received since the last zero
+void FrameReceiver::endPiece() {
+    if (m_piece.empty()) { return; }
+    Frame frame;
+    if (decodeFrame(m_piece.data(), m_piece.size(), frame)) {
+        m_stats.frames++;
+        addChunk(frame);
+    } else if (m_piece.size() == FRAME_WIRE_MEMSIZE - 1) {
+        m_stats.badFrames++;
+    } else {
+        m_stats.textPieces++;
+        m_text.append(m_piece.begin(), m_piece.end());
+    }
+    m_piece.clear();
+}
+
+// copies a chunk into its file, a frame of another version or size starts the file over
+void FrameReceiver::addChunk(const Frame &frame) {
+    FileAssembly &file = m_files[frame.fileId];
+    uint32_t chunks = frame.fileSize == 0 ? 1 : (frame.fileSize + DOWNLINK_CHUNK_SIZE - 1) / DOWNLINK_CHUNK_SIZE;
+    if (file.chunkSeen.size() != chunks || file.size != frame.fileSize || file.version != frame.version) {
+        if (file.complete() && !file.saved && !file.chunkSeen.empty()) { m_replaced.push_back(file); }
+        file = FileAssembly();
+        file.fileId = frame.fileId;
+        file.version = frame.version;
+        file.size = frame.fileSize;
+        file.data.assign(frame.fileSize, 0);
+        file.chunkSeen.assign(chunks, false);
+    }
+    uint32_t offset = (uint32_t)frame.chunk * DOWNLINK_CHUNK_SIZE;
+    if (frame.chunk >= chunks || offset + frame.length > frame.fileSize) {
+        m_stats.badFrames++;
+        return;
+    }
+    if (file.chunkSeen[frame.chunk]) {
+        m_stats.duplicates++;
+        return;
+    }
+    memcpy(file.data.data() + offset, frame.data, frame.length);
+    file.chunkSeen[frame.chunk] = true;
+    file.chunksSeen++;
+    if (file.complete()) { m_stats.filesComplete++; }
+}
+
+std::vector<FileAssembly> FrameReceiver::takeComplete() {
+    std::vector<FileAssembly> complete;
+    complete.swap(m_replaced);
+    for (FileAssembly &file : complete) { file.saved = true; }
+    for (auto &entry : m_files) {
+        if (entry.second.complete() && !entry.second.saved) {
+            entry.second.saved = true;
+            complete.push_back(entry.second);
+        }
+    }
+    return complete;
+}
+
+// diagnostic text received since the last call
+std::string FrameReceiver::takeText() {
+    std::string text;
+    text.swap(m_text);
+    return text;
+}
+
+/* ackCommands
+ *  ACK_DOWNLINK commands for the chunks of a file received so far, one per DOWNLINK_ACK_CHUNKS
+ *  chunks with any received: file ID, version, first chunk and bitmap. Arguments are sent as
+ *  signed 32 bit numbers */
+std::vector<std::string> FrameReceiver::ackCommands(const FileAssembly &file) {
+    std::vector<std::string> commands;
+    for (size_t base = 0; base < file.chunkSeen.size(); base += DOWNLINK_ACK_CHUNKS) {
+        uint32_t bitmap = 0;
+        for (size_t bit = 0; bit < DOWNLINK_ACK_CHUNKS && base + bit < file.chunkSeen.size(); bit++) {
+            if (file.chunkSeen[base + bit]) { bitmap |= 1UL << bit; }
+        }
+        if (bitmap == 0) { continue; }
+        char command[64];
+        snprintf(command, sizeof(command), "%d %u %u %u %d", ACK_DOWNLINK_CODE, (unsigned)file.fileId, (unsigned)file.version,
+                 (unsigned)base, (int32_t)bitmap);
+        commands.push_back(command);
+    }
+    return commands;
+}
+
+/* summaryLines
+ *  one line per file listed in a received summary, in the order NS2 sends them */
+std::vector<std::string> FrameReceiver::summaryLines(const FileAssembly &file) {
+    std::vector<std::string> lines;
+    for (size_t pos = 0; pos + SUMMARY_ENTRY_MEMSIZE <= file.data.size(); pos += SUMMARY_ENTRY_MEMSIZE) {
+        const uint8_t *entry = file.data.data() + pos;
+        uint32_t size = readLE(entry, 4, 4);
+        uint32_t chunks = size == 0 ? 1 : (size + DOWNLINK_CHUNK_SIZE - 1) / DOWNLINK_CHUNK_SIZE;
+        char line[128];
+        snprintf(line, sizeof(line), "%s version %u, %u bytes, timestamp %u, %u of %u chunk(s) acknowledged, quality %u",
+                 fileName((uint16_t)readLE(entry, 0, 2)).c_str(), (unsigned)readLE(entry, 2, 2), (unsigned)size,
+                 (unsigned)readLE(entry, 8, 4), (unsigned)readLE(entry, 12, 2), (unsigned)chunks, (unsigned)entry[14]);
+        lines.push_back(line);
+    }
+    return lines;
+}
@@ -0,0 +1,106 @@
+#ifndef FRAME_RECEIVER_H
+#define FRAME_RECEIVER_H
+/* frameReceiver.hpp reassembles files downlinked by NS2 in binary frames
+ * Usage:
+ *  Feed every byte read from the serial link to FrameReceiver::push(). Frames are found by
+ *  the zero byte that ends each one, COBS decoded and checked against their CRC, then the
+ *  chunk is copied into its file. Anything between zero bytes that is not a frame is
+ *  diagnostic text from the payload and is kept for printing.
+ *  NS2 keeps each file and resends the chunks the ground has not acknowledged, ackCommands()
+ *  gives the ACK_DOWNLINK commands for what has arrived so far. A file is deleted on board once
+ *  all of it is acknowledged.
+ *  Must match FSW/src/util/downlinkFrame.cpp, the summary in FSW/src/util/downlinkScheduler.cpp,
+ *  DOWNLINK_CHUNK_SIZE and DOWNLINK_ACK_CHUNKS in
+ *  FSW/src/headers/config.hpp and the command codes in FSW/src/headers/commandHandling.hpp.
+ */
+
+/* - - - - - - Includes - - - - - - */
+#include <cstdint>
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+/* - - - - - - Constants - - - - - - */
+const int DOWNLINK_CHUNK_SIZE = 236;    // bytes of file per frame, DOWNLINK_CHUNK_SIZE in config.hpp
+const int DOWNLINK_ACK_CHUNKS = 32;     // chunks per acknowledgement bitmap, DOWNLINK_ACK_CHUNKS in config.hpp
+const int MAXFILES = 250;               // science catalog slots, higher file IDs are burst files
+const int MAX_BURST_FILES = 10;         // burst files, MAX_BURST_FILES in config.hpp
+const int SUMMARY_FILE_ID = MAXFILES + MAX_BURST_FILES; // summary of the stored files, DOWNLINK_SUMMARY_ID in config.hpp
+const int ERROR_MAP_FILE_ID = SUMMARY_FILE_ID + 1;      // flash sector error map, DOWNLINK_ERROR_MAP_ID in config.hpp
+const int HK_HISTORY_FILE_ID = ERROR_MAP_FILE_ID + 1;   // housekeeping history blocks, one at a time, DOWNLINK_HK_HISTORY_ID in config.hpp
+const int SUMMARY_ENTRY_MEMSIZE = 15;   // file ID, version, size, timestamp, chunks acknowledged, quality
+const int ACK_DOWNLINK_CODE = 63;       // commandCode::ACK_DOWNLINK
+const int FRAME_HEADER_MEMSIZE = 13;    // type, file ID, version, file size, chunk, length
+const int FRAME_RAW_MEMSIZE = FRAME_HEADER_MEMSIZE + DOWNLINK_CHUNK_SIZE + 4;
+const int FRAME_WIRE_MEMSIZE = FRAME_RAW_MEMSIZE + 2; // COBS code byte and delimiter
+const uint8_t FRAME_FILE_DATA = 'D';
+
+/* - - - - - - Structs - - - - - - */
+
+// a decoded frame
+struct Frame {
+    uint8_t type = 0;
+    uint16_t fileId = 0;
+    uint16_t version = 0;
+    uint32_t fileSize = 0;
+    uint16_t chunk = 0;
+    uint16_t length = 0;
+    uint8_t data[DOWNLINK_CHUNK_SIZE] = {};
+};
+
+// a file being put back together
+struct FileAssembly {
+    uint16_t fileId = 0;
+    uint16_t version = 0;
+    uint32_t size = 0;
+    std::vector<uint8_t> data;
+    std::vector<bool> chunkSeen;
+    uint32_t chunksSeen = 0;
+    bool saved = false;         // handed out by takeComplete()
+    bool complete() const { return chunksSeen == chunkSeen.size(); }
+};
+
+// what the receiver has seen on the link
+struct ReceiverStats {
+    uint64_t bytes = 0;         // bytes pushed
+    uint32_t frames = 0;        // frames that passed their CRC
+    uint32_t duplicates = 0;    // good frames for chunks already received
+    uint32_t badFrames = 0;     // frame sized pieces that failed their CRC
+    uint32_t textPieces = 0;    // other pieces, diagnostic text
+    uint32_t filesComplete = 0;
+};
+
+/* - - - - - - Class Declarations - - - - - - */
+class FrameReceiver {
+    public:
+        void push(uint8_t byte);
+        void push(const uint8_t *bytes, size_t length);
+
+        // files with every chunk received since the last call
+        std::vector<FileAssembly> takeComplete();
+        const std::map<uint16_t, FileAssembly> &getFiles() const { return m_files; }
+        std::string takeText();
+        ReceiverStats getStats() const { return m_stats; }
+
+        static std::vector<std::string> ackCommands(const FileAssembly &file);
+        static bool decodeFrame(const uint8_t *wire, size_t length, Frame &frame);
+        static std::string fileName(uint16_t fileId);
+        static std::string fileName(const FileAssembly &file);
+        static std::vector<std::string> summaryLines(const FileAssembly &file);
+
+    private:
+        void endPiece();
+        void addChunk(const Frame &frame);
+
+        std::vector<uint8_t> m_piece;   // bytes since the last zero
+        std::map<uint16_t, FileAssembly> m_files;
+        std::vector<FileAssembly> m_replaced; // complete files a new version replaced before takeComplete()
+        std::string m_text;
+        ReceiverStats m_stats;
+};
+
+size_t cobsDecode(const uint8_t *src, size_t length, uint8_t *dst);
+uint32_t crc32c(const uint8_t *data, size_t size);
+
+#endif
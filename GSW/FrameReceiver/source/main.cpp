@@ -0,0 +1,81 @@
+/* main.cpp is the command line front end of the NS2 frame receiver
+ * Usage:
+ *  frameReceiver <capture file or serial device> [output directory]
+ *  Reads the link until it ends, writes every file that arrives whole to the output directory
+ *  under the name the flight software gives it, passes diagnostic text through to stdout and
+ *  lists the chunks still missing from files that did not complete. The files a summary lists are
+ *  printed when it arrives. The ACK_DOWNLINK commands for everything received are printed last
+ *  and written to acks.txt in the output directory, uplink them so NS2 deletes the complete files
+ *  and resends only the missing chunks.
+ */
+
+/* - - - - - - Includes - - - - - - */
+#include "frameReceiver.hpp"
+
+#include <cstdio>
+#include <string>
+
+// writes a complete file, returns false if it could not be written
+static bool saveFile(const FileAssembly &file, const std::string &directory) {
+    std::string path = directory + "/" + FrameReceiver::fileName(file);
+    FILE *out = fopen(path.c_str(), "wb");
+    if (out == nullptr) { return false; }
+    bool written = fwrite(file.data.data(), 1, file.data.size(), out) == file.data.size();
+    fclose(out);
+    printf("Received %s, %u bytes\n", path.c_str(), (unsigned)file.size);
+    if (file.fileId == SUMMARY_FILE_ID) {
+        for (const std::string &line : FrameReceiver::summaryLines(file)) { printf("  %s\n", line.c_str()); }
+    }
+    return written;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: frameReceiver <capture file or serial device> [output directory]\n");
+        return 2;
+    }
+    std::string directory = argc > 2 ? argv[2] : ".";
+    FILE *link = fopen(argv[1], "rb");
+    if (link == nullptr) {
+        fprintf(stderr, "could not open %s\n", argv[1]);
+        return 2;
+    }
+
+    int failures = 0;
+    uint8_t bytes[4096];
+    size_t length;
+    FrameReceiver receiver;
+    while ((length = fread(bytes, 1, sizeof(bytes), link)) > 0) {
+        receiver.push(bytes, length);
+        fputs(receiver.takeText().c_str(), stdout);
+        for (const FileAssembly &file : receiver.takeComplete()) {
+            if (!saveFile(file, directory)) { failures++; }
+        }
+    }
+    fclose(link);
+    receiver.push(0); // the link ended, whatever is left is text
+
+    fputs(receiver.takeText().c_str(), stdout);
+    std::string ackPath = directory + "/acks.txt";
+    FILE *acks = fopen(ackPath.c_str(), "w");
+    for (const auto &entry : receiver.getFiles()) {
+        const FileAssembly &file = entry.second;
+        if (!file.complete()) {
+            printf("Incomplete %s, missing chunk(s)", FrameReceiver::fileName(file.fileId).c_str());
+            for (size_t chunk = 0; chunk < file.chunkSeen.size(); chunk++) {
+                if (!file.chunkSeen[chunk]) { printf(" %u", (unsigned)chunk); }
+            }
+            printf("\n");
+            failures++;
+        }
+        for (const std::string &command : FrameReceiver::ackCommands(file)) {
+            printf("ACK %s\n", command.c_str());
+            if (acks != nullptr) { fprintf(acks, "%s\n", command.c_str()); }
+        }
+    }
+    if (acks != nullptr) { fclose(acks); }
+    ReceiverStats stats = receiver.getStats();
+    printf("%llu bytes, %u good frame(s), %u duplicate(s), %u bad frame(s), %u file(s) complete\n",
+           (unsigned long long)stats.bytes, stats.frames, stats.duplicates, stats.badFrames, stats.filesComplete);
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,163 @@
+/* adaptiveSamplingTest.cpp tests the AdaptiveSampler class
+ * Usage:
+ *  part of NS2 unit testing suite
+ *  to be called in unitTestDriver.cpp
+ *
+ *  Replays a synthetic sunrise profile through the adaptive sampler and compares it
+ *  to uniform sampling at SAMPLING_RATE. Both store the same number of bytes of flash,
+ *  so samples on the limb per KB of flash is the figure of merit.
+ */
+
+
+// NS2 includes
+#include "../headers/config.hpp"
+#include "../headers/adaptiveSampler.hpp"
+
+// replay profile
+const float REPLAY_LIMB_SEC = 120.0F;     // seconds, time the sun crosses the limb
+const float REPLAY_LIMB_WIDTH_SEC = 1.5F; // seconds, time constant of the limb transition
+const float REPLAY_DARK_BINS = 200.0F;    // ADC bins, signal before sunrise
+const float REPLAY_SUN_BINS = 50000.0F;   // ADC bins, signal after sunrise
+const int REPLAY_NOISE_BINS = 4;          // ADC bins, peak to peak noise added to the profile
+
+/* - - - - - - replaySample - - - - - - *
+ * Usage:
+ *  returns the synthetic photodiode sample at a given time
+ * 
+ * Inputs:
+ *  timeMsec - milliseconds since start of window
+ *  
+ * Outputs:
+ *  sample, ADC bins
+ */
+uint16_t replaySample(unsigned long timeMsec) {
+    static uint32_t lcg = 12345; // deterministic noise
+    lcg = lcg * 1103515245 + 12345;
+    float t = (timeMsec / 1000.0F - REPLAY_LIMB_SEC) / REPLAY_LIMB_WIDTH_SEC;
+    float value = REPLAY_DARK_BINS + (REPLAY_SUN_BINS - REPLAY_DARK_BINS) * 0.5F * (1.0F + tanhf(t));
+    return (uint16_t)(value + (int)((lcg >> 16) % REPLAY_NOISE_BINS));
+}
+
+/* - - - - - - isOnLimb - - - - - - *
+ * Usage:
+ *  returns whether a time falls within the limb transition (10% to 90% of the signal rise)
+ */
+bool isOnLimb(unsigned long timeMsec) {
+    float t = (timeMsec / 1000.0F - REPLAY_LIMB_SEC) / REPLAY_LIMB_WIDTH_SEC;
+    return fabsf(t) < 1.1F; // tanh(1.1) = 0.8
+}
+
+/* - - - - - - testAdaptiveReplay - - - - - - *
+ * Usage:
+ * replays a full window through uniform and adaptive sampling and reports limb resolution
+ * 
+ * Inputs:
+ *  none
+ *  
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testAdaptiveReplay() {
+    const unsigned long windowMsec = WINDOW_LENGTH_SEC * 1000UL;
+    const float flashKB = (SCIDATA_RAW_MEMSIZE) / 1024.0F; // same file size in both cases
+
+    // uniform sampling
+    int uniformTotal = 0;
+    int uniformLimb = 0;
+    for (unsigned long t = 0; t < windowMsec; t += SAMPLE_PERIOD_MSEC) {
+        uniformTotal++;
+        uniformLimb += isOnLimb(t);
+    }
+
+    // adaptive sampling
+    AdaptiveSampler sampler;
+    int adaptiveTotal = 0;
+    int adaptiveLimb = 0;
+    uint8_t code = ADAPTIVE_NOMINAL_RATE_CODE;
+    for (unsigned long t = 0; t < windowMsec; t += ADAPTIVE_PERIODS_MSEC[code]) {
+        adaptiveTotal++;
+        adaptiveLimb += isOnLimb(t);
+        code = sampler.update(replaySample(t), ADAPTIVE_PERIODS_MSEC[code]);
+    }
+
+    Serial.print("Uniform replay: ");
+    Serial.print(uniformTotal);
+    Serial.print(" samples, ");
+    Serial.print(uniformLimb);
+    Serial.print(" on limb, ");
+    Serial.print(uniformLimb / flashKB);
+    Serial.println(" limb samples/KB");
+    Serial.print("Adaptive replay: ");
+    Serial.print(adaptiveTotal);
+    Serial.print(" samples, ");
+    Serial.print(adaptiveLimb);
+    Serial.print(" on limb, ");
+    Serial.print(adaptiveLimb / flashKB);
+    Serial.println(" limb samples/KB");
+
+    if (adaptiveTotal > BUFFERSIZE) {
+        Serial.println("Adaptive replay overflowed the science buffer (adaptive sampling)");
+        return 1;
+    }
+    if (adaptiveLimb <= uniformLimb) {
+        Serial.println("Adaptive replay did not improve limb resolution (adaptive sampling)");
+        return 1;
+    }
+    return 0;
+}
+
+/* - - - - - - testAdaptiveBudget - - - - - - *
+ * Usage:
+ * feeds a constantly changing signal, which asks for the fastest rate forever,
+ * and checks that a full window still fits in the science buffer
+ * 
+ * Inputs:
+ *  none
+ *  
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testAdaptiveBudget() {
+    const unsigned long windowMsec = WINDOW_LENGTH_SEC * 1000UL;
+    AdaptiveSampler sampler;
+    int total = 0;
+    uint8_t code = ADAPTIVE_NOMINAL_RATE_CODE;
+    for (unsigned long t = 0; t < windowMsec; t += ADAPTIVE_PERIODS_MSEC[code]) {
+        total++;
+        uint16_t sample = (total % 2) ? 0 : 60000; // worst case square wave
+        code = sampler.update(sample, ADAPTIVE_PERIODS_MSEC[code]);
+    }
+    if (total > BUFFERSIZE) {
+        Serial.println("Adaptive sample budget exceeded (adaptive sampling)");
+        return 1;
+    }
+    return 0;
+}
+
+
+/* - - - - - - adaptiveSamplingTestMain - - - - - - *
+ * Usage:
+ * runs the adaptive sampling unit tests, prints results over serial
+ *  must be kept last in file since we are not using header structure for testing
+ * 
+ * Inputs:
+ *  none
+ *  
+ * Outputs:
+ *  number of tests that failed in module
+ */
+int adaptiveSamplingTestMain() {
+    int testsFailed = 0; // iterator to track how many tests have failed
+
+    testsFailed += testAdaptiveReplay();
+    testsFailed += testAdaptiveBudget();
+
+    // print module summary
+    Serial.print("Adaptive Sampling module: ");
+    Serial.print(testsFailed);
+    Serial.println(" tests failed");
+
+    return testsFailed;
+}
@@ -0,0 +1,256 @@
+/* attitudeFusionTest.cpp tests the AttitudeFusion class
+ * Usage:
+ *  part of NS2 unit testing suite
+ *  to be called in unitTestDriver.cpp
+ *
+ *  Checks interpolation accuracy against a known attitude profile, measures
+ *  how many photodiode samples per second align() can keep up with, and checks
+ *  the delta encoded attitude column saved with each science file.
+ */
+
+
+// NS2 includes
+#include "../headers/config.hpp"
+#include "../headers/attitudeFusion.hpp"
+#include "../headers/encodedSciData.hpp"
+#include "testFixtures.hpp"
+
+const uint32_t FUSION_TEST_ATTITUDE_PERIOD = 10000; // microseconds, 100 Hz ADCS
+const float FUSION_TEST_RATE_DEG_PER_SEC = 2.0F;    // deg/s, slew rate of the test profile
+const int FUSION_TEST_MIN_RATE_MULTIPLE = 5;        // align() must sustain this multiple of SAMPLING_RATE
+
+/* - - - - - - fusionTestProfile - - - - - - *
+ * Usage:
+ *  returns the elevation of the linear test profile at a given time
+ */
+float fusionTestProfile(uint32_t timeMicros) {
+    return -10.0F + FUSION_TEST_RATE_DEG_PER_SEC * (timeMicros / 1000000.0F);
+}
+
+/* - - - - - - testFusionAccuracy - - - - - - *
+ * Usage:
+ * aligns photodiode samples taken between attitude samples of a linear slew,
+ * every aligned value must be within one LSB of the true elevation
+ * 
+ * Inputs:
+ *  none
+ *  
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testFusionAccuracy() {
+    static AttitudeFusion fusion;
+    int16_t *column = (int16_t *)testPages; // aligned column, built in the scratch file
+    fusion.reset();
+
+    const uint32_t photoPeriod = 1000000 / SAMPLING_RATE;
+    uint32_t nextAttitude = 0;
+    int samples = 0;
+    for (uint32_t t = 1000; samples < BUFFERSIZE && t < 5000000; t += photoPeriod) {
+        // ADCS reports everything up to and past this sample first
+        while ((int32_t)(nextAttitude - t) <= (int32_t)FUSION_TEST_ATTITUDE_PERIOD) {
+            AttitudeSample sample;
+            sample.timeMicros = nextAttitude;
+            sample.elevationDeg = fusionTestProfile(nextAttitude);
+            fusion.pushAttitude(sample);
+            nextAttitude += FUSION_TEST_ATTITUDE_PERIOD;
+        }
+        fusion.addPhotoSample(t, samples, column);
+        fusion.align(column, t, ATTITUDE_PENDING_SIZE);
+
+        float error = fabsf(AttitudeFusion::dequantize(column[samples]) - fusionTestProfile(t));
+        if (column[samples] == ATTITUDE_INVALID || error > ATTITUDE_LSB_DEG) {
+            Serial.print("Attitude misaligned at ");
+            Serial.print(t);
+            Serial.println(" us (attitude fusion)");
+            return 1;
+        }
+        samples++;
+    }
+
+    FusionStats stats = fusion.getStats();
+    if (stats.aligned != (uint32_t)samples || stats.unaligned != 0) {
+        Serial.println("Attitude fusion counters incorrect (attitude fusion)");
+        return 1;
+    }
+    return 0;
+}
+
+/* - - - - - - testFusionGap - - - - - - *
+ * Usage:
+ * samples with no attitude after them are marked invalid once ATTITUDE_MAX_WAIT_MICROS passes
+ * 
+ * Inputs:
+ *  none
+ *  
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testFusionGap() {
+    static AttitudeFusion fusion;
+    int16_t column[2] = {0, 0};
+    fusion.reset();
+
+    AttitudeSample sample;
+    sample.timeMicros = 0;
+    sample.elevationDeg = 1.0F;
+    fusion.pushAttitude(sample);
+    fusion.addPhotoSample(5000, 0, column);
+
+    // waiting on the next attitude sample
+    if (fusion.align(column, 6000, 1) != 0 || column[0] != ATTITUDE_INVALID) {
+        Serial.println("Attitude resolved before it arrived (attitude fusion)");
+        return 1;
+    }
+    // ADCS never reports, give up
+    if (fusion.align(column, 5000 + ATTITUDE_MAX_WAIT_MICROS, 1) != 1 || column[0] != ATTITUDE_INVALID) {
+        Serial.println("Stale sample not released (attitude fusion)");
+        return 1;
+    }
+    return 0;
+}
+
+/* - - - - - - testFusionThroughput - - - - - - *
+ * Usage:
+ * times align() on a stream of photodiode samples at 10x SAMPLING_RATE
+ * and reports the sustainable rate as a multiple of SAMPLING_RATE
+ * 
+ * Inputs:
+ *  none
+ *  
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testFusionThroughput() {
+    static AttitudeFusion fusion;
+    int16_t *column = (int16_t *)testPages; // aligned column, built in the scratch file
+    fusion.reset();
+
+    const uint32_t photoPeriod = 1000000 / (10 * SAMPLING_RATE);
+    const int totalSamples = 20000;
+    uint32_t nextAttitude = 0;
+    uint32_t t = 0;
+    unsigned long busyMicros = 0;
+
+    for (int i = 0; i < totalSamples; i++) {
+        t += photoPeriod;
+        while ((int32_t)(nextAttitude - t) <= (int32_t)FUSION_TEST_ATTITUDE_PERIOD) {
+            AttitudeSample sample;
+            sample.timeMicros = nextAttitude;
+            sample.elevationDeg = fusionTestProfile(nextAttitude);
+            fusion.pushAttitude(sample);
+            nextAttitude += FUSION_TEST_ATTITUDE_PERIOD;
+        }
+
+        unsigned long start = micros();
+        fusion.addPhotoSample(t, i % BUFFERSIZE, column);
+        fusion.align(column, t, ATTITUDE_ALIGN_MAX_WORK);
+        busyMicros += micros() - start;
+    }
+
+    if (busyMicros == 0) { busyMicros = 1; }
+    float sustainableHz = totalSamples * 1000000.0F / busyMicros;
+    float multiple = sustainableHz / SAMPLING_RATE;
+    Serial.print("Attitude fusion: ");
+    Serial.print(busyMicros);
+    Serial.print(" us for ");
+    Serial.print(totalSamples);
+    Serial.print(" samples, sustains ");
+    Serial.print(multiple);
+    Serial.println("x SAMPLING_RATE");
+
+    if (fusion.getStats().photoDropped != 0 || multiple < FUSION_TEST_MIN_RATE_MULTIPLE) {
+        Serial.println("Attitude fusion cannot keep up (attitude fusion)");
+        return 1;
+    }
+    return 0;
+}
+
+
+/* - - - - - - testAttitudeColumn - - - - - - *
+ * Usage:
+ * delta encodes a column holding a slew, a gap with no attitude and a step too large for
+ * one delta. The slew and gap must decode exactly, the step must be reached by the next
+ * keyframe.
+ * 
+ * Inputs:
+ *  none
+ *  
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testAttitudeColumn() {
+    int16_t *column = (int16_t *)testPages;    // columns are kept in the scratch files
+    int16_t *decoded = (int16_t *)testReadBack;
+    static uint8_t packed[ATTITUDE_COLUMN_MEMSIZE];
+    const int gapStart = 1000, gapEnd = 1100;          // samples with no attitude
+    const int stepIdx = 5 * ATTITUDE_KEYFRAME_SAMPLES + 10; // 10 degree step
+    const int16_t stepSize = 1000;
+
+    for (int i = 0; i < BUFFERSIZE; i++) {
+        column[i] = -1000 + i / 4 + (i % 7) * 10 - 30; // noisy slew, 0.0025 deg per sample
+        if (i >= stepIdx) { column[i] += stepSize; }
+        if (i >= gapStart && i < gapEnd) { column[i] = ATTITUDE_INVALID; }
+    }
+    EncodedSciData::packAttitude(column, packed);
+    EncodedSciData::unpackAttitude(packed, decoded);
+
+    int settledIdx = (stepIdx / ATTITUDE_KEYFRAME_SAMPLES + 1) * ATTITUDE_KEYFRAME_SAMPLES;
+    for (int i = 0; i < BUFFERSIZE; i++) {
+        bool settling = i >= stepIdx && i < settledIdx;
+        if ((settling && abs(decoded[i] - column[i]) > stepSize) || (!settling && decoded[i] != column[i])) {
+            Serial.print("Attitude column decoded wrong at sample ");
+            Serial.print(i);
+            Serial.println(" (attitude fusion)");
+            return 1;
+        }
+    }
+
+    // a file saved without attitude reads as unaligned
+    EncodedSciData::packAttitude(nullptr, packed);
+    EncodedSciData::unpackAttitude(packed, decoded);
+    for (int i = 0; i < BUFFERSIZE; i++) {
+        if (decoded[i] != ATTITUDE_INVALID) {
+            Serial.println("Missing attitude column decoded as aligned (attitude fusion)");
+            return 1;
+        }
+    }
+
+    Serial.print("Attitude column: ");
+    Serial.print(ATTITUDE_COLUMN_MEMSIZE);
+    Serial.print(" bytes, ");
+    Serial.print(BUFFERSIZE * (int)sizeof(int16_t));
+    Serial.println(" bytes unencoded");
+    return 0;
+}
+
+/* - - - - - - attitudeFusionTestMain - - - - - - *
+ * Usage:
+ * runs the attitude fusion unit tests, prints results over serial
+ *  must be kept last in file since we are not using header structure for testing
+ * 
+ * Inputs:
+ *  none
+ *  
+ * Outputs:
+ *  number of tests that failed in module
+ */
+int attitudeFusionTestMain() {
+    int testsFailed = 0; // iterator to track how many tests have failed
+
+    testsFailed += testFusionAccuracy();
+    testsFailed += testFusionGap();
+    testsFailed += testFusionThroughput();
+    testsFailed += testAttitudeColumn();
+
+    // print module summary
+    Serial.print("Attitude Fusion module: ");
+    Serial.print(testsFailed);
+    Serial.println(" tests failed");
+
+    return testsFailed;
+}
@@ -0,0 +1,235 @@
+/* blackBoxTest.cpp tests the flash black box recorder
+ * Usage:
+ *  part of NS2 unit testing suite
+ *  to be called in unitTestDriver.cpp
+ *
+ *  Mounts the record store on a simulated flash module in RAM, the flight record store and
+ *  black box are restored at the end.
+ */
+
+
+// NS2 includes
+#include "../headers/config.hpp"
+#include "../headers/flashDevice.hpp"
+#include "../headers/recordStore.hpp"
+#include "../headers/flashQueue.hpp"
+#include "../headers/blackBox.hpp"
+#include "../headers/faultManager.hpp"
+#include "testFixtures.hpp"
+
+const int BB_TEST_SECTOR_SIZE = 65536;
+const int BB_TEST_SECTORS = 2;
+
+/* - - - - - - testBlackBoxCost - - - - - - *
+ * Usage:
+ * measures the time a log call takes, sealing blocks included, and the flash the events take
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testBlackBoxCost() {
+    static BlackBox box;
+    testFlash1.eraseAll();
+    recordStore.format(&testFlash1);
+    box.begin();
+
+    // two blocks of events with two arguments each, then written outside the timing
+    const int rounds = 500;
+    const int perRound = 2 * (BLACKBOX_BLOCK_MEMSIZE - BlackBox::HEADER_MEMSIZE) / (BlackBox::ENTRY_MEMSIZE + 8) - 2;
+    unsigned long elapsed = 0;
+    for (int round = 0; round < rounds; round++) {
+        unsigned long start = micros();
+        for (int i = 0; i < perRound; i++) { box.log(BB_FAULT, 2, i, round); }
+        elapsed += micros() - start;
+        box.flush();
+    }
+    BlackBoxStats stats = box.getStats();
+    float nanosPerCall = elapsed * 1000.0F / (rounds * perRound);
+    float flashPerEvent = (float)stats.flashBytes / stats.logCalls;
+    Serial.print("Black Box: ");
+    Serial.print(nanosPerCall);
+    Serial.print(" ns per log call, ");
+    Serial.print(flashPerEvent);
+    Serial.print(" flash bytes per event, ");
+    Serial.print(flashPerEvent * 60);
+    Serial.println(" flash bytes per hour at one event a minute");
+    if (stats.logCalls != (uint32_t)(rounds * perRound) || stats.dropped != 0 || stats.blocksLost != 0) {
+        Serial.println("Events not logged (black box)");
+        return 1;
+    }
+    if (nanosPerCall > 2000) {
+        Serial.println("Log call too slow (black box)");
+        return 1;
+    }
+    return 0;
+}
+
+/* - - - - - - testBlackBoxRoundTrip - - - - - - *
+ * Usage:
+ * events read back from a stored block match the ones logged, the block is indexed again after
+ * a remount, and a truncated block is refused
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testBlackBoxRoundTrip() {
+    static BlackBox box;
+    static uint8_t block[BLACKBOX_BLOCK_MEMSIZE];
+    BlackBoxEntry entries[8];
+    testFlash1.eraseAll();
+    recordStore.format(&testFlash1);
+    box.begin();
+
+    box.log(BB_STARTUP, 2, 7, 1);
+    box.log(BB_MODE, 2, 3, 1);
+    box.log(BB_COMMAND, 3, 12, -2000, 50);
+    box.log(BB_RESTART);
+    uint32_t activeLength = 0;
+    box.getActive(activeLength);
+    if (!box.flush() || box.blockCount() != 1 || box.getActive(activeLength) == nullptr || activeLength != 0) {
+        Serial.println("Block not written by flush (black box)");
+        return 1;
+    }
+
+    recordStore.mount(&testFlash1);
+    box.begin();
+    int recordIdx = recordStore.find(RECORD_BLACK_BOX, box.getBlockKey(0));
+    uint32_t length = recordIdx >= 0 ? recordStore.getRecord(recordIdx).length : 0;
+    if (box.blockCount() != 1 || recordIdx < 0 || !recordStore.read(recordIdx, block, 0, length)) {
+        Serial.println("Block not indexed after a remount (black box)");
+        return 1;
+    }
+    int count = readBlackBoxBlock(block, length, entries, 8);
+    if (count != 4 || entries[0].event != BB_STARTUP || entries[0].argc != 2 || entries[0].args[0] != 7
+        || entries[2].event != BB_COMMAND || entries[2].argc != 3 || entries[2].args[1] != -2000
+        || entries[2].args[2] != 50 || entries[3].event != BB_RESTART || entries[3].argc != 0
+        || entries[3].millis < entries[0].millis || entries[0].startCount != payloadData.startCount) {
+        Serial.println("Events read back incorrectly (black box)");
+        return 1;
+    }
+    if (readBlackBoxBlock(block, length - 2, entries, 8) != -1) {
+        Serial.println("Truncated block read (black box)");
+        return 1;
+    }
+    return 0;
+}
+
+/* - - - - - - testBlackBoxRing - - - - - - *
+ * Usage:
+ * a full block is written by handle() through the flash queue, events are dropped once both
+ * blocks are full, and the oldest blocks are removed past BLACKBOX_BLOCKS
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testBlackBoxRing() {
+    static BlackBox box;
+    testFlash1.eraseAll();
+    recordStore.format(&testFlash1);
+    box.begin();
+
+    // fills both blocks, the first is sealed and the rest of the events dropped
+    const int perBlock = (BLACKBOX_BLOCK_MEMSIZE - BlackBox::HEADER_MEMSIZE) / (BlackBox::ENTRY_MEMSIZE + 12);
+    for (int i = 0; i < 3 * perBlock; i++) { box.log(BB_COMMAND, 3, i, i, i); }
+    uint32_t sealedLength = 0;
+    box.getSealed(sealedLength);
+    if (box.getStats().dropped != (uint32_t)perBlock || sealedLength == 0) {
+        Serial.println("Events not dropped with both blocks full (black box)");
+        return 1;
+    }
+    box.handle();
+    flashQueue.flush();
+    box.getSealed(sealedLength);
+    if (box.blockCount() != 1 || box.getStats().blocksWritten != 1 || sealedLength != 0) {
+        Serial.println("Sealed block not written by handle() (black box)");
+        return 1;
+    }
+
+    // one block per flush, the ring keeps the newest
+    for (int i = 0; i < BLACKBOX_BLOCKS + 2; i++) {
+        box.log(BB_FAULT, 1, i);
+        box.flush();
+    }
+    int stored = 0;
+    for (int idx = 0; idx < recordStore.count(); idx++) { stored += recordStore.getRecord(idx).type == RECORD_BLACK_BOX; }
+    if (box.blockCount() != BLACKBOX_BLOCKS || stored != BLACKBOX_BLOCKS || box.getStats().blocksRemoved != 3
+        || box.getBlockKey(0) != 3 || box.getBlockKey(BLACKBOX_BLOCKS - 1) != BLACKBOX_BLOCKS + 2) {
+        Serial.println("Oldest blocks not removed (black box)");
+        return 1;
+    }
+    return 0;
+}
+
+/* - - - - - - testBlackBoxDump - - - - - - *
+ * Usage:
+ * the dump prints the events in RAM and on flash, the same events after they are written
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testBlackBoxDump() {
+    testFlash1.eraseAll();
+    recordStore.format(&testFlash1);
+    blackBox.begin();
+    blackBox.flush(); // events logged by earlier tests
+    int before = dumpBlackBox();
+    blackBox.log(BB_SCIENCE_SAVED, 2, 3, 1);
+    blackBox.log(BB_EVICTED, 2, 1, -4);
+    blackBox.log(BB_RESTART, 1, 1);
+    int inRam = dumpBlackBox();
+    blackBox.flush();
+    if (inRam != before + 3 || dumpBlackBox() != before + 3) {
+        Serial.println("Events not dumped (black box)");
+        return 1;
+    }
+    return 0;
+}
+
+
+/* - - - - - - blackBoxTestMain - - - - - - *
+ * Usage:
+ * runs the black box unit tests, prints results over serial
+ *  must be kept last in file since we are not using header structure for testing
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  number of tests that failed in module
+ */
+int blackBoxTestMain() {
+    resetTestFlash(BB_TEST_SECTOR_SIZE, BB_TEST_SECTORS);
+    int testsFailed = 0; // iterator to track how many tests have failed
+
+    testsFailed += testBlackBoxCost();
+    testsFailed += testBlackBoxRoundTrip();
+    testsFailed += testBlackBoxRing();
+    testsFailed += testBlackBoxDump();
+
+    // give back the flight record store and black box
+    initRecordStore();
+    initBlackBox();
+
+    // print module summary
+    Serial.print("Black Box module: ");
+    Serial.print(testsFailed);
+    Serial.println(" tests failed");
+
+    return testsFailed;
+}
@@ -0,0 +1,151 @@
+/* burstCaptureTest.cpp tests the BurstRing class
+ * Usage:
+ *  part of NS2 unit testing suite
+ *  to be called in unitTestDriver.cpp
+ *
+ *  A counting stand-in ADC replaces the science ADC, so every sample value equals its sample number
+ */
+
+
+// NS2 includes
+#include "../headers/config.hpp"
+#include "../headers/burstCapture.hpp"
+
+static uint16_t standInCount = 0; // next value of the stand-in ADC
+
+/* - - - - - - standInAdc - - - - - - *
+ * Usage:
+ *  stand-in for the science ADC, returns consecutive integers
+ */
+uint16_t standInAdc() {
+    return standInCount++;
+}
+
+/* - - - - - - testBurstPreTrigger - - - - - - *
+ * Usage:
+ * fills the ring past its size, triggers, and checks that the frozen burst holds
+ * exactly BURST_PRE_SAMPLES before and BURST_POST_SAMPLES after the trigger
+ * 
+ * Inputs:
+ *  none
+ *  
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testBurstPreTrigger() {
+    static BurstRing ring; // static, the ring is too large for the stack of some boards
+    static uint16_t burst[BURST_SAMPLES];
+    BurstHeader header;
+    BurstSampleSource source = standInAdc;
+    standInCount = 0;
+    ring.reset();
+
+    // fill with more history than fits
+    for (int i = 0; i < 3 * BURST_SAMPLES; i++) { ring.addSample(source()); }
+    uint16_t triggerValue = standInCount; // first sample after the trigger
+    ring.trigger(BURST_TRIGGER_COMMAND, 1234);
+
+    // a second trigger during the burst is ignored
+    if (ring.trigger(BURST_TRIGGER_SWEEP, 1235)) {
+        Serial.println("Second trigger accepted during burst (burst capture)");
+        return 1;
+    }
+
+    for (int i = 0; i < BURST_POST_SAMPLES; i++) {
+        if (ring.isFrozen()) {
+            Serial.println("Burst froze early (burst capture)");
+            return 1;
+        }
+        ring.addSample(source());
+    }
+    if (!ring.isFrozen()) {
+        Serial.println("Burst did not freeze (burst capture)");
+        return 1;
+    }
+
+    // samples while frozen are lost, not stored
+    uint32_t lostBefore = ring.getSamplesLost();
+    for (int i = 0; i < 10; i++) { ring.addSample(source()); }
+    if (ring.getSamplesLost() != lostBefore + 10) {
+        Serial.println("Lost samples not counted while frozen (burst capture)");
+        return 1;
+    }
+
+    ring.copyBurst(burst, header);
+    if (burst[BURST_PRE_SAMPLES] != triggerValue || header.preSamples != BURST_PRE_SAMPLES
+        || header.triggerMillis != 1234 || header.source != BURST_TRIGGER_COMMAND) {
+        Serial.println("Burst not aligned to trigger (burst capture)");
+        return 1;
+    }
+    for (int i = 1; i < BURST_SAMPLES; i++) {
+        if (burst[i] != burst[i - 1] + 1) {
+            Serial.println("Burst samples out of order (burst capture)");
+            return 1;
+        }
+    }
+
+    // after release a new burst can be captured
+    ring.release();
+    if (!ring.trigger(BURST_TRIGGER_SWEEP, 2000)) {
+        Serial.println("Trigger rejected after release (burst capture)");
+        return 1;
+    }
+    return 0;
+}
+
+/* - - - - - - testBurstShortHistory - - - - - - *
+ * Usage:
+ * triggers before the pre-trigger history has filled and checks the header reports it
+ * 
+ * Inputs:
+ *  none
+ *  
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testBurstShortHistory() {
+    static BurstRing ring;
+    static uint16_t burst[BURST_SAMPLES];
+    BurstHeader header;
+    standInCount = 0;
+    ring.reset();
+
+    for (int i = 0; i < 10; i++) { ring.addSample(standInAdc()); }
+    ring.trigger(BURST_TRIGGER_SUNRISE, 0);
+    for (int i = 0; i < BURST_POST_SAMPLES; i++) { ring.addSample(standInAdc()); }
+    ring.copyBurst(burst, header);
+
+    if (header.preSamples != 10 || burst[BURST_PRE_SAMPLES] != 10) {
+        Serial.println("Short pre-trigger history not reported (burst capture)");
+        return 1;
+    }
+    return 0;
+}
+
+
+/* - - - - - - burstCaptureTestMain - - - - - - *
+ * Usage:
+ * runs the burst capture unit tests, prints results over serial
+ *  must be kept last in file since we are not using header structure for testing
+ * 
+ * Inputs:
+ *  none
+ *  
+ * Outputs:
+ *  number of tests that failed in module
+ */
+int burstCaptureTestMain() {
+    int testsFailed = 0; // iterator to track how many tests have failed
+
+    testsFailed += testBurstPreTrigger();
+    testsFailed += testBurstShortHistory();
+
+    // print module summary
+    Serial.print("Burst Capture module: ");
+    Serial.print(testsFailed);
+    Serial.println(" tests failed");
+
+    return testsFailed;
+}
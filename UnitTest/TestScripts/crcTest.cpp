@@ -0,0 +1,189 @@
+/* crcTest.cpp tests the crc32c checksum
+ * Usage:
+ *  part of NS2 unit testing suite
+ *  to be called in unitTestDriver.cpp
+ *
+ *  Compares crc32c() against a bit at a time reference over every alignment, and measures
+ *  checking a clean science file by its page checksums against decoding it.
+ */
+
+
+// NS2 includes
+#include "../headers/config.hpp"
+#include "../headers/crc.hpp"
+#include "../headers/encodedSciData.hpp"
+#include "testFixtures.hpp"
+
+
+/* - - - - - - crcTestReference - - - - - - *
+ * Usage:
+ *  CRC-32C a bit at a time, straight from the polynomial
+ */
+uint32_t crcTestReference(const uint8_t *data, size_t size, uint32_t crc = 0) {
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0x82F63B78 & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+/* - - - - - - testCrcVectors - - - - - - *
+ * Usage:
+ * crc32c gives the published check values of the Castagnoli polynomial
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testCrcVectors() {
+    const char *check = "123456789";
+    uint8_t zeros[32] = {};
+    uint8_t ones[32];
+    memset(ones, 0xFF, sizeof(ones));
+    if (crc32c(check, 9) != 0xE3069283 || crc32c(zeros, sizeof(zeros)) != 0x8A9136AA
+        || crc32c(ones, sizeof(ones)) != 0x62A8AB43 || crc32c(check, 0) != 0) {
+        Serial.println("crc32c check values incorrect (crc)");
+        return 1;
+    }
+    return 0;
+}
+
+/* - - - - - - testCrcAlignment - - - - - - *
+ * Usage:
+ * crc32c matches the reference from every start alignment and length around a step of 8 bytes,
+ * and in pieces of any size
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testCrcAlignment() {
+    for (int i = 0; i < 1024; i++) { testPages[i] = (uint8_t)(i * 151 + 7); }
+
+    for (int start = 0; start < 8; start++) {
+        for (int length = 0; length < 40; length++) {
+            if (crc32c(testPages + start, length) != crcTestReference(testPages + start, length)) {
+                Serial.println("crc32c differs from reference at an alignment (crc)");
+                return 1;
+            }
+        }
+    }
+
+    uint32_t whole = crcTestReference(testPages, 1000);
+    for (int split = 1; split < 40; split++) {
+        uint32_t crc = 0;
+        for (int offset = 0; offset < 1000; offset += split) {
+            crc = crc32c(testPages + offset, min(split, 1000 - offset), crc);
+        }
+        if (crc != whole) {
+            Serial.println("crc32c in pieces differs from whole (crc)");
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* - - - - - - testCrcCost - - - - - - *
+ * Usage:
+ * measures crc32c against the bit at a time reference, and checking a clean science file by
+ * its page checksums against decoding it with fill() and scrub(), which must be at least an
+ * order of magnitude slower
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testCrcCost() {
+    const int repeats = 20;
+    EncodedSciData &file = testSciFile;
+    uint16_t *buffer = testRing;
+    for (int i = 0; i < BUFFERSIZE; i++) { buffer[i] = (uint16_t)(i * 37 + 11); }
+    unsigned long timestamp = 99;
+    file.encodeData(buffer, timestamp);
+    file.toPages(testPages);
+
+    // checksums of one file worth of data
+    volatile uint32_t sink = 0;
+    uint32_t startMicros = micros();
+    for (int i = 0; i < repeats; i++) { sink = sink + crcTestReference(testPages, EncodedSciData::PAGED_MEMSIZE); }
+    uint32_t referenceMicros = micros() - startMicros;
+    startMicros = micros();
+    for (int i = 0; i < repeats; i++) { sink = sink + crc32c(testPages, EncodedSciData::PAGED_MEMSIZE); }
+    uint32_t crcMicros = micros() - startMicros;
+
+    // clean file, page checksums only against decoding every block
+    uint8_t *pages = testReadBack;
+    int badPages = 0;
+    startMicros = micros();
+    for (int i = 0; i < repeats; i++) {
+        memcpy(pages, testPages, EncodedSciData::PAGED_MEMSIZE);
+        badPages += EncodedSciData::unpage(pages);
+    }
+    uint32_t checkMicros = micros() - startMicros;
+    EncodedSciData &decoded = testSciFile;
+    int errors = 0;
+    startMicros = micros();
+    for (int i = 0; i < repeats; i++) {
+        memcpy(pages, testPages, EncodedSciData::PAGED_MEMSIZE);
+        EncodedSciData::unpage(pages);
+        decoded.fill(pages);
+        errors += decoded.scrub().numErrors;
+    }
+    uint32_t decodeMicros = micros() - startMicros;
+
+    uint32_t megabytes = (uint32_t)((uint64_t)repeats * EncodedSciData::PAGED_MEMSIZE * 1000000 / 1048576);
+    Serial.print("crc32c: ");
+    Serial.print(referenceMicros > 0 ? megabytes / referenceMicros : 0);
+    Serial.print(" MB/s bitwise, ");
+    Serial.print(crcMicros > 0 ? megabytes / crcMicros : 0);
+    Serial.print(" MB/s slice-by-8; clean file ");
+    Serial.print(checkMicros / repeats);
+    Serial.print(" us checking pages, ");
+    Serial.print(decodeMicros / repeats);
+    Serial.println(" us decoding");
+
+    if (badPages != 0 || errors != 0 || checkMicros * 10 > decodeMicros || crcMicros * 4 > referenceMicros) {
+        Serial.println("Checking a clean file not an order of magnitude faster than decoding (crc)");
+        return 1;
+    }
+    return 0;
+}
+
+
+/* - - - - - - crcTestMain - - - - - - *
+ * Usage:
+ * runs the crc unit tests, prints results over serial
+ *  must be kept last in file since we are not using header structure for testing
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  number of tests that failed in module
+ */
+int crcTestMain() {
+    int testsFailed = 0; // iterator to track how many tests have failed
+
+    testsFailed += testCrcVectors();
+    testsFailed += testCrcAlignment();
+    testsFailed += testCrcCost();
+
+    // print module summary
+    Serial.print("CRC module: ");
+    Serial.print(testsFailed);
+    Serial.println(" tests failed");
+
+    return testsFailed;
+}
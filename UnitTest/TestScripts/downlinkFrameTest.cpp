@@ -0,0 +1,205 @@
+/* downlinkFrameTest.cpp tests the downlink framing
+ * Usage:
+ *  part of NS2 unit testing suite
+ *  to be called in unitTestDriver.cpp
+ *
+ *  Frames are built into RAM the way writeFrame() sends them, nothing is sent.
+ */
+
+
+// NS2 includes
+#include "../headers/config.hpp"
+#include "../headers/downlinkFrame.hpp"
+
+const uint32_t DF_TEST_FILE_SIZE = 5000;
+static uint8_t dfTestFile[DF_TEST_FILE_SIZE];
+
+/* - - - - - - testCobs - - - - - - *
+ * Usage:
+ * COBS encoding leaves no zero bytes, costs at most a byte per 254 and decodes to the
+ * original, including runs longer than 254 bytes and data of only zeros
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testCobs() {
+    static uint8_t src[600];
+    static uint8_t encoded[600 + 600 / 254 + 1];
+    static uint8_t decoded[sizeof(encoded)];
+
+    for (int pattern = 0; pattern < 3; pattern++) {
+        for (int i = 0; i < 600; i++) {
+            if (pattern == 0) { src[i] = (uint8_t)(i % 7 == 0 ? 0 : i); } // scattered zeros
+            else if (pattern == 1) { src[i] = (uint8_t)(i % 255 + 1); } // no zeros, runs past 254
+            else { src[i] = 0; }
+        }
+        size_t length = cobsEncode(src, 600, encoded);
+        if (length > sizeof(encoded) || memchr(encoded, 0, length) != nullptr) {
+            Serial.println("Encoded data holds a zero or is too long (downlink frame)");
+            return 1;
+        }
+        if (cobsDecode(encoded, length, decoded) != 600 || memcmp(src, decoded, 600) != 0) {
+            Serial.println("Encoded data did not decode to the original (downlink frame)");
+            return 1;
+        }
+    }
+
+    // a zero inside a frame, or a run past its end, is not COBS
+    encoded[5] = 0;
+    uint8_t shortRun[] = {5, 1, 2};
+    if (cobsDecode(encoded, 20, decoded) != 0 || cobsDecode(shortRun, sizeof(shortRun), decoded) != 0) {
+        Serial.println("Malformed data decoded (downlink frame)");
+        return 1;
+    }
+    return 0;
+}
+
+/* - - - - - - testFrameRoundTrip - - - - - - *
+ * Usage:
+ * a frame is always WIRE_MEMSIZE bytes ending in its only zero, decodes to the same chunk,
+ * and is dropped if any byte changes
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testFrameRoundTrip() {
+    static DownlinkFrame frame;
+    static DownlinkFrame received;
+    static uint8_t wire[DownlinkFrame::WIRE_MEMSIZE];
+    for (uint32_t i = 0; i < DF_TEST_FILE_SIZE; i++) { dfTestFile[i] = (uint8_t)(i % 3 == 0 ? 0 : i * 7); }
+
+    // last chunk, partly padding
+    uint16_t chunk = DF_TEST_FILE_SIZE / DOWNLINK_CHUNK_SIZE;
+    uint32_t offset = chunk * DOWNLINK_CHUNK_SIZE;
+    frame.fill(42, 0xBEEF, dfTestFile, DF_TEST_FILE_SIZE, chunk);
+    size_t length = frame.encode(wire);
+    if (length != DownlinkFrame::WIRE_MEMSIZE || wire[length - 1] != 0 || memchr(wire, 0, length - 1) != nullptr) {
+        Serial.println("Frame is not fixed size with one delimiter (downlink frame)");
+        return 1;
+    }
+    if (!received.decode(wire, length - 1) || received.fileId != 42 || received.version != 0xBEEF
+        || received.fileSize != DF_TEST_FILE_SIZE || received.chunk != chunk || received.length != DF_TEST_FILE_SIZE - offset
+        || memcmp(received.data, dfTestFile + offset, received.length) != 0) {
+        Serial.println("Frame did not decode to the same chunk (downlink frame)");
+        return 1;
+    }
+
+    // any changed byte fails the CRC or the encoding
+    for (size_t i = 0; i < length - 1; i += 17) {
+        wire[i] ^= 0x10;
+        bool accepted = received.decode(wire, length - 1);
+        wire[i] ^= 0x10;
+        if (accepted) {
+            Serial.println("Corrupted frame accepted (downlink frame)");
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* - - - - - - testFrameReassembly - - - - - - *
+ * Usage:
+ * a file framed behind diagnostic text is found and put back together from the stream, a
+ * corrupted frame loses only its own chunk, and most of the link carries file data
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testFrameReassembly() {
+    const int frames = (DF_TEST_FILE_SIZE + DOWNLINK_CHUNK_SIZE - 1) / DOWNLINK_CHUNK_SIZE;
+    static uint8_t stream[64 + frames * DownlinkFrame::WIRE_MEMSIZE];
+    static uint8_t rebuilt[DF_TEST_FILE_SIZE];
+    static bool chunkSeen[frames];
+    static DownlinkFrame frame;
+
+    // stream as DownlinkTransfer::sendWanted() writes it, after a line of text
+    const char text[] = "Downlinking sci042.bin:\n";
+    size_t streamLength = 0;
+    memcpy(stream, text, sizeof(text) - 1);
+    streamLength += sizeof(text) - 1;
+    stream[streamLength++] = 0;
+    size_t fileStart = streamLength;
+    for (int chunk = 0; chunk < frames; chunk++) {
+        frame.fill(42, 1, dfTestFile, DF_TEST_FILE_SIZE, chunk);
+        streamLength += frame.encode(stream + streamLength);
+    }
+    stream[fileStart + 3 * DownlinkFrame::WIRE_MEMSIZE + 100] ^= 0x01; // bit error in the fourth frame
+
+    // split at the zeros, decode and place each chunk
+    memset(rebuilt, 0, sizeof(rebuilt));
+    memset(chunkSeen, 0, sizeof(chunkSeen));
+    int good = 0;
+    int dropped = 0;
+    size_t start = 0;
+    for (size_t i = 0; i < streamLength; i++) {
+        if (stream[i] != 0) { continue; }
+        if (i > start) {
+            if (frame.decode(stream + start, i - start) && (uint32_t)frame.chunk * DOWNLINK_CHUNK_SIZE + frame.length <= DF_TEST_FILE_SIZE) {
+                memcpy(rebuilt + frame.chunk * DOWNLINK_CHUNK_SIZE, frame.data, frame.length);
+                chunkSeen[frame.chunk] = true;
+                good++;
+            } else {
+                dropped++;
+            }
+        }
+        start = i + 1;
+    }
+    if (good != frames - 1 || dropped != 2 || chunkSeen[3]) { // the text and the corrupted frame
+        Serial.println("Frames not found in the stream (downlink frame)");
+        return 1;
+    }
+    memcpy(rebuilt + 3 * DOWNLINK_CHUNK_SIZE, dfTestFile + 3 * DOWNLINK_CHUNK_SIZE, DOWNLINK_CHUNK_SIZE);
+    if (memcmp(rebuilt, dfTestFile, DF_TEST_FILE_SIZE) != 0) {
+        Serial.println("File not reassembled from its frames (downlink frame)");
+        return 1;
+    }
+
+    // 92% of every full frame is file data
+    float efficiency = (float)DF_TEST_FILE_SIZE / (streamLength - fileStart + 1);
+    Serial.print("Downlink frame efficiency: ");
+    Serial.println(efficiency);
+    if ((float)DOWNLINK_CHUNK_SIZE / DownlinkFrame::WIRE_MEMSIZE < 0.9F) {
+        Serial.println("Frames carry too little file data (downlink frame)");
+        return 1;
+    }
+    return 0;
+}
+
+
+/* - - - - - - downlinkFrameTestMain - - - - - - *
+ * Usage:
+ * runs the downlink frame unit tests, prints results over serial
+ *  must be kept last in file since we are not using header structure for testing
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  number of tests that failed in module
+ */
+int downlinkFrameTestMain() {
+    int testsFailed = 0; // iterator to track how many tests have failed
+
+    testsFailed += testCobs();
+    testsFailed += testFrameRoundTrip();
+    testsFailed += testFrameReassembly();
+
+    // print module summary
+    Serial.print("Downlink Frame module: ");
+    Serial.print(testsFailed);
+    Serial.println(" tests failed");
+
+    return testsFailed;
+}
@@ -0,0 +1,501 @@
+/* downlinkSchedulerTest.cpp tests the order stored products are downlinked in
+ * Usage:
+ *  part of NS2 unit testing suite
+ *  to be called in unitTestDriver.cpp
+ *
+ *  Mounts the record store on the simulated flash modules in RAM, striped, and clears the
+ *  catalog in RAM, both are restored at the end. The scheduling weights are restored too.
+ *  testDownlinkPass() runs a whole pass through the flight downlink on a simulated link, in
+ *  safe mode so no sample guard holds it up.
+ */
+
+
+// NS2 includes
+#include "../headers/config.hpp"
+#include "../headers/encodedSciData.hpp"
+#include "../headers/burstCapture.hpp"
+#include "../headers/flashDevice.hpp"
+#include "../headers/recordStore.hpp"
+#include "../headers/fileCatalog.hpp"
+#include "../headers/windowCache.hpp"
+#include "../headers/downlinkFrame.hpp"
+#include "../headers/downlinkTransfer.hpp"
+#include "../headers/downlinkScheduler.hpp"
+#include "../headers/timing.hpp"
+#include "../headers/dataCollection.hpp"
+#include "../headers/commandHandling.hpp"
+#include "../headers/flashQueue.hpp"
+#include "testFixtures.hpp"
+
+const int DS_TEST_SECTOR_SIZE = 32768; // per module, the striped pair has four 64KB sectors, one window each
+const int DS_TEST_SECTORS = 4;
+static uint8_t dsTestSummary[DownlinkScheduler::SUMMARY_MEMSIZE];
+
+// ground end of the pass run by testDownlinkPass()
+const int DS_TEST_PASS_LOOPS = 20000;           // loop iterations the pass must finish in
+const uint64_t DS_TEST_LOOP_NANOS = 100000;     // simulated time between loop iterations
+static uint8_t dsTestLinkBuffer[2 * DOWNLINK_LOOP_BYTES];
+static SimLinkPort dsTestLink(dsTestLinkBuffer, sizeof(dsTestLinkBuffer));
+static SerialLinkPort dsTestSerial;             // the flight link, given back at the end
+static uint8_t dsTestPiece[DownlinkFrame::WIRE_MEMSIZE]; // bytes since the last frame delimiter
+static size_t dsTestPieceLength = 0;
+static bool dsTestChunkSeen[DownlinkTransfer::MAX_CHUNKS];
+
+/* - DsTestReceived -
+*   What the ground end of testDownlinkPass() received of the science file and the summary.
+*/
+struct DsTestReceived {
+    int frames = 0;
+    uint16_t firstId = 0;       // file ID of the first frame
+    uint16_t version = 0;       // of the science file
+    uint32_t size = 0;
+    int chunks = 0;             // distinct chunks of the science file
+    uint16_t summaryVersion = 0;
+};
+
+// mission replayed by testSchedulerValue()
+const int DS_TEST_DAYS = 7;
+const int DS_TEST_WINDOWS_PER_DAY = 24;         // a sunrise and a sunset window each orbit
+const int DS_TEST_BURST_DAYS = 2;               // days between burst files
+const int DS_TEST_MAX_PRODUCTS = DS_TEST_DAYS * (DS_TEST_WINDOWS_PER_DAY + 1);
+const long DS_TEST_PASS_BYTES = 6L * DownlinkTransfer::MAX_CHUNKS * DownlinkFrame::WIRE_MEMSIZE; // about six windows a day
+const float DS_TEST_FRAME_LOSS = 0.02F;         // share of frames lost on the link
+const int DS_TEST_BURST_VALUE = DOWNLINK_BURST_SCORE / DOWNLINK_QUALITY_WEIGHT_INIT; // worth what it is scored as
+
+// a product of the replayed mission, value is its quality (a burst file is worth DS_TEST_BURST_VALUE)
+struct DsTestProduct {
+    uint16_t fileId;
+    uint8_t quality;
+    int value;
+    uint32_t seq;
+    uint16_t chunks;
+    uint16_t acked;
+};
+
+// stores a window of a quality as a valid catalog file with a transfer open and every chunk wanted, returns its slot
+int dsTestStore(uint8_t quality) {
+    int slot = fileCatalog.allocate();
+    if (slot < 0) { return -1; }
+    fileCatalog.getEntry(slot).quality = quality;
+    fileCatalog.getEntry(slot).timestamp = 1000 + slot;
+    fileCatalog.setState(slot, FILE_VALID);
+    recordStore.append(RECORD_SCIENCE, slot, testPages, EncodedSciData::PAGED_MEMSIZE, true);
+    downlinkTransfer.close(slot);
+    downlinkTransfer.open(slot, 7, EncodedSciData::MEMSIZE);
+    downlinkTransfer.requestUnacked(slot);
+    return slot;
+}
+
+// next pseudo random number in 0-1, the same for every run
+float dsTestRandom(uint32_t &seed) {
+    seed = seed * 1664525UL + 1013904223UL;
+    return (seed >> 8) / 16777216.0F;
+}
+
+/* - - - - - - testSchedulerOrder - - - - - - *
+ * Usage:
+ * products are scored by quality or as a burst file, less their age, plus the share the ground
+ * already has, and sorted highest score first, the newest first among equal scores
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testSchedulerOrder() {
+    DOWNLINK_QUALITY_WEIGHT = 4;
+    DOWNLINK_AGE_WEIGHT = 2;
+    DOWNLINK_PARTIAL_WEIGHT = 512;
+    DownlinkProduct products[5];
+    const uint16_t ids[5] = {0, 1, MAXFILES, 3, 4};
+    const uint8_t qualities[5] = {100, 250, 0, 50, 99};
+    const uint16_t newer[5] = {5, 0, 3, 9, 3};
+    for (int i = 0; i < 5; i++) {
+        products[i].fileId = ids[i];
+        products[i].quality = qualities[i];
+        products[i].newer = newer[i];
+        products[i].chunks = 100;
+    }
+    products[3].acked = 90;
+    for (int i = 0; i < 5; i++) { products[i].score = DownlinkScheduler::score(products[i]); }
+    if (products[0].score != 390 || products[1].score != 1000 || products[2].score != DOWNLINK_BURST_SCORE - 6
+        || products[3].score != 200 - 18 + 460 || products[4].score != 390) {
+        Serial.println("Product scores incorrect (downlink scheduler)");
+        return 1;
+    }
+
+    DownlinkScheduler::order(products, 5);
+    const uint16_t expected[5] = {1, MAXFILES, 3, 4, 0};
+    for (int i = 0; i < 5; i++) {
+        if (products[i].fileId != expected[i]) {
+            Serial.println("Products not sorted by score (downlink scheduler)");
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* - - - - - - testSchedulerPlan - - - - - - *
+ * Usage:
+ * a plan puts the summary first, then an error map asked for and the stored windows with chunks
+ * wanted by score, and the summary lists the windows in that order
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testSchedulerPlan() {
+    testFlash1.eraseAll();
+    testFlash2.eraseAll();
+    recordStore.format(&testFlashPair);
+    fileCatalog.clear();
+    DOWNLINK_QUALITY_WEIGHT = 4;
+    DOWNLINK_AGE_WEIGHT = 2;
+    DOWNLINK_PARTIAL_WEIGHT = 512;
+    int poor = dsTestStore(10);     // 40 - 3 * 2
+    int good = dsTestStore(200);    // 800 - 2 * 2
+    int sent = dsTestStore(255);    // nothing wanted, not planned
+    int fair = dsTestStore(50);     // 200
+    downlinkTransfer.cancel(sent);
+
+    if (downlinkScheduler.plan(true) != 4 || downlinkScheduler.getProduct(0).fileId != DOWNLINK_SUMMARY_ID
+        || downlinkScheduler.getProduct(1).fileId != good || downlinkScheduler.getProduct(2).fileId != fair
+        || downlinkScheduler.getProduct(3).fileId != poor || downlinkScheduler.getProduct(1).score != 796
+        || downlinkScheduler.getProduct(3).newer != 3) {
+        Serial.println("Stored windows not planned by score (downlink scheduler)");
+        return 1;
+    }
+    size_t size = downlinkScheduler.buildSummary(dsTestSummary);
+    uint16_t firstId = 0;
+    uint32_t firstTimestamp = 0;
+    memcpy(&firstId, dsTestSummary, sizeof(firstId));
+    memcpy(&firstTimestamp, dsTestSummary + 8, sizeof(firstTimestamp));
+    if (size != 3 * DownlinkScheduler::SUMMARY_ENTRY_MEMSIZE || firstId != good || firstTimestamp != 1000U + good
+        || dsTestSummary[DownlinkScheduler::SUMMARY_ENTRY_MEMSIZE - 1] != 200) {
+        Serial.println("Summary does not list the plan (downlink scheduler)");
+        return 1;
+    }
+    if (downlinkScheduler.plan(false) != 3 || downlinkScheduler.getProduct(0).fileId != good) {
+        Serial.println("Summary planned when not asked for (downlink scheduler)");
+        return 1;
+    }
+
+    // the error map was asked for, it goes after the summary and is not listed in it
+    downlinkTransfer.open(DOWNLINK_ERROR_MAP_ID, 0, 0);
+    downlinkTransfer.requestUnacked(DOWNLINK_ERROR_MAP_ID);
+    if (downlinkScheduler.plan(true) != 5 || downlinkScheduler.getProduct(1).fileId != DOWNLINK_ERROR_MAP_ID
+        || downlinkScheduler.getProduct(2).fileId != good
+        || downlinkScheduler.buildSummary(dsTestSummary) != 3 * DownlinkScheduler::SUMMARY_ENTRY_MEMSIZE) {
+        Serial.println("Error map not planned after the summary (downlink scheduler)");
+        return 1;
+    }
+    downlinkTransfer.close(DOWNLINK_ERROR_MAP_ID);
+
+    for (int slot : {poor, good, sent, fair}) { downlinkTransfer.close(slot); }
+    return 0;
+}
+
+// decodes the frames written to the simulated link since the last call, the science file into testReadBack
+void dsTestReceive(int slot, DsTestReceived &received) {
+    static DownlinkFrame frame;
+    for (size_t i = 0; i < dsTestLink.getLength(); i++) {
+        uint8_t byte = dsTestLink.getData()[i];
+        if (byte != 0) {
+            if (dsTestPieceLength < sizeof(dsTestPiece)) { dsTestPiece[dsTestPieceLength++] = byte; }
+            continue;
+        }
+        bool good = dsTestPieceLength > 0 && frame.decode(dsTestPiece, dsTestPieceLength);
+        dsTestPieceLength = 0;
+        if (!good) { continue; }
+        if (received.frames++ == 0) { received.firstId = frame.fileId; }
+        if (frame.fileId == DOWNLINK_SUMMARY_ID) { received.summaryVersion = frame.version; }
+        if (frame.fileId != slot || frame.chunk >= DownlinkTransfer::MAX_CHUNKS) { continue; }
+        received.version = frame.version;
+        received.size = frame.fileSize;
+        memcpy(testReadBack + frame.chunk * DOWNLINK_CHUNK_SIZE, frame.data, frame.length);
+        received.chunks += !dsTestChunkSeen[frame.chunk];
+        dsTestChunkSeen[frame.chunk] = true;
+    }
+    dsTestLink.clear();
+}
+
+/* dsTestAck
+ *  uplinks ACK_DOWNLINK for chunks first to last of a file, as the frame receiver gives it.
+ *  returns the chunks of the file acknowledged after it */
+int dsTestAck(long fileId, long version, int first, int last) {
+    CommandArgs args;
+    args.count = 4;
+    args.values[0] = fileId;
+    args.values[1] = version;
+    for (int base = first; base <= last; base += DOWNLINK_ACK_CHUNKS) {
+        uint32_t bitmap = 0;
+        for (int bit = 0; bit < DOWNLINK_ACK_CHUNKS && base + bit <= last; bit++) { bitmap |= 1UL << bit; }
+        args.values[2] = base;
+        args.values[3] = (int32_t)bitmap;
+        executeCommand(commandCode::ACK_DOWNLINK, args);
+    }
+    return downlinkTransfer.ackedChunks(fileId);
+}
+
+/* - - - - - - testDownlinkPass - - - - - - *
+ * Usage:
+ * a window saved by saveBuffer() and dropped from the window cache is sent by DOWNLINK_START,
+ * read from flash by downlink() and framed by handleDownlink() after the summary. The ground
+ * rebuilds it and acknowledges it with ACK_DOWNLINK, file ID and version apart: a version
+ * that was not sent is rejected, a partial one keeps the file, and the last one deletes it
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testDownlinkPass() {
+    testFlash1.eraseAll();
+    testFlash2.eraseAll();
+    recordStore.format(&testFlashPair);
+    fileCatalog.clear();
+    windowCache.clear();
+    for (int fileId = 0; fileId < DOWNLINK_FILE_IDS; fileId++) { downlinkTransfer.close(fileId); }
+    memset(dsTestChunkSeen, 0, sizeof(dsTestChunkSeen));
+    dsTestLink.clear();
+    dsTestPieceLength = 0;
+    downlinkTransfer.setPort(&dsTestLink);
+
+    // a window saved the way the flight code saves it, read back from flash by the pass
+    saveBuffer();
+    flashQueue.flush();
+    windowCache.clear();
+    int slot = 0;
+    while (slot < MAXFILES && !fileCatalog.isValid(slot)) { slot++; }
+    int recordIdx = findDownlinkRecord(slot);
+    if (recordIdx < 0) {
+        Serial.println("Window not saved for the pass (downlink scheduler)");
+        return 1;
+    }
+
+    CommandArgs args;
+    executeCommand(commandCode::DOWNLINK_START, args);
+    DsTestReceived received;
+    for (int loop = 0; loop < DS_TEST_PASS_LOOPS && received.chunks < DownlinkTransfer::MAX_CHUNKS; loop++) {
+        handleDownlink();
+        handleFlashQueue();
+        SimFlashDevice::advanceBusClock(DS_TEST_LOOP_NANOS);
+        dsTestReceive(slot, received);
+    }
+    recordStore.read(recordIdx, testPages, 0, EncodedSciData::PAGED_MEMSIZE);
+    uint8_t badPages[EncodedSciData::BAD_PAGE_MEMSIZE];
+    EncodedSciData::unpage(testPages, badPages);
+    if (received.firstId != DOWNLINK_SUMMARY_ID || received.size != (uint32_t)EncodedSciData::MEMSIZE
+        || received.chunks != DownlinkTransfer::MAX_CHUNKS || received.version != downlinkTransfer.getVersion(slot)
+        || memcmp(testReadBack, testPages, EncodedSciData::MEMSIZE) != 0) {
+        Serial.println("Window not downlinked whole after the summary (downlink scheduler)");
+        return 1;
+    }
+
+    // every version fits an argument of its own, one the pass did not send is rejected
+    int lastChunk = DownlinkTransfer::MAX_CHUNKS - 1;
+    if (dsTestAck(slot, (received.version + 1) % 65536, 0, lastChunk) != 0 || dsTestAck(slot, 65536L + received.version, 0, lastChunk) != 0
+        || dsTestAck(slot, received.version, 0, lastChunk - 1) != lastChunk || findDownlinkRecord(slot) < 0) {
+        Serial.println("Acknowledgement of another version accepted (downlink scheduler)");
+        return 1;
+    }
+    if (dsTestAck(slot, received.version, lastChunk, lastChunk) != 0 || findDownlinkRecord(slot) >= 0
+        || fileCatalog.isValid(slot) || dsTestAck(DOWNLINK_SUMMARY_ID, received.summaryVersion, 0, 0) != 0
+        || downlinkTransfer.isOpen(DOWNLINK_SUMMARY_ID)) {
+        Serial.println("Window not deleted once acknowledged in full (downlink scheduler)");
+        return 1;
+    }
+    return 0;
+}
+
+/* dsTestReplay
+ *  replays DS_TEST_DAYS days of windows and burst files with a downlink pass of
+ *  DS_TEST_PASS_BYTES a day, in slot order as passes once were or in the scheduler's order.
+ *  Lost frames are sent again by the next pass. valueSent is the value of the products the
+ *  ground received whole, wireBytes all the bytes written. */
+void dsTestReplay(bool scored, long &valueSent, uint32_t &wireBytes) {
+    static DsTestProduct stored[DS_TEST_MAX_PRODUCTS];
+    static DownlinkProduct pass[DS_TEST_MAX_PRODUCTS];
+    uint32_t missionSeed = 2718;    // the same windows for either order
+    uint32_t linkSeed = 31415;
+    int count = 0;
+    uint32_t seq = 0;
+    int burstIdx = 0;
+    valueSent = 0;
+    wireBytes = 0;
+    for (int day = 0; day < DS_TEST_DAYS; day++) {
+        // most windows stay dark or saturated, the few that cross the limb sweep a wide range
+        for (int window = 0; window < DS_TEST_WINDOWS_PER_DAY; window++) {
+            DsTestProduct &product = stored[count++];
+            float draw = dsTestRandom(missionSeed);
+            product.fileId = seq;
+            product.quality = draw < 0.2F ? 100 + (uint8_t)(dsTestRandom(missionSeed) * 155) : (uint8_t)(dsTestRandom(missionSeed) * 30);
+            product.value = product.quality;
+            product.seq = ++seq;
+            product.chunks = DownlinkTransfer::MAX_CHUNKS;
+            product.acked = 0;
+        }
+        if (day % DS_TEST_BURST_DAYS == 0) {
+            DsTestProduct &product = stored[count++];
+            product.fileId = MAXFILES + burstIdx++;
+            product.quality = 0;
+            product.value = DS_TEST_BURST_VALUE;
+            product.seq = ++seq;
+            product.chunks = downlinkChunks(BURST_RAW_MEMSIZE);
+            product.acked = 0;
+        }
+
+        // the pass, stored products not yet received in full are in slot order
+        int planned = 0;
+        for (int i = 0; i < count; i++) {
+            if (stored[i].acked == stored[i].chunks) { continue; }
+            DownlinkProduct &product = pass[planned++];
+            product = DownlinkProduct();
+            product.fileId = stored[i].fileId;
+            product.quality = stored[i].quality;
+            for (int j = 0; j < count; j++) { product.newer += stored[j].seq > stored[i].seq; }
+            product.chunks = stored[i].chunks;
+            product.acked = stored[i].acked;
+            product.score = DownlinkScheduler::score(product);
+        }
+        long left = DS_TEST_PASS_BYTES;
+        if (scored) {
+            DownlinkScheduler::order(pass, planned);
+            long summaryBytes = 1 + (long)downlinkChunks(planned * DownlinkScheduler::SUMMARY_ENTRY_MEMSIZE) * DownlinkFrame::WIRE_MEMSIZE;
+            left -= summaryBytes;
+            wireBytes += summaryBytes;
+        } else { // science slots first, then burst files
+            int scienceCount = 0;
+            static DownlinkProduct bursts[DS_TEST_MAX_PRODUCTS];
+            int burstCount = 0;
+            for (int i = 0; i < planned; i++) {
+                if (pass[i].fileId >= MAXFILES) { bursts[burstCount++] = pass[i]; }
+                else { pass[scienceCount++] = pass[i]; }
+            }
+            for (int i = 0; i < burstCount; i++) { pass[scienceCount + i] = bursts[i]; }
+        }
+
+        for (int rank = 0; rank < planned; rank++) {
+            int idx = 0;
+            while (stored[idx].fileId != pass[rank].fileId) { idx++; }
+            DsTestProduct &product = stored[idx];
+            long chunks = min((long)(product.chunks - product.acked), left > 1 ? (left - 1) / DownlinkFrame::WIRE_MEMSIZE : 0L);
+            if (chunks == 0) { break; } // the pass is over
+            long bytes = 1 + chunks * DownlinkFrame::WIRE_MEMSIZE;
+            left -= bytes;
+            wireBytes += bytes;
+            for (int chunk = 0; chunk < chunks; chunk++) { product.acked += dsTestRandom(linkSeed) >= DS_TEST_FRAME_LOSS; }
+            if (product.acked == product.chunks) { valueSent += product.value; }
+        }
+    }
+}
+
+/* - - - - - - testSchedulerValue - - - - - - *
+ * Usage:
+ * over a replayed week of windows and burst files, with a daily pass that cannot send all of
+ * them and some frames lost, scored passes deliver more science value per byte written than
+ * passes in slot order
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testSchedulerValue() {
+    DOWNLINK_QUALITY_WEIGHT = DOWNLINK_QUALITY_WEIGHT_INIT;
+    DOWNLINK_AGE_WEIGHT = DOWNLINK_AGE_WEIGHT_INIT;
+    DOWNLINK_PARTIAL_WEIGHT = DOWNLINK_PARTIAL_WEIGHT_INIT;
+    long slotValue = 0;
+    long scoredValue = 0;
+    uint32_t slotBytes = 0;
+    uint32_t scoredBytes = 0;
+    dsTestReplay(false, slotValue, slotBytes);
+    dsTestReplay(true, scoredValue, scoredBytes);
+    float slotRate = slotBytes > 0 ? slotValue * 1e6F / slotBytes : 0;
+    float scoredRate = scoredBytes > 0 ? scoredValue * 1e6F / scoredBytes : 0;
+
+    Serial.print("Downlink value over ");
+    Serial.print(DS_TEST_DAYS);
+    Serial.print(" days: slot order ");
+    Serial.print(slotValue);
+    Serial.print(" in ");
+    Serial.print(slotBytes);
+    Serial.print(" bytes (");
+    Serial.print(slotRate);
+    Serial.print(" per MB), scored ");
+    Serial.print(scoredValue);
+    Serial.print(" in ");
+    Serial.print(scoredBytes);
+    Serial.print(" bytes (");
+    Serial.print(scoredRate);
+    Serial.println(" per MB)");
+
+    if (scoredBytes > (uint32_t)(DS_TEST_DAYS * DS_TEST_PASS_BYTES) || slotBytes > (uint32_t)(DS_TEST_DAYS * DS_TEST_PASS_BYTES)) {
+        Serial.println("Pass byte budget exceeded (downlink scheduler)");
+        return 1;
+    }
+    if (scoredRate < 1.5F * slotRate) {
+        Serial.println("Scored passes do not send more value per byte (downlink scheduler)");
+        return 1;
+    }
+    return 0;
+}
+
+
+/* - - - - - - downlinkSchedulerTestMain - - - - - - *
+ * Usage:
+ * runs the downlink scheduler unit tests, prints results over serial
+ *  must be kept last in file since we are not using header structure for testing
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  number of tests that failed in module
+ */
+int downlinkSchedulerTestMain() {
+    resetTestFlash(DS_TEST_SECTOR_SIZE, DS_TEST_SECTORS);
+    testFlashPair.setMode(STORAGE_STRIPED);
+    int testsFailed = 0; // iterator to track how many tests have failed
+    long qualityWeight = DOWNLINK_QUALITY_WEIGHT;
+    long ageWeight = DOWNLINK_AGE_WEIGHT;
+    long partialWeight = DOWNLINK_PARTIAL_WEIGHT;
+    long passBytes = DOWNLINK_PASS_BYTES;
+    int mode = scienceMode.getMode();
+    for (int i = 0; i < EncodedSciData::PAGED_MEMSIZE; i++) { testPages[i] = (uint8_t)(i * 11); }
+
+    testsFailed += testSchedulerOrder();
+    testsFailed += testSchedulerPlan();
+    testsFailed += testSchedulerValue();
+    DOWNLINK_PASS_BYTES = 0;
+    scienceMode.setMode(SAFE_MODE);
+    testsFailed += testDownlinkPass();
+
+    // give back the flight record store, catalog and settings
+    DOWNLINK_QUALITY_WEIGHT = qualityWeight;
+    DOWNLINK_AGE_WEIGHT = ageWeight;
+    DOWNLINK_PARTIAL_WEIGHT = partialWeight;
+    DOWNLINK_PASS_BYTES = passBytes;
+    scienceMode.setMode(mode);
+    downlinkTransfer.setPort(&dsTestSerial);
+    for (int fileId = 0; fileId < DOWNLINK_FILE_IDS; fileId++) { downlinkTransfer.close(fileId); }
+    windowCache.clear();
+    initRecordStore();
+    fileCatalog.load();
+
+    // print module summary
+    Serial.print("Downlink Scheduler module: ");
+    Serial.print(testsFailed);
+    Serial.println(" tests failed");
+
+    return testsFailed;
+}
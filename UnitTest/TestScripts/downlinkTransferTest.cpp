@@ -0,0 +1,348 @@
+/* downlinkTransferTest.cpp tests the selective repeat downlink
+ * Usage:
+ *  part of NS2 unit testing suite
+ *  to be called in unitTestDriver.cpp
+ *
+ *  Uses its own transfers writing to a simulated link in RAM, the flight downlink is not
+ *  touched. testTransferGoodput() flips bits on the simulated link at several bit error rates
+ *  and prints the goodput of each, testTransferPacing() prints the most a paced send writes
+ *  and takes in one loop iteration.
+ */
+
+
+// NS2 includes
+#include "../headers/config.hpp"
+#include "../headers/downlinkFrame.hpp"
+#include "../headers/downlinkTransfer.hpp"
+#include "../headers/crc.hpp"
+#include "testFixtures.hpp"
+
+const int DT_TEST_FILE_SIZE = EncodedSciData::MEMSIZE;
+const int DT_TEST_CHUNKS = (DT_TEST_FILE_SIZE + DOWNLINK_CHUNK_SIZE - 1) / DOWNLINK_CHUNK_SIZE;
+static uint8_t dtTestLinkBuffer[1 + DT_TEST_CHUNKS * DownlinkFrame::WIRE_MEMSIZE];
+static SimLinkPort dtTestLink(dtTestLinkBuffer, sizeof(dtTestLinkBuffer));
+static DownlinkTransfer dtTestTransfer(&dtTestLink);
+
+// ground end of the simulated link, the file sent is in testPages and rebuilt in testReadBack
+static bool dtTestReceived[DT_TEST_CHUNKS];
+
+// decodes the frames on the simulated link into the ground copy, returns the number of good frames
+int dtTestReceive(uint16_t fileId, uint16_t version) {
+    static DownlinkFrame frame;
+    uint8_t *stream = dtTestLink.getData();
+    int good = 0;
+    size_t start = 0;
+    for (size_t i = 0; i < dtTestLink.getLength(); i++) {
+        if (stream[i] != 0) { continue; }
+        if (i > start && frame.decode(stream + start, i - start) && frame.fileId == fileId && frame.version == version
+            && frame.chunk < DT_TEST_CHUNKS) {
+            memcpy(testReadBack + frame.chunk * DOWNLINK_CHUNK_SIZE, frame.data, frame.length);
+            dtTestReceived[frame.chunk] = true;
+            good++;
+        }
+        start = i + 1;
+    }
+    return good;
+}
+
+// acknowledges everything the ground copy holds, as ACK_DOWNLINK commands would
+AckResult dtTestAcknowledge(uint16_t fileId, uint16_t version, int chunks) {
+    AckResult result = ACK_REJECTED;
+    for (int base = 0; base < chunks; base += DOWNLINK_ACK_CHUNKS) {
+        uint32_t bitmap = 0;
+        for (int bit = 0; bit < DOWNLINK_ACK_CHUNKS && base + bit < chunks; bit++) {
+            if (dtTestReceived[base + bit]) { bitmap |= 1UL << bit; }
+        }
+        result = dtTestTransfer.acknowledge(fileId, version, base, bitmap);
+    }
+    return result;
+}
+
+// flips bits of the simulated link at random, on average one in every 1 / ber
+void dtTestCorrupt(float ber, uint32_t &seed) {
+    if (ber <= 0) { return; }
+    uint64_t bits = (uint64_t)dtTestLink.getLength() * 8;
+    uint64_t bit = 0;
+    while (true) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        float uniform = (seed + 1.0F) / 4294967296.0F;
+        bit += (uint64_t)(-logf(uniform) / ber); // exponential gaps between errors
+        if (bit >= bits) { return; }
+        dtTestLink.getData()[bit / 8] ^= 1 << (bit % 8);
+        bit++;
+    }
+}
+
+/* - - - - - - testTransferSelectiveRepeat - - - - - - *
+ * Usage:
+ * only chunks the ground has not acknowledged are sent again, acknowledgements for another
+ * version are rejected, and the file is complete once every chunk is acknowledged
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testTransferSelectiveRepeat() {
+    for (int i = 0; i < DT_TEST_FILE_SIZE; i++) { testPages[i] = (uint8_t)(i * 11 + 3); }
+    memset(dtTestReceived, 0, sizeof(dtTestReceived));
+    dtTestTransfer.close(5);
+    dtTestLink.clear();
+
+    const uint32_t size = 3000; // 13 chunks
+    if (!dtTestTransfer.open(5, 7, size) || dtTestTransfer.requestUnacked(5) != 13 || dtTestTransfer.sendWanted(5, testPages) != 13
+        || dtTestTransfer.wantedChunks(5) != 0 || dtTestLink.getLength() != 1 + 13 * DownlinkFrame::WIRE_MEMSIZE) {
+        Serial.println("Whole file not sent (downlink transfer)");
+        return 1;
+    }
+
+    // chunks 2 and 9 lost
+    uint32_t bitmap = 0x1FFF & ~((1UL << 2) | (1UL << 9));
+    if (dtTestTransfer.acknowledge(5, 7, 0, bitmap) != ACK_PARTIAL || dtTestTransfer.ackedChunks(5) != 11
+        || dtTestTransfer.acknowledge(5, 6, 0, 0x1FFF) != ACK_REJECTED || dtTestTransfer.acknowledge(5, 7, 13, 1) != ACK_REJECTED) {
+        Serial.println("Acknowledgement not applied (downlink transfer)");
+        return 1;
+    }
+    dtTestLink.clear();
+    if (dtTestTransfer.requestUnacked(5) != 2 || dtTestTransfer.sendWanted(5, testPages) != 2 || dtTestReceive(5, 7) != 2
+        || !dtTestReceived[2] || !dtTestReceived[9] || dtTestReceived[0]) {
+        Serial.println("Acknowledged chunks sent again (downlink transfer)");
+        return 1;
+    }
+    if (dtTestTransfer.acknowledge(5, 7, 0, (1UL << 2) | (1UL << 9)) != ACK_COMPLETE
+        || memcmp(testReadBack + 2 * DOWNLINK_CHUNK_SIZE, testPages + 2 * DOWNLINK_CHUNK_SIZE, DOWNLINK_CHUNK_SIZE) != 0) {
+        Serial.println("File not complete once every chunk is acknowledged (downlink transfer)");
+        return 1;
+    }
+    return 0;
+}
+
+/* - - - - - - testTransferRequests - - - - - - *
+ * Usage:
+ * the ground can ask for a range of chunks again, reopening the same file keeps its progress,
+ * and another file under the same ID starts over
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testTransferRequests() {
+    dtTestTransfer.close(6);
+    dtTestTransfer.close(MAXFILES);
+    if (!dtTestTransfer.open(6, 1, 3000) || dtTestTransfer.request(6, 3, 100000) != 10 || dtTestTransfer.request(7, 0, 5) != 0) {
+        Serial.println("Chunk range not requested (downlink transfer)");
+        return 1;
+    }
+    dtTestTransfer.cancel(6);
+    dtTestTransfer.acknowledge(6, 1, 0, 0x0F);
+    if (!dtTestTransfer.open(6, 1, 3000) || dtTestTransfer.ackedChunks(6) != 4 || dtTestTransfer.wantedChunks(6) != 0
+        || dtTestTransfer.request(6, 0, 0) != 1) {
+        Serial.println("Reopening the same file lost its progress (downlink transfer)");
+        return 1;
+    }
+    if (!dtTestTransfer.open(6, 2, 3000) || dtTestTransfer.ackedChunks(6) != 0 || dtTestTransfer.wantedChunks(6) != 0) {
+        Serial.println("New file under the same ID kept the old progress (downlink transfer)");
+        return 1;
+    }
+    if (dtTestTransfer.open(6, 3, DT_TEST_FILE_SIZE + DOWNLINK_CHUNK_SIZE) || dtTestTransfer.open(DOWNLINK_FILE_IDS, 1, 10)
+        || !dtTestTransfer.open(MAXFILES, 1, 0) || dtTestTransfer.requestUnacked(MAXFILES) != 1) {
+        Serial.println("File size or ID range not checked (downlink transfer)");
+        return 1;
+    }
+    dtTestTransfer.close(6);
+    dtTestTransfer.close(MAXFILES);
+    return 0;
+}
+
+/* - - - - - - testTransferGoodput - - - - - - *
+ * Usage:
+ * a science file is sent over a link that flips bits at several rates, each pass resends only
+ * the chunks the ground did not acknowledge. The file must arrive intact at every rate, and
+ * goodput (file bytes per byte sent) must stay close to the frame efficiency times the share
+ * of frames that arrive, where resending the whole file would almost never get it through.
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testTransferGoodput() {
+    const int rateCount = 4;
+    const float bitErrorRates[rateCount] = {0.0F, 1e-5F, 1e-4F, 1e-3F};
+    const char *rateNames[rateCount] = {"0", "1e-5", "1e-4", "1e-3"};
+    const float minGoodput[rateCount] = {0.9F, 0.85F, 0.7F, 0.08F};
+    const int maxPasses = 500;
+    uint32_t seed = 12345;
+    for (int i = 0; i < DT_TEST_FILE_SIZE; i++) { testPages[i] = (uint8_t)(i % 4 == 0 ? 0 : i * 29 + 7); }
+
+    int failed = 0;
+    for (int rate = 0; rate < rateCount; rate++) {
+        memset(testReadBack, 0, DT_TEST_FILE_SIZE);
+        memset(dtTestReceived, 0, sizeof(dtTestReceived));
+        dtTestTransfer.close(9);
+        dtTestTransfer.open(9, 1, DT_TEST_FILE_SIZE);
+
+        uint32_t wireBytes = 0;
+        int passes = 0;
+        AckResult result = ACK_PARTIAL;
+        while (result != ACK_COMPLETE && passes < maxPasses) {
+            dtTestLink.clear();
+            dtTestTransfer.requestUnacked(9);
+            dtTestTransfer.sendWanted(9, testPages);
+            wireBytes += dtTestLink.getLength();
+            dtTestCorrupt(bitErrorRates[rate], seed);
+            dtTestReceive(9, 1);
+            result = dtTestAcknowledge(9, 1, DT_TEST_CHUNKS);
+            passes++;
+        }
+
+        float goodput = (float)DT_TEST_FILE_SIZE / wireBytes;
+        float frameArrives = powf(1.0F - bitErrorRates[rate], DownlinkFrame::WIRE_MEMSIZE * 8);
+        Serial.print("Downlink goodput at bit error rate ");
+        Serial.print(rateNames[rate]);
+        Serial.print(": ");
+        Serial.print(goodput * 100);
+        Serial.print("% in ");
+        Serial.print(passes);
+        Serial.print(" pass(es), resending whole files would get ");
+        Serial.print((float)DOWNLINK_CHUNK_SIZE / DownlinkFrame::WIRE_MEMSIZE * powf(frameArrives, DT_TEST_CHUNKS) * 100);
+        Serial.println("%");
+
+        if (result != ACK_COMPLETE || memcmp(testReadBack, testPages, DT_TEST_FILE_SIZE) != 0) {
+            Serial.println("File not delivered over the lossy link (downlink transfer)");
+            failed = 1;
+        } else if (goodput < minGoodput[rate]) {
+            Serial.println("Goodput too low over the lossy link (downlink transfer)");
+            failed = 1;
+        }
+    }
+    dtTestTransfer.close(9);
+    return failed;
+}
+
+/* - - - - - - testTransferPacing - - - - - - *
+ * Usage:
+ * a science file sent by pump() through a small transmit buffer that drains a little each loop
+ * iteration never writes more than the buffer has room for and puts the same bytes on the link
+ * as sending it at once. Chunks requested while the file is sent go out with it.
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testTransferPacing() {
+    const size_t txBuffer = 64;     // bytes, transmit buffer of the simulated serial port
+    const size_t drainBytes = 16;   // bytes the port sends each loop iteration
+    for (int i = 0; i < DT_TEST_FILE_SIZE; i++) { testPages[i] = (uint8_t)(i * 7 + 1); }
+
+    // sent at once, for reference
+    dtTestTransfer.close(11);
+    dtTestTransfer.open(11, 4, DT_TEST_FILE_SIZE);
+    dtTestLink.clear();
+    dtTestTransfer.requestUnacked(11);
+    dtTestTransfer.sendWanted(11, testPages);
+    size_t referenceLength = dtTestLink.getLength();
+    uint32_t referenceCrc = crc32c(dtTestLink.getData(), referenceLength);
+
+    // paced
+    dtTestLink.clear();
+    dtTestTransfer.requestUnacked(11);
+    dtTestTransfer.startSending(11, testPages);
+    size_t queued = 0;
+    size_t maxBytes = 0;
+    uint32_t maxMicros = 0;
+    int iterations = 0;
+    while (dtTestTransfer.isSending() && iterations < 100000) {
+        dtTestLink.setRoom(txBuffer - queued);
+        uint32_t startMicros = micros();
+        size_t bytes = dtTestTransfer.pump(DOWNLINK_LOOP_BYTES, DOWNLINK_LOOP_BUDGET_MICROS);
+        maxMicros = max(maxMicros, (uint32_t)(micros() - startMicros));
+        maxBytes = max(maxBytes, bytes);
+        queued += bytes;
+        queued -= min(queued, drainBytes);
+        iterations++;
+    }
+    dtTestLink.setRoom(sizeof(dtTestLinkBuffer));
+
+    Serial.print("Paced downlink: ");
+    Serial.print(dtTestLink.getLength());
+    Serial.print(" bytes in ");
+    Serial.print(iterations);
+    Serial.print(" loop iteration(s), at most ");
+    Serial.print(maxBytes);
+    Serial.print(" bytes and ");
+    Serial.print(maxMicros);
+    Serial.print(" us in one, sending at once would hold one for ");
+    Serial.print(referenceLength * 10 / (SERIAL_BAUD / 1000));
+    Serial.println(" ms");
+
+    if (dtTestTransfer.isSending() || maxBytes > txBuffer || dtTestLink.getLength() != referenceLength
+        || crc32c(dtTestLink.getData(), referenceLength) != referenceCrc) {
+        Serial.println("Paced send differs from sending at once or overfilled the link (downlink transfer)");
+        return 1;
+    }
+    if (maxMicros > 10 * DOWNLINK_LOOP_BUDGET_MICROS) {
+        Serial.println("Paced send took too long in one loop iteration (downlink transfer)");
+        return 1;
+    }
+
+    // a full link takes nothing, a chunk asked for again while the file is sent goes out with it
+    uint32_t chunksSent = dtTestTransfer.getStats().chunksSent;
+    dtTestLink.clear();
+    dtTestTransfer.request(11, 0, 2);
+    dtTestTransfer.startSending(11, testPages);
+    dtTestLink.setRoom(0);
+    size_t blocked = dtTestTransfer.pump(DOWNLINK_LOOP_BYTES, DOWNLINK_LOOP_BUDGET_MICROS);
+    dtTestLink.setRoom(1 + DownlinkFrame::WIRE_MEMSIZE);
+    dtTestTransfer.pump(SIZE_MAX, ULONG_MAX);
+    dtTestTransfer.request(11, 0, 0);
+    dtTestLink.setRoom(sizeof(dtTestLinkBuffer));
+    while (dtTestTransfer.isSending() && dtTestTransfer.pump(SIZE_MAX, ULONG_MAX) > 0) { }
+    dtTestTransfer.close(11);
+    if (blocked != 0 || dtTestTransfer.getStats().chunksSent - chunksSent != 4
+        || dtTestLink.getLength() != 1 + 4 * DownlinkFrame::WIRE_MEMSIZE) {
+        Serial.println("Chunks requested during a send not sent (downlink transfer)");
+        return 1;
+    }
+    return 0;
+}
+
+
+/* - - - - - - downlinkTransferTestMain - - - - - - *
+ * Usage:
+ * runs the downlink transfer unit tests, prints results over serial
+ *  must be kept last in file since we are not using header structure for testing
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  number of tests that failed in module
+ */
+int downlinkTransferTestMain() {
+    int testsFailed = 0; // iterator to track how many tests have failed
+
+    testsFailed += testTransferSelectiveRepeat();
+    testsFailed += testTransferRequests();
+    testsFailed += testTransferGoodput();
+    testsFailed += testTransferPacing();
+
+    // print module summary
+    Serial.print("Downlink Transfer module: ");
+    Serial.print(testsFailed);
+    Serial.println(" tests failed");
+
+    return testsFailed;
+}
@@ -0,0 +1,292 @@
+/* dualFlashTest.cpp tests the DualFlashDevice class
+ * Usage:
+ *  part of NS2 unit testing suite
+ *  to be called in unitTestDriver.cpp
+ *
+ *  Runs on two simulated flash modules in RAM. Checks the striped layout, failover when
+ *  a module stops responding and repair of a scrubbed record from its mirror copy.
+ *  Reports simulated write and read throughput in each storage mode.
+ */
+
+
+// NS2 includes
+#include "../headers/config.hpp"
+#include "../headers/flashDevice.hpp"
+#include "../headers/recordStore.hpp"
+#include "../headers/encodedFile.hpp"
+#include "testFixtures.hpp"
+
+const int DF_TEST_SECTOR_SIZE = 4096;
+const int DF_TEST_SECTORS = 8;
+const uint32_t DF_TEST_CHIP_MEMSIZE = DF_TEST_SECTOR_SIZE * DF_TEST_SECTORS;
+static_assert(DF_TEST_CHIP_MEMSIZE <= EncodedSciData::PAGED_MEMSIZE, "test data is kept in testPages and read back into testReadBack");
+
+typedef EncodedFile<512> DfTestFile;
+
+/* - - - - - - dfTestReset - - - - - - *
+ * Usage:
+ *  erases and revives both modules and sets the storage mode
+ */
+void dfTestReset(uint8_t mode) {
+    testFlash1.setFailed(false);
+    testFlash2.setFailed(false);
+    testFlash1.eraseAll();
+    testFlash2.eraseAll();
+    testFlashPair.setMode(mode);
+    for (uint32_t i = 0; i < DF_TEST_CHIP_MEMSIZE; i++) { testPages[i] = (uint8_t)(i * 13 + i / 256); }
+}
+
+/* - - - - - - testStripedLayout - - - - - - *
+ * Usage:
+ * data written in striped mode reads back whole and alternates between the modules by chunk
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testStripedLayout() {
+    const uint32_t start = 100;
+    const uint32_t length = 3000;
+    dfTestReset(STORAGE_STRIPED);
+
+    if (testFlashPair.capacity() != 2 * DF_TEST_CHIP_MEMSIZE || testFlashPair.sectorSize() != 2 * DF_TEST_SECTOR_SIZE) {
+        Serial.println("Striped geometry incorrect (dual flash)");
+        return 1;
+    }
+    testFlashPair.program(start, testPages, length);
+    testFlashPair.read(start, testReadBack, length);
+    if (memcmp(testPages, testReadBack, length) != 0) {
+        Serial.println("Striped data did not read back (dual flash)");
+        return 1;
+    }
+
+    // first chunk on module 1, second chunk on module 2, third back on module 1
+    if (testFlashMemory1[start] != testPages[0] || testFlashMemory2[0] != testPages[STORAGE_STRIPE_CHUNK - start]
+        || testFlashMemory1[STORAGE_STRIPE_CHUNK] != testPages[2 * STORAGE_STRIPE_CHUNK - start]) {
+        Serial.println("Chunks not alternated between modules (dual flash)");
+        return 1;
+    }
+
+    // a striped sector is a sector on each module
+    testFlashPair.program(testFlashPair.sectorSize(), testPages, 1);
+    testFlashPair.eraseSector(0);
+    if (testFlashMemory1[start] != 0xFF || testFlashMemory2[0] != 0xFF || testFlashMemory1[DF_TEST_SECTOR_SIZE] != testPages[0]) {
+        Serial.println("Striped sector erase incorrect (dual flash)");
+        return 1;
+    }
+    return 0;
+}
+
+/* - - - - - - testMirroredFailover - - - - - - *
+ * Usage:
+ * both modules hold the same records, and when module 1 stops responding
+ * records are still read and written using module 2 alone
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testMirroredFailover() {
+    dfTestReset(STORAGE_MIRRORED);
+    testStore.format(&testFlashPair);
+    for (int key = 0; key < 5; key++) { testStore.append(RECORD_SCIENCE, key, testPages + 100 * key, 700); }
+    if (memcmp(testFlashMemory1, testFlashMemory2, DF_TEST_CHIP_MEMSIZE) != 0) {
+        Serial.println("Mirrored modules differ (dual flash)");
+        return 1;
+    }
+
+    uint32_t failovers = testFlashPair.getFailovers();
+    testFlash1.setFailed(true);
+    int idx = testStore.find(RECORD_SCIENCE, 3);
+    if (!testStore.verify(idx) || testFlashPair.getMode() != STORAGE_SINGLE_2 || testFlashPair.getFailovers() != failovers + 1) {
+        Serial.println("Mirrored read did not fail over (dual flash)");
+        return 1;
+    }
+    if (!testStore.append(RECORD_SCIENCE, 5, testPages, 700) || !testStore.mount(&testFlashPair) || testStore.count() != 6) {
+        Serial.println("Store unusable after failover (dual flash)");
+        return 1;
+    }
+    return 0;
+}
+
+/* - - - - - - testStripedFailover - - - - - - *
+ * Usage:
+ * when a module stops responding striped storage moves to the other module with a new layout
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testStripedFailover() {
+    dfTestReset(STORAGE_STRIPED);
+    testStore.format(&testFlashPair);
+    testStore.append(RECORD_SCIENCE, 0, testPages, 700);
+
+    testFlash2.setFailed(true);
+    if (testStore.append(RECORD_SCIENCE, 1, testPages, 700) || testFlashPair.getMode() != STORAGE_SINGLE_1) {
+        Serial.println("Striped write did not fail over (dual flash)");
+        return 1;
+    }
+    testStore.format(&testFlashPair);
+    if (testFlashPair.capacity() != DF_TEST_CHIP_MEMSIZE || !testStore.append(RECORD_SCIENCE, 1, testPages, 700)) {
+        Serial.println("Remaining module not usable (dual flash)");
+        return 1;
+    }
+    return 0;
+}
+
+/* - - - - - - testMirrorRepair - - - - - - *
+ * Usage:
+ * a block with a double bit error on module 1 is restored from module 2 while scrubbing,
+ * and the rebuilt file matches what was written
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testMirrorRepair() {
+    static DfTestFile original;
+    static DfTestFile scrubbed;
+    static uint8_t contents[DfTestFile::MEMSIZE];
+    dfTestReset(STORAGE_MIRRORED);
+    testStore.format(&testFlashPair);
+    original.encodeData(testPages);
+    testStore.append(RECORD_SCIENCE, 0, original.getData(), DfTestFile::MEMSIZE);
+
+    // two bits of block 3 on module 1, one bit of block 5 on module 2
+    int idx = testStore.find(RECORD_SCIENCE, 0);
+    uint32_t payloadAddr = testStore.getRecord(idx).addr + RecordHeader::MEMSIZE;
+    for (int blockBit = 0; blockBit < 2; blockBit++) {
+        int bitIdx = 3 + blockBit * DfTestFile::MESSAGE_COUNT;
+        testFlash1.injectBitFlip(payloadAddr + bitIdx / 8, bitIdx % 8);
+    }
+    testFlash2.injectBitFlip(payloadAddr + 5 / 8, 5 % 8);
+
+    // without the mirror the block is lost
+    testStore.read(idx, contents, 0, DfTestFile::MEMSIZE);
+    scrubbed.fill(contents);
+    if (scrubbed.scrub().uncorrected != 1) {
+        Serial.println("Double bit error not detected (dual flash)");
+        return 1;
+    }
+
+    testStore.read(idx, contents, 0, DfTestFile::MEMSIZE);
+    scrubbed.fill(contents);
+    if (!testStore.readMirror(idx, contents, 0, DfTestFile::MEMSIZE)) {
+        Serial.println("Mirror copy not read (dual flash)");
+        return 1;
+    }
+    ScrubReport report = scrubbed.scrub(contents);
+    if (report.repaired != 1 || report.uncorrected != 0
+        || memcmp(scrubbed.getData(), original.getData(), DfTestFile::MEMSIZE) != 0
+        || memcmp(scrubbed.getDecodedData(), testPages, DfTestFile::DECODED_MEMSIZE) != 0) {
+        Serial.println("Block not repaired from mirror (dual flash)");
+        return 1;
+    }
+    return 0;
+}
+
+/* - - - - - - dfTestMeasure - - - - - - *
+ * Usage:
+ *  simulated nanoseconds to write then read length bytes on device
+ */
+void dfTestMeasure(FlashDevice &device, uint32_t length, uint64_t &writeNanos, uint64_t &readNanos) {
+    // wait out anything still programming
+    uint8_t scratch;
+    testFlash1.read(0, &scratch, 1);
+    testFlash2.read(0, &scratch, 1);
+
+    uint64_t start = SimFlashDevice::getBusNanos();
+    device.program(0, testPages, length);
+    testFlash1.read(0, &scratch, 1); // the last page programs before the write is done
+    testFlash2.read(0, &scratch, 1);
+    writeNanos = SimFlashDevice::getBusNanos() - start;
+
+    start = SimFlashDevice::getBusNanos();
+    device.read(0, testReadBack, length);
+    readNanos = SimFlashDevice::getBusNanos() - start;
+}
+
+/* - - - - - - testStorageThroughput - - - - - - *
+ * Usage:
+ * striping must write at least 1.6x faster than one module, mirroring about as fast as one module.
+ * Reads share one SPI bus, so no mode reads faster than one module.
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testStorageThroughput() {
+    const uint32_t length = 16384;
+    const char *names[3] = {"single", "mirrored", "striped"};
+    uint64_t writeNanos[3];
+    uint64_t readNanos[3];
+
+    dfTestReset(STORAGE_MIRRORED);
+    dfTestMeasure(testFlash1, length, writeNanos[0], readNanos[0]);
+    dfTestReset(STORAGE_MIRRORED);
+    dfTestMeasure(testFlashPair, length, writeNanos[1], readNanos[1]);
+    dfTestReset(STORAGE_STRIPED);
+    dfTestMeasure(testFlashPair, length, writeNanos[2], readNanos[2]);
+
+    for (int mode = 0; mode < 3; mode++) {
+        Serial.print("Flash ");
+        Serial.print(names[mode]);
+        Serial.print(": write ");
+        Serial.print((uint32_t)(length * 1000000ULL / writeNanos[mode]));
+        Serial.print(" KB/s, read ");
+        Serial.print((uint32_t)(length * 1000000ULL / readNanos[mode]));
+        Serial.println(" KB/s");
+    }
+
+    if (writeNanos[2] * 16 > writeNanos[0] * 10 || writeNanos[1] * 10 > writeNanos[0] * 12) {
+        Serial.println("Storage modes do not write at the expected rate (dual flash)");
+        return 1;
+    }
+    return 0;
+}
+
+
+/* - - - - - - dualFlashTestMain - - - - - - *
+ * Usage:
+ * runs the dual flash unit tests, prints results over serial
+ *  must be kept last in file since we are not using header structure for testing
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  number of tests that failed in module
+ */
+int dualFlashTestMain() {
+    resetTestFlash(DF_TEST_SECTOR_SIZE, DF_TEST_SECTORS);
+    int testsFailed = 0; // iterator to track how many tests have failed
+
+    testsFailed += testStripedLayout();
+    testsFailed += testMirroredFailover();
+    testsFailed += testStripedFailover();
+    testsFailed += testMirrorRepair();
+    testsFailed += testStorageThroughput();
+
+    // print module summary
+    Serial.print("Dual Flash module: ");
+    Serial.print(testsFailed);
+    Serial.println(" tests failed");
+
+    return testsFailed;
+}
@@ -0,0 +1,228 @@
+/* fileCatalogTest.cpp tests the FileCatalog class
+ * Usage:
+ *  part of NS2 unit testing suite
+ *  to be called in unitTestDriver.cpp
+ *
+ *  The tests run on the simulated flash, the flight record store and catalog are loaded again at the end.
+ */
+
+
+// NS2 includes
+#include "../headers/config.hpp"
+#include "../headers/fileCatalog.hpp"
+#include "../headers/recordStore.hpp"
+#include "../headers/flashQueue.hpp"
+#include "../headers/crc.hpp"
+#include "testFixtures.hpp"
+
+const int FC_TEST_SECTOR_SIZE = 4096;
+const int FC_TEST_SECTORS = 16;
+
+static FileCatalog fcTestCatalogs[2]; // a test's catalog and the one it is loaded back into
+
+/* - - - - - - fcTestCatalog - - - - - - *
+ * Usage:
+ *  returns shared catalog which (0 or 1) as if it was just constructed, once the flash queue is done with it
+ */
+FileCatalog &fcTestCatalog(int which) {
+    flashQueue.flush();
+    fcTestCatalogs[which] = FileCatalog();
+    return fcTestCatalogs[which];
+}
+
+/* - - - - - - fcTestSave - - - - - - *
+ * Usage:
+ *  saves a catalog and runs the flash queue until every changed chunk is committed
+ */
+void fcTestSave(FileCatalog &catalog) {
+    catalog.save();
+    while (!catalog.isSaved()) {
+        flashQueue.flush();
+        catalog.service();
+    }
+}
+
+/* - - - - - - testCatalogAllocation - - - - - - *
+ * Usage:
+ * fills every slot, checks the catalog reports full and that freed slots are reused oldest first
+ * 
+ * Inputs:
+ *  none
+ *  
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testCatalogAllocation() {
+    FileCatalog &catalog = fcTestCatalog(0);
+    catalog.clear();
+
+    for (int i = 0; i < MAXFILES; i++) {
+        if (catalog.allocate() != i) {
+            Serial.println("Slots not allocated in order (file catalog)");
+            return 1;
+        }
+        catalog.setState(i, FILE_VALID);
+    }
+    if (catalog.allocate() != -1 || catalog.count() != MAXFILES) {
+        Serial.println("Full catalog still allocated a slot (file catalog)");
+        return 1;
+    }
+
+    catalog.release(7);
+    catalog.release(3);
+    catalog.release(3); // releasing twice must not duplicate the slot
+    if (catalog.allocate() != 7 || catalog.allocate() != 3 || catalog.allocate() != -1) {
+        Serial.println("Freed slots not reused in order (file catalog)");
+        return 1;
+    }
+
+    uint16_t slots[MAXFILES];
+    if (catalog.list(slots, MAXFILES) != MAXFILES - 2) { // 3 and 7 are still being written
+        Serial.println("Catalog listing incorrect (file catalog)");
+        return 1;
+    }
+    return 0;
+}
+
+/* - - - - - - testCatalogPersistence - - - - - - *
+ * Usage:
+ * saves the catalog many times to mirrored storage and loads it back, checks that a save only
+ * writes the chunk that changed and that the catalog survives losing the copy on module 1
+ * 
+ * Inputs:
+ *  none
+ *  
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testCatalogPersistence() {
+    FileCatalog &catalog = fcTestCatalog(0);
+    FileCatalog &loaded = fcTestCatalog(1);
+    testFlash1.eraseAll();
+    testFlash2.eraseAll();
+    testFlashPair.setMode(STORAGE_MIRRORED);
+    if (!recordStore.format(&testFlashPair)) {
+        Serial.println("Record store not formatted (file catalog)");
+        return 1;
+    }
+    catalog.clear();
+
+    for (int i = 0; i < CATALOG_CHUNK_SLOTS + 3; i++) {
+        int slot = catalog.allocate();
+        catalog.getEntry(slot).size = 1000 + i;
+        catalog.getEntry(slot).timestamp = 5000 * i;
+        catalog.getEntry(slot).checksum = 0xC0FFEE00 + i;
+        catalog.setState(slot, FILE_VALID);
+        fcTestSave(catalog);
+    }
+
+    if (!loaded.load() || loaded.count() != catalog.count() || loaded.getEntry(4).checksum != catalog.getEntry(4).checksum
+        || loaded.getEntry(CATALOG_CHUNK_SLOTS + 1).size != catalog.getEntry(CATALOG_CHUNK_SLOTS + 1).size) {
+        Serial.println("Catalog not restored (file catalog)");
+        return 1;
+    }
+
+    // one slot changed, one chunk written
+    uint32_t payloadBytes = recordStore.getStats().payloadBytes;
+    catalog.getEntry(CATALOG_CHUNK_SLOTS).quality = 200;
+    fcTestSave(catalog);
+    uint32_t written = recordStore.getStats().payloadBytes - payloadBytes;
+    if (written != EncodedCatalogChunk::MEMSIZE) {
+        Serial.println("Catalog save wrote unchanged chunks (file catalog)");
+        return 1;
+    }
+
+    // lose the copy of the first chunk on module 1
+    int recordIdx = recordStore.find(RECORD_CATALOG, 0);
+    memset(testFlashMemory1 + recordStore.getRecord(recordIdx).addr + RecordStore::payloadOffset(false), 0, 64);
+    if (!loaded.load() || loaded.count() != catalog.count() || loaded.getEntry(4).checksum != catalog.getEntry(4).checksum
+        || loaded.getEntry(CATALOG_CHUNK_SLOTS).quality != 200) {
+        Serial.println("Catalog not restored from the mirror copy (file catalog)");
+        return 1;
+    }
+
+    Serial.print("Catalog save: ");
+    Serial.print(written);
+    Serial.print(" bytes for one changed slot, ");
+    Serial.print(CATALOG_CHUNKS * EncodedCatalogChunk::MEMSIZE);
+    Serial.println(" bytes for the whole catalog");
+    return 0;
+}
+
+/* - - - - - - testCatalogInterruptedWrite - - - - - - *
+ * Usage:
+ * a file left in the writing state is kept only if its record matches the checksum
+ * 
+ * Inputs:
+ *  none
+ *  
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testCatalogInterruptedWrite() {
+    FileCatalog &catalog = fcTestCatalog(0);
+    FileCatalog &loaded = fcTestCatalog(1);
+    uint8_t contents[100];
+    for (int i = 0; i < 100; i++) { contents[i] = i; }
+    testFlash1.eraseAll();
+    testFlash2.eraseAll();
+    testFlashPair.setMode(STORAGE_MIRRORED);
+    if (!recordStore.format(&testFlashPair)) {
+        Serial.println("Record store not formatted (file catalog)");
+        return 1;
+    }
+    catalog.clear();
+
+    // slot 0 written completely, slot 1 never written, slot 2 left over from an older window
+    for (int slot = 0; slot < 3; slot++) {
+        catalog.allocate();
+        catalog.getEntry(slot).size = sizeof(contents);
+        catalog.getEntry(slot).checksum = crc32c(contents, sizeof(contents));
+    }
+    fcTestSave(catalog);
+    recordStore.append(RECORD_SCIENCE, 0, contents, sizeof(contents));
+    recordStore.append(RECORD_SCIENCE, 2, contents, sizeof(contents) - 1);
+
+    loaded.load();
+    if (!loaded.isValid(0) || loaded.getEntry(1).state != FILE_FREE || loaded.getEntry(2).state != FILE_FREE
+        || recordStore.find(RECORD_SCIENCE, 2) >= 0) {
+        Serial.println("Interrupted write not resolved (file catalog)");
+        return 1;
+    }
+    return 0;
+}
+
+
+/* - - - - - - fileCatalogTestMain - - - - - - *
+ * Usage:
+ * runs the file catalog unit tests, prints results over serial
+ *  must be kept last in file since we are not using header structure for testing
+ * 
+ * Inputs:
+ *  none
+ *  
+ * Outputs:
+ *  number of tests that failed in module
+ */
+int fileCatalogTestMain() {
+    resetTestFlash(FC_TEST_SECTOR_SIZE, FC_TEST_SECTORS);
+    int testsFailed = 0; // iterator to track how many tests have failed
+
+    testsFailed += testCatalogAllocation();
+    testsFailed += testCatalogPersistence();
+    testsFailed += testCatalogInterruptedWrite();
+
+    // give back the flight record store and catalog
+    initRecordStore();
+    fileCatalog.load();
+
+    // print module summary
+    Serial.print("File Catalog module: ");
+    Serial.print(testsFailed);
+    Serial.println(" tests failed");
+
+    return testsFailed;
+}
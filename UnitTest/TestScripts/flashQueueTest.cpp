@@ -0,0 +1,253 @@
+/* flashQueueTest.cpp tests the FlashQueue class and queued record store appends and reads
+ * Usage:
+ *  part of NS2 unit testing suite
+ *  to be called in unitTestDriver.cpp
+ *
+ *  Runs on simulated flash modules in RAM. Between calls to service() the simulated bus clock
+ *  is advanced as if the main loop were taking samples, so page programs finish in the background.
+ */
+
+
+// NS2 includes
+#include "../headers/config.hpp"
+#include "../headers/flashDevice.hpp"
+#include "../headers/flashQueue.hpp"
+#include "../headers/recordStore.hpp"
+#include "testFixtures.hpp"
+
+const int FQ_TEST_SECTOR_SIZE = 4096;
+const int FQ_TEST_SECTORS = 8;
+const uint32_t FQ_TEST_CHIP_MEMSIZE = FQ_TEST_SECTOR_SIZE * FQ_TEST_SECTORS;
+const uint64_t FQ_TEST_LOOP_NANOS = 100000; // simulated time between loop iterations
+static uint8_t fqTestData[FQ_TEST_SECTOR_SIZE];
+static uint8_t fqTestReadBack[FQ_TEST_SECTOR_SIZE];
+
+/* - FqTestResult -
+*   Filled in by fqTestCallback.
+*/
+struct FqTestResult {
+    int calls = 0;
+    bool status = false;
+};
+
+void fqTestCallback(void *context, bool status) {
+    FqTestResult *result = (FqTestResult *)context;
+    result->calls++;
+    result->status = status;
+}
+
+/* - - - - - - fqTestReset - - - - - - *
+ * Usage:
+ *  empties the queue, erases both modules and formats the test store on device
+ */
+void fqTestReset(FlashDevice *device) {
+    flashQueue.flush();
+    testFlash1.restorePower();
+    testFlash1.eraseAll();
+    testFlash2.eraseAll();
+    testStore.format(device);
+    for (int i = 0; i < FQ_TEST_SECTOR_SIZE; i++) { fqTestData[i] = (uint8_t)(i * 7 + 3); }
+}
+
+/* - - - - - - fqTestRunLoop - - - - - - *
+ * Usage:
+ *  services the queue once per simulated loop iteration until it is empty
+ *  returns the number of iterations
+ */
+int fqTestRunLoop() {
+    int iterations = 0;
+    while (!flashQueue.isIdle() && iterations < 100000) {
+        flashQueue.service(FLASH_QUEUE_BUDGET_MICROS);
+        SimFlashDevice::advanceBusClock(FQ_TEST_LOOP_NANOS);
+        iterations++;
+    }
+    return iterations;
+}
+
+/* - - - - - - testQueuedAppend - - - - - - *
+ * Usage:
+ * a submitted record is written over several loop iterations, a page at a time, and is only
+ * indexed once its commit is programmed
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testQueuedAppend() {
+    const uint32_t length = 2000;
+    FqTestResult result;
+    fqTestReset(&testFlash1);
+
+    if (!testStore.submitAppend(RECORD_SCIENCE, 4, fqTestData, length, fqTestCallback, &result)
+        || testStore.find(RECORD_SCIENCE, 4) >= 0 || testStore.pendingAppends() != 1) {
+        Serial.println("Append not queued (flash queue)");
+        return 1;
+    }
+
+    // every page waits for the one before it to program, none are waited on
+    int iterations = fqTestRunLoop();
+    int pages = 1 + (length + FLASH_QUEUE_STEP - 1) / FLASH_QUEUE_STEP + 1; // header, payload, commit
+    if (iterations < pages || result.calls != 1 || !result.status || testStore.pendingAppends() != 0) {
+        Serial.println("Append not spread over loop iterations (flash queue)");
+        return 1;
+    }
+
+    int idx = testStore.find(RECORD_SCIENCE, 4);
+    if (!testStore.verify(idx) || !testStore.mount(&testFlash1) || testStore.count() != 1) {
+        Serial.println("Queued record not stored (flash queue)");
+        return 1;
+    }
+    return 0;
+}
+
+/* - - - - - - testQueuedPowerCut - - - - - - *
+ * Usage:
+ * power lost part way through a queued payload fails the append and leaves no record
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testQueuedPowerCut() {
+    FqTestResult result;
+    fqTestReset(&testFlash1);
+
+    testStore.submitAppend(RECORD_SCIENCE, 1, fqTestData, 2000, fqTestCallback, &result);
+    testFlash1.cutPowerAfter(1000);
+    fqTestRunLoop();
+    testFlash1.restorePower();
+
+    if (result.calls != 1 || result.status || testStore.find(RECORD_SCIENCE, 1) >= 0) {
+        Serial.println("Cut append not failed (flash queue)");
+        return 1;
+    }
+    if (!testStore.mount(&testFlash1) || testStore.count() != 0 || testStore.getStats().uncommitted != 1) {
+        Serial.println("Cut append committed (flash queue)");
+        return 1;
+    }
+    return 0;
+}
+
+/* - - - - - - testStripedOverlap - - - - - - *
+ * Usage:
+ * with striped storage one module is sent a page while the other programs, so a record
+ * takes fewer loop iterations than on one module
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testStripedOverlap() {
+    const uint32_t length = 3000;
+    FqTestResult result;
+
+    fqTestReset(&testFlash1);
+    testStore.submitAppend(RECORD_SCIENCE, 0, fqTestData, length, fqTestCallback, &result);
+    int singleIterations = fqTestRunLoop();
+
+    testFlashPair.setMode(STORAGE_STRIPED);
+    fqTestReset(&testFlashPair);
+    testStore.submitAppend(RECORD_SCIENCE, 0, fqTestData, length, fqTestCallback, &result);
+    int stripedIterations = fqTestRunLoop();
+    testFlashPair.setMode(STORAGE_MIRRORED);
+
+    Serial.print("Flash queue: ");
+    Serial.print(length);
+    Serial.print(" byte record in ");
+    Serial.print(singleIterations);
+    Serial.print(" loop iterations on one module, ");
+    Serial.print(stripedIterations);
+    Serial.println(" striped");
+
+    if (result.calls != 2 || !result.status || stripedIterations * 10 > singleIterations * 7) {
+        Serial.println("Striped pages did not overlap (flash queue)");
+        return 1;
+    }
+    return 0;
+}
+
+/* - - - - - - testQueuedRead - - - - - - *
+ * Usage:
+ * queued reads complete in order with the data, a full queue refuses requests and is counted
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testQueuedRead() {
+    FqTestResult appended;
+    FqTestResult read;
+    fqTestReset(&testFlash1);
+    testStore.append(RECORD_SCIENCE, 2, fqTestData, 1500);
+
+    memset(fqTestReadBack, 0, sizeof(fqTestReadBack));
+    int idx = testStore.find(RECORD_SCIENCE, 2);
+    if (!testStore.submitRead(idx, fqTestReadBack, 100, 1400, fqTestCallback, &read)
+        || testStore.submitRead(idx, fqTestReadBack, 100, 1401, fqTestCallback, &read)) {
+        Serial.println("Read not queued or out of range read queued (flash queue)");
+        return 1;
+    }
+    fqTestRunLoop();
+    if (read.calls != 1 || !read.status || memcmp(fqTestReadBack, fqTestData + 100, 1400) != 0) {
+        Serial.println("Queued read incorrect (flash queue)");
+        return 1;
+    }
+
+    // fill the queue
+    uint32_t refused = flashQueue.getStats().refused;
+    int submitted = 0;
+    while (flashQueue.submitRead(&testFlash1, 0, fqTestReadBack, 1, fqTestCallback, &read)) { submitted++; }
+    if (submitted != FLASH_QUEUE_DEPTH || flashQueue.getStats().refused != refused + 1
+        || testStore.submitAppend(RECORD_SCIENCE, 3, fqTestData, 10, fqTestCallback, &appended)) {
+        Serial.println("Full queue not refused (flash queue)");
+        return 1;
+    }
+    flashQueue.flush();
+    if (read.calls != 1 + FLASH_QUEUE_DEPTH || !flashQueue.isIdle() || flashQueue.getStats().maxDepth != FLASH_QUEUE_DEPTH) {
+        Serial.println("Queue not flushed (flash queue)");
+        return 1;
+    }
+    return 0;
+}
+
+
+/* - - - - - - flashQueueTestMain - - - - - - *
+ * Usage:
+ * runs the flash queue unit tests, prints results over serial
+ *  must be kept last in file since we are not using header structure for testing
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  number of tests that failed in module
+ */
+int flashQueueTestMain() {
+    resetTestFlash(FQ_TEST_SECTOR_SIZE, FQ_TEST_SECTORS);
+    int testsFailed = 0; // iterator to track how many tests have failed
+
+    testsFailed += testQueuedAppend();
+    testsFailed += testQueuedPowerCut();
+    testsFailed += testStripedOverlap();
+    testsFailed += testQueuedRead();
+    printFlashQueueInfo();
+
+    // print module summary
+    Serial.print("Flash Queue module: ");
+    Serial.print(testsFailed);
+    Serial.println(" tests failed");
+
+    return testsFailed;
+}
@@ -0,0 +1,282 @@
+/* hkHistoryTest.cpp tests the compressed housekeeping history
+ * Usage:
+ *  part of NS2 unit testing suite
+ *  to be called in unitTestDriver.cpp
+ *
+ *  Mounts the record store on a simulated flash module in RAM, the flight record store and
+ *  history are restored at the end.
+ */
+
+
+// NS2 includes
+#include "../headers/config.hpp"
+#include "../headers/flashDevice.hpp"
+#include "../headers/recordStore.hpp"
+#include "../headers/housekeeping.hpp"
+#include "../headers/hkHistory.hpp"
+#include "../headers/faultManager.hpp"
+#include "../headers/flashQueue.hpp"
+#include "../headers/crc.hpp"
+#include "testFixtures.hpp"
+
+const int HH_TEST_SECTOR_SIZE = 65536;
+const int HH_TEST_SECTORS = 2;
+static uint8_t hhTestPiece[HK_PIECE_MEMSIZE];
+static uint8_t hhTestBlock[HK_BLOCK_MEMSIZE];
+static int hhTestReads = 0;
+
+// counts the history blocks the flash queue has read for downlink
+void hhTestOnRead(void *context, bool status) {
+    (void)context;
+    hhTestReads += status;
+}
+
+// whether a downlinked piece holds the block of a key, as stored or as in RAM
+bool hhTestCheckPiece(size_t size, uint16_t key, const uint8_t *block, uint16_t length) {
+    uint16_t pieceKey = 0;
+    uint16_t pieceLength = 0;
+    uint32_t crc = 0;
+    memcpy(&pieceKey, hhTestPiece + 2, sizeof(pieceKey));
+    memcpy(&pieceLength, hhTestPiece + 4, sizeof(pieceLength));
+    memcpy(&crc, hhTestPiece + HK_PIECE_HEADER_MEMSIZE + length, sizeof(crc));
+    return size == HK_PIECE_HEADER_MEMSIZE + length + sizeof(crc) && memcmp(hhTestPiece, "HK", 2) == 0
+           && pieceKey == key && pieceLength == length && memcmp(hhTestPiece + HK_PIECE_HEADER_MEMSIZE, block, length) == 0
+           && crc == crc32c(hhTestPiece, HK_PIECE_HEADER_MEMSIZE + length);
+}
+
+// a sample of slowly drifting temperatures and currents with a bin of noise, as the ADC gives them
+HousekeepingData hhTestSample(int i) {
+    HousekeepingData sample = HousekeepingData();
+    int noise = (i * 7919) % 3 - 1;
+    sample.heaterOn = (i / 300) % 2;
+    sample.opticsTemp = 12.0F + i * 0.0005F + noise * 0.05F;
+    sample.analogTemp = 25.0F - i * 0.0002F;
+    sample.digitalTemp = 31.5F + noise * 0.05F;
+    sample.analogCurrent = (310 + noise) * TEENSY_VOLTAGE_RES;
+    sample.digitalCurrent = (205 + (i / 100) % 2) * TEENSY_VOLTAGE_RES;
+    sample.digitalRegPG = 1023 * TEENSY_VOLTAGE_RES;
+    return sample;
+}
+
+/* - - - - - - testHkRoundTrip - - - - - - *
+ * Usage:
+ * a block of samples a second apart decodes to the same times and heater states, and values
+ * within half a quantization step. A truncated block is refused
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testHkRoundTrip() {
+    static HkBlockEncoder encoder;
+    HkHistoryPoint *points = (HkHistoryPoint *)testReadBack; // decoded into the scratch file
+    const int maxPoints = sizeof(testReadBack) / sizeof(HkHistoryPoint);
+    const uint32_t firstMillis = 4000000000UL; // wraps in the block
+    encoder.begin(7);
+    uint32_t millis = firstMillis;
+    int added = 0;
+    while (added < maxPoints) {
+        if (!encoder.add(hhTestSample(added), millis)) { break; }
+        added++;
+        millis += 1000 + (added % 5 == 0); // loop jitter
+    }
+
+    int decoded = decodeHkBlock(encoder.getData(), encoder.length(), points, maxPoints);
+    HkBlockHeader &header = encoder.getHeader();
+    float bitsPerSample = (float)header.bitCount / added;
+    Serial.print("HK History: ");
+    Serial.print(added);
+    Serial.print(" samples in a ");
+    Serial.print(encoder.length());
+    Serial.print(" byte block, ");
+    Serial.print(bitsPerSample);
+    Serial.print(" bits per sample against ");
+    Serial.print(sizeof(HousekeepingData) * 8);
+    Serial.print(" in RAM, ");
+    Serial.print(86400.0F * bitsPerSample / 8 / 1024);
+    Serial.println(" KB per day");
+    if (decoded != added || header.startCount != 7 || added < 500) {
+        Serial.println("Block samples not decoded (hk history)");
+        return 1;
+    }
+    millis = firstMillis;
+    for (int i = 0; i < added; i++) {
+        HousekeepingData expected = hhTestSample(i);
+        HousekeepingData &sample = points[i].sample;
+        if (points[i].millis != millis || sample.heaterOn != expected.heaterOn
+            || fabsf(sample.opticsTemp - expected.opticsTemp) > HK_TEMP_RESOLUTION / 2 + 0.001F
+            || fabsf(sample.analogTemp - expected.analogTemp) > HK_TEMP_RESOLUTION / 2 + 0.001F
+            || fabsf(sample.digitalTemp - expected.digitalTemp) > HK_TEMP_RESOLUTION / 2 + 0.001F
+            || fabsf(sample.analogCurrent - expected.analogCurrent) > HK_VOLTAGE_RESOLUTION / 2
+            || fabsf(sample.digitalCurrent - expected.digitalCurrent) > HK_VOLTAGE_RESOLUTION / 2
+            || fabsf(sample.digitalRegPG - expected.digitalRegPG) > HK_VOLTAGE_RESOLUTION / 2) {
+            Serial.print("Sample decoded incorrectly (hk history): ");
+            Serial.println(i);
+            return 1;
+        }
+        millis += 1000 + ((i + 1) % 5 == 0);
+    }
+    if (bitsPerSample > 24) {
+        Serial.println("Samples not compressed (hk history)");
+        return 1;
+    }
+    if (decodeHkBlock(encoder.getData(), encoder.length() - 2, points, maxPoints) != -1) {
+        Serial.println("Truncated block decoded (hk history)");
+        return 1;
+    }
+    return 0;
+}
+
+/* - - - - - - testHkHistoryStore - - - - - - *
+ * Usage:
+ * blocks are stored once they span HK_BLOCK_MAX_MSEC, found by time range from the index,
+ * indexed again after a remount, and the oldest are removed past HK_HISTORY_BLOCKS
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testHkHistoryStore() {
+    static HkHistory history;
+    testFlash1.eraseAll();
+    recordStore.format(&testFlash1);
+    history.begin();
+    uint16_t run = payloadData.startCount;
+
+    // three blocks, one sample a minute
+    uint32_t millis = 0;
+    int samples = 0;
+    while (history.blockCount() < 3) {
+        history.add(hhTestSample(samples++), millis);
+        millis += 60000;
+    }
+    int blocks[HK_HISTORY_BLOCKS];
+    uint32_t secondFirst = history.getBlock(1).header.firstMillis;
+    int found = history.findBlocks(run, secondFirst, secondFirst + 1000, blocks, HK_HISTORY_BLOCKS);
+    if (history.getBlock(0).header.samples != HK_BLOCK_MAX_MSEC / 60000 || found != 1 || blocks[0] != 1
+        || history.findBlocks(run + 1, 0, millis, blocks, HK_HISTORY_BLOCKS) != 0
+        || history.findBlocks(run, 0, millis, blocks, HK_HISTORY_BLOCKS) != 3) {
+        Serial.println("Blocks not found by time range (hk history)");
+        return 1;
+    }
+
+    // the index is rebuilt from the record store
+    HkBlockIndex last = history.getBlock(2);
+    recordStore.mount(&testFlash1);
+    history.begin();
+    if (history.blockCount() != 3 || history.getBlock(2).key != last.key
+        || history.getBlock(2).header.firstMillis != last.header.firstMillis
+        || history.getBlock(2).header.bitCount != last.header.bitCount) {
+        Serial.println("Index not rebuilt after a remount (hk history)");
+        return 1;
+    }
+
+    // one sample per block, sealed by the gap to the next, 202 blocks written in all
+    while (history.getStats().blocksWritten < HK_HISTORY_BLOCKS + 2) {
+        history.add(hhTestSample(samples++), millis);
+        millis += HK_BLOCK_MAX_MSEC;
+    }
+    int stored = 0;
+    for (int idx = 0; idx < recordStore.count(); idx++) { stored += recordStore.getRecord(idx).type == RECORD_HK_HISTORY; }
+    if (history.blockCount() != HK_HISTORY_BLOCKS || stored != HK_HISTORY_BLOCKS
+        || history.getStats().blocksRemoved != 2 || history.getBlock(0).key != 2) {
+        Serial.println("Oldest blocks not removed (hk history)");
+        return 1;
+    }
+    return 0;
+}
+
+
+/* - - - - - - testHkHistoryDownlink - - - - - - *
+ * Usage:
+ * a time range selects the stored blocks and the block being filled, stored blocks are read by
+ * the flash queue one at a time, each framed as "HK" | key | length | block | crc32c, and a block
+ * removed since it was selected is skipped
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testHkHistoryDownlink() {
+    testFlash1.eraseAll();
+    recordStore.format(&testFlash1);
+    hkHistory.begin();
+    uint32_t millis = 0;
+    int samples = 0;
+    while (hkHistory.blockCount() < 2 || hkHistory.getCurrent().getHeader().samples < 3) {
+        hkHistory.add(hhTestSample(samples++), millis);
+        millis += 60000;
+    }
+
+    hhTestReads = 0;
+    if (selectHkHistory(0, 0, millis / 1000) != 3 || hkHistoryPiecesLeft() != 3
+        || readHkHistoryPiece(hhTestPiece, hhTestOnRead, nullptr) != 1) {
+        Serial.println("Stored block not read through the flash queue (hk history)");
+        return 1;
+    }
+    flashQueue.flush();
+    int recordIdx = recordStore.find(RECORD_HK_HISTORY, hkHistory.getBlock(0).key);
+    uint16_t length = recordStore.getRecord(recordIdx).length;
+    recordStore.read(recordIdx, hhTestBlock, 0, length);
+    if (hhTestReads != 1 || !hhTestCheckPiece(finishHkHistoryPiece(hhTestPiece), hkHistory.getBlock(0).key, hhTestBlock, length)) {
+        Serial.println("Stored block not framed for downlink (hk history)");
+        return 1;
+    }
+
+    // the second block is removed before it is sent, the one being filled is sent from RAM with the key it will get
+    nextHkHistoryPiece();
+    recordStore.remove(recordStore.find(RECORD_HK_HISTORY, hkHistory.getBlock(1).key));
+    HkBlockEncoder &current = hkHistory.getCurrent();
+    if (readHkHistoryPiece(hhTestPiece, hhTestOnRead, nullptr) != 0
+        || !hhTestCheckPiece(finishHkHistoryPiece(hhTestPiece), hkHistory.nextKey(), current.getData(), current.length())) {
+        Serial.println("Block being filled not sent last (hk history)");
+        return 1;
+    }
+    nextHkHistoryPiece();
+    if (hkHistoryPiecesLeft() != 0 || readHkHistoryPiece(hhTestPiece, hhTestOnRead, nullptr) != -1
+        || selectHkHistory(0, millis / 1000 + 10, millis / 1000 + 20) != 0) {
+        Serial.println("Blocks sent past the selection (hk history)");
+        return 1;
+    }
+    return 0;
+}
+
+/* - - - - - - hkHistoryTestMain - - - - - - *
+ * Usage:
+ * runs the housekeeping history unit tests, prints results over serial
+ *  must be kept last in file since we are not using header structure for testing
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  number of tests that failed in module
+ */
+int hkHistoryTestMain() {
+    resetTestFlash(HH_TEST_SECTOR_SIZE, HH_TEST_SECTORS);
+    int testsFailed = 0; // iterator to track how many tests have failed
+
+    testsFailed += testHkRoundTrip();
+    testsFailed += testHkHistoryStore();
+    testsFailed += testHkHistoryDownlink();
+
+    // give back the flight record store and history
+    initRecordStore();
+    initHkHistory();
+
+    // print module summary
+    Serial.print("HK History module: ");
+    Serial.print(testsFailed);
+    Serial.println(" tests failed");
+
+    return testsFailed;
+}
@@ -0,0 +1,414 @@
+/* pagedLayoutTest.cpp tests the paged science file layout
+ * Usage:
+ *  part of NS2 unit testing suite
+ *  to be called in unitTestDriver.cpp
+ *
+ *  Runs on a simulated flash module in RAM with 64KB sectors, the erase block size of the
+ *  flight flash modules, and compares packed and paged science records.
+ */
+
+
+// NS2 includes
+#include "../headers/config.hpp"
+#include "../headers/encodedSciData.hpp"
+#include "../headers/flashDevice.hpp"
+#include "../headers/recordStore.hpp"
+#include "testFixtures.hpp"
+
+const int PL_TEST_SECTOR_SIZE = 65536;
+const int PL_TEST_SECTORS = 2;
+
+/* - - - - - - plTestEncode - - - - - - *
+ * Usage:
+ *  encodes a buffer of counting data into testSciFile and lays it out in testPages, the buffer
+ *  is built in testReadBack
+ */
+void plTestEncode() {
+    uint16_t *buffer = (uint16_t *)testReadBack;
+    for (int i = 0; i < BUFFERSIZE; i++) { buffer[i] = (uint16_t)(i * 13); }
+    unsigned long timestamp = 1234;
+    testSciFile.encodeData(buffer, timestamp);
+    testSciFile.toPages(testPages);
+}
+
+/* - - - - - - plTestGather - - - - - - *
+ * Usage:
+ *  gathers the encoded file in testPages into dst, so testSciFile can be used to decode
+ */
+void plTestGather(uint8_t *dst) {
+    memcpy(dst, testPages, EncodedSciData::PAGED_MEMSIZE);
+    EncodedSciData::unpage(dst);
+}
+
+/* - - - - - - plTestReset - - - - - - *
+ * Usage:
+ *  erases the module and formats the test store on it
+ */
+void plTestReset() {
+    testFlash1.restorePower();
+    testFlash1.eraseAll();
+    testStore.format(&testFlash1);
+}
+
+/* - - - - - - testPageRoundTrip - - - - - - *
+ * Usage:
+ * paged data gathers back to the encoded file, and a flipped bit is found in its page only
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testPageRoundTrip() {
+    plTestEncode();
+    memcpy(testReadBack, testPages, EncodedSciData::PAGED_MEMSIZE);
+    if (EncodedSciData::unpage(testReadBack) != 0
+        || memcmp(testReadBack, testSciFile.getData(), EncodedSciData::MEMSIZE) != 0) {
+        Serial.println("Pages not gathered back to encoded file (paged layout)");
+        return 1;
+    }
+
+    // one bit in page 3, two in the last page
+    memcpy(testReadBack, testPages, EncodedSciData::PAGED_MEMSIZE);
+    testReadBack[3 * FLASH_PAGE_SIZE + 17] ^= 0x04;
+    testReadBack[EncodedSciData::PAGED_MEMSIZE - 1] ^= 0x80;
+    testReadBack[EncodedSciData::PAGED_MEMSIZE - FLASH_PAGE_SIZE] ^= 0x01;
+    if (EncodedSciData::unpage(testReadBack) != 2) {
+        Serial.println("Bad pages not found (paged layout)");
+        return 1;
+    }
+
+    // the corrupted data still decodes, the checksum only finds it
+    testSciFile.fill(testReadBack);
+    ScrubReport report = testSciFile.scrub();
+    plTestGather(testReadBack);
+    if (report.uncorrected != 0 || memcmp(testSciFile.getData(), testReadBack, EncodedSciData::MEMSIZE) != 0) {
+        Serial.println("Bad page not corrected (paged layout)");
+        return 1;
+    }
+    return 0;
+}
+
+/* - - - - - - testScrubPages - - - - - - *
+ * Usage:
+ * gathered data is corrected where pages failed their checksum, and blocks in pages that
+ * passed are not decoded
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testScrubPages() {
+    EncodedSciData &whole = testSciFile;
+    uint8_t badPages[EncodedSciData::BAD_PAGE_MEMSIZE];
+    plTestEncode();
+
+    // clean, nothing to decode
+    memcpy(testReadBack, testPages, EncodedSciData::PAGED_MEMSIZE);
+    EncodedSciData::unpage(testReadBack, badPages);
+    ScrubReport report = EncodedSciData::scrubPages(testReadBack, badPages);
+    if (report.numErrors != 0 || report.badPages != 0) {
+        Serial.println("Clean pages scrubbed (paged layout)");
+        return 1;
+    }
+
+    // single errors in two blocks and a double error in a third, each bit in its own page
+    memcpy(testReadBack, testPages, EncodedSciData::PAGED_MEMSIZE);
+    int bits[] = {40 + 3 * EncodedSciData::MESSAGE_COUNT, 5000 + 70 * EncodedSciData::MESSAGE_COUNT,
+                  900 + 10 * EncodedSciData::MESSAGE_COUNT, 900 + 11 * EncodedSciData::MESSAGE_COUNT};
+    for (int i = 0; i < 4; i++) {
+        testReadBack[EncodedSciData::pagedOffset(bits[i] / 8)] ^= 1 << (bits[i] % 8);
+    }
+    if (EncodedSciData::unpage(testReadBack, badPages) != 4) {
+        Serial.println("Bad pages not marked (paged layout)");
+        return 1;
+    }
+
+    // the same as decoding the whole file
+    whole.fill(testReadBack);
+    ScrubReport wholeReport = whole.scrub();
+    report = EncodedSciData::scrubPages(testReadBack, badPages);
+    if (report.corrected != 2 || report.uncorrected != 1 || report.badPages != 4
+        || report.corrected != wholeReport.corrected || report.uncorrected != wholeReport.uncorrected
+        || memcmp(testReadBack, whole.getData(), EncodedSciData::MEMSIZE) != 0) {
+        Serial.println("Bad pages not corrected as a whole file scrub (paged layout)");
+        return 1;
+    }
+    return 0;
+}
+
+/* - - - - - - testPagedRecord - - - - - - *
+ * Usage:
+ * a paged record starts its payload on a page boundary after a packed record, fits one
+ * erase block, and mounts with the packed record
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testPagedRecord() {
+    plTestReset();
+    plTestEncode();
+
+    uint8_t small[100];
+    memset(small, 0x5A, sizeof(small));
+    if (!testStore.append(RECORD_SCIENCE, 100, small, sizeof(small))
+        || !testStore.append(RECORD_SCIENCE, 7, testPages, EncodedSciData::PAGED_MEMSIZE, true)) {
+        Serial.println("Records not appended (paged layout)");
+        return 1;
+    }
+    if (RecordStore::recordMemsize(EncodedSciData::PAGED_MEMSIZE, true) > (uint32_t)PL_TEST_SECTOR_SIZE) {
+        Serial.println("Science record larger than an erase block (paged layout)");
+        return 1;
+    }
+
+    int idx = testStore.find(RECORD_SCIENCE, 7);
+    RecordInfo info = testStore.getRecord(idx);
+    if (!info.paged || info.addr % FLASH_PAGE_SIZE != 0) {
+        Serial.println("Paged record not page aligned (paged layout)");
+        return 1;
+    }
+
+    if (!testStore.mount(&testFlash1) || testStore.count() != 2) {
+        Serial.println("Paged record not mounted (paged layout)");
+        return 1;
+    }
+    idx = testStore.find(RECORD_SCIENCE, 7);
+    memset(testReadBack, 0, EncodedSciData::PAGED_MEMSIZE);
+    if (!testStore.getRecord(idx).paged || !testStore.verify(idx)
+        || !testStore.read(idx, testReadBack, 0, EncodedSciData::PAGED_MEMSIZE)
+        || memcmp(testReadBack, testPages, EncodedSciData::PAGED_MEMSIZE) != 0) {
+        Serial.println("Mounted paged record incorrect (paged layout)");
+        return 1;
+    }
+
+    // a packed record after it carries on from the end of its last page
+    if (!testStore.append(RECORD_SCIENCE, 101, small, sizeof(small)) || !testStore.mount(&testFlash1)
+        || testStore.count() != 3) {
+        Serial.println("Record after paged record lost (paged layout)");
+        return 1;
+    }
+    return 0;
+}
+
+/* - - - - - - testPagedPowerCut - - - - - - *
+ * Usage:
+ * power lost anywhere in a paged record leaves the records before it and the record only if
+ * its commit was programmed, and the store can still be appended to
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testPagedPowerCut() {
+    const uint32_t length = 3 * FLASH_PAGE_SIZE;
+    uint8_t small[40];
+    memset(small, 0x33, sizeof(small));
+    int failures = 0;
+
+    for (uint32_t cut = 0; cut < RecordStore::recordMemsize(length, true); cut += 97) {
+        plTestReset();
+        testStore.append(RECORD_SCIENCE, 100, small, sizeof(small));
+        testFlash1.cutPowerAfter(cut);
+        bool appended = testStore.append(RECORD_SCIENCE, 1, testPages, length, true);
+        testFlash1.restorePower();
+
+        // the padding is never programmed, so late cut points miss the record
+        if (!testStore.mount(&testFlash1) || testStore.find(RECORD_SCIENCE, 100) < 0
+            || (testStore.find(RECORD_SCIENCE, 1) >= 0) != appended || !testStore.append(RECORD_SCIENCE, 2, testPages, length, true)
+            || !testStore.mount(&testFlash1) || !testStore.verify(testStore.find(RECORD_SCIENCE, 2))) {
+            failures++;
+        }
+    }
+    if (failures > 0) {
+        Serial.print(failures);
+        Serial.println(" cut points lost records (paged layout)");
+        return 1;
+    }
+    return 0;
+}
+
+/* - - - - - - testPagedCost - - - - - - *
+ * Usage:
+ * measures program operations and bus time of packed and paged science records, and the time
+ * to scrub a clean file by checking its pages against a full decode
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testPagedCost() {
+    plTestEncode();
+    plTestGather(testReadBack);
+
+    // packed record of the encoded file
+    plTestReset();
+    uint32_t programs = testFlash1.getPagePrograms();
+    uint32_t partial = testFlash1.getPartialPrograms();
+    uint64_t startNanos = SimFlashDevice::getBusNanos();
+    testStore.append(RECORD_SCIENCE, 0, testReadBack, EncodedSciData::MEMSIZE);
+    uint32_t packedPrograms = testFlash1.getPagePrograms() - programs;
+    uint32_t packedPartial = testFlash1.getPartialPrograms() - partial;
+    uint32_t packedMicros = (uint32_t)((SimFlashDevice::getBusNanos() - startNanos) / 1000);
+
+    // paged record, after a packed record so it has to be aligned
+    plTestReset();
+    uint8_t small[100] = {};
+    testStore.append(RECORD_SCIENCE, 100, small, sizeof(small));
+    programs = testFlash1.getPagePrograms();
+    partial = testFlash1.getPartialPrograms();
+    startNanos = SimFlashDevice::getBusNanos();
+    testStore.append(RECORD_SCIENCE, 0, testPages, EncodedSciData::PAGED_MEMSIZE, true);
+    uint32_t pagedPrograms = testFlash1.getPagePrograms() - programs;
+    uint32_t pagedPartial = testFlash1.getPartialPrograms() - partial;
+    uint32_t pagedMicros = (uint32_t)((SimFlashDevice::getBusNanos() - startNanos) / 1000);
+
+    // clean scrub, checksums only against decoding every block
+    uint32_t startMicros = micros();
+    memcpy(testReadBack, testPages, EncodedSciData::PAGED_MEMSIZE);
+    int badPages = EncodedSciData::unpage(testReadBack);
+    uint32_t checkMicros = micros() - startMicros;
+    startMicros = micros();
+    testSciFile.fill(testReadBack);
+    ScrubReport report = testSciFile.scrub();
+    uint32_t decodeMicros = micros() - startMicros;
+
+    Serial.print("Paged layout: packed record ");
+    Serial.print(packedPrograms);
+    Serial.print(" programs (");
+    Serial.print(packedPartial);
+    Serial.print(" partial), ");
+    Serial.print(packedMicros);
+    Serial.print(" us; paged record ");
+    Serial.print(pagedPrograms);
+    Serial.print(" programs (");
+    Serial.print(pagedPartial);
+    Serial.print(" partial), ");
+    Serial.print(pagedMicros);
+    Serial.println(" us");
+    Serial.print("Paged layout: clean scrub ");
+    Serial.print(checkMicros);
+    Serial.print(" us checking pages, ");
+    Serial.print(decodeMicros);
+    Serial.println(" us decoding");
+
+    // only the header page and the commit are partial, the payload is whole pages
+    if (badPages != 0 || report.numErrors != 0 || pagedPartial > 2
+        || pagedPrograms != (uint32_t)EncodedSciData::PAGE_COUNT + 2) {
+        Serial.println("Paged record not written in whole pages (paged layout)");
+        return 1;
+    }
+    return 0;
+}
+
+
+/* - - - - - - testEncodePages - - - - - - *
+ * Usage:
+ * a window encoded straight from its ring buffers gives the same pages as the sorted window
+ * encoded and laid out by toPages(), and decodeRange() reads its samples and timestamp back
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testEncodePages() {
+    uint16_t *ring = testRing;
+    int16_t *ringAttitude = testRingAttitude;
+    uint8_t *ringCodes = testRingCodes;
+    // the sorted window is built in the scratch files, both are written only once it is encoded
+    uint16_t *sorted = (uint16_t *)testReadBack;
+    int16_t *sortedAttitude = (int16_t *)testPages;
+    uint8_t *sortedCodes = testPages + BUFFERSIZE * sizeof(int16_t);
+    static_assert(BUFFERSIZE * sizeof(int16_t) + RATE_CODE_MEMSIZE <= EncodedSciData::PAGED_MEMSIZE, "the sorted window must fit in the scratch files");
+    const int start = 4321; // oldest sample
+    memset(ringCodes, 0, RATE_CODE_MEMSIZE);
+    memset(sortedCodes, 0, RATE_CODE_MEMSIZE);
+    for (int i = 0; i < BUFFERSIZE; i++) {
+        int ringIdx = (start + i) % BUFFERSIZE;
+        uint8_t code = (i / 50) % ADAPTIVE_RATE_COUNT;
+        ring[ringIdx] = sorted[i] = (uint16_t)(i * 7 + 3);
+        ringAttitude[ringIdx] = sortedAttitude[i] = i % 500 == 0 ? ATTITUDE_INVALID : (int16_t)(i % 3000 - 1500);
+        ringCodes[ringIdx / RATE_CODES_PER_BYTE] |= code << (2 * (ringIdx % RATE_CODES_PER_BYTE));
+        sortedCodes[i / RATE_CODES_PER_BYTE] |= code << (2 * (i % RATE_CODES_PER_BYTE));
+    }
+    unsigned long timestamp = 987654;
+    testSciFile.encodeData(sorted, timestamp, sortedCodes, sortedAttitude);
+    testSciFile.toPages(testPages);
+
+    ScienceSource window;
+    window.buffer = ring;
+    window.rateCodes = ringCodes;
+    window.attitude = ringAttitude;
+    window.start = start;
+    window.timestamp = timestamp;
+    uint32_t startMicros = micros();
+    EncodedSciData::encodePages(window, testReadBack);
+    uint32_t encodeMicros = micros() - startMicros;
+    if (memcmp(testReadBack, testPages, EncodedSciData::PAGED_MEMSIZE) != 0) {
+        Serial.println("Window encoded from ring buffers does not match (paged layout)");
+        return 1;
+    }
+
+    EncodedSciData::unpage(testReadBack);
+    uint16_t samples[3];
+    unsigned long decodedTimestamp = 0;
+    EncodedSciData::decodeRange(testReadBack, 1001 * sizeof(uint16_t), samples, sizeof(samples));
+    EncodedSciData::decodeRange(testReadBack, BUFFER_MEMSIZE, &decodedTimestamp, TIMESTAMP_SIZE);
+    if (samples[0] != 1001 * 7 + 3 || samples[2] != 1003 * 7 + 3 || decodedTimestamp != timestamp) {
+        Serial.println("Range not decoded (paged layout)");
+        return 1;
+    }
+
+    Serial.print("Paged encode from ring buffers: ");
+    Serial.print(encodeMicros);
+    Serial.println(" us");
+    return 0;
+}
+
+
+/* - - - - - - pagedLayoutTestMain - - - - - - *
+ * Usage:
+ * runs the paged layout unit tests, prints results over serial
+ *  must be kept last in file since we are not using header structure for testing
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  number of tests that failed in module
+ */
+int pagedLayoutTestMain() {
+    resetTestFlash(PL_TEST_SECTOR_SIZE, PL_TEST_SECTORS);
+    int testsFailed = 0; // iterator to track how many tests have failed
+
+    testsFailed += testPageRoundTrip();
+    testsFailed += testScrubPages();
+    testsFailed += testPagedRecord();
+    testsFailed += testPagedPowerCut();
+    testsFailed += testPagedCost();
+    testsFailed += testEncodePages();
+
+    // print module summary
+    Serial.print("Paged Layout module: ");
+    Serial.print(testsFailed);
+    Serial.println(" tests failed");
+
+    return testsFailed;
+}
@@ -0,0 +1,628 @@
+/* recordStoreTest.cpp tests the RecordStore class
+ * Usage:
+ *  part of NS2 unit testing suite
+ *  to be called in unitTestDriver.cpp
+ *
+ *  Runs on a simulated flash device in RAM. Power is cut at every byte of a sequence of
+ *  appends and removes, and the store must mount consistent each time.
+ *  Reports mount time and write amplification. Dead sectors are reclaimed through the flash queue.
+ */
+
+
+// NS2 includes
+#include "../headers/config.hpp"
+#include "../headers/recordStore.hpp"
+#include "../headers/encodedSciData.hpp"
+#include "testFixtures.hpp"
+
+const int RS_TEST_SECTOR_SIZE = 4096;
+const int RS_TEST_SECTORS = 8;
+const int RS_TEST_KEYS = 6;
+
+/* - RsTestOp -
+*   One step of the power cut sequence, version 0 removes the key.
+*/
+struct RsTestOp {
+    uint16_t key;
+    uint8_t version;
+    uint32_t length;
+};
+
+// replaces key 1, removes key 2 and moves to a new sector when key 3 does not fit in the first
+static const RsTestOp RS_TEST_OPS[] = {
+    {0, 1, 40}, {1, 1, 300}, {2, 1, 1000}, {1, 2, 301}, {2, 0, 0}, {3, 1, 3000}, {4, 1, 5}, {0, 2, 0}
+};
+const int RS_TEST_OP_COUNT = sizeof(RS_TEST_OPS) / sizeof(RS_TEST_OPS[0]);
+
+/* - - - - - - rsTestFill - - - - - - *
+ * Usage:
+ *  fills a payload with a pattern unique to the key and version
+ */
+void rsTestFill(uint8_t *data, uint16_t key, uint8_t version, uint32_t length) {
+    for (uint32_t i = 0; i < length; i++) { data[i] = (uint8_t)(key * 31 + version * 7 + i); }
+}
+
+/* - - - - - - rsTestMatches - - - - - - *
+ * Usage:
+ *  checks a stored record holds the given version of its key, version 0 means absent
+ */
+bool rsTestMatches(int idx, uint16_t key, uint8_t version) {
+    uint8_t *expected = testPages;
+    uint8_t *actual = testReadBack;
+    if (version == 0) { return idx < 0; }
+    if (idx < 0) { return false; }
+
+    uint32_t length = 0;
+    for (int i = 0; i < RS_TEST_OP_COUNT; i++) {
+        if (RS_TEST_OPS[i].key == key && RS_TEST_OPS[i].version == version) { length = RS_TEST_OPS[i].length; }
+    }
+    if (testStore.getRecord(idx).length != length || !testStore.read(idx, actual, 0, length)) { return false; }
+    rsTestFill(expected, key, version, length);
+    return memcmp(expected, actual, length) == 0;
+}
+
+/* - - - - - - rsTestRunOps - - - - - - *
+ * Usage:
+ *  runs the op sequence on a freshly formatted store until an op fails.
+ *  before[key] and after[key] are the versions allowed for each key afterwards,
+ *  they differ only for the key of the op that failed.
+ */
+void rsTestRunOps(uint8_t before[RS_TEST_KEYS], uint8_t after[RS_TEST_KEYS]) {
+    uint8_t *payload = testPages;
+    memset(before, 0, RS_TEST_KEYS);
+    memset(after, 0, RS_TEST_KEYS);
+
+    for (int i = 0; i < RS_TEST_OP_COUNT; i++) {
+        const RsTestOp &op = RS_TEST_OPS[i];
+        bool status;
+        if (op.version == 0) {
+            status = testStore.remove(testStore.find(RECORD_SCIENCE, op.key));
+        } else {
+            rsTestFill(payload, op.key, op.version, op.length);
+            status = testStore.append(RECORD_SCIENCE, op.key, payload, op.length);
+        }
+        after[op.key] = op.version;
+        if (!status) { return; } // either version may be found
+        before[op.key] = op.version;
+        if (!testFlash1.isPowered()) { return; }
+    }
+}
+
+/* - - - - - - testRecordRoundTrip - - - - - - *
+ * Usage:
+ * appends, replaces and removes records and checks they read back the same after a remount
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testRecordRoundTrip() {
+    uint8_t before[RS_TEST_KEYS];
+    uint8_t after[RS_TEST_KEYS];
+    testFlash1.restorePower();
+    testFlash1.eraseAll();
+    testStore.format(&testFlash1);
+    rsTestRunOps(before, after);
+
+    for (int pass = 0; pass < 2; pass++) {
+        for (int key = 0; key < RS_TEST_KEYS; key++) {
+            int idx = testStore.find(RECORD_SCIENCE, key);
+            if (!rsTestMatches(idx, key, before[key]) || (idx >= 0 && !testStore.verify(idx))) {
+                Serial.println("Record contents incorrect (record store)");
+                return 1;
+            }
+        }
+        testStore.mount(&testFlash1);
+    }
+    if (testStore.count() != 4 || testStore.getStats().uncommitted != 0 || testStore.getStats().tornHeaders != 0) {
+        Serial.println("Record index incorrect after mount (record store)");
+        return 1;
+    }
+    return 0;
+}
+
+/* - - - - - - testRecordPowerCut - - - - - - *
+ * Usage:
+ * cuts power after every byte the op sequence programs. After each cut the store must
+ * mount with every acknowledged op applied, no record that fails its checksum, and
+ * room for a new record that survives another mount.
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testRecordPowerCut() {
+    uint8_t before[RS_TEST_KEYS];
+    uint8_t after[RS_TEST_KEYS];
+    uint8_t payload[16];
+
+    // program bytes used by the whole sequence
+    testFlash1.restorePower();
+    testFlash1.eraseAll();
+    testStore.format(&testFlash1);
+    uint32_t startBytes = testFlash1.getBytesProgrammed();
+    rsTestRunOps(before, after);
+    uint32_t totalBytes = testFlash1.getBytesProgrammed() - startBytes;
+
+    int failures = 0;
+    uint32_t maxMountMicros = 0;
+    for (uint32_t cut = 0; cut <= totalBytes; cut++) {
+        testFlash1.restorePower();
+        testFlash1.eraseAll();
+        testStore.format(&testFlash1);
+        testFlash1.cutPowerAfter(cut);
+        rsTestRunOps(before, after);
+
+        // reset
+        testFlash1.restorePower();
+        testStore.mount(&testFlash1);
+        maxMountMicros = max(maxMountMicros, testStore.getStats().mountMicros);
+
+        bool consistent = true;
+        for (int key = 0; key < RS_TEST_KEYS; key++) {
+            int idx = testStore.find(RECORD_SCIENCE, key);
+            consistent = consistent && (idx < 0 || testStore.verify(idx))
+                         && (rsTestMatches(idx, key, before[key]) || rsTestMatches(idx, key, after[key]));
+        }
+
+        // the store must still take appends
+        rsTestFill(payload, RS_TEST_KEYS - 1, 1, sizeof(payload));
+        consistent = consistent && testStore.append(RECORD_SCIENCE, RS_TEST_KEYS - 1, payload, sizeof(payload));
+        testStore.mount(&testFlash1);
+        int idx = testStore.find(RECORD_SCIENCE, RS_TEST_KEYS - 1);
+        consistent = consistent && idx >= 0 && testStore.verify(idx);
+
+        if (!consistent) {
+            if (failures == 0) {
+                Serial.print("Store inconsistent after power cut at byte ");
+                Serial.print(cut);
+                Serial.println(" (record store)");
+            }
+            failures++;
+        }
+    }
+
+    Serial.print("Record store power cuts: ");
+    Serial.print(totalBytes + 1);
+    Serial.print(" tried, ");
+    Serial.print(failures);
+    Serial.print(" inconsistent, ");
+    Serial.print(maxMountMicros);
+    Serial.println(" us longest mount");
+    return failures > 0;
+}
+
+/* - - - - - - testRecordCorruptHeader - - - - - - *
+ * Usage:
+ * a bit flip in a committed header loses only the records after it in the same sector
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testRecordCorruptHeader() {
+    uint8_t payload[700];
+    const int recordsPerSector = (RS_TEST_SECTOR_SIZE - SectorHeader::MEMSIZE) / RecordStore::recordMemsize(sizeof(payload));
+    testFlash1.restorePower();
+    testFlash1.eraseAll();
+    testStore.format(&testFlash1);
+    for (int key = 0; key < 2 * recordsPerSector; key++) {
+        rsTestFill(payload, key, 1, sizeof(payload));
+        testStore.append(RECORD_SCIENCE, key, payload, sizeof(payload));
+    }
+
+    testFlash1.injectBitFlip(SectorHeader::MEMSIZE + RecordStore::recordMemsize(sizeof(payload)) + 5, 2); // seq of the second record
+    testStore.mount(&testFlash1);
+    if (testStore.getStats().tornHeaders != 1 || testStore.count() != recordsPerSector + 1
+        || testStore.find(RECORD_SCIENCE, 0) < 0 || testStore.find(RECORD_SCIENCE, recordsPerSector) < 0) {
+        Serial.println("Corrupted header lost more than its sector (record store)");
+        return 1;
+    }
+    return 0;
+}
+
+/* - - - - - - testRecordMountCost - - - - - - *
+ * Usage:
+ * fills the store, checks mount reads one header per record and reports mount time
+ * and write amplification. Emptying a full store lets its sectors be erased and reused.
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testRecordMountCost() {
+    uint8_t payload[100];
+    testFlash1.restorePower();
+    testFlash1.eraseAll();
+    testStore.format(&testFlash1);
+
+    int records = 0;
+    rsTestFill(payload, 0, 1, sizeof(payload));
+    while (records < RECORD_MAX_RECORDS && testStore.append(RECORD_SCIENCE, records, payload, sizeof(payload))) { records++; }
+    RecordStoreStats writeStats = testStore.getStats();
+
+    testStore.mount(&testFlash1);
+    RecordStoreStats stats = testStore.getStats();
+    if (testStore.count() != records || stats.headersScanned > (uint32_t)(records + RS_TEST_SECTORS)) {
+        Serial.println("Mount did not read headers only (record store)");
+        return 1;
+    }
+
+    Serial.print("Record store mount: ");
+    Serial.print(records);
+    Serial.print(" records in ");
+    Serial.print(stats.mountMicros);
+    Serial.print(" us, ");
+    Serial.print(stats.headersScanned);
+    Serial.println(" headers read");
+    Serial.print("Write amplification: ");
+    Serial.print(100 * writeStats.programmedBytes / writeStats.payloadBytes);
+    Serial.print("% for ");
+    Serial.print(sizeof(payload));
+    Serial.print(" byte records, ");
+    Serial.print(RecordStore::recordMemsize(EncodedSciData::MEMSIZE) - EncodedSciData::MEMSIZE);
+    Serial.print(" bytes over ");
+    Serial.print(EncodedSciData::MEMSIZE);
+    Serial.println(" for science records");
+
+    // full until every record is gone
+    if (testStore.append(RECORD_SCIENCE, records, payload, sizeof(payload))) {
+        Serial.println("Full store took a record (record store)");
+        return 1;
+    }
+    while (testStore.count() > 0) { testStore.remove(0); }
+    if (!testStore.append(RECORD_SCIENCE, 0, payload, sizeof(payload))) {
+        Serial.println("Empty store not reused (record store)");
+        return 1;
+    }
+    return 0;
+}
+
+
+/* - - - - - - rsTestFillSectors - - - - - - *
+ * Usage:
+ *  appends one record per sector, keys from firstKey, until count records are written or the store is full.
+ *  returns the number appended
+ */
+int rsTestFillSectors(int firstKey, int count) {
+    static uint8_t payload[RS_TEST_SECTOR_SIZE / 2 + 1]; // too big for two to share a sector
+    int appended = 0;
+    rsTestFill(payload, firstKey, 1, sizeof(payload));
+    while (appended < count && testStore.append(RECORD_SCIENCE, firstKey + appended, payload, sizeof(payload))) { appended++; }
+    return appended;
+}
+
+/* - - - - - - testRecordReclaim - - - - - - *
+ * Usage:
+ * sectors whose records are all removed are erased by reclaim() through the flash queue and
+ * appends then use them without erasing. Erases go to the least worn sectors and the counts
+ * survive a mount.
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testRecordReclaim() {
+    testFlash1.restorePower();
+    testFlash1.eraseAll();
+    testStore.format(&testFlash1);
+
+    // a full store, one record per sector
+    if (rsTestFillSectors(0, RS_TEST_SECTORS + 1) != RS_TEST_SECTORS || testStore.countSectors(SECTOR_FREE) != 0) {
+        Serial.println("Store not filled a record per sector (record store)");
+        return 1;
+    }
+
+    // downlink half of them, the head sector stays open
+    for (int key = 0; key < RS_TEST_SECTORS / 2; key++) { testStore.remove(testStore.find(RECORD_SCIENCE, key)); }
+    if (testStore.reclaimableSectors() != RS_TEST_SECTORS / 2 || testStore.freeBytes() >= RS_TEST_SECTOR_SIZE) {
+        Serial.println("Dead sectors not found (record store)");
+        return 1;
+    }
+
+    // one erase in the queue at a time
+    int erases = 0;
+    while (testStore.reclaimableSectors() > 0 && erases <= RS_TEST_SECTORS) {
+        testStore.reclaim();
+        if (testStore.countSectors(SECTOR_ERASING) != 1 || flashQueue.depth() > 2) {
+            Serial.println("Reclaim did not queue one erase (record store)");
+            return 1;
+        }
+        flashQueue.flush();
+        erases++;
+    }
+    RecordStoreStats stats = testStore.getStats();
+    if (erases != RS_TEST_SECTORS / 2 || stats.reclaimedSectors != (uint32_t)erases
+        || testStore.countSectors(SECTOR_FREE) != RS_TEST_SECTORS / 2) {
+        Serial.println("Dead sectors not reclaimed (record store)");
+        return 1;
+    }
+
+    // appends use the erased sectors without erasing, nothing is lost
+    uint32_t erasedBefore = testFlash1.getSectorsErased();
+    if (rsTestFillSectors(100, RS_TEST_SECTORS) != RS_TEST_SECTORS / 2 || testFlash1.getSectorsErased() != erasedBefore
+        || testStore.getStats().foregroundErases != 0 || testStore.count() != RS_TEST_SECTORS) {
+        Serial.println("Reclaimed sectors not reused without erasing (record store)");
+        return 1;
+    }
+
+    // erase counts survive a mount, the reclaimed sectors have one more erase
+    testStore.mount(&testFlash1);
+    int worn = 0;
+    for (int sector = 0; sector < testStore.sectorCount(); sector++) { worn += testStore.getSector(sector).eraseCount == 2; }
+    if (testStore.count() != RS_TEST_SECTORS || worn != RS_TEST_SECTORS / 2) {
+        Serial.println("Erase counts not kept (record store)");
+        return 1;
+    }
+
+    // with nothing erased the append erases a sector itself
+    testStore.remove(testStore.find(RECORD_SCIENCE, 100));
+    if (rsTestFillSectors(200, 1) != 1 || testStore.getStats().foregroundErases != 1) {
+        Serial.println("Append did not erase a dead sector (record store)");
+        return 1;
+    }
+    return 0;
+}
+
+/* - - - - - - rsTestReclaimReset - - - - - - *
+ * Usage:
+ *  remounts after a reset part way through reclaiming sector 0, which held only the removed key 0.
+ *  returns whether key 0 stayed removed, key 1 is intact and sector 0 is then reclaimed
+ */
+bool rsTestReclaimReset() {
+    testFlash1.restorePower();
+    testStore.mount(&testFlash1);
+    bool consistent = testStore.find(RECORD_SCIENCE, 0) < 0 && testStore.verify(testStore.find(RECORD_SCIENCE, 1));
+    for (int i = 0; i < RS_TEST_SECTORS && testStore.reclaimableSectors() > 0; i++) {
+        testStore.reclaim();
+        flashQueue.flush();
+    }
+    return consistent && testStore.getSector(0).state == SECTOR_FREE && testStore.getSector(0).eraseCount >= 2;
+}
+
+/* - - - - - - testRecordReclaimPowerCut - - - - - - *
+ * Usage:
+ * power lost at any point of a background erase, including part way through the erase itself,
+ * does not bring removed records back and the sector is reclaimed after the reset
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testRecordReclaimPowerCut() {
+    int failures = 0;
+
+    // cut while marking the sector obsolete or stamping it
+    for (uint32_t cut = 0; cut <= 1 + SectorHeader::STAMP_MEMSIZE; cut++) {
+        testFlash1.restorePower();
+        testFlash1.eraseAll();
+        testStore.format(&testFlash1);
+        rsTestFillSectors(0, 2);
+        testStore.remove(testStore.find(RECORD_SCIENCE, 0));
+
+        testFlash1.cutPowerAfter(cut);
+        testStore.reclaim();
+        flashQueue.flush();
+        failures += !rsTestReclaimReset();
+    }
+
+    // cut during the erase, the header is still there or already erased
+    for (int headerErased = 0; headerErased < 2; headerErased++) {
+        testFlash1.restorePower();
+        testFlash1.eraseAll();
+        testStore.format(&testFlash1);
+        rsTestFillSectors(0, 2);
+        testStore.remove(testStore.find(RECORD_SCIENCE, 0));
+
+        testFlashMemory1[SectorHeader::FLAGS_OFFSET] &= (uint8_t)~SectorHeader::SECTOR_FLAG_OBSOLETE;
+        memset(testFlashMemory1 + RS_TEST_SECTOR_SIZE / 2, 0xFF, RS_TEST_SECTOR_SIZE / 2);
+        if (headerErased) { memset(testFlashMemory1, 0xFF, SectorHeader::MEMSIZE); }
+        failures += !rsTestReclaimReset();
+    }
+
+    if (failures > 0) {
+        Serial.print(failures);
+        Serial.println(" reclaim power cuts inconsistent (record store)");
+        return 1;
+    }
+    return 0;
+}
+
+
+/* - - - - - - testRecordErrorMap - - - - - - *
+ * Usage:
+ * errors found in a record are counted against its sector, a sector with too many is never
+ * used for records again, and the counts survive a mount and a format
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testRecordErrorMap() {
+    testFlash1.restorePower();
+    testFlash1.eraseAll();
+    testStore.format(&testFlash1);
+
+    rsTestFillSectors(0, 2);
+    int idx = testStore.find(RECORD_SCIENCE, 1);
+    int sector = testStore.getRecord(idx).addr / RS_TEST_SECTOR_SIZE;
+    testStore.noteErrors(idx, SECTOR_RETIRE_ERRORS - 1);
+    if (testStore.isRetired(sector) || testStore.getSectorErrors(sector) != SECTOR_RETIRE_ERRORS - 1) {
+        Serial.println("Errors not counted against sector (record store)");
+        return 1;
+    }
+    testStore.noteErrors(idx, 1);
+    if (!testStore.isRetired(sector) || !testStore.saveErrorMap() || !testStore.mount(&testFlash1)
+        || !testStore.isRetired(sector) || testStore.retiredSectors() != 1) {
+        Serial.println("Error map not kept over a mount (record store)");
+        return 1;
+    }
+
+    // removed and reclaimed, the retired sector is never erased or filled again
+    testStore.remove(testStore.find(RECORD_SCIENCE, 1));
+    for (int i = 0; i < RS_TEST_SECTORS; i++) {
+        testStore.reclaim();
+        flashQueue.flush();
+    }
+    rsTestFillSectors(100, RS_TEST_SECTORS);
+    for (int i = 0; i < testStore.count(); i++) {
+        if ((int)(testStore.getRecord(i).addr / RS_TEST_SECTOR_SIZE) == sector) {
+            Serial.println("Record put in retired sector (record store)");
+            return 1;
+        }
+    }
+    if (testStore.getSector(sector).state != SECTOR_USED || testStore.getSector(sector).eraseCount != 1) {
+        Serial.println("Retired sector reclaimed (record store)");
+        return 1;
+    }
+
+    // a format empties the store but keeps the map
+    testStore.format(&testFlash1);
+    if (!testStore.isRetired(sector) || !testStore.mount(&testFlash1) || !testStore.isRetired(sector)
+        || testStore.count() != 1 || testStore.find(RECORD_ERROR_MAP, 0) < 0) {
+        Serial.println("Error map not kept over a format (record store)");
+        return 1;
+    }
+    return 0;
+}
+
+/* - - - - - - rsTestOnRead - - - - - - *
+ * Usage:
+ *  flash queue callback of a submitted read, context is a status to set
+ */
+void rsTestOnRead(void *context, bool status) {
+    *(int *)context = status ? 1 : 0;
+}
+
+/* - - - - - - testRecordShadow - - - - - - *
+ * Usage:
+ * windows written again as shadows are read in place of the record's own bytes, directly and
+ * through the flash queue, are patched in the shadow, last over a mount, and go with the record
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testRecordShadow() {
+    const uint32_t length = 1000; // last window is short
+    const uint32_t window = RecordStore::SHADOW_WINDOW;
+    static uint8_t expected[length];
+    static uint8_t actual[length];
+    testFlash1.restorePower();
+    testFlash1.eraseAll();
+    testStore.format(&testFlash1);
+    int others = testStore.count(); // the error map of the last test
+
+    rsTestFill(expected, 5, 1, length);
+    testStore.append(RECORD_SCIENCE, 5, expected, length);
+    for (uint32_t i = window; i < 2 * window; i++) { expected[i] ^= 0x55; } // bits set and cleared
+    for (uint32_t i = 3 * window; i < length; i++) { expected[i] = ~expected[i]; }
+    int idx = testStore.find(RECORD_SCIENCE, 5);
+    if (!testStore.writeShadow(idx, 1, expected + window) || !testStore.writeShadow(idx, 3, expected + 3 * window)
+        || testStore.writeShadow(idx, 4, expected) || testStore.getRecord(idx).shadows != 2
+        || !testStore.read(idx, actual, 0, length) || memcmp(actual, expected, length) != 0
+        || !testStore.read(idx, actual, 250, 300) || memcmp(actual, expected + 250, 300) != 0) {
+        Serial.println("Shadow windows not read over record (record store)");
+        return 1;
+    }
+
+    // through the flash queue
+    int readStatus = -1;
+    memset(actual, 0, length);
+    if (!testStore.submitRead(idx, actual, 200, 700, rsTestOnRead, &readStatus)) {
+        Serial.println("Read of record with shadows not queued (record store)");
+        return 1;
+    }
+    flashQueue.flush();
+    if (readStatus != 1 || memcmp(actual, expected + 200, 700) != 0) {
+        Serial.println("Shadow windows not read over queued read (record store)");
+        return 1;
+    }
+
+    // patched across the edge of a shadow, kept over a mount, replaced by a newer shadow
+    uint8_t cleared[4] = {0, 0, 0, 0};
+    memset(expected + window - 2, 0, sizeof(cleared));
+    testStore.patch(idx, window - 2, cleared, sizeof(cleared));
+    testStore.mount(&testFlash1);
+    idx = testStore.find(RECORD_SCIENCE, 5);
+    for (uint32_t i = window; i < 2 * window; i++) { expected[i] = (uint8_t)i; }
+    if (idx < 0 || testStore.getRecord(idx).shadows != 2 || !testStore.writeShadow(idx, 1, expected + window)
+        || testStore.getRecord(idx).shadows != 2 || testStore.count() != others + 3
+        || !testStore.read(idx, actual, 0, length) || memcmp(actual, expected, length) != 0) {
+        Serial.println("Shadow windows not kept over a mount (record store)");
+        return 1;
+    }
+
+    // a new record and removing the record take the shadows with them
+    rsTestFill(expected, 5, 2, length);
+    testStore.append(RECORD_SCIENCE, 5, expected, length);
+    idx = testStore.find(RECORD_SCIENCE, 5);
+    if (testStore.count() != others + 1 || testStore.getRecord(idx).shadows != 0 || !testStore.read(idx, actual, 0, length) || memcmp(actual, expected, length) != 0) {
+        Serial.println("Shadows of a replaced record not removed (record store)");
+        return 1;
+    }
+    testStore.writeShadow(idx, 0, expected);
+    testStore.remove(idx);
+    testStore.mount(&testFlash1);
+    if (testStore.count() != others) {
+        Serial.println("Shadows of a removed record not removed (record store)");
+        return 1;
+    }
+    return 0;
+}
+
+/* - - - - - - recordStoreTestMain - - - - - - *
+ * Usage:
+ * runs the record store unit tests, prints results over serial
+ *  must be kept last in file since we are not using header structure for testing
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  number of tests that failed in module
+ */
+int recordStoreTestMain() {
+    resetTestFlash(RS_TEST_SECTOR_SIZE, RS_TEST_SECTORS);
+    int testsFailed = 0; // iterator to track how many tests have failed
+
+    testsFailed += testRecordRoundTrip();
+    testsFailed += testRecordPowerCut();
+    testsFailed += testRecordCorruptHeader();
+    testsFailed += testRecordMountCost();
+    testsFailed += testRecordReclaim();
+    testsFailed += testRecordReclaimPowerCut();
+    testsFailed += testRecordErrorMap();
+    testsFailed += testRecordShadow();
+
+    // print module summary
+    Serial.print("Record Store module: ");
+    Serial.print(testsFailed);
+    Serial.println(" tests failed");
+
+    return testsFailed;
+}
@@ -0,0 +1,184 @@
+/* retentionTest.cpp tests the choice of stored science windows evicted when storage is full
+ * Usage:
+ *  part of NS2 unit testing suite
+ *  to be called in unitTestDriver.cpp
+ *
+ *  Mounts the record store on the simulated flash modules in RAM, striped, and clears the
+ *  catalog in RAM, both are restored at the end. The retention settings are restored too.
+ */
+
+
+// NS2 includes
+#include "../headers/config.hpp"
+#include "../headers/encodedSciData.hpp"
+#include "../headers/flashDevice.hpp"
+#include "../headers/recordStore.hpp"
+#include "../headers/fileCatalog.hpp"
+#include "../headers/windowCache.hpp"
+#include "../headers/retention.hpp"
+#include "testFixtures.hpp"
+
+const int RT_TEST_SECTOR_SIZE = 32768; // per module, the striped pair has four 64KB sectors, one window each
+const int RT_TEST_SECTORS = 4;
+
+// stores a window of a quality as a valid catalog file, returns its slot
+int rtTestStore(uint8_t quality) {
+    int slot = fileCatalog.allocate();
+    if (slot < 0) { return -1; }
+    fileCatalog.getEntry(slot).quality = quality;
+    fileCatalog.setState(slot, FILE_VALID);
+    recordStore.append(RECORD_SCIENCE, slot, testPages, EncodedSciData::PAGED_MEMSIZE, true);
+    return slot;
+}
+
+/* - - - - - - testRetentionChoice - - - - - - *
+ * Usage:
+ * a low quality window is evicted before a newer one and before an older high quality one,
+ * the oldest when keeping the newest, and a window whose record is lost before any other
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testRetentionChoice() {
+    WindowSummary summary;
+    summary.minSample = 1000;
+    summary.maxSample = 1000 + RETENTION_FULL_RANGE_BINS / 2;
+    uint8_t half = Retention::quality(summary);
+    summary.maxSample = 900;
+    if (half < 126 || half > 128 || Retention::quality(summary) != 0) {
+        Serial.println("Window quality incorrect (retention)");
+        return 1;
+    }
+
+    testFlash1.eraseAll();
+    testFlash2.eraseAll();
+    recordStore.format(&testFlashPair);
+    fileCatalog.clear();
+    RETENTION_QUALITY_WEIGHT = 1;
+    RETENTION_AGE_WEIGHT = 4;
+    int good = rtTestStore(200); // 200 - 2 * 4
+    int poor = rtTestStore(5);   // 5 - 1 * 4
+    int newest = rtTestStore(5); // 5
+    int32_t score = 0;
+    int newer = 0;
+
+    RETENTION_POLICY = RETAIN_SCORED;
+    int chosen = retention.pickEviction(-1, score, newer);
+    if (chosen != poor || score != 1 || newer != 1 || retention.pickEviction(poor, score, newer) != newest) {
+        Serial.println("Lowest scored window not chosen (retention)");
+        return 1;
+    }
+    RETENTION_POLICY = RETAIN_NEWEST;
+    if (retention.pickEviction(-1, score, newer) != good || newer != 2) {
+        Serial.println("Oldest window not chosen (retention)");
+        return 1;
+    }
+    recordStore.remove(recordStore.find(RECORD_SCIENCE, newest));
+    RETENTION_POLICY = RETAIN_SCORED;
+    if (retention.pickEviction(-1, score, newer) != newest || score != INT32_MIN) {
+        Serial.println("Window with a lost record not chosen first (retention)");
+        return 1;
+    }
+    fileCatalog.setState(poor, FILE_WRITING);
+    fileCatalog.release(newest);
+    if (retention.pickEviction(-1, score, newer) != good) {
+        Serial.println("Window being written chosen (retention)");
+        return 1;
+    }
+    return 0;
+}
+
+/* - - - - - - testRetentionMakeRoom - - - - - - *
+ * Usage:
+ * windows are evicted at the file quota and when the record store is full, until the next
+ * window fits, and none are evicted when the policy keeps stored windows
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testRetentionMakeRoom() {
+    testFlash1.eraseAll();
+    testFlash2.eraseAll();
+    recordStore.format(&testFlashPair);
+    fileCatalog.clear();
+    RETENTION_POLICY = RETAIN_SCORED;
+    RETENTION_QUOTA_FILES = 2;
+    int first = rtTestStore(10);
+    int second = rtTestStore(90);
+    RetentionStats before = retention.getStats();
+    if (!retention.makeRoom(-1) || fileCatalog.count() != 1 || fileCatalog.isValid(first)
+        || recordStore.find(RECORD_SCIENCE, first) >= 0 || retention.getStats().evictions != before.evictions + 1
+        || retention.getLog(0).slot != first || retention.getLog(0).quality != 10) {
+        Serial.println("Window not evicted at the quota (retention)");
+        return 1;
+    }
+
+    // one window per sector, the store is full once every sector holds one (the first also holds the error map)
+    RETENTION_QUOTA_FILES = MAXFILES;
+    while (recordStore.fits(EncodedSciData::PAGED_MEMSIZE, true)) {
+        if (rtTestStore(50) < 0) { break; }
+    }
+    int stored = fileCatalog.count();
+    RETENTION_POLICY = RETAIN_STORED;
+    if (retention.makeRoom(-1) || fileCatalog.count() != stored || retention.getStats().dropped != before.dropped + 1) {
+        Serial.println("Window evicted when stored windows are kept (retention)");
+        return 1;
+    }
+    RETENTION_POLICY = RETAIN_SCORED;
+    if (stored < 3 || !retention.makeRoom(-1) || fileCatalog.count() != stored - 1
+        || !recordStore.fits(EncodedSciData::PAGED_MEMSIZE, true) || !fileCatalog.isValid(second)) {
+        Serial.println("No room made in a full record store (retention)");
+        return 1;
+    }
+    return 0;
+}
+
+
+/* - - - - - - retentionTestMain - - - - - - *
+ * Usage:
+ * runs the retention unit tests, prints results over serial
+ *  must be kept last in file since we are not using header structure for testing
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  number of tests that failed in module
+ */
+int retentionTestMain() {
+    resetTestFlash(RT_TEST_SECTOR_SIZE, RT_TEST_SECTORS);
+    testFlashPair.setMode(STORAGE_STRIPED);
+    int testsFailed = 0; // iterator to track how many tests have failed
+    long policy = RETENTION_POLICY;
+    long quota = RETENTION_QUOTA_FILES;
+    long qualityWeight = RETENTION_QUALITY_WEIGHT;
+    long ageWeight = RETENTION_AGE_WEIGHT;
+    for (int i = 0; i < EncodedSciData::PAGED_MEMSIZE; i++) { testPages[i] = (uint8_t)(i * 7); }
+
+    testsFailed += testRetentionChoice();
+    testsFailed += testRetentionMakeRoom();
+
+    // give back the flight record store, catalog and settings
+    RETENTION_POLICY = policy;
+    RETENTION_QUOTA_FILES = quota;
+    RETENTION_QUALITY_WEIGHT = qualityWeight;
+    RETENTION_AGE_WEIGHT = ageWeight;
+    windowCache.clear();
+    initRecordStore();
+    fileCatalog.load();
+
+    // print module summary
+    Serial.print("Retention module: ");
+    Serial.print(testsFailed);
+    Serial.println(" tests failed");
+
+    return testsFailed;
+}
@@ -0,0 +1,595 @@
+/* scrubberTest.cpp tests the chunked flash scrub
+ * Usage:
+ *  part of NS2 unit testing suite
+ *  to be called in unitTestDriver.cpp
+ *
+ *  Mounts the record store on simulated flash modules in RAM and adds a science file to the
+ *  catalog, both are restored at the end with the scrub settings. Bits are upset directly in the simulated memory, a
+ *  programmed bit losing its charge reads as a 1.
+ */
+
+
+// NS2 includes
+#include "../headers/config.hpp"
+#include "../headers/encodedSciData.hpp"
+#include "../headers/flashDevice.hpp"
+#include "../headers/flashQueue.hpp"
+#include "../headers/recordStore.hpp"
+#include "../headers/fileCatalog.hpp"
+#include "../headers/scrubber.hpp"
+#include "../headers/faultManager.hpp"
+#include "../headers/windowCache.hpp"
+#include "testFixtures.hpp"
+
+const int SC_TEST_SECTOR_SIZE = 65536;
+const int SC_TEST_SECTORS = 2;
+static int scTestSlot = -1;
+
+/* - - - - - - scTestSetup - - - - - - *
+ * Usage:
+ *  formats the record store on device and stores an encoded science file in a catalog slot,
+ *  with no files left to scrub first from an earlier test
+ */
+bool scTestSetup(FlashDevice *device) {
+    flashQueue.flush();
+    testFlash1.restorePower();
+    testFlash1.eraseAll();
+    testFlash2.eraseAll();
+    recordStore.format(device);
+    recordStore.clearErrorMap(); // upsets of earlier tests do not retire sectors
+    payloadData.scrubPriorityCount = 0;
+
+    uint16_t *buffer = (uint16_t *)testReadBack;
+    for (int i = 0; i < BUFFERSIZE; i++) { buffer[i] = (uint16_t)(i * 29 + 5); }
+    unsigned long timestamp = 4321;
+    testSciFile.encodeData(buffer, timestamp);
+    testSciFile.toPages(testPages); // the stored test file, before any upset
+
+    if (scTestSlot < 0) { scTestSlot = fileCatalog.allocate(); }
+    if (scTestSlot < 0) { return false; }
+    fileCatalog.setState(scTestSlot, FILE_VALID);
+    return recordStore.append(RECORD_SCIENCE, scTestSlot, testPages, EncodedSciData::PAGED_MEMSIZE, true);
+}
+
+/* - - - - - - scTestUnpage - - - - - - *
+ * Usage:
+ *  copies the stored test file out of testPages without its page CRCs, dst may be testPages itself
+ *  since every byte moves down or stays
+ */
+void scTestUnpage(uint8_t *dst) {
+    for (int i = 0; i < EncodedSciData::MEMSIZE; i++) { dst[i] = testPages[EncodedSciData::pagedOffset(i)]; }
+}
+
+/* - - - - - - scTestUpset - - - - - - *
+ * Usage:
+ *  flips a stored bit of block blockNum, from startBit on, that is 0 in the file if chargeLoss is
+ *  set and 1 otherwise, in the test file or the copy of it in slot. returns the bit flipped, -1 if none
+ */
+int scTestUpset(uint8_t *memory, int blockNum, int startBit, bool chargeLoss, int slot = -1) {
+    if (slot < 0) { slot = scTestSlot; }
+    RecordInfo info = recordStore.getRecord(recordStore.find(RECORD_SCIENCE, slot));
+    for (int bit = startBit; bit < EncodedSciData::ROW_COUNT; bit++) {
+        int bitIdx = blockNum + bit * EncodedSciData::MESSAGE_COUNT;
+        int byteOffset = EncodedSciData::pagedOffset(bitIdx / 8);
+        if (checkBit(testPages + byteOffset, bitIdx % 8) == chargeLoss) { continue; }
+        uint32_t addr = info.addr + RecordStore::payloadOffset(true) + byteOffset;
+        memory[addr] ^= 1 << (bitIdx % 8);
+        return bit;
+    }
+    return -1;
+}
+
+/* - - - - - - scTestRun - - - - - - *
+ * Usage:
+ *  steps scrubber until the scrub is done or maxSteps are taken, returns the first status
+ *  other than SCRUB_RUNNING
+ */
+ScrubStatus scTestRun(Scrubber &scrubber, int maxSteps) {
+    for (int i = 0; i < maxSteps; i++) {
+        ScrubStatus status = scrubber.step();
+        if (status != SCRUB_RUNNING) { return status; }
+    }
+    return SCRUB_RUNNING;
+}
+
+/* - - - - - - scTestStored - - - - - - *
+ * Usage:
+ *  whether the stored file matches what was written
+ */
+bool scTestStored() {
+    int idx = recordStore.find(RECORD_SCIENCE, scTestSlot);
+    return recordStore.read(idx, testReadBack, 0, EncodedSciData::PAGED_MEMSIZE)
+        && memcmp(testReadBack, testPages, EncodedSciData::PAGED_MEMSIZE) == 0;
+}
+
+/* - - - - - - testChunkScrub - - - - - - *
+ * Usage:
+ * scrubbing the file a run of columns at a time gives the same data and report as scrubbing it whole
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testChunkScrub() {
+    const int rows = EncodedSciData::ROW_COUNT;
+    const int rowBytes = EncodedSciData::ROW_BYTES;
+    uint8_t *data = testReadBack;
+    uint8_t *mirror = testPages; // set up again by the next test
+    EncodedSciData &whole = testSciFile;
+    scTestSetup(&testFlash1);
+    scTestUnpage(data);
+    scTestUnpage(mirror);
+
+    // single errors, a double error, and a double error the mirror copy does not share
+    int blocks[] = {0, 7, 8, 1000, EncodedSciData::MESSAGE_COUNT - 1};
+    for (int i = 0; i < 5; i++) { flipBit(data, blocks[i] + (i * 11) * EncodedSciData::MESSAGE_COUNT); }
+    flipBit(data, 500 + 3 * EncodedSciData::MESSAGE_COUNT);
+    flipBit(data, 500 + 40 * EncodedSciData::MESSAGE_COUNT);
+    flipBit(data, 2000 + 5 * EncodedSciData::MESSAGE_COUNT);
+    flipBit(data, 2000 + 60 * EncodedSciData::MESSAGE_COUNT);
+    flipBit(mirror, 500 + 3 * EncodedSciData::MESSAGE_COUNT);
+    flipBit(mirror, 500 + 9 * EncodedSciData::MESSAGE_COUNT);
+
+    whole.fill(data);
+    ScrubReport wholeReport = whole.scrub(mirror);
+
+    ScrubReport chunkReport;
+    uint8_t chunk[Scrubber::BUFFER_MEMSIZE];
+    uint8_t mirrorChunk[Scrubber::BUFFER_MEMSIZE];
+    for (int column = 0; column < rowBytes; column += SCRUB_CHUNK_COLUMNS) {
+        int columns = min(SCRUB_CHUNK_COLUMNS, rowBytes - column);
+        for (int row = 0; row < rows; row++) {
+            memcpy(chunk + row * columns, data + row * rowBytes + column, columns);
+            memcpy(mirrorChunk + row * columns, mirror + row * rowBytes + column, columns);
+        }
+        ScrubReport report = EncodedSciData::scrubChunk(chunk, columns, mirrorChunk);
+        for (int row = 0; row < rows; row++) {
+            memcpy(data + row * rowBytes + column, chunk + row * columns, columns);
+        }
+        chunkReport.numErrors += report.numErrors;
+        chunkReport.corrected += report.corrected;
+        chunkReport.uncorrected += report.uncorrected;
+        chunkReport.repaired += report.repaired;
+    }
+
+    if (chunkReport.numErrors != wholeReport.numErrors || chunkReport.corrected != wholeReport.corrected
+        || chunkReport.uncorrected != wholeReport.uncorrected || chunkReport.repaired != wholeReport.repaired
+        || wholeReport.corrected != 5 || wholeReport.repaired != 1 || wholeReport.uncorrected != 1
+        || memcmp(data, whole.getData(), EncodedSciData::MEMSIZE) != 0) {
+        Serial.println("Chunked scrub differs from whole file scrub (scrubber)");
+        return 1;
+    }
+    return 0;
+}
+
+/* - - - - - - testScrubInPlace - - - - - - *
+ * Usage:
+ * bits that lost their charge are corrected by programming only the bytes holding them, a
+ * clean file is not decoded, and a correction that sets a bit writes only its page again, as a
+ * shadow that reads of the file and a later mount see
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testScrubInPlace() {
+    static Scrubber testScrubber;
+
+    // clean
+    scTestSetup(&testFlash1);
+    testScrubber.start();
+    if (scTestRun(testScrubber, 100000) != SCRUB_DONE || testScrubber.getStats().cleanFiles != 1
+        || testScrubber.getReport().numErrors != 0 || testScrubber.getStats().patches != 0) {
+        Serial.println("Clean file not passed on its checksums (scrubber)");
+        return 1;
+    }
+
+    // three upsets in different pages
+    scTestUpset(testFlashMemory1, 10, 0, true);
+    scTestUpset(testFlashMemory1, 3000, 20, true);
+    scTestUpset(testFlashMemory1, 6000, 50, true);
+    uint32_t programs = testFlash1.getPagePrograms();
+    testScrubber.start();
+    ScrubStatus status = scTestRun(testScrubber, 100000);
+    ScrubStats stats = testScrubber.getStats();
+    ScrubReport report = testScrubber.getReport();
+    if (status != SCRUB_DONE || report.corrected != 3 || report.badPages != 3 || stats.patchedBytes != 3
+        || stats.patches != 3 || testFlash1.getPagePrograms() - programs != 3 || !scTestStored()) {
+        Serial.println("Upsets not corrected in place (scrubber)");
+        return 1;
+    }
+
+    // a bit that has to be set cannot be programmed, a shadow header, page and commit are
+    scTestUpset(testFlashMemory1, 4000, 0, false);
+    programs = testFlash1.getPagePrograms();
+    testScrubber.start();
+    status = scTestRun(testScrubber, 100000);
+    stats = testScrubber.getStats();
+    if (status != SCRUB_DONE || testScrubber.getReport().corrected != 1 || stats.shadowWindows != 1
+        || testFlash1.getPagePrograms() - programs > 3 || !scTestStored()) {
+        Serial.println("Correction setting a bit not written as a shadow page (scrubber)");
+        return 1;
+    }
+    recordStore.mount(&testFlash1);
+    testScrubber.start();
+    if (!scTestStored() || scTestRun(testScrubber, 100000) != SCRUB_DONE || testScrubber.getStats().cleanFiles != 1) {
+        Serial.println("Shadow page lost on mount (scrubber)");
+        return 1;
+    }
+    return 0;
+}
+
+/* - - - - - - testScrubShadowPowerCut - - - - - - *
+ * Usage:
+ * power lost at any byte of writing a shadow page leaves the file either repaired or as it was,
+ * still correctable by the next scrub
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testScrubShadowPowerCut() {
+    static Scrubber testScrubber;
+    // shadow header, its page of payload and its commit marker
+    const uint32_t shadowBytes = RecordHeader::MEMSIZE + RecordStore::SHADOW_WINDOW + RECORD_COMMIT_MEMSIZE;
+    const uint32_t cuts[] = {0, 5, RecordHeader::MEMSIZE, RecordHeader::MEMSIZE + 100, shadowBytes - 2, shadowBytes - 1, shadowBytes};
+    int repaired = 0;
+
+    for (uint32_t cut : cuts) {
+        scTestSetup(&testFlash1);
+        scTestUpset(testFlashMemory1, 3210, 0, false);
+        testFlash1.cutPowerAfter(cut);
+        testScrubber.start();
+        scTestRun(testScrubber, 100000);
+        testScrubber.stop();
+        bool cutShort = !testFlash1.isPowered();
+
+        // reset, the store is mounted again
+        testFlash1.restorePower();
+        recordStore.mount(&testFlash1);
+        if (scTestStored()) {
+            repaired++;
+            if (cutShort) {
+                Serial.println("Shadow page cut short taken as a repair (scrubber)");
+                return 1;
+            }
+            continue;
+        }
+        testScrubber.start();
+        if (scTestRun(testScrubber, 100000) != SCRUB_DONE || testScrubber.getReport().corrected != 1 || !scTestStored()) {
+            Serial.println("File not correctable after power lost writing a shadow page (scrubber)");
+            return 1;
+        }
+    }
+    if (repaired != 1) {
+        Serial.println("Completed shadow page not kept (scrubber)");
+        return 1;
+    }
+    return 0;
+}
+
+/* - - - - - - testScrubMirror - - - - - - *
+ * Usage:
+ * with mirrored storage a block too corrupted to correct is taken from the other module
+ * and programmed in place
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testScrubMirror() {
+    static Scrubber testScrubber;
+    testFlashPair.setMode(STORAGE_MIRRORED);
+    scTestSetup(&testFlashPair);
+
+    int bit = scTestUpset(testFlashMemory1, 1234, 0, true);
+    scTestUpset(testFlashMemory1, 1234, bit + 1, true);
+    testScrubber.start();
+    ScrubStatus status = scTestRun(testScrubber, 100000);
+    if (status != SCRUB_DONE || testScrubber.getReport().repaired != 1 || testScrubber.getReport().uncorrected != 0
+        || testScrubber.getStats().shadowWindows != 0 || !scTestStored()) {
+        Serial.println("Block not repaired from mirror (scrubber)");
+        return 1;
+    }
+    return 0;
+}
+
+/* - - - - - - testScrubFromCache - - - - - - *
+ * Usage:
+ * on a single module a block too corrupted to correct is taken from the copy of the file in the
+ * window cache
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testScrubFromCache() {
+    static Scrubber testScrubber;
+    scTestSetup(&testFlash1);
+    int recordIdx = recordStore.find(RECORD_SCIENCE, scTestSlot);
+    windowCache.put(scTestSlot, recordStore.getRecord(recordIdx).seq, testPages, WindowSummary());
+
+    int bit = scTestUpset(testFlashMemory1, 4321, 0, true);
+    scTestUpset(testFlashMemory1, 4321, bit + 1, true);
+    testScrubber.start();
+    ScrubStatus status = scTestRun(testScrubber, 100000);
+    windowCache.clear();
+    if (status != SCRUB_DONE || testScrubber.getReport().repaired != 1 || testScrubber.getReport().uncorrected != 0
+        || !scTestStored()) {
+        Serial.println("Block not repaired from window cache (scrubber)");
+        return 1;
+    }
+    return 0;
+}
+
+/* - - - - - - testScrubResume - - - - - - *
+ * Usage:
+ * a scrub reset part way through a file carries on from the saved cursor, or starts the file
+ * again if a page had failed its checksum
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testScrubResume() {
+    static Scrubber beforeReset;
+    static Scrubber afterReset;
+    int checkSteps = (EncodedSciData::PAGE_COUNT + SCRUB_CHECK_PAGES - 1) / SCRUB_CHECK_PAGES;
+
+    // clean file
+    scTestSetup(&testFlash1);
+    beforeReset.start();
+    scTestRun(beforeReset, SCRUB_SAVE_STEPS + 5);
+    if (!afterReset.resume() || afterReset.currentSlot() != scTestSlot
+        || afterReset.getCursor().pos != SCRUB_SAVE_STEPS * SCRUB_CHECK_PAGES) {
+        Serial.println("Scrub cursor not saved (scrubber)");
+        return 1;
+    }
+    if (scTestRun(afterReset, 100000) != SCRUB_DONE || afterReset.getStats().cleanFiles != 1
+        || afterReset.getStats().steps > (uint32_t)(checkSteps - SCRUB_SAVE_STEPS + 1)) {
+        Serial.println("Scrub not resumed from cursor (scrubber)");
+        return 1;
+    }
+
+    // a bad page before the reset
+    scTestUpset(testFlashMemory1, 8, 0, true);
+    beforeReset.start();
+    scTestRun(beforeReset, SCRUB_SAVE_STEPS + 5);
+    if (!afterReset.resume() || afterReset.getCursor().pos != 0 || scTestRun(afterReset, 100000) != SCRUB_DONE
+        || afterReset.getReport().corrected != 1 || !scTestStored()) {
+        Serial.println("File with a bad page not scrubbed again after reset (scrubber)");
+        return 1;
+    }
+    if (afterReset.isActive() || afterReset.resume()) {
+        Serial.println("Finished scrub resumed (scrubber)");
+        return 1;
+    }
+    return 0;
+}
+
+/* - - - - - - testScrubPriority - - - - - - *
+ * Usage:
+ * a pass covers every stored byte once, and a file that showed errors is scrubbed first in the
+ * next pass and not again in the walk of the slots
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testScrubPriority() {
+    static Scrubber testScrubber;
+    scTestSetup(&testFlash1);
+    int otherSlot = fileCatalog.allocate();
+    if (otherSlot < 0) {
+        Serial.println("No second catalog slot (scrubber)");
+        return 1;
+    }
+    fileCatalog.setState(otherSlot, FILE_VALID);
+    recordStore.append(RECORD_SCIENCE, otherSlot, testPages, EncodedSciData::PAGED_MEMSIZE, true);
+    int laterSlot = max(scTestSlot, otherSlot);
+    int failed = 0;
+
+    // errors in the later file only
+    scTestUpset(testFlashMemory1, 2500, 0, true, laterSlot);
+    int passes = testScrubber.getPasses();
+    testScrubber.start();
+    scTestRun(testScrubber, 100000);
+    ScrubStats stats = testScrubber.getLastStats();
+    if (testScrubber.getPasses() != passes + 1 || stats.storedBytes != 2 * (uint32_t)EncodedSciData::PAGED_MEMSIZE
+        || stats.coveredBytes != stats.storedBytes || payloadData.scrubPriorityCount != 1
+        || payloadData.scrubPriority[0] != laterSlot) {
+        Serial.println("Scrub pass not covered or file with errors not kept (scrubber)");
+        failed = 1;
+    }
+
+    // scrubbed first, once
+    scTestUpset(testFlashMemory1, 4500, 0, true, laterSlot);
+    testScrubber.start();
+    int firstSlot = testScrubber.currentSlot();
+    scTestRun(testScrubber, 100000);
+    stats = testScrubber.getLastStats();
+    if (!failed && (testScrubber.priorityCount() != 1 || firstSlot != laterSlot || stats.files != 2
+        || stats.coveredBytes != stats.storedBytes || testScrubber.getLastReport().corrected != 1)) {
+        Serial.println("File with errors not scrubbed first (scrubber)");
+        failed = 1;
+    }
+
+    // a clean pass empties the list
+    testScrubber.start();
+    scTestRun(testScrubber, 100000);
+    if (!failed && payloadData.scrubPriorityCount != 0) {
+        Serial.println("Clean file kept to scrub first (scrubber)");
+        failed = 1;
+    }
+    fileCatalog.release(otherSlot);
+    return failed;
+}
+
+/* - - - - - - testBackgroundScrub - - - - - - *
+ * Usage:
+ * a commanded scrub runs to the end through handleScrub() without the rate limit, and the
+ * rate paces a pass over the stored bytes in the set hours
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testBackgroundScrub() {
+    long savedRate = SCRUB_BYTES_PER_SEC;
+    long savedHours = SCRUB_PASS_HOURS;
+    bool savedAuto = AUTO_SCRUB;
+    int failed = 0;
+
+    SCRUB_BYTES_PER_SEC = 0;
+    SCRUB_PASS_HOURS = 2;
+    if (scrubRate(7200 * 100) != 101 || scrubRate(0) != 1) {
+        Serial.println("Scrub rate not paced by hours per pass (scrubber)");
+        failed = 1;
+    }
+    SCRUB_BYTES_PER_SEC = 500;
+    if (!failed && scrubRate(7200 * 100) != 500) {
+        Serial.println("Scrub rate not set in bytes/s (scrubber)");
+        failed = 1;
+    }
+
+    SCRUB_BYTES_PER_SEC = 1; // a commanded pass is not held to it
+    AUTO_SCRUB = false;
+    scTestSetup(&testFlash1);
+    scTestUpset(testFlashMemory1, 77, 0, true);
+    int passes = scrubber.getPasses();
+    scrubEvent.invoke();
+    dataProcessEvent.start();
+    for (int i = 0; i < 100000; i++) {
+        dataProcessEvent.checkInvoked(); // samples are taken as they come due, the scrub keeps clear of them
+        handleScrub();
+        if (!scrubber.isActive()) { break; }
+    }
+    if (!failed && (scrubber.getPasses() != passes + 1 || scrubber.getLastReport().corrected != 1 || !scTestStored())) {
+        Serial.println("Commanded scrub not run by background scrub (scrubber)");
+        failed = 1;
+    }
+
+    SCRUB_BYTES_PER_SEC = savedRate;
+    SCRUB_PASS_HOURS = savedHours;
+    AUTO_SCRUB = savedAuto;
+    return failed;
+}
+
+/* - - - - - - testScrubCost - - - - - - *
+ * Usage:
+ * measures the RAM, longest step and repair writes of the chunked scrub against decoding and
+ * rewriting the whole file
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testScrubCost() {
+    static Scrubber testScrubber;
+    EncodedSciData &whole = testSciFile;
+    scTestSetup(&testFlash1);
+    for (int i = 0; i < 8; i++) { scTestUpset(testFlashMemory1, i * 797, i * 9, true); }
+
+    testScrubber.start();
+    scTestRun(testScrubber, 100000);
+    ScrubStats stats = testScrubber.getStats();
+
+    // whole file: read, decode, scrub and write again
+    scTestUnpage(testReadBack);
+    uint32_t startMicros = micros();
+    whole.fill(testReadBack);
+    whole.scrub();
+    whole.toPages(testReadBack);
+    uint32_t wholeMicros = micros() - startMicros;
+    uint32_t wholeRam = sizeof(EncodedSciData) + EncodedSciData::PAGED_MEMSIZE;
+
+    Serial.print("Scrubber: ");
+    Serial.print(sizeof(Scrubber));
+    Serial.print(" bytes RAM, ");
+    Serial.print(stats.maxStepMicros);
+    Serial.print(" us longest of ");
+    Serial.print(stats.steps);
+    Serial.print(" steps, ");
+    Serial.print(stats.patchedBytes);
+    Serial.print(" bytes programmed; whole file ");
+    Serial.print(wholeRam);
+    Serial.print(" bytes RAM, ");
+    Serial.print(wholeMicros);
+    Serial.print(" us, ");
+    Serial.print(EncodedSciData::PAGED_MEMSIZE);
+    Serial.println(" bytes programmed");
+
+    if (testScrubber.getReport().corrected != 8 || stats.patchedBytes != 8 || sizeof(Scrubber) * 20 > wholeRam) {
+        Serial.println("Chunked scrub not bounded (scrubber)");
+        return 1;
+    }
+    return 0;
+}
+
+
+/* - - - - - - scrubberTestMain - - - - - - *
+ * Usage:
+ * runs the scrubber unit tests, prints results over serial
+ *  must be kept last in file since we are not using header structure for testing
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  number of tests that failed in module
+ */
+int scrubberTestMain() {
+    resetTestFlash(SC_TEST_SECTOR_SIZE, SC_TEST_SECTORS);
+    int testsFailed = 0; // iterator to track how many tests have failed
+
+    testsFailed += testChunkScrub();
+    testsFailed += testScrubInPlace();
+    testsFailed += testScrubShadowPowerCut();
+    testsFailed += testScrubMirror();
+    testsFailed += testScrubFromCache();
+    testsFailed += testScrubResume();
+    testsFailed += testScrubPriority();
+    testsFailed += testBackgroundScrub();
+    testsFailed += testScrubCost();
+
+    // give back the catalog slot and the flight record store
+    if (scTestSlot >= 0) { fileCatalog.release(scTestSlot); }
+    payloadData.scrubPriorityCount = 0;
+    saveEEPROM();
+    initRecordStore();
+    fileCatalog.load();
+
+    // print module summary
+    Serial.print("Scrubber module: ");
+    Serial.print(testsFailed);
+    Serial.println(" tests failed");
+
+    return testsFailed;
+}
@@ -0,0 +1,185 @@
+/* spiBusTest.cpp tests the SPI bus arbiter
+ * Usage:
+ *  part of NS2 unit testing suite
+ *  to be called in unitTestDriver.cpp
+ *
+ *  Uses its own bus with a stand-in ADC and a simulated flash module in RAM, the flight bus
+ *  is not touched.
+ */
+
+
+// NS2 includes
+#include "../headers/config.hpp"
+#include "../headers/flashDevice.hpp"
+#include "../headers/spiBus.hpp"
+#include "testFixtures.hpp"
+
+const int SB_TEST_SECTOR_SIZE = 4096;
+const int SB_TEST_SECTORS = 4;
+static SimAdcPort sbTestAdc;
+static SpiBus sbTestBus(&sbTestAdc);
+
+// a sample comes due once the bus has asked sbTestDueAfter times
+static int sbTestChecks = 0;
+static int sbTestDueAfter = 0;
+static uint32_t sbTestDueMicros = 0;
+bool sbTestSlotCheck(uint32_t &dueMicros) {
+    sbTestChecks++;
+    if (sbTestDueAfter == 0 || sbTestChecks < sbTestDueAfter) { return false; }
+    if (sbTestChecks == sbTestDueAfter) { sbTestDueMicros = micros(); }
+    dueMicros = sbTestDueMicros;
+    return true;
+}
+
+/* - - - - - - testSpiBusChunks - - - - - - *
+ * Usage:
+ * flash transfers are split into chunks aligned to SPI_FLASH_CHUNK, so programs stay whole
+ * pages, and the data is unchanged
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testSpiBusChunks() {
+    uint8_t *data = testPages;
+    uint8_t *readBack = testReadBack;
+    BusFlashDevice device(&testFlash1, &sbTestBus, SPI_DEVICE_FLASH1);
+    testFlash1.eraseAll();
+    sbTestBus.resetStats();
+    sbTestBus.setAdcSlot(nullptr);
+    for (int i = 0; i < 3000; i++) { data[i] = (uint8_t)(i * 13 + 1); }
+
+    // 156 bytes to the first boundary, 11 whole chunks, 92 bytes
+    uint32_t partial = testFlash1.getPartialPrograms();
+    if (!device.program(100, data, 3000) || !device.read(100, readBack, 3000) || memcmp(data, readBack, 3000) != 0) {
+        Serial.println("Data changed by chunked transfers (spi bus)");
+        return 1;
+    }
+    SpiBusStats stats = sbTestBus.getStats();
+    if (stats.flashChunks != 2 * 13 || stats.flashBytes != 2 * 3000 || testFlash1.getPartialPrograms() - partial != 2) {
+        Serial.println("Transfers not split into aligned chunks (spi bus)");
+        return 1;
+    }
+
+    // a sample waits at most one chunk and an ADC read for the bus
+    uint32_t chunkNanos = (SPI_FLASH_CHUNK + SimFlashDevice::COMMAND_BYTES) * SimFlashDevice::BYTE_NANOS;
+    uint32_t adcNanos = 16 * 1000000000UL / ADC_MAX_SPEED;
+    if ((chunkNanos + adcNanos) / 1000 > SPI_ADC_LATENCY_BOUND_MICROS) {
+        Serial.println("Chunk too long for the latency bound (spi bus)");
+        return 1;
+    }
+    return 0;
+}
+
+/* - - - - - - testSpiBusPriority - - - - - - *
+ * Usage:
+ * a polled sample that comes due during a long flash read is read before the next chunk and
+ * held for the loop, within the latency bound, and only one is held
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testSpiBusPriority() {
+    const uint32_t length = SB_TEST_SECTOR_SIZE * 2; // read into testReadBack
+    BusFlashDevice device(&testFlash1, &sbTestBus, SPI_DEVICE_FLASH1);
+    sbTestBus.resetStats();
+    sbTestBus.setAdcSlot(sbTestSlotCheck);
+    sbTestAdc.setValue(1234);
+    uint32_t reads = sbTestAdc.getReads();
+    sbTestChecks = 0;
+    sbTestDueAfter = 5; // due during the fifth chunk
+
+    if (!device.read(0, testReadBack, length) || !sbTestBus.isHolding() || sbTestAdc.getReads() != reads + 1) {
+        Serial.println("Due sample not read between flash chunks (spi bus)");
+        return 1;
+    }
+    SpiBusStats stats = sbTestBus.getStats();
+    if (stats.heldSamples != 1 || stats.adcReads != 1 || stats.lateSamples != 0
+        || stats.maxLatencyMicros > SPI_ADC_LATENCY_BOUND_MICROS || stats.flashChunks != length / SPI_FLASH_CHUNK) {
+        Serial.println("Due sample not read within the latency bound (spi bus)");
+        return 1;
+    }
+
+    // the loop takes the held sample, then reads its own
+    uint32_t sampleMicros = 0;
+    sbTestDueAfter = 0;
+    sbTestAdc.setValue(4321);
+    uint16_t held = sbTestBus.takeAdcSample(sbTestDueMicros, sampleMicros);
+    if (held != 1234 || sampleMicros < sbTestDueMicros || sbTestBus.isHolding() || sbTestAdc.getReads() != reads + 1
+        || sbTestBus.takeAdcSample(micros(), sampleMicros) != 4321 || sbTestAdc.getReads() != reads + 2) {
+        Serial.println("Held sample not taken by the loop (spi bus)");
+        return 1;
+    }
+    sbTestBus.setAdcSlot(nullptr);
+    return 0;
+}
+
+/* - - - - - - testSpiBusStats - - - - - - *
+ * Usage:
+ * latencies land in their power of two bucket, late samples are counted, bus time is kept
+ * by device and the utilization never passes 100%
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testSpiBusStats() {
+    sbTestBus.resetStats();
+    sbTestBus.readAdc(micros() + 1000); // not due yet, no latency
+    sbTestBus.readAdc(micros() - 300);
+    sbTestBus.noteFlash(SPI_DEVICE_FLASH2, 256, 70);
+    delay(1); // the 70 us noted above must fit in the time elapsed
+    SpiBusStats stats = sbTestBus.getStats();
+    if (stats.latency[0] != 1 || stats.latency[9] != 1 || stats.lateSamples != 1 || stats.maxLatencyMicros < 300
+        || stats.busyMicros[SPI_DEVICE_FLASH2] != 70 || stats.busyMicros[SPI_DEVICE_FLASH1] != 0
+        || stats.flashBytes != 256 || sbTestBus.utilization() < 0 || sbTestBus.utilization() > 1) {
+        Serial.println("Bus statistics incorrect (spi bus)");
+        return 1;
+    }
+
+    // more busy time than has passed, as counted twice by a burst sample inside a polled one
+    sbTestBus.noteFlash(SPI_DEVICE_FLASH1, 0, 10000000);
+    if (sbTestBus.utilization() != 1.0F) {
+        Serial.println("Bus utilization not clamped to 100% (spi bus)");
+        return 1;
+    }
+    return 0;
+}
+
+
+/* - - - - - - spiBusTestMain - - - - - - *
+ * Usage:
+ * runs the SPI bus unit tests, prints results over serial
+ *  must be kept last in file since we are not using header structure for testing
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  number of tests that failed in module
+ */
+int spiBusTestMain() {
+    resetTestFlash(SB_TEST_SECTOR_SIZE, SB_TEST_SECTORS);
+    int testsFailed = 0; // iterator to track how many tests have failed
+
+    testsFailed += testSpiBusChunks();
+    testsFailed += testSpiBusPriority();
+    testsFailed += testSpiBusStats();
+
+    // print module summary
+    Serial.print("SPI Bus module: ");
+    Serial.print(testsFailed);
+    Serial.println(" tests failed");
+
+    return testsFailed;
+}
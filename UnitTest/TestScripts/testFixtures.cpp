@@ -0,0 +1,52 @@
+/* testFixtures.cpp holds the fixtures shared by the test scripts
+ * Usage:
+ *  part of NS2 unit testing suite
+ *  test scripts include testFixtures.hpp and call resetTestFlash() before using the simulated
+ *  flash modules, a test that needs other sectors than TEST_FLASH_SECTOR_SIZE passes its own
+ *
+ */
+
+
+// NS2 includes
+#include "testFixtures.hpp"
+#include "../headers/flashQueue.hpp"
+
+DMAMEM uint8_t testFlashMemory1[TEST_FLASH_MEMSIZE]; // second RAM bank, with the window cache
+DMAMEM uint8_t testFlashMemory2[TEST_FLASH_MEMSIZE];
+SimFlashDevice testFlash1(testFlashMemory1, TEST_FLASH_SECTOR_SIZE, TEST_FLASH_SECTORS);
+SimFlashDevice testFlash2(testFlashMemory2, TEST_FLASH_SECTOR_SIZE, TEST_FLASH_SECTORS);
+DualFlashDevice testFlashPair(&testFlash1, &testFlash2);
+EncodedSciData testSciFile;
+alignas(4) uint8_t testPages[EncodedSciData::PAGED_MEMSIZE]; // aligned so tests can keep sample arrays in them
+alignas(4) uint8_t testReadBack[EncodedSciData::PAGED_MEMSIZE];
+uint16_t testRing[BUFFERSIZE];
+int16_t testRingAttitude[BUFFERSIZE];
+uint8_t testRingCodes[RATE_CODE_MEMSIZE];
+RecordStore testStore;
+
+/* - - - - - - resetTestFlash - - - - - - *
+ * Usage:
+ *  lays both simulated modules out in sectorCount sectors of sectorSize bytes, erases them and
+ *  clears power cuts, failures and counters left by an earlier test, after the flash queue has
+ *  finished the work that test left in it. The pair is mirrored and testStore unmounted.
+ *
+ * Inputs:
+ *  sectorSize - bytes per sector
+ *  sectorCount - sectors per module, sectorSize * sectorCount must fit in TEST_FLASH_MEMSIZE
+ *
+ * Outputs:
+ *  none
+ */
+void resetTestFlash(uint32_t sectorSize, int sectorCount) {
+    if (sectorSize * sectorCount > TEST_FLASH_MEMSIZE) {
+        Serial.println("Test flash layout too large (test fixtures)");
+        sectorCount = TEST_FLASH_MEMSIZE / sectorSize;
+    }
+    flashQueue.flush();
+    testFlash1.reset(sectorSize, sectorCount);
+    testFlash2.reset(sectorSize, sectorCount);
+    testFlash1.eraseAll();
+    testFlash2.eraseAll();
+    testFlashPair.setMode(STORAGE_MIRRORED);
+    testStore = RecordStore(); // drops the error map an earlier test left
+}
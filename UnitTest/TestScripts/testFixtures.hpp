@@ -0,0 +1,38 @@
+#ifndef TEST_FIXTURES_H
+#define TEST_FIXTURES_H
+
+/* - - - - - - Includes - - - - - - */
+// C++ libraries
+
+// Other libraries
+
+// NS2 headers
+#include "../headers/config.hpp"
+#include "../headers/flashDevice.hpp"
+#include "../headers/encodedSciData.hpp"
+#include "../headers/recordStore.hpp"
+
+/* - - - - - - Test Fixtures - - - - - - */
+// shared by every test script so the suite holds one copy of each, see testFixtures.cpp
+
+const uint32_t TEST_FLASH_MEMSIZE = 131072;   // bytes of each simulated flash module, two 64KB sectors
+const uint32_t TEST_FLASH_SECTOR_SIZE = 4096; // bytes, sector size unless a test needs whole science records in a sector
+const int TEST_FLASH_SECTORS = TEST_FLASH_MEMSIZE / TEST_FLASH_SECTOR_SIZE;
+
+extern uint8_t testFlashMemory1[TEST_FLASH_MEMSIZE]; // memory of module 1, for tests that corrupt it directly
+extern uint8_t testFlashMemory2[TEST_FLASH_MEMSIZE];
+extern SimFlashDevice testFlash1;       // simulated flash module 1
+extern SimFlashDevice testFlash2;       // simulated flash module 2
+extern DualFlashDevice testFlashPair;   // both simulated modules, mirrored after resetTestFlash()
+extern EncodedSciData testSciFile;      // scratch science file, copy out anything that must outlive the next use
+extern uint8_t testPages[EncodedSciData::PAGED_MEMSIZE];    // scratch paged science file
+extern uint8_t testReadBack[EncodedSciData::PAGED_MEMSIZE]; // scratch paged science file, read back or corrupted
+extern uint16_t testRing[BUFFERSIZE];             // ring buffers of a window being recorded
+extern int16_t testRingAttitude[BUFFERSIZE];
+extern uint8_t testRingCodes[RATE_CODE_MEMSIZE];
+extern RecordStore testStore;                     // record store apart from the flight one, format it before use
+
+/* - - - - - - Declarations - - - - - - */
+void resetTestFlash(uint32_t sectorSize = TEST_FLASH_SECTOR_SIZE, int sectorCount = TEST_FLASH_SECTORS);
+
+#endif
@@ -0,0 +1,179 @@
+/* windowCacheTest.cpp tests the RAM cache of recently written science windows
+ * Usage:
+ *  part of NS2 unit testing suite
+ *  to be called in unitTestDriver.cpp
+ *
+ *  Mounts the record store on a simulated flash module in RAM and adds a science file to the
+ *  catalog, both are restored at the end. Flash read time is the simulated bus time.
+ */
+
+
+// NS2 includes
+#include "../headers/config.hpp"
+#include "../headers/encodedSciData.hpp"
+#include "../headers/flashDevice.hpp"
+#include "../headers/recordStore.hpp"
+#include "../headers/fileCatalog.hpp"
+#include "../headers/windowCache.hpp"
+#include "../headers/dataCollection.hpp"
+#include "testFixtures.hpp"
+
+const int WC_TEST_SECTOR_SIZE = 65536;
+const int WC_TEST_SECTORS = 2;
+
+/* - - - - - - testCacheLru - - - - - - *
+ * Usage:
+ * the least recently used window is replaced, a window is only found for the record seq it was
+ * written as, and invalidating a slot drops it
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testCacheLru() {
+    static WindowCache cache;
+    WindowSummary summary;
+    for (int i = 0; i < EncodedSciData::PAGED_MEMSIZE; i++) { testPages[i] = (uint8_t)(i * 13); }
+
+    // fill, then use the first so the second is the oldest
+    for (int slot = 0; slot < WINDOW_CACHE_WINDOWS; slot++) {
+        summary.timestamp = slot;
+        cache.put(slot, 100 + slot, testPages, summary);
+    }
+    cache.get(0, 100);
+    cache.put(WINDOW_CACHE_WINDOWS, 200, testPages, summary);
+    if (cache.count() != WINDOW_CACHE_WINDOWS || cache.get(0, 100) == nullptr
+        || (WINDOW_CACHE_WINDOWS > 1 && cache.peek(1, 101) != nullptr) || cache.get(WINDOW_CACHE_WINDOWS, 200) == nullptr
+        || cache.getStats().evictions != 1) {
+        Serial.println("Least recently used window not replaced (window cache)");
+        return 1;
+    }
+
+    // another record in the slot, or the slot emptied
+    WindowCacheStats before = cache.getStats();
+    if (cache.get(0, 101) != nullptr || cache.getStats().misses != before.misses + 1
+        || !cache.getSummary(0, 100, summary) || summary.timestamp != 0
+        || memcmp(cache.peek(0, 100), testPages, EncodedSciData::PAGED_MEMSIZE) != 0) {
+        Serial.println("Window found for another record (window cache)");
+        return 1;
+    }
+    cache.invalidate(0);
+    if (cache.peek(0, 100) != nullptr || cache.getStats().invalidations != 1) {
+        Serial.println("Window not dropped (window cache)");
+        return 1;
+    }
+
+    uint16_t samples[] = {10, 4, 30, 16};
+    summary = WindowCache::summarize(samples, 4, 77);
+    if (summary.samples != 4 || summary.minSample != 4 || summary.maxSample != 30 || summary.meanSample != 15
+        || summary.timestamp != 77) {
+        Serial.println("Window summary incorrect (window cache)");
+        return 1;
+    }
+    return 0;
+}
+
+/* - - - - - - testCacheSavedRead - - - - - - *
+ * Usage:
+ * measures reading a science file from flash against taking it from the cache, serves the
+ * newest file to quicklook from RAM, and from flash once it has left the cache
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testCacheSavedRead() {
+    EncodedSciData &file = testSciFile;
+    uint16_t *buffer = testRing;
+    for (int i = 0; i < BUFFERSIZE; i++) { buffer[i] = (uint16_t)(1000 + i % 500); }
+    unsigned long timestamp = 5555;
+    file.encodeData(buffer, timestamp);
+    file.toPages(testPages);
+
+    testFlash1.eraseAll();
+    recordStore.format(&testFlash1);
+    int slot = fileCatalog.allocate();
+    if (slot < 0) {
+        Serial.println("No catalog slot (window cache)");
+        return 1;
+    }
+    fileCatalog.setState(slot, FILE_VALID);
+    recordStore.append(RECORD_SCIENCE, slot, testPages, EncodedSciData::PAGED_MEMSIZE, true);
+    int recordIdx = recordStore.find(RECORD_SCIENCE, slot);
+    uint32_t seq = recordStore.getRecord(recordIdx).seq;
+    windowCache.clear();
+    windowCache.put(slot, seq, testPages, WindowCache::summarize(buffer, BUFFERSIZE, timestamp));
+
+    uint64_t startNanos = SimFlashDevice::getBusNanos();
+    recordStore.read(recordIdx, testReadBack, 0, EncodedSciData::PAGED_MEMSIZE);
+    uint32_t flashMicros = (uint32_t)((SimFlashDevice::getBusNanos() - startNanos) / 1000);
+    windowCache.noteFlashRead(EncodedSciData::PAGED_MEMSIZE, flashMicros);
+    uint32_t startMicros = micros();
+    const uint8_t *cached = windowCache.get(slot, seq);
+    memcpy(testReadBack, cached, EncodedSciData::PAGED_MEMSIZE);
+    uint32_t cacheMicros = micros() - startMicros;
+
+    Serial.print("Window cache: science file ");
+    Serial.print(flashMicros);
+    Serial.print(" us from flash, ");
+    Serial.print(cacheMicros);
+    Serial.print(" us from RAM, ");
+    Serial.print(windowCache.savedMicros());
+    Serial.println(" us saved");
+    int failed = 0;
+    if (memcmp(testReadBack, testPages, EncodedSciData::PAGED_MEMSIZE) != 0 || windowCache.savedMicros() != flashMicros
+        || cacheMicros * 10 > flashMicros) {
+        Serial.println("Cached file not served faster than flash (window cache)");
+        failed = 1;
+    }
+
+    WindowCacheStats before = windowCache.getStats();
+    bool cachedLook = quicklook();
+    windowCache.clear();
+    bool flashLook = quicklook();
+    WindowCacheStats after = windowCache.getStats();
+    if (!failed && (!cachedLook || !flashLook || after.hits != before.hits + 1 || after.misses != before.misses + 1)) {
+        Serial.println("Quicklook not served from cache (window cache)");
+        failed = 1;
+    }
+    fileCatalog.release(slot);
+    return failed;
+}
+
+
+/* - - - - - - windowCacheTestMain - - - - - - *
+ * Usage:
+ * runs the window cache unit tests, prints results over serial
+ *  must be kept last in file since we are not using header structure for testing
+ *
+ * Inputs:
+ *  none
+ *
+ * Outputs:
+ *  number of tests that failed in module
+ */
+int windowCacheTestMain() {
+    resetTestFlash(WC_TEST_SECTOR_SIZE, WC_TEST_SECTORS);
+    int testsFailed = 0; // iterator to track how many tests have failed
+
+    testsFailed += testCacheLru();
+    testsFailed += testCacheSavedRead();
+
+    // give back the flight record store
+    windowCache.clear();
+    initRecordStore();
+    fileCatalog.load();
+
+    // print module summary
+    Serial.print("Window Cache module: ");
+    Serial.print(testsFailed);
+    Serial.println(" tests failed");
+
+    return testsFailed;
+}
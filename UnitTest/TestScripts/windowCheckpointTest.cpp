@@ -0,0 +1,399 @@
+/* windowCheckpointTest.cpp tests the CheckpointLog class
+ * Usage:
+ *  part of NS2 unit testing suite
+ *  to be called in unitTestDriver.cpp
+ *
+ *  Checkpoints a synthetic window to the simulated flash modules, striped, simulates a reset by
+ *  clearing the buffers and reads the window back. Reports the checkpoint overhead per interval.
+ */
+
+
+// NS2 includes
+#include "../headers/config.hpp"
+#include "../headers/windowCheckpoint.hpp"
+#include "../headers/flashQueue.hpp"
+#include "../headers/timing.hpp"
+#include "testFixtures.hpp"
+
+const int CKPT_TEST_SECTOR_SIZE = 4096;
+const int CKPT_TEST_SECTORS = 32; // per module, striped each half holds more segments than a nominal window needs
+
+static CheckpointLog ckptLogs[2]; // a test's log and the one a simulated reset reads it back with
+
+// reference copy of the test buffers, kept in the scratch paged science files
+static uint16_t *const ckptRefBuffer = (uint16_t *)testPages;
+static int16_t *const ckptRefAttitude = (int16_t *)testReadBack;
+static uint8_t *const ckptRefCodes = testReadBack + sizeof(testRingAttitude);
+static_assert(sizeof(testRing) <= sizeof(testPages) && sizeof(testRingAttitude) + sizeof(testRingCodes) <= sizeof(testReadBack),
+              "the reference copy must fit in the scratch files");
+
+const int CKPT_TEST_INTERVAL_SAMPLES = SAMPLING_RATE * CHECKPOINT_INTERVAL_MSEC / 1000; // samples per nominal interval
+
+/* - - - - - - ckptTestLog - - - - - - *
+ * Usage:
+ *  returns shared log which (0 or 1) as if it was just constructed, once the flash queue is done with it
+ */
+CheckpointLog &ckptTestLog(int which) {
+    flashQueue.flush();
+    ckptLogs[which] = CheckpointLog();
+    return ckptLogs[which];
+}
+
+/* - - - - - - ckptTestKeep - - - - - - *
+ * Usage:
+ *  copies the test buffers to the reference copy
+ */
+void ckptTestKeep() {
+    memcpy(ckptRefBuffer, testRing, sizeof(testRing));
+    memcpy(ckptRefCodes, testRingCodes, sizeof(testRingCodes));
+    memcpy(ckptRefAttitude, testRingAttitude, sizeof(testRingAttitude));
+}
+
+/* - - - - - - ckptTestFill - - - - - - *
+ * Usage:
+ *  adds count synthetic samples to the test buffers starting at bufIdx, returns the new bufIdx
+ */
+int ckptTestFill(int bufIdx, int count, uint32_t &sampleNum) {
+    for (int i = 0; i < count; i++) {
+        testRing[bufIdx] = (uint16_t)(sampleNum * 7);
+        testRingAttitude[bufIdx] = (int16_t)(sampleNum % 1000);
+        int shift = 2 * (bufIdx % RATE_CODES_PER_BYTE);
+        uint8_t code = sampleNum % ADAPTIVE_RATE_COUNT;
+        testRingCodes[bufIdx / RATE_CODES_PER_BYTE] = (testRingCodes[bufIdx / RATE_CODES_PER_BYTE] & ~(0b11 << shift)) | (code << shift);
+        bufIdx = (bufIdx + 1) % BUFFERSIZE;
+        sampleNum++;
+    }
+    return bufIdx;
+}
+
+/* - - - - - - ckptTestCheckpoint - - - - - - *
+ * Usage:
+ *  runs one checkpoint interval to the end, letting the flash queue program each batch of segments
+ */
+void ckptTestCheckpoint(CheckpointLog &log, int bufIdx) {
+    log.requestCheckpoint();
+    while (log.isRequested()) {
+        log.checkpoint(testRing, testRingCodes, testRingAttitude, bufIdx);
+        flashQueue.flush();
+    }
+}
+
+/* - - - - - - ckptTestRun - - - - - - *
+ * Usage:
+ *  starts a window on a blank flash module, fills intervals worth of samples, checkpointing
+ *  after each interval, then adds lostSamples that are never checkpointed. Returns the final bufIdx.
+ */
+int ckptTestRun(CheckpointLog &log, int intervals, int lostSamples) {
+    uint32_t sampleNum = 0;
+    int bufIdx = 0;
+    memset(testRing, 0, sizeof(testRing));
+    memset(testRingCodes, 0, sizeof(testRingCodes));
+    memset(testRingAttitude, 0, sizeof(testRingAttitude));
+
+    testFlash1.eraseAll();
+    testFlash2.eraseAll();
+    log.attach(&testFlashPair);
+    log.recover(nullptr, nullptr, nullptr, 0);
+    log.begin(SUNRISE_MODE, 1, bufIdx);
+    for (int i = 0; i < intervals; i++) {
+        bufIdx = ckptTestFill(bufIdx, CKPT_TEST_INTERVAL_SAMPLES, sampleNum);
+        ckptTestCheckpoint(log, bufIdx);
+    }
+    return ckptTestFill(bufIdx, lostSamples, sampleNum);
+}
+
+/* - - - - - - ckptTestReboot - - - - - - *
+ * Usage:
+ *  clears the test buffers as a reset would and reads the window that began in windowEpoch
+ *  back into them with a new log
+ */
+RecoveredWindow ckptTestReboot(CheckpointLog &rebootedLog, uint32_t windowEpoch) {
+    memset(testRing, 0, sizeof(testRing));
+    memset(testRingCodes, 0, sizeof(testRingCodes));
+    memset(testRingAttitude, 0, sizeof(testRingAttitude));
+    rebootedLog.attach(&testFlashPair);
+    return rebootedLog.recover(testRing, testRingCodes, testRingAttitude, windowEpoch);
+}
+
+/* - - - - - - ckptTestCompare - - - - - - *
+ * Usage:
+ *  checks that the recovered buffers match the reference copy at every checkpointed sample
+ */
+bool ckptTestCompare(int firstIdx, int count) {
+    for (int i = 0; i < count; i++) {
+        int idx = (firstIdx + i) % BUFFERSIZE;
+        uint8_t refCode = (ckptRefCodes[idx / RATE_CODES_PER_BYTE] >> (2 * (idx % RATE_CODES_PER_BYTE))) & 0b11;
+        uint8_t code = (testRingCodes[idx / RATE_CODES_PER_BYTE] >> (2 * (idx % RATE_CODES_PER_BYTE))) & 0b11;
+        if (ckptRefBuffer[idx] != testRing[idx] || ckptRefAttitude[idx] != testRingAttitude[idx] || refCode != code) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* - - - - - - testCheckpointRecover - - - - - - *
+ * Usage:
+ * checkpoints part of a window, "resets" and checks that only the samples after the
+ * last checkpoint are lost
+ * 
+ * Inputs:
+ *  none
+ *  
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testCheckpointRecover() {
+    CheckpointLog &log = ckptTestLog(0);
+    const int intervals = 10;
+    const int lostSamples = CKPT_TEST_INTERVAL_SAMPLES - 1; // reset just before the next checkpoint
+
+    ckptTestRun(log, intervals, lostSamples);
+    ckptTestKeep();
+
+    CheckpointLog &rebootedLog = ckptTestLog(1);
+    RecoveredWindow window = ckptTestReboot(rebootedLog, log.getWindowEpoch());
+
+    const int expected = intervals * CKPT_TEST_INTERVAL_SAMPLES;
+    if (!window.found || window.mode != SUNRISE_MODE || window.samples != expected || window.bufIdx != expected) {
+        Serial.println("Checkpointed window not recovered (window checkpoint)");
+        return 1;
+    }
+    if (!ckptTestCompare(0, expected)) {
+        Serial.println("Recovered samples do not match (window checkpoint)");
+        return 1;
+    }
+    Serial.print("Checkpoint reset lost ");
+    Serial.print(lostSamples);
+    Serial.print(" of ");
+    Serial.print(expected + lostSamples);
+    Serial.println(" samples");
+
+    rebootedLog.end();
+    flashQueue.flush();
+    return 0;
+}
+
+/* - - - - - - testCheckpointRebase - - - - - - *
+ * Usage:
+ * runs a window long enough to fill the log, the newest BUFFERSIZE samples must still be recovered
+ * 
+ * Inputs:
+ *  none
+ *  
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testCheckpointRebase() {
+    CheckpointLog &log = ckptTestLog(0);
+    log.attach(&testFlashPair);
+    const int intervals = log.getHalfSegments() + 5; // at least one segment per interval
+
+    int bufIdx = ckptTestRun(log, intervals, 0);
+    ckptTestKeep();
+
+    CheckpointLog &rebootedLog = ckptTestLog(1);
+    RecoveredWindow window = ckptTestReboot(rebootedLog, log.getWindowEpoch());
+
+    if (log.getStats().rebases == 0) {
+        Serial.println("Checkpoint log never rebased (window checkpoint)");
+        return 1;
+    }
+    if (!window.found || window.bufIdx != bufIdx || !ckptTestCompare(0, BUFFERSIZE)) {
+        Serial.println("Rebased window not recovered (window checkpoint)");
+        return 1;
+    }
+    rebootedLog.end();
+    flashQueue.flush();
+    return 0;
+}
+
+/* - - - - - - testCheckpointInterruptedRebase - - - - - - *
+ * Usage:
+ * resets part way through a rebase, the old half must still supply the newest samples and the
+ * resumed log must finish the rebase before it appends new ones
+ * 
+ * Inputs:
+ *  none
+ *  
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testCheckpointInterruptedRebase() {
+    CheckpointLog &log = ckptTestLog(0);
+    log.attach(&testFlashPair);
+    const int intervals = log.getHalfSegments(); // fills the first half, one segment per interval
+
+    uint32_t sampleNum = 1000000;
+    int bufIdx = ckptTestRun(log, intervals, 0);
+    int oldEnd = bufIdx;
+
+    // the next interval starts the rebase, reset once the flash queue has taken its first batch
+    bufIdx = ckptTestFill(bufIdx, CKPT_TEST_INTERVAL_SAMPLES, sampleNum);
+    int rebaseStart = bufIdx;
+    log.requestCheckpoint();
+    log.checkpoint(testRing, testRingCodes, testRingAttitude, bufIdx);
+    flashQueue.flush();
+    if (log.getStats().rebases != 1 || !log.isRequested()) {
+        Serial.println("Rebase did not start (window checkpoint)");
+        return 1;
+    }
+    ckptTestKeep();
+
+    uint32_t windowEpoch = log.getWindowEpoch();
+    CheckpointLog &rebootedLog = ckptTestLog(1);
+    RecoveredWindow window = ckptTestReboot(rebootedLog, windowEpoch);
+    int kept = BUFFERSIZE - CKPT_TEST_INTERVAL_SAMPLES; // the interval that started the rebase was never written
+    bool match = true;
+    for (int i = 0; i < kept && match; i++) {
+        int idx = (rebaseStart + i) % BUFFERSIZE;
+        match = ckptRefBuffer[idx] == testRing[idx];
+    }
+    if (!window.found || window.bufIdx != oldEnd || !match) {
+        Serial.println("Window not recovered from an interrupted rebase (window checkpoint)");
+        return 1;
+    }
+
+    // resume from the newest recovered sample, the rebase is finished first
+    rebootedLog.resume();
+    bufIdx = window.bufIdx;
+    for (int i = 0; i < 3; i++) {
+        bufIdx = ckptTestFill(bufIdx, CKPT_TEST_INTERVAL_SAMPLES, sampleNum);
+        ckptTestCheckpoint(rebootedLog, bufIdx);
+    }
+    ckptTestKeep();
+
+    CheckpointLog &secondLog = ckptTestLog(0); // the first log is done with
+    window = ckptTestReboot(secondLog, windowEpoch);
+    if (!window.found || window.bufIdx != bufIdx || memcmp(ckptRefBuffer, testRing, sizeof(testRing)) != 0) {
+        Serial.println("Resumed rebase not recovered (window checkpoint)");
+        return 1;
+    }
+    secondLog.end();
+    flashQueue.flush();
+    return 0;
+}
+
+/* - - - - - - testCheckpointNextWindow - - - - - - *
+ * Usage:
+ * ends a window, the log must be erased behind it in the background so the next window
+ * starts on an erased half, and only the next window's samples are recovered after a reset
+ * 
+ * Inputs:
+ *  none
+ *  
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testCheckpointNextWindow() {
+    CheckpointLog &log = ckptTestLog(0);
+    ckptTestRun(log, 10, 0);
+    flashQueue.flush();
+
+    log.end();
+    while (log.isDirty()) {
+        flashQueue.flush();
+        log.service();
+    }
+    flashQueue.flush();
+    for (uint32_t i = 0; i < testFlash1.capacity(); i++) {
+        if (testFlashMemory1[i] != 0xFF || testFlashMemory2[i] != 0xFF) {
+            Serial.println("Checkpoint log not erased after the window ended (window checkpoint)");
+            return 1;
+        }
+    }
+
+    // next window, no erase is queued ahead of its first segment
+    uint32_t erased = testFlash1.getSectorsErased();
+    uint32_t sampleNum = 0;
+    int bufIdx = 100;
+    log.begin(SUNSET_MODE, 2, bufIdx);
+    for (int i = 0; i < 2; i++) {
+        bufIdx = ckptTestFill(bufIdx, CKPT_TEST_INTERVAL_SAMPLES, sampleNum);
+        ckptTestCheckpoint(log, bufIdx);
+    }
+    if (testFlash1.getSectorsErased() != erased) {
+        Serial.println("Next window waited on an erase (window checkpoint)");
+        return 1;
+    }
+
+    CheckpointLog &rebootedLog = ckptTestLog(1);
+    RecoveredWindow window = ckptTestReboot(rebootedLog, log.getWindowEpoch());
+    if (!window.found || window.mode != SUNSET_MODE || window.samples != 2 * CKPT_TEST_INTERVAL_SAMPLES || window.bufIdx != bufIdx) {
+        Serial.println("Next window not recovered on its own (window checkpoint)");
+        return 1;
+    }
+    rebootedLog.end();
+    flashQueue.flush();
+    return 0;
+}
+
+/* - - - - - - testCheckpointOverhead - - - - - - *
+ * Usage:
+ * measures the time and flash written per checkpoint interval at the nominal sampling rate
+ * 
+ * Inputs:
+ *  none
+ *  
+ * Outputs:
+ *  0 - pass
+ *  1 - fail
+ */
+int testCheckpointOverhead() {
+    CheckpointLog &log = ckptTestLog(0);
+    const int intervals = WINDOW_LENGTH_MSEC / CHECKPOINT_INTERVAL_MSEC; // one full sunrise window
+
+    ckptTestRun(log, intervals, 0);
+    CheckpointStats stats = log.getStats();
+    log.end();
+
+    Serial.print("Checkpoint overhead: ");
+    Serial.print(stats.totalMicros / max(stats.intervals, (uint32_t)1));
+    Serial.print(" us mean, ");
+    Serial.print(stats.maxMicros);
+    Serial.print(" us max, ");
+    Serial.print(stats.bytes / max(stats.intervals, (uint32_t)1));
+    Serial.print(" bytes per ");
+    Serial.print(CHECKPOINT_INTERVAL_MSEC);
+    Serial.println(" ms interval");
+
+    if (stats.intervals != (uint32_t)intervals || stats.rebases != 0) {
+        Serial.println("A nominal window does not fit the checkpoint log (window checkpoint)");
+        return 1;
+    }
+    return 0;
+}
+
+
+/* - - - - - - windowCheckpointTestMain - - - - - - *
+ * Usage:
+ * runs the window checkpoint unit tests, prints results over serial
+ *  must be kept last in file since we are not using header structure for testing
+ * 
+ * Inputs:
+ *  none
+ *  
+ * Outputs:
+ *  number of tests that failed in module
+ */
+int windowCheckpointTestMain() {
+    resetTestFlash(CKPT_TEST_SECTOR_SIZE, CKPT_TEST_SECTORS);
+    testFlashPair.setMode(STORAGE_STRIPED);
+    int testsFailed = 0; // iterator to track how many tests have failed
+
+    testsFailed += testCheckpointRecover();
+    testsFailed += testCheckpointRebase();
+    testsFailed += testCheckpointInterruptedRebase();
+    testsFailed += testCheckpointNextWindow();
+    testsFailed += testCheckpointOverhead();
+
+    // print module summary
+    Serial.print("Window Checkpoint module: ");
+    Serial.print(testsFailed);
+    Serial.println(" tests failed");
+
+    return testsFailed;
+}
@@ -11,6 +11,25 @@
 int timingTestMain();
 int commandTestMain();
 int encodedSciDataTestMain();
+int adaptiveSamplingTestMain();
+int burstCaptureTestMain();
+int attitudeFusionTestMain();
+int windowCheckpointTestMain();
+int fileCatalogTestMain();
+int recordStoreTestMain();
+int dualFlashTestMain();
+int flashQueueTestMain();
+int pagedLayoutTestMain();
+int scrubberTestMain();
+int crcTestMain();
+int windowCacheTestMain();
+int retentionTestMain();
+int hkHistoryTestMain();
+int blackBoxTestMain();
+int spiBusTestMain();
+int downlinkFrameTestMain();
+int downlinkTransferTestMain();
+int downlinkSchedulerTestMain();
 
 /* - - - - - - main - - - - - - *
  * Usage:
@@ -31,6 +50,25 @@ int main() {
     testFailCount += timingTestMain();
     testFailCount += commandTestMain();
     testFailCount += encodedSciDataTestMain();
+    testFailCount += adaptiveSamplingTestMain();
+    testFailCount += burstCaptureTestMain();
+    testFailCount += attitudeFusionTestMain();
+    testFailCount += windowCheckpointTestMain();
+    testFailCount += fileCatalogTestMain();
+    testFailCount += recordStoreTestMain();
+    testFailCount += dualFlashTestMain();
+    testFailCount += flashQueueTestMain();
+    testFailCount += pagedLayoutTestMain();
+    testFailCount += scrubberTestMain();
+    testFailCount += crcTestMain();
+    testFailCount += windowCacheTestMain();
+    testFailCount += retentionTestMain();
+    testFailCount += hkHistoryTestMain();
+    testFailCount += blackBoxTestMain();
+    testFailCount += spiBusTestMain();
+    testFailCount += downlinkFrameTestMain();
+    testFailCount += downlinkTransferTestMain();
+    testFailCount += downlinkSchedulerTestMain();
 
     // print summary of test results
     Serial.println("\n - - - - Unit Test Summary - - - - -");